@@ -0,0 +1,159 @@
+/**
+ * @file bench.c
+ * Thread-Metric style RTOS benchmark suite.
+ *
+ * Runs the benchmark selected by BENCH_TEST, printing the operations it
+ * completed and the context switches taken in each reporting window.
+ * Benchmarks whose counters should advance at the same rate also report any
+ * counter more than 10% away from the average, which points to a scheduling
+ * fault.
+ *
+ * Expected output (counts vary):
+ * Cooperative switching: period 1, 5823410 ops, 194113 ops/s, 5823412 switches
+ * Cooperative switching: period 2, 5823395 ops, 194113 ops/s, 5823397 switches
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <sys/task/task.h>
+#include <util/logging/logging.h>
+
+#include "bench.h"
+
+#ifndef BENCH_TEST
+#define BENCH_TEST "cooperative"
+#endif
+
+static const char *TAG = "bench";
+
+volatile uint32_t bench_counters[BENCH_NUM_COUNTERS];
+
+static const bench_t benchmarks[] = {
+    {"cooperative", "Cooperative switching", bench_cooperative_start, 5, true},
+    {"preemptive", "Preemptive switching", bench_preemptive_start, 5, true},
+    {"handoff", "Batched handoff", bench_handoff_start, 1, false},
+    {"handoff_threshold", "Batched handoff with preemption threshold",
+     bench_handoff_threshold_start, 1, false},
+    {"interrupt", "Interrupt processing", bench_interrupt_start, 2, true},
+    {"interrupt_preempt", "Interrupt preemption processing",
+     bench_interrupt_preempt_start, 2, true},
+    {"message", "Message passing", bench_message_start, 1, false},
+    {"sync", "Synchronization", bench_sync_start, 1, false},
+    {"memory", "Memory allocation", bench_memory_start, 1, false},
+};
+
+/**
+ * Initializes system clock
+ */
+static void system_init() {
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    clock_init(&clk_cfg);
+}
+
+/**
+ * Reporting task entry point. Prints operations completed by the benchmark
+ * every reporting window.
+ * @param arg: benchmark being run
+ */
+static void report_task(void *arg) {
+    const bench_t *bench = (const bench_t *)arg;
+    uint32_t last[BENCH_NUM_COUNTERS] = {0};
+    uint32_t delta[BENCH_NUM_COUNTERS];
+    uint32_t i, now, total, average, period = 0;
+    uint32_t switches, last_switches = get_context_switches();
+    while (1) {
+        task_delay(BENCH_WINDOW_MS);
+        period++;
+        total = 0;
+        now = get_context_switches();
+        switches = now - last_switches;
+        last_switches = now;
+        // Counters are never reset, so take differences to allow wrapping
+        for (i = 0; i < bench->num_counters; i++) {
+            now = bench_counters[i];
+            delta[i] = now - last[i];
+            last[i] = now;
+            total += delta[i];
+        }
+        printf("%s: period %lu, %lu ops, %lu ops/s, %lu switches\n",
+               bench->title, period, total,
+               (uint32_t)((uint64_t)total * 1000 / BENCH_WINDOW_MS), switches);
+        if (!bench->fair) {
+            continue;
+        }
+        average = total / bench->num_counters;
+        for (i = 0; i < bench->num_counters; i++) {
+            if (delta[i] < average - average / 10 ||
+                delta[i] > average + average / 10) {
+                printf("%s: counter %lu unbalanced, %lu ops\n", bench->title,
+                       i, delta[i]);
+            }
+        }
+    }
+}
+
+/**
+ * Creates a benchmark task
+ * @param entry: task entry point
+ * @param index: counter index, passed to the task as its argument
+ * @param priority: task priority
+ * @return SYS_OK on success, or ERR_FAIL if the task could not be created
+ */
+syserr_t bench_task_create(void (*entry)(void *), uint32_t index,
+                           uint32_t priority) {
+    return bench_task_create_threshold(entry, index, priority, priority);
+}
+
+/**
+ * Creates a benchmark task with a preemption threshold
+ * @param entry: task entry point
+ * @param index: counter index, passed to the task as its argument
+ * @param priority: task priority
+ * @param threshold: task preemption threshold
+ * @return SYS_OK on success, or ERR_FAIL if the task could not be created
+ */
+syserr_t bench_task_create_threshold(void (*entry)(void *), uint32_t index,
+                                     uint32_t priority, uint32_t threshold) {
+    task_config_t conf = DEFAULT_TASK_CONFIG;
+    conf.task_name = "Bench Task";
+    conf.task_priority = priority;
+    conf.task_preempt_threshold = threshold;
+    if (task_create(entry, (void *)(uintptr_t)index, &conf) == NULL) {
+        return ERR_FAIL;
+    }
+    return SYS_OK;
+}
+
+/**
+ * Benchmark entry point. Starts the selected benchmark and reporting task
+ */
+int main() {
+    task_config_t report_conf = DEFAULT_TASK_CONFIG;
+    const bench_t *bench = NULL;
+    uint32_t i;
+    system_init();
+    for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (strcmp(benchmarks[i].name, BENCH_TEST) == 0) {
+            bench = &benchmarks[i];
+        }
+    }
+    if (bench == NULL) {
+        LOG_E(TAG, "Unknown benchmark %s", BENCH_TEST);
+        return ERR_BADPARAM;
+    }
+    report_conf.task_name = "Report Task";
+    report_conf.task_priority = BENCH_REPORT_PRIORITY;
+    if (task_create(report_task, (void *)bench, &report_conf) == NULL) {
+        LOG_E(TAG, "Failed to create report task");
+        return ERR_FAIL;
+    }
+    if (bench->start() != SYS_OK) {
+        LOG_E(TAG, "Failed to start benchmark %s", bench->name);
+        return ERR_FAIL;
+    }
+    rtos_start();
+    return SYS_OK;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file bench.h
+ * Thread-Metric style RTOS benchmark suite.
+ *
+ * Each benchmark creates tasks (and optionally an interrupt) that increment
+ * counters as fast as they can. A reporting task at the highest priority
+ * wakes every BENCH_WINDOW_MS, and prints how many operations completed
+ * within the window. One benchmark is built per program, selected with
+ * "make BENCH=name".
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/err.h>
+#include <sys/task/task.h>
+
+/** Maximum number of counters a benchmark may use */
+#define BENCH_NUM_COUNTERS 5
+
+/**
+ * Length of a reporting window in ms.
+ * Set by passing -DBENCH_WINDOW_MS=val
+ */
+#ifndef BENCH_WINDOW_MS
+#define BENCH_WINDOW_MS 30000
+#endif
+
+/** Priority of the reporting task. Benchmark tasks must run below this */
+#define BENCH_REPORT_PRIORITY (RTOS_PRIORITY_COUNT - 1)
+
+/**
+ * Benchmark description
+ */
+typedef struct {
+    const char *name;        /*!< Name used to select the benchmark */
+    const char *title;       /*!< Title printed in reports */
+    syserr_t (*start)(void); /*!< Creates benchmark tasks and interrupts */
+    uint32_t num_counters;   /*!< Number of counters the benchmark uses */
+    bool fair; /*!< Counters should advance at the same rate */
+} bench_t;
+
+/**
+ * Benchmark operation counters. Each is incremented by a single task or
+ * interrupt, and read by the reporting task.
+ */
+extern volatile uint32_t bench_counters[BENCH_NUM_COUNTERS];
+
+/**
+ * Starts the cooperative switching benchmark. Five tasks of equal priority
+ * increment a counter and yield in turn.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_cooperative_start(void);
+
+/**
+ * Starts the preemptive switching benchmark. Five tasks of increasing
+ * priority each wake the next, so every wake preempts the waker.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_preemptive_start(void);
+
+/**
+ * Starts the interrupt processing benchmark. A task raises an interrupt,
+ * whose handler posts a semaphore the same task then takes.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_interrupt_start(void);
+
+/**
+ * Starts the interrupt preemption benchmark. A task raises an interrupt,
+ * whose handler posts a semaphore that wakes a higher priority task.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_interrupt_preempt_start(void);
+
+/**
+ * Starts the message passing benchmark. A task sends a 16 byte message to a
+ * queue, then receives it back.
+ * @return SYS_OK on success, or an error if the queue could not be created
+ */
+syserr_t bench_message_start(void);
+
+/**
+ * Starts the synchronization benchmark. A task takes and gives back an
+ * uncontended semaphore.
+ * @return SYS_OK on success, or an error if the semaphore could not be created
+ */
+syserr_t bench_sync_start(void);
+
+/**
+ * Starts the memory allocation benchmark. A task allocates and frees a 128
+ * byte block.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_memory_start(void);
+
+/**
+ * Starts the batched handoff benchmark. A producer posts a batch of items to
+ * a higher priority consumer, then yields. Every post preempts the producer.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_handoff_start(void);
+
+/**
+ * Starts the batched handoff benchmark with the producer's preemption
+ * threshold raised to the consumer's priority, so the consumer only runs once
+ * the producer yields, and takes the whole batch in one switch.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_handoff_threshold_start(void);
+
+/**
+ * Creates a benchmark task
+ * @param entry: task entry point
+ * @param index: counter index, passed to the task as its argument
+ * @param priority: task priority
+ * @return SYS_OK on success, or ERR_FAIL if the task could not be created
+ */
+syserr_t bench_task_create(void (*entry)(void *), uint32_t index,
+                           uint32_t priority);
+
+/**
+ * Creates a benchmark task with a preemption threshold
+ * @param entry: task entry point
+ * @param index: counter index, passed to the task as its argument
+ * @param priority: task priority
+ * @param threshold: task preemption threshold
+ * @return SYS_OK on success, or ERR_FAIL if the task could not be created
+ */
+syserr_t bench_task_create_threshold(void (*entry)(void *), uint32_t index,
+                                     uint32_t priority, uint32_t threshold);
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * @file handoff.c
+ * Batched handoff benchmarks, with and without a preemption threshold.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+
+#include "bench.h"
+
+/** Items the producer posts before yielding */
+#define HANDOFF_BATCH 8
+/** Priority of the producer. The consumer runs one level above it */
+#define PRODUCER_PRIORITY DEFAULT_PRIORITY
+
+// Counting semaphore holding the items posted but not yet consumed
+static semaphore_t items_sem;
+
+static syserr_t handoff_start(uint32_t producer_threshold);
+static void producer_task(void *arg);
+static void consumer_task(void *arg);
+
+/**
+ * Starts the batched handoff benchmark. A producer posts a batch of items to
+ * a higher priority consumer, then yields. Every post preempts the producer.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_handoff_start(void) { return handoff_start(PRODUCER_PRIORITY); }
+
+/**
+ * Starts the batched handoff benchmark with the producer's preemption
+ * threshold raised to the consumer's priority, so the consumer only runs once
+ * the producer yields, and takes the whole batch in one switch.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_handoff_threshold_start(void) {
+    return handoff_start(PRODUCER_PRIORITY + 1);
+}
+
+/**
+ * Creates the item semaphore, producer and consumer
+ * @param producer_threshold: preemption threshold of the producer
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+static syserr_t handoff_start(uint32_t producer_threshold) {
+    syserr_t ret;
+    items_sem = semaphore_create_counting(0);
+    if (items_sem == NULL) {
+        return ERR_NOMEM;
+    }
+    ret = bench_task_create(consumer_task, 0, PRODUCER_PRIORITY + 1);
+    if (ret != SYS_OK) {
+        return ret;
+    }
+    return bench_task_create_threshold(producer_task, 0, PRODUCER_PRIORITY,
+                                       producer_threshold);
+}
+
+/**
+ * Producer task entry point. Posts a batch of items, then yields so the
+ * consumer can run if it has not already.
+ * @param arg: unused
+ */
+static void producer_task(void *arg) {
+    uint32_t i;
+    while (1) {
+        for (i = 0; i < HANDOFF_BATCH; i++) {
+            semaphore_post(items_sem);
+        }
+        task_yield();
+    }
+}
+
+/**
+ * Consumer task entry point. Takes items, counting each one.
+ * @param arg: unused
+ */
+static void consumer_task(void *arg) {
+    while (1) {
+        semaphore_pend(items_sem, SYS_TIMEOUT_INF);
+        bench_counters[0]++;
+    }
+}
@@ -0,0 +1,100 @@
+/**
+ * @file interrupt.c
+ * Interrupt processing and interrupt preemption benchmarks. Interrupts are
+ * raised from software, so no peripheral is needed.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <drivers/device/device.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+
+#include "bench.h"
+
+/** Interrupt raised by the benchmarks. Not used by any driver */
+#define BENCH_IRQ SWPMI1_IRQn
+
+// Semaphore posted by the interrupt handler
+static semaphore_t irq_sem;
+
+static syserr_t irq_start(uint32_t waiter_priority);
+static void raise_task(void *arg);
+static void wait_task(void *arg);
+static void bench_irq_handler(void);
+
+/**
+ * Starts the interrupt processing benchmark. A task raises an interrupt,
+ * whose handler posts a semaphore the same task then takes.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_interrupt_start(void) { return irq_start(0); }
+
+/**
+ * Starts the interrupt preemption benchmark. A task raises an interrupt,
+ * whose handler posts a semaphore that wakes a higher priority task.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_interrupt_preempt_start(void) {
+    return irq_start(DEFAULT_PRIORITY + 1);
+}
+
+/**
+ * Creates the benchmark semaphore and tasks, and installs the interrupt
+ * @param waiter_priority: priority of a separate task waiting on the
+ * interrupt, or 0 for the raising task to wait itself
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+static syserr_t irq_start(uint32_t waiter_priority) {
+    syserr_t ret;
+    irq_sem = semaphore_create_binary();
+    if (irq_sem == NULL) {
+        return ERR_NOMEM;
+    }
+    ret = bench_task_create(raise_task, waiter_priority == 0,
+                            DEFAULT_PRIORITY);
+    if (ret == SYS_OK && waiter_priority != 0) {
+        ret = bench_task_create(wait_task, 0, waiter_priority);
+    }
+    if (ret != SYS_OK) {
+        return ret;
+    }
+    enable_irq(BENCH_IRQ, bench_irq_handler);
+    return SYS_OK;
+}
+
+/**
+ * Raising task entry point. Counts in counter 0, then raises the interrupt.
+ * @param arg: nonzero if this task should take the semaphore itself, and
+ * count in counter 1 once it has
+ */
+static void raise_task(void *arg) {
+    bool self_wait = (uint32_t)(uintptr_t)arg != 0;
+    while (1) {
+        bench_counters[0]++;
+        NVIC->STIR = BENCH_IRQ;
+        if (self_wait) {
+            semaphore_pend(irq_sem, SYS_TIMEOUT_INF);
+            bench_counters[1]++;
+        }
+    }
+}
+
+/**
+ * Waiting task entry point. Preempts the raising task each time the
+ * interrupt posts, and counts in counter 1.
+ * @param arg: unused
+ */
+static void wait_task(void *arg) {
+    while (1) {
+        semaphore_pend(irq_sem, SYS_TIMEOUT_INF);
+        bench_counters[1]++;
+    }
+}
+
+/**
+ * Benchmark interrupt handler. Posts the benchmark semaphore.
+ */
+static void bench_irq_handler(void) { semaphore_post(irq_sem); }
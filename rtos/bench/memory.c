@@ -0,0 +1,45 @@
+/**
+ * @file memory.c
+ * Memory allocation benchmark. The RTOS has no block pools, so blocks come
+ * from the heap allocator.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <util/logging/logging.h>
+
+#include "bench.h"
+
+/** Allocated block size, matching Thread-Metric's block pool */
+#define BLOCK_SIZE 128
+
+static const char *TAG = "bench_memory";
+
+static void memory_task(void *arg);
+
+/**
+ * Starts the memory allocation benchmark. A task allocates and frees a 128
+ * byte block.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_memory_start(void) {
+    return bench_task_create(memory_task, 0, DEFAULT_PRIORITY);
+}
+
+/**
+ * Memory task entry point. Allocates and frees a block.
+ * @param arg: unused
+ */
+static void memory_task(void *arg) {
+    void *block;
+    while (1) {
+        block = malloc(BLOCK_SIZE);
+        if (block == NULL) {
+            LOG_E(TAG, "Could not allocate block");
+            return;
+        }
+        free(block);
+        bench_counters[0]++;
+    }
+}
@@ -0,0 +1,68 @@
+/**
+ * @file message.c
+ * Message passing benchmark. The RTOS has no message queue, so the queue is
+ * a ring buffer of fixed size messages, with a counting semaphore tracking
+ * queued messages as a message queue would.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/semaphore/semaphore.h>
+#include <util/logging/logging.h>
+#include <util/ringbuf/ringbuf.h>
+
+#include "bench.h"
+
+/** Message size in bytes, matching Thread-Metric's four word messages */
+#define MESSAGE_SIZE 16
+/** Messages the queue can hold */
+#define QUEUE_DEPTH 4
+
+static const char *TAG = "bench_message";
+
+static RingBuf_t queue_buf;
+static uint8_t queue_store[MESSAGE_SIZE * QUEUE_DEPTH];
+static semaphore_t queue_sem;
+
+static void message_task(void *arg);
+
+/**
+ * Starts the message passing benchmark. A task sends a 16 byte message to a
+ * queue, then receives it back.
+ * @return SYS_OK on success, or an error if the queue could not be created
+ */
+syserr_t bench_message_start(void) {
+    syserr_t ret;
+    ret = buf_init(&queue_buf, queue_store, sizeof(queue_store));
+    if (ret != SYS_OK) {
+        return ret;
+    }
+    queue_sem = semaphore_create_counting(0);
+    if (queue_sem == NULL) {
+        return ERR_NOMEM;
+    }
+    return bench_task_create(message_task, 0, DEFAULT_PRIORITY);
+}
+
+/**
+ * Message task entry point. Sends a message, receives it back, and checks
+ * it was not corrupted.
+ * @param arg: unused
+ */
+static void message_task(void *arg) {
+    uint32_t sent[MESSAGE_SIZE / sizeof(uint32_t)] = {0};
+    uint32_t received[MESSAGE_SIZE / sizeof(uint32_t)];
+    while (1) {
+        sent[0]++;
+        buf_writeblock(&queue_buf, (uint8_t *)sent, MESSAGE_SIZE);
+        semaphore_post(queue_sem);
+        semaphore_pend(queue_sem, SYS_TIMEOUT_INF);
+        buf_readblock(&queue_buf, (uint8_t *)received, MESSAGE_SIZE);
+        if (memcmp(sent, received, MESSAGE_SIZE) != 0) {
+            LOG_E(TAG, "Received corrupted message");
+            return;
+        }
+        bench_counters[0]++;
+    }
+}
@@ -0,0 +1,94 @@
+/**
+ * @file switching.c
+ * Cooperative and preemptive context switching benchmarks.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+
+#include "bench.h"
+
+/** Number of tasks switched between */
+#define SWITCH_TASKS 5
+/** Priority of the lowest priority preemptive task */
+#define PREEMPT_BASE_PRIORITY (BENCH_REPORT_PRIORITY - SWITCH_TASKS)
+
+// Semaphore each preemptive task waits on. The lowest priority task never waits
+static semaphore_t preempt_sems[SWITCH_TASKS];
+
+static void cooperative_task(void *arg);
+static void preemptive_task(void *arg);
+
+/**
+ * Starts the cooperative switching benchmark. Five tasks of equal priority
+ * increment a counter and yield in turn.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_cooperative_start(void) {
+    uint32_t i;
+    syserr_t ret;
+    for (i = 0; i < SWITCH_TASKS; i++) {
+        ret = bench_task_create(cooperative_task, i, DEFAULT_PRIORITY);
+        if (ret != SYS_OK) {
+            return ret;
+        }
+    }
+    return SYS_OK;
+}
+
+/**
+ * Starts the preemptive switching benchmark. Five tasks of increasing
+ * priority each wake the next, so every wake preempts the waker.
+ * @return SYS_OK on success, or an error if tasks could not be created
+ */
+syserr_t bench_preemptive_start(void) {
+    uint32_t i;
+    syserr_t ret;
+    for (i = 1; i < SWITCH_TASKS; i++) {
+        preempt_sems[i] = semaphore_create_binary();
+        if (preempt_sems[i] == NULL) {
+            return ERR_NOMEM;
+        }
+    }
+    for (i = 0; i < SWITCH_TASKS; i++) {
+        ret = bench_task_create(preemptive_task, i, PREEMPT_BASE_PRIORITY + i);
+        if (ret != SYS_OK) {
+            return ret;
+        }
+    }
+    return SYS_OK;
+}
+
+/**
+ * Cooperative task entry point. Counts, then yields to the next task.
+ * @param arg: counter index
+ */
+static void cooperative_task(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    while (1) {
+        bench_counters[index]++;
+        task_yield();
+    }
+}
+
+/**
+ * Preemptive task entry point. Waits to be woken by the next lower priority
+ * task, counts, then wakes the next higher priority task. The highest
+ * priority task wakes nobody, so control unwinds back down to the lowest.
+ * @param arg: counter index
+ */
+static void preemptive_task(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    while (1) {
+        if (index != 0) {
+            semaphore_pend(preempt_sems[index], SYS_TIMEOUT_INF);
+        }
+        bench_counters[index]++;
+        if (index != SWITCH_TASKS - 1) {
+            semaphore_post(preempt_sems[index + 1]);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+/**
+ * @file sync.c
+ * Synchronization benchmark.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/semaphore/semaphore.h>
+
+#include "bench.h"
+
+static semaphore_t sync_sem;
+
+static void sync_task(void *arg);
+
+/**
+ * Starts the synchronization benchmark. A task takes and gives back an
+ * uncontended semaphore.
+ * @return SYS_OK on success, or an error if the semaphore could not be created
+ */
+syserr_t bench_sync_start(void) {
+    sync_sem = semaphore_create_counting(1);
+    if (sync_sem == NULL) {
+        return ERR_NOMEM;
+    }
+    return bench_task_create(sync_task, 0, DEFAULT_PRIORITY);
+}
+
+/**
+ * Synchronization task entry point. Takes and gives back the semaphore.
+ * @param arg: unused
+ */
+static void sync_task(void *arg) {
+    while (1) {
+        semaphore_pend(sync_sem, SYS_TIMEOUT_INF);
+        semaphore_post(sync_sem);
+        bench_counters[0]++;
+    }
+}
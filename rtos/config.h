@@ -41,6 +41,39 @@
 #define PREEMPTION_DISABLED 0 // Tasks cannot be preempted
 #define PREEMPTION_ENABLED 1  // Higher priority tasks will preempt
 
+/** System trace options */
+#define TRACE_DISABLED 0 // Trace hooks compile to nothing
+#define TRACE_ENABLED 1  // Kernel events are recorded in the trace buffer
+
+/** Default trace buffer length in events. Must be a power of two */
+#define SYS_TRACE_BUFLEN_DEFAULT 512
+
+/** System profiler options */
+#define PROFILE_DISABLED 0 // Profiler is not built
+#define PROFILE_ENABLED 1  // TIM7 samples the interrupted PC when started
+
+/** Default profiler buffer length in samples. Must be a power of two */
+#define SYS_PROFILE_BUFLEN_DEFAULT 1024
+
+/** Interrupt statistics options */
+#define IRQ_STATS_DISABLED 0 // Interrupts are dispatched without measurement
+#define IRQ_STATS_ENABLED 1  // Handler calls and cycles are counted per IRQ
+
+/** Semaphore statistics options */
+#define SEM_STATS_DISABLED 0 // Semaphores are not instrumented
+#define SEM_STATS_ENABLED 1  // Semaphores track contention and are registered
+
+/** Scheduling latency statistics options */
+#define LATENCY_STATS_DISABLED 0 // Wakeups are not timestamped
+#define LATENCY_STATS_ENABLED 1  // Wake to run latency is recorded per task
+
+/** Earliest deadline first scheduling options */
+#define EDF_DISABLED 0 // All tasks are scheduled by fixed priority
+#define EDF_ENABLED 1  // Tasks at SYS_EDF_PRIORITY are ordered by deadline
+
+/** Default priority level of earliest deadline first tasks */
+#define SYS_EDF_PRIORITY_DEFAULT 5
+
 /** Default system stack protection size. Can be changed */
 #define SYS_STACK_PROTECTION_SIZE_DEFAULT 16 /* 16 bytes, or 4 registers */
 
@@ -109,6 +142,94 @@
 #define SYS_USE_PREEMPTION PREEMPTION_ENABLED
 #endif
 
+/**
+ * System trace setting. If enabled, the kernel records context switches,
+ * interrupt entry and exit, semaphore operations, task creation and deletion,
+ * and user markers into a RAM ring buffer, timestamped with the DWT cycle
+ * counter. See sys/trace/trace.h.
+ * Set by passing -DSYS_USE_TRACE=val
+ */
+#ifndef SYS_USE_TRACE
+#define SYS_USE_TRACE TRACE_DISABLED
+#endif
+
+/**
+ * Trace buffer length, in 8 byte events. Once full, the oldest events are
+ * overwritten. Set by passing -DSYS_TRACE_BUFLEN=val
+ */
+#ifndef SYS_TRACE_BUFLEN
+#define SYS_TRACE_BUFLEN SYS_TRACE_BUFLEN_DEFAULT
+#endif
+
+/**
+ * System profiler setting. If enabled, profile_start samples the interrupted
+ * program counter and active task from a TIM7 interrupt, which the timer
+ * driver does not use. See sys/profile/profile.h.
+ * Set by passing -DSYS_USE_PROFILE=val
+ */
+#ifndef SYS_USE_PROFILE
+#define SYS_USE_PROFILE PROFILE_DISABLED
+#endif
+
+/**
+ * Profiler buffer length, in 8 byte samples. Once full, the oldest samples
+ * are overwritten. Set by passing -DSYS_PROFILE_BUFLEN=val
+ */
+#ifndef SYS_PROFILE_BUFLEN
+#define SYS_PROFILE_BUFLEN SYS_PROFILE_BUFLEN_DEFAULT
+#endif
+
+/**
+ * Interrupt statistics setting. If enabled, every peripheral interrupt
+ * dispatched by the default handler is counted, and the cycles spent in its
+ * handler are measured with the DWT cycle counter. See sys/isr/isr.h.
+ * Set by passing -DSYS_USE_IRQ_STATS=val
+ */
+#ifndef SYS_USE_IRQ_STATS
+#define SYS_USE_IRQ_STATS IRQ_STATS_DISABLED
+#endif
+
+/**
+ * Semaphore statistics setting. If enabled, each semaphore counts pends,
+ * contended pends and timeouts, and tracks its wait queue depth and the time
+ * tasks spend blocked on it. Live semaphores are kept in a registry that can
+ * be listed. See sys/semaphore/semaphore.h.
+ * Set by passing -DSYS_USE_SEM_STATS=val
+ */
+#ifndef SYS_USE_SEM_STATS
+#define SYS_USE_SEM_STATS SEM_STATS_DISABLED
+#endif
+
+/**
+ * Scheduling latency statistics setting. If enabled, the scheduler measures
+ * the cycles from when a task is made ready until it runs, and keeps a
+ * logarithmic histogram of them per task. See sys/task/task.h.
+ * Set by passing -DSYS_USE_LATENCY_STATS=val
+ */
+#ifndef SYS_USE_LATENCY_STATS
+#define SYS_USE_LATENCY_STATS LATENCY_STATS_DISABLED
+#endif
+
+/**
+ * Earliest deadline first scheduling setting. If enabled, tasks at priority
+ * SYS_EDF_PRIORITY form an EDF class: among them, the task whose current job
+ * has the earliest absolute deadline runs. The class still ranks above lower
+ * priorities and below higher ones. Tasks join it by being created at that
+ * priority, or by calling task_edf_release. See sys/task/task.h.
+ * Set by passing -DSYS_USE_EDF=val
+ */
+#ifndef SYS_USE_EDF
+#define SYS_USE_EDF EDF_DISABLED
+#endif
+
+/**
+ * Priority level of earliest deadline first tasks, used when SYS_USE_EDF is
+ * enabled. Set by passing -DSYS_EDF_PRIORITY=val
+ */
+#ifndef SYS_EDF_PRIORITY
+#define SYS_EDF_PRIORITY SYS_EDF_PRIORITY_DEFAULT
+#endif
+
 /**
  * System stack protection size. If nonzero, statically allocated stacks will
  * effectively be this many bytes smaller than their set size. Dynamically
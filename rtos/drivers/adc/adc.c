@@ -0,0 +1,444 @@
+/**
+ * @file adc.c
+ * Implements continuous ADC sampling for STM32L4xxxx.
+ * Conversions are triggered by a hardware timer, and samples are streamed
+ * by DMA into a double buffer. Readers are woken once per completed half.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <drivers/device/device.h>
+#include <drivers/dma/dma.h>
+#include <drivers/timer/timer.h>
+#include <sys/err.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+#include <util/bitmask.h>
+
+#include "adc.h"
+
+/**
+ * ADC device state
+ */
+typedef enum {
+    ADC_dev_closed = 0,
+    ADC_dev_open = 1,
+} ADC_state_t;
+
+/**
+ * Configuration structure for ADC devices
+ */
+typedef struct {
+    ADC_config_t cfg;           /*!< User configuration for ADC */
+    ADC_TypeDef *regs;          /*!< Register access for this ADC */
+    ADC_state_t state;          /*!< ADC state (open or closed) */
+    TIMER_handle_t timer;       /*!< Timer triggering conversions */
+    DMA_handle_t dma;           /*!< DMA channel reading conversion data */
+    uint16_t *buf;              /*!< Sample double buffer */
+    uint32_t len;               /*!< Length of sample buffer */
+    uint16_t *volatile ready;   /*!< Last completed half, or NULL if read */
+    semaphore_t ready_sem;      /*!< Posted to when a half completes */
+} ADC_status_t;
+
+/** Tick frequency of the trigger timer */
+#define ADC_TIMER_FREQ 1000000
+/** Highest ADC input channel number */
+#define ADC_MAX_CHANNEL 18
+/** EXTEN value to trigger on rising edges */
+#define ADC_EXTEN_RISING 0x1UL
+/** EXTSEL values for timer TRGO triggers (see reference manual) */
+#define ADC_EXTSEL_TIM2_TRGO 11UL
+#define ADC_EXTSEL_TIM15_TRGO 14UL
+/** CKMODE value for synchronous HCLK/2 ADC clock */
+#define ADC_CKMODE_HCLK_DIV2 0x2UL
+#define ADC_SQ_WIDTH 6
+#define ADC_SMP_WIDTH 3
+
+static ADC_status_t ADCS[NUM_ADCS] = {0};
+
+static syserr_t ADC_enable(ADC_status_t *handle);
+static void ADC_disable(ADC_status_t *handle);
+static syserr_t ADC_set_sequence(ADC_status_t *handle);
+static void ADC_dma_callback(DMA_event_t event, void *ctx);
+
+/**
+ * Opens and calibrates an ADC. Sampling does not begin until ADC_start.
+ * Channel input pins must be configured in analog mode by the caller.
+ * The sample rate is rounded to a whole number of microseconds per sequence.
+ * @param periph: ADC peripheral to open
+ * @param config: ADC configuration structure
+ * @param buf: sample double buffer. Each half receives len / 2 samples,
+ * stored in sequence order. Must remain valid until the ADC is closed.
+ * @param len: number of samples in buf. Each half must hold a whole number
+ * of sequences, and len must not exceed 65535
+ * @param err: Set on function error
+ * @return NULL on error, or an ADC handle to the open peripheral
+ */
+ADC_handle_t ADC_open(ADC_periph_t periph, ADC_config_t *config,
+                      uint16_t *buf, uint32_t len, syserr_t *err) {
+    ADC_status_t *handle;
+    TIMER_config_t timer_cfg = TIMER_DEFAULT_CONFIG;
+    DMA_config_t dma_cfg = DMA_DEFAULT_CONFIG;
+    TIMER_periph_t timer;
+    uint32_t extsel;
+    *err = SYS_OK; // Set no error until one occurs
+    /**
+     * Check parameters.
+     */
+    if (periph != ADC_1 || config == NULL || buf == NULL ||
+        config->ADC_num_channels == 0 ||
+        config->ADC_num_channels > ADC_MAX_SEQUENCE ||
+        config->ADC_sample_rate == 0 ||
+        config->ADC_sample_time > ADC_smp_640_5 || len == 0 ||
+        len > 0xFFFF || (len % (2 * config->ADC_num_channels)) != 0) {
+        *err = ERR_BADPARAM;
+        return NULL;
+    }
+    switch (config->ADC_trigger) {
+    case ADC_trigger_tim2:
+        timer = TIMER_2;
+        extsel = ADC_EXTSEL_TIM2_TRGO;
+        break;
+    case ADC_trigger_tim15:
+        timer = TIMER_15;
+        extsel = ADC_EXTSEL_TIM15_TRGO;
+        break;
+    default:
+        *err = ERR_BADPARAM;
+        return NULL;
+        break;
+    }
+    handle = &ADCS[periph];
+    if (handle->state == ADC_dev_open) {
+        *err = ERR_INUSE;
+        return NULL;
+    }
+    // Set handle state to open
+    handle->state = ADC_dev_open;
+    handle->regs = ADC1;
+    handle->timer = NULL;
+    handle->dma = NULL;
+    handle->ready_sem = NULL;
+    handle->ready = NULL;
+    handle->buf = buf;
+    handle->len = len;
+    memcpy(&handle->cfg, config, sizeof(ADC_config_t));
+    /**
+     * Create the ready semaphore even before the scheduler starts, since an
+     * ADC opened in main is usually read from a task
+     */
+    handle->ready_sem = semaphore_create_binary();
+    if (handle->ready_sem == NULL) {
+        *err = ERR_NOMEM;
+        ADC_close(handle);
+        return NULL;
+    }
+    /**
+     * The trigger timer counts at 1MHz, with its period set to the sample
+     * interval. Each update event pulses TRGO, starting a conversion sequence
+     */
+    timer_cfg.TIMER_frequency = ADC_TIMER_FREQ;
+    timer_cfg.TIMER_period = ADC_TIMER_FREQ / config->ADC_sample_rate;
+    if (timer_cfg.TIMER_period < 2) {
+        *err = ERR_BADPARAM;
+        ADC_close(handle);
+        return NULL;
+    }
+    handle->timer = TIMER_open(timer, &timer_cfg, err);
+    if (handle->timer == NULL) {
+        ADC_close(handle);
+        return NULL;
+    }
+    *err = TIMER_enable_trigger(handle->timer);
+    if (*err != SYS_OK) {
+        ADC_close(handle);
+        return NULL;
+    }
+    /* Conversion results are streamed into the buffer halves by DMA */
+    dma_cfg.DMA_request = 0;
+    dma_cfg.DMA_periph_width = DMA_width_16;
+    dma_cfg.DMA_mem_width = DMA_width_16;
+    dma_cfg.DMA_mode = DMA_mode_double_buffer;
+    dma_cfg.DMA_priority = DMA_priority_high;
+    dma_cfg.DMA_callback = ADC_dma_callback;
+    dma_cfg.DMA_callback_ctx = handle;
+    handle->dma = DMA_open(DMA1_CH1, &dma_cfg, err);
+    if (handle->dma == NULL) {
+        ADC_close(handle);
+        return NULL;
+    }
+    /**
+     * Enable the ADC clock. The synchronous HCLK/2 clock is valid for any
+     * AHB prescaler, and avoids a dependency on the PLLSAI clocks.
+     */
+    SETBITS(RCC->AHB2ENR, RCC_AHB2ENR_ADCEN);
+    MODIFY_REG(ADC1_COMMON->CCR, ADC_CCR_CKMODE,
+               ADC_CKMODE_HCLK_DIV2 << ADC_CCR_CKMODE_Pos);
+    *err = ADC_enable(handle);
+    if (*err != SYS_OK) {
+        ADC_close(handle);
+        return NULL;
+    }
+    /**
+     * Convert on rising trigger edges, with DMA requests issued in circular
+     * mode so the ADC keeps requesting after each buffer wrap
+     */
+    handle->regs->CFGR = (ADC_EXTEN_RISING << ADC_CFGR_EXTEN_Pos) |
+                         (extsel << ADC_CFGR_EXTSEL_Pos) | ADC_CFGR_DMAEN |
+                         ADC_CFGR_DMACFG | ADC_CFGR_OVRMOD;
+    *err = ADC_set_sequence(handle);
+    if (*err != SYS_OK) {
+        ADC_close(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+/**
+ * Starts timer triggered sampling into the sample buffer
+ * @param handle: ADC handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t ADC_start(ADC_handle_t handle) {
+    ADC_status_t *adc = (ADC_status_t *)handle;
+    syserr_t err;
+    if (adc == NULL || adc->state != ADC_dev_open) {
+        return ERR_BADPARAM;
+    }
+    adc->ready = NULL;
+    err = DMA_start(adc->dma, &adc->regs->DR, adc->buf, adc->len);
+    if (err != SYS_OK) {
+        return err;
+    }
+    // Arm the ADC, then start the trigger timer
+    SETBITS(adc->regs->CR, ADC_CR_ADSTART);
+    return TIMER_start(adc->timer);
+}
+
+/**
+ * Stops sampling. Samples in an incomplete half buffer are discarded.
+ * @param handle: ADC handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t ADC_stop(ADC_handle_t handle) {
+    ADC_status_t *adc = (ADC_status_t *)handle;
+    if (adc == NULL || adc->state != ADC_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (adc->timer) {
+        TIMER_stop(adc->timer);
+    }
+    if (READBITS(adc->regs->CR, ADC_CR_ADSTART)) {
+        SETBITS(adc->regs->CR, ADC_CR_ADSTP);
+        while (READBITS(adc->regs->CR, ADC_CR_ADSTP)) {
+            // Spin
+        }
+    }
+    if (adc->dma) {
+        DMA_stop(adc->dma);
+    }
+    return SYS_OK;
+}
+
+/**
+ * Waits for half of the sample buffer to be filled. The calling task sleeps
+ * until a half completes, or the read timeout expires. If the reader falls
+ * behind, older halves are dropped and the newest is returned.
+ * The returned half is overwritten after the other half completes, so
+ * samples should be processed (or copied) before then.
+ * @param handle: ADC handle
+ * @param samples: set to the completed half of the sample buffer
+ * @param err: Set on error
+ * @return number of samples in the completed half, or -1 on error
+ */
+int ADC_read(ADC_handle_t handle, uint16_t **samples, syserr_t *err) {
+    ADC_status_t *adc = (ADC_status_t *)handle;
+    ADC_timeout_t timeout;
+    uint16_t *ready;
+    *err = SYS_OK;
+    if (adc == NULL || samples == NULL || adc->state != ADC_dev_open) {
+        *err = ERR_BADPARAM;
+        return -1;
+    }
+    timeout = adc->cfg.ADC_read_timeout;
+    while (1) {
+        // Take the completed half, so it is only returned once
+        mask_irq();
+        ready = adc->ready;
+        adc->ready = NULL;
+        unmask_irq();
+        if (ready != NULL) {
+            break;
+        }
+        if (timeout == ADC_TIMEOUT_NONE) {
+            *err = ERR_TIMEOUT;
+            return -1;
+        }
+        if (rtos_started()) {
+            if (timeout == ADC_TIMEOUT_INF) {
+                semaphore_pend(adc->ready_sem, SYS_TIMEOUT_INF);
+            } else if (semaphore_pend(adc->ready_sem, timeout) != SYS_OK) {
+                // No half completed before timeout. Check once more
+                timeout = ADC_TIMEOUT_NONE;
+            }
+        } else if (timeout != ADC_TIMEOUT_INF) {
+            // RTOS is not running, so poll for a completed half
+            blocking_delay_ms(1);
+            timeout--;
+        }
+    }
+    *samples = ready;
+    return adc->len / 2;
+}
+
+/**
+ * Closes an ADC, releasing its trigger timer and DMA channel
+ * @param handle: Handle to open ADC
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t ADC_close(ADC_handle_t handle) {
+    syserr_t err;
+    ADC_status_t *adc = (ADC_status_t *)handle;
+    if (adc == NULL || adc->state != ADC_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (READBITS(RCC->AHB2ENR, RCC_AHB2ENR_ADCEN)) {
+        ADC_stop(adc);
+        ADC_disable(adc);
+        CLEARBITS(RCC->AHB2ENR, RCC_AHB2ENR_ADCEN);
+    }
+    if (adc->timer) {
+        TIMER_close(adc->timer);
+        adc->timer = NULL;
+    }
+    if (adc->dma) {
+        DMA_close(adc->dma);
+        adc->dma = NULL;
+    }
+    if (adc->ready_sem) {
+        err = semaphore_destroy(adc->ready_sem);
+        if (err != SYS_OK) {
+            return err;
+        }
+        adc->ready_sem = NULL;
+    }
+    adc->state = ADC_dev_closed;
+    return SYS_OK;
+}
+
+/**
+ * Powers up, calibrates and enables an ADC
+ * @param handle: ADC to enable
+ * @return SYS_OK on success, or error value otherwise
+ */
+static syserr_t ADC_enable(ADC_status_t *handle) {
+    // Exit deep power down and start the internal voltage regulator
+    CLEARBITS(handle->regs->CR, ADC_CR_DEEPPWD);
+    SETBITS(handle->regs->CR, ADC_CR_ADVREGEN);
+    // Regulator startup time is 20us
+    blocking_delay_ms(1);
+    // Calibrate for single ended inputs
+    CLEARBITS(handle->regs->CR, ADC_CR_ADCALDIF);
+    SETBITS(handle->regs->CR, ADC_CR_ADCAL);
+    while (READBITS(handle->regs->CR, ADC_CR_ADCAL)) {
+        // Spin
+    }
+    /**
+     * ADEN is ignored for a few ADC clock cycles after calibration, so set
+     * it until the ADC reports ready
+     */
+    handle->regs->ISR = ADC_ISR_ADRDY;
+    while (READBITS(handle->regs->ISR, ADC_ISR_ADRDY) == 0) {
+        if (READBITS(handle->regs->CR, ADC_CR_ADEN) == 0) {
+            SETBITS(handle->regs->CR, ADC_CR_ADEN);
+        }
+    }
+    handle->regs->ISR = ADC_ISR_ADRDY;
+    return SYS_OK;
+}
+
+/**
+ * Disables an ADC and returns it to deep power down
+ * @param handle: ADC to disable
+ */
+static void ADC_disable(ADC_status_t *handle) {
+    if (READBITS(handle->regs->CR, ADC_CR_ADEN)) {
+        SETBITS(handle->regs->CR, ADC_CR_ADDIS);
+        while (READBITS(handle->regs->CR, ADC_CR_ADEN)) {
+            // Spin
+        }
+    }
+    CLEARBITS(handle->regs->CR, ADC_CR_ADVREGEN);
+    SETBITS(handle->regs->CR, ADC_CR_DEEPPWD);
+}
+
+/**
+ * Programs the regular conversion sequence and channel sample times
+ * @param handle: ADC to configure
+ * @return SYS_OK on success, or ERR_BADPARAM for an invalid channel
+ */
+static syserr_t ADC_set_sequence(ADC_status_t *handle) {
+    volatile uint32_t *sqr[] = {&handle->regs->SQR1, &handle->regs->SQR2,
+                                &handle->regs->SQR3, &handle->regs->SQR4};
+    uint32_t i, rank, chan, smp = handle->cfg.ADC_sample_time;
+    handle->regs->SQR1 = (handle->cfg.ADC_num_channels - 1)
+                         << ADC_SQR1_L_Pos;
+    handle->regs->SQR2 = 0;
+    handle->regs->SQR3 = 0;
+    handle->regs->SQR4 = 0;
+    for (i = 0; i < handle->cfg.ADC_num_channels; i++) {
+        chan = handle->cfg.ADC_channels[i];
+        if (chan > ADC_MAX_CHANNEL) {
+            return ERR_BADPARAM;
+        }
+        /**
+         * SQR1 holds ranks 1-4 after the length field, and each following
+         * register holds five ranks
+         */
+        rank = i + 1;
+        if (rank < 5) {
+            SETFIELD(*sqr[0], chan, rank * ADC_SQ_WIDTH);
+        } else {
+            SETFIELD(*sqr[((rank - 5) / 5) + 1], chan,
+                     ((rank - 5) % 5) * ADC_SQ_WIDTH);
+        }
+        // Channels 0-9 use SMPR1, and channels 10-18 use SMPR2
+        if (chan < 10) {
+            MODIFY_REG(handle->regs->SMPR1, 0x7UL << (chan * ADC_SMP_WIDTH),
+                       smp << (chan * ADC_SMP_WIDTH));
+        } else {
+            MODIFY_REG(handle->regs->SMPR2,
+                       0x7UL << ((chan - 10) * ADC_SMP_WIDTH),
+                       smp << ((chan - 10) * ADC_SMP_WIDTH));
+        }
+    }
+    return SYS_OK;
+}
+
+/**
+ * Handles sample DMA events. Each event marks one half of the sample buffer
+ * as complete.
+ * @param event: DMA event
+ * @param ctx: ADC the DMA channel serves
+ */
+static void ADC_dma_callback(DMA_event_t event, void *ctx) {
+    ADC_status_t *adc = (ADC_status_t *)ctx;
+    uint16_t *half;
+    if (event == DMA_event_half) {
+        half = adc->buf;
+    } else if (event == DMA_event_complete) {
+        half = adc->buf + (adc->len / 2);
+    } else {
+        return;
+    }
+    adc->ready = half;
+    if (rtos_started()) {
+        semaphore_post(adc->ready_sem);
+    }
+    if (adc->cfg.ADC_callback) {
+        adc->cfg.ADC_callback(half, adc->len / 2);
+    }
+}
@@ -0,0 +1,137 @@
+/**
+ * @file adc.h
+ * Implements continuous ADC sampling for STM32L4xxxx.
+ * Conversions are triggered by a hardware timer, and samples are streamed
+ * by DMA into a double buffer. Readers are woken once per completed half.
+ */
+
+#ifndef ADC_H
+#define ADC_H
+
+#include <stdint.h>
+
+#include <sys/err.h>
+
+/**
+ * ADC peripheral list
+ */
+typedef enum {
+    ADC_1 = 0,
+} ADC_periph_t;
+
+#define NUM_ADCS 1
+
+/** Maximum number of channels in a conversion sequence */
+#define ADC_MAX_SEQUENCE 16
+
+/**
+ * Conversion trigger sources. The ADC driver takes ownership of the timer
+ * selected here while the ADC is open.
+ */
+typedef enum {
+    ADC_trigger_tim2,  /*!< TIM2 update event */
+    ADC_trigger_tim15, /*!< TIM15 update event */
+} ADC_trigger_t;
+
+/**
+ * Channel sample times, in ADC clock cycles. Longer sample times suit
+ * higher impedance sources.
+ */
+typedef enum {
+    ADC_smp_2_5 = 0,
+    ADC_smp_6_5 = 1,
+    ADC_smp_12_5 = 2,
+    ADC_smp_24_5 = 3,
+    ADC_smp_47_5 = 4,
+    ADC_smp_92_5 = 5,
+    ADC_smp_247_5 = 6,
+    ADC_smp_640_5 = 7,
+} ADC_sample_time_t;
+
+/* ADC read timeout (ms) */
+typedef int ADC_timeout_t;
+#define ADC_TIMEOUT_NONE 0 // No timeout
+#define ADC_TIMEOUT_INF -1 // Infinite timeout
+
+/**
+ * ADC configuration structure
+ */
+typedef struct ADC_config {
+    uint8_t ADC_channels[ADC_MAX_SEQUENCE]; /*!< Channels, in sample order */
+    uint32_t ADC_num_channels;              /*!< Number of channels used */
+    ADC_trigger_t ADC_trigger;              /*!< Conversion trigger timer */
+    uint32_t ADC_sample_rate; /*!< Sequence conversions per second */
+    ADC_sample_time_t ADC_sample_time; /*!< Sample time for all channels */
+    ADC_timeout_t ADC_read_timeout;    /*!< Read timeout */
+    /**
+     * Optional callback, run from interrupt context each time half of the
+     * sample buffer is filled, with the half that was just completed
+     */
+    void (*ADC_callback)(uint16_t *samples, uint32_t count);
+} ADC_config_t;
+
+/**
+ * Default ADC configuration:
+ * Channel 5 (PA0) alone, sampled at 1kHz with TIM2 as the trigger
+ */
+#define ADC_DEFAULT_CONFIG                                                     \
+    {                                                                          \
+        .ADC_channels = {5}, .ADC_num_channels = 1,                            \
+        .ADC_trigger = ADC_trigger_tim2, .ADC_sample_rate = 1000,              \
+        .ADC_sample_time = ADC_smp_47_5,                                       \
+        .ADC_read_timeout = ADC_TIMEOUT_INF, .ADC_callback = NULL              \
+    }
+
+typedef void *ADC_handle_t;
+
+/**
+ * Opens and calibrates an ADC. Sampling does not begin until ADC_start.
+ * Channel input pins must be configured in analog mode by the caller.
+ * The sample rate is rounded to a whole number of microseconds per sequence.
+ * @param periph: ADC peripheral to open
+ * @param config: ADC configuration structure
+ * @param buf: sample double buffer. Each half receives len / 2 samples,
+ * stored in sequence order. Must remain valid until the ADC is closed.
+ * @param len: number of samples in buf. Each half must hold a whole number
+ * of sequences, and len must not exceed 65535
+ * @param err: Set on function error
+ * @return NULL on error, or an ADC handle to the open peripheral
+ */
+ADC_handle_t ADC_open(ADC_periph_t periph, ADC_config_t *config,
+                      uint16_t *buf, uint32_t len, syserr_t *err);
+
+/**
+ * Starts timer triggered sampling into the sample buffer
+ * @param handle: ADC handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t ADC_start(ADC_handle_t handle);
+
+/**
+ * Stops sampling. Samples in an incomplete half buffer are discarded.
+ * @param handle: ADC handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t ADC_stop(ADC_handle_t handle);
+
+/**
+ * Waits for half of the sample buffer to be filled. The calling task sleeps
+ * until a half completes, or the read timeout expires. If the reader falls
+ * behind, older halves are dropped and the newest is returned.
+ * The returned half is overwritten after the other half completes, so
+ * samples should be processed (or copied) before then.
+ * @param handle: ADC handle
+ * @param samples: set to the completed half of the sample buffer
+ * @param err: Set on error
+ * @return number of samples in the completed half, or -1 on error
+ */
+int ADC_read(ADC_handle_t handle, uint16_t **samples, syserr_t *err);
+
+/**
+ * Closes an ADC, releasing its trigger timer and DMA channel
+ * @param handle: Handle to open ADC
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t ADC_close(ADC_handle_t handle);
+
+#endif
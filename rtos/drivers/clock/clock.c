@@ -340,6 +340,9 @@ void blocking_delay_ms(uint32_t delay) {
      * total of 8196 cycles
      * divide by 8,196,000, because we want a target in milliseconds
      */
+#ifdef PERIPH_MOCK
+    mock_delay_ms(delay);
+#else
     uint32_t target = (sysclk_freq / 8196000UL) * delay;
     // use assembly here to ensure known number of instructions
     asm volatile("loop:\n"
@@ -353,6 +356,7 @@ void blocking_delay_ms(uint32_t delay) {
                  :
                  : "r"(target)
                  : "r1");
+#endif
 }
 
 /**
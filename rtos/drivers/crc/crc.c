@@ -0,0 +1,370 @@
+/**
+ * @file crc.c
+ * Implements CRC calculation using the STM32L4xxxx CRC unit.
+ * Large buffers are fed to the unit by DMA. The unit is shared between all
+ * open handles, with access serialized by a mutex.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/device/device.h>
+#include <drivers/dma/dma.h>
+#include <sys/err.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+#include <util/bitmask.h>
+
+#include "crc.h"
+
+/**
+ * CRC handle state
+ */
+typedef enum {
+    CRC_dev_closed = 0,
+    CRC_dev_open = 1,
+} CRC_state_t;
+
+/**
+ * Configuration structure for CRC handles
+ */
+typedef struct {
+    CRC_config_t cfg;  /*!< User configuration for handle */
+    CRC_state_t state; /*!< Handle state (open or closed) */
+    bool sw_capable;   /*!< Can CRC be computed with CRC_sw_crc32 */
+    uint32_t cr;       /*!< Control register value for configuration */
+    uint32_t mask;     /*!< Mask for CRC result, based on polynomial size */
+} CRC_status_t;
+
+/**
+ * State of the CRC unit, shared by all handles
+ */
+typedef struct {
+    volatile bool busy;      /*!< Is the unit in use */
+    semaphore_t mutex;       /*!< Posted when unit is released */
+    semaphore_t dma_sem;     /*!< Posted when a DMA transfer completes */
+    volatile bool dma_done;  /*!< Set when a DMA transfer completes */
+    volatile bool dma_error; /*!< Set when a DMA transfer fails */
+    uint32_t open_count;     /*!< Number of open handles */
+} CRC_unit_t;
+
+/** DMA channel used for memory to memory transfers into the CRC unit */
+#define CRC_DMA_CHANNEL DMA2_CH7
+/** Default CRC-32 parameters, matching CRC_sw_crc32 */
+#define CRC32_POLY 0x04C11DB7UL
+#define CRC32_INIT 0xFFFFFFFFUL
+#define CRC32_XOR_OUT 0xFFFFFFFFUL
+
+static CRC_status_t CRCS[CRC_MAX_HANDLES] = {0};
+static CRC_unit_t CRC_UNIT = {0};
+
+static bool CRC_lock(CRC_status_t *handle, syserr_t *err);
+static void CRC_unlock(void);
+static void CRC_feed(CRC_status_t *handle, const void *data, uint32_t len);
+static bool CRC_feed_dma(CRC_status_t *handle, const void *data,
+                         uint32_t len);
+static void CRC_dma_callback(DMA_event_t event, void *ctx);
+
+/**
+ * Opens a CRC handle with the given configuration. The CRC unit is
+ * reconfigured for each calculation, so handles may use different
+ * configurations.
+ * @param config: CRC configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or a CRC handle
+ */
+CRC_handle_t CRC_open(CRC_config_t *config, syserr_t *err) {
+    CRC_status_t *handle = NULL;
+    int i;
+    *err = SYS_OK; // Set no error until one occurs
+    /**
+     * Check parameters. The unit only supports odd polynomials
+     */
+    if (config == NULL || config->CRC_poly_size > CRC_poly_7 ||
+        config->CRC_input_width > CRC_input_32 ||
+        (config->CRC_poly & 0x1) == 0) {
+        *err = ERR_BADPARAM;
+        return NULL;
+    }
+    mask_irq();
+    for (i = 0; i < CRC_MAX_HANDLES; i++) {
+        if (CRCS[i].state == CRC_dev_closed) {
+            handle = &CRCS[i];
+            handle->state = CRC_dev_open;
+            break;
+        }
+    }
+    unmask_irq();
+    if (handle == NULL) {
+        *err = ERR_NOMEM;
+        return NULL;
+    }
+    memcpy(&handle->cfg, config, sizeof(CRC_config_t));
+    handle->sw_capable = config->CRC_poly == CRC32_POLY &&
+                         config->CRC_poly_size == CRC_poly_32 &&
+                         config->CRC_init == CRC32_INIT &&
+                         config->CRC_input_width == CRC_input_8 &&
+                         config->CRC_reflect_in && config->CRC_reflect_out &&
+                         config->CRC_xor_out == CRC32_XOR_OUT;
+    handle->cr = config->CRC_poly_size << CRC_CR_POLYSIZE_Pos;
+    if (config->CRC_reflect_in) {
+        // Bits are reflected within each element of the input width
+        handle->cr |= (config->CRC_input_width + 1) << CRC_CR_REV_IN_Pos;
+    }
+    if (config->CRC_reflect_out) {
+        handle->cr |= CRC_CR_REV_OUT;
+    }
+    switch (config->CRC_poly_size) {
+    case CRC_poly_32:
+        handle->mask = 0xFFFFFFFF;
+        break;
+    case CRC_poly_16:
+        handle->mask = 0xFFFF;
+        break;
+    case CRC_poly_8:
+        handle->mask = 0xFF;
+        break;
+    default:
+        handle->mask = 0x7F;
+        break;
+    }
+    /**
+     * The first handle opened enables the unit, and creates the semaphores
+     * used to wait for it
+     */
+    if (CRC_UNIT.open_count == 0) {
+        SETBITS(RCC->AHB1ENR, RCC_AHB1ENR_CRCEN);
+        CRC_UNIT.busy = false;
+        // Handles are usually opened in main, and then used from tasks
+        CRC_UNIT.mutex = semaphore_create_binary();
+        CRC_UNIT.dma_sem = semaphore_create_binary();
+        if (CRC_UNIT.mutex == NULL || CRC_UNIT.dma_sem == NULL) {
+            CRC_UNIT.open_count++;
+            CRC_close(handle);
+            *err = ERR_NOMEM;
+            return NULL;
+        }
+    }
+    CRC_UNIT.open_count++;
+    return handle;
+}
+
+/**
+ * Computes the CRC of a buffer. Blocks while another handle is using the
+ * CRC unit. If the handle uses the default CRC-32 configuration, the CRC is
+ * instead computed in software when the unit is busy, or when called from
+ * an interrupt.
+ * @param handle: CRC handle
+ * @param data: data to compute CRC over, with elements of the configured
+ * input width
+ * @param len: number of elements in data (max 65535)
+ * @param err: Set on error. ERR_INUSE if the unit is busy and the CRC
+ * cannot be computed in software
+ * @return computed CRC value
+ */
+uint32_t CRC_compute(CRC_handle_t handle, const void *data, uint32_t len,
+                     syserr_t *err) {
+    CRC_status_t *crc = (CRC_status_t *)handle;
+    uint32_t result;
+    *err = SYS_OK;
+    if (crc == NULL || crc->state != CRC_dev_open ||
+        (data == NULL && len != 0) || len > 0xFFFF) {
+        *err = ERR_BADPARAM;
+        return 0;
+    }
+    if (!CRC_lock(crc, err)) {
+        if (crc->sw_capable) {
+            // Unit is not available. Fall back to software
+            *err = SYS_OK;
+            return CRC_sw_crc32(0, data, len);
+        }
+        return 0;
+    }
+    // Load the configuration, then reset the unit to load the initial value
+    CRC->POL = crc->cfg.CRC_poly;
+    CRC->INIT = crc->cfg.CRC_init;
+    CRC->CR = crc->cr | CRC_CR_RESET;
+    if (len < CRC_DMA_THRESHOLD || !CRC_feed_dma(crc, data, len)) {
+        CRC_feed(crc, data, len);
+    }
+    result = (CRC->DR & crc->mask) ^ (crc->cfg.CRC_xor_out & crc->mask);
+    CRC_unlock();
+    return result;
+}
+
+/**
+ * Closes a CRC handle
+ * @param handle: CRC handle to close
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t CRC_close(CRC_handle_t handle) {
+    CRC_status_t *crc = (CRC_status_t *)handle;
+    if (crc == NULL || crc->state != CRC_dev_open) {
+        return ERR_BADPARAM;
+    }
+    crc->state = CRC_dev_closed;
+    CRC_UNIT.open_count--;
+    if (CRC_UNIT.open_count == 0) {
+        // Last handle closed. Release the unit
+        if (CRC_UNIT.mutex) {
+            semaphore_destroy(CRC_UNIT.mutex);
+            CRC_UNIT.mutex = NULL;
+        }
+        if (CRC_UNIT.dma_sem) {
+            semaphore_destroy(CRC_UNIT.dma_sem);
+            CRC_UNIT.dma_sem = NULL;
+        }
+        CLEARBITS(RCC->AHB1ENR, RCC_AHB1ENR_CRCEN);
+    }
+    return SYS_OK;
+}
+
+/**
+ * Takes ownership of the CRC unit. If the unit is busy, the calling task
+ * sleeps until it is released, unless the CRC can be computed in software.
+ * Never blocks in interrupt context.
+ * @param handle: CRC handle requesting the unit
+ * @param err: Set to ERR_INUSE if the unit could not be taken
+ * @return true if the unit was taken, false otherwise
+ */
+static bool CRC_lock(CRC_status_t *handle, syserr_t *err) {
+    bool locked;
+    if (READBITS(SCB->ICSR, SCB_ICSR_VECTACTIVE_Msk)) {
+        /**
+         * Interrupts may not block, or unmask interrupts. Software is the
+         * only option here
+         */
+        *err = ERR_INUSE;
+        return false;
+    }
+    while (1) {
+        mask_irq();
+        locked = !CRC_UNIT.busy;
+        CRC_UNIT.busy = true;
+        unmask_irq();
+        if (locked) {
+            return true;
+        }
+        if (handle->sw_capable || !rtos_started()) {
+            // Caller uses software, or has no way to wait
+            *err = ERR_INUSE;
+            return false;
+        }
+        // Wait for the unit to be released, then try again
+        semaphore_pend(CRC_UNIT.mutex, SYS_TIMEOUT_INF);
+    }
+}
+
+/**
+ * Releases the CRC unit, waking a task waiting for it
+ */
+static void CRC_unlock(void) {
+    CRC_UNIT.busy = false;
+    if (rtos_started()) {
+        semaphore_post(CRC_UNIT.mutex);
+    }
+}
+
+/**
+ * Writes data into the CRC unit from the CPU
+ * @param handle: CRC handle
+ * @param data: data to write
+ * @param len: number of elements in data
+ */
+static void CRC_feed(CRC_status_t *handle, const void *data, uint32_t len) {
+    const uint8_t *data8 = data;
+    const uint16_t *data16 = data;
+    const uint32_t *data32 = data;
+    uint32_t i;
+    /**
+     * The unit processes each write at the width of the access, so the data
+     * register is written at the configured input width
+     */
+    switch (handle->cfg.CRC_input_width) {
+    case CRC_input_8:
+        for (i = 0; i < len; i++) {
+            *(volatile uint8_t *)&CRC->DR = data8[i];
+        }
+        break;
+    case CRC_input_16:
+        for (i = 0; i < len; i++) {
+            *(volatile uint16_t *)&CRC->DR = data16[i];
+        }
+        break;
+    default:
+        for (i = 0; i < len; i++) {
+            CRC->DR = data32[i];
+        }
+        break;
+    }
+}
+
+/**
+ * Writes data into the CRC unit by DMA, and waits for the transfer to
+ * complete
+ * @param handle: CRC handle
+ * @param data: data to write
+ * @param len: number of elements in data
+ * @return true if data was written, or false if DMA was unavailable or
+ * failed
+ */
+static bool CRC_feed_dma(CRC_status_t *handle, const void *data,
+                         uint32_t len) {
+    DMA_config_t dma_cfg = DMA_DEFAULT_CONFIG;
+    DMA_handle_t dma;
+    syserr_t err;
+    /**
+     * Memory to memory transfer. The DMA "peripheral" side is the source
+     * buffer, and the memory side is the CRC data register
+     */
+    dma_cfg.DMA_direction = DMA_mem_to_mem;
+    dma_cfg.DMA_periph_width = (DMA_width_t)handle->cfg.CRC_input_width;
+    dma_cfg.DMA_mem_width = (DMA_width_t)handle->cfg.CRC_input_width;
+    dma_cfg.DMA_periph_inc = true;
+    dma_cfg.DMA_mem_inc = false;
+    dma_cfg.DMA_priority = DMA_priority_low;
+    dma_cfg.DMA_callback = CRC_dma_callback;
+    dma = DMA_open(CRC_DMA_CHANNEL, &dma_cfg, &err);
+    if (dma == NULL) {
+        return false;
+    }
+    CRC_UNIT.dma_done = false;
+    CRC_UNIT.dma_error = false;
+    if (rtos_started()) {
+        // Clear any stale post
+        semaphore_pend(CRC_UNIT.dma_sem, 0);
+    }
+    if (DMA_start(dma, (volatile void *)data, (void *)&CRC->DR, len) !=
+        SYS_OK) {
+        DMA_close(dma);
+        return false;
+    }
+    while (!CRC_UNIT.dma_done) {
+        if (rtos_started()) {
+            semaphore_pend(CRC_UNIT.dma_sem, SYS_TIMEOUT_INF);
+        }
+    }
+    DMA_close(dma);
+    if (CRC_UNIT.dma_error) {
+        // Restart the calculation, so the caller can feed data by CPU
+        SETBITS(CRC->CR, CRC_CR_RESET);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Handles CRC DMA events
+ * @param event: DMA event
+ * @param ctx: unused
+ */
+static void CRC_dma_callback(DMA_event_t event, void *ctx) {
+    if (event == DMA_event_complete || event == DMA_event_error) {
+        CRC_UNIT.dma_error = (event == DMA_event_error);
+        CRC_UNIT.dma_done = true;
+        if (rtos_started()) {
+            semaphore_post(CRC_UNIT.dma_sem);
+        }
+    }
+}
@@ -0,0 +1,104 @@
+/**
+ * @file crc.h
+ * Implements CRC calculation using the STM32L4xxxx CRC unit.
+ * Large buffers are fed to the unit by DMA. The unit is shared between all
+ * open handles, with access serialized by a mutex.
+ */
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/err.h>
+
+#include "crc_sw.h"
+
+/** Maximum number of open CRC handles */
+#define CRC_MAX_HANDLES 4
+
+/** Buffers with at least this many elements are fed to the unit by DMA */
+#define CRC_DMA_THRESHOLD 64
+
+/**
+ * CRC polynomial sizes
+ */
+typedef enum {
+    CRC_poly_32 = 0,
+    CRC_poly_16 = 1,
+    CRC_poly_8 = 2,
+    CRC_poly_7 = 3,
+} CRC_poly_size_t;
+
+/**
+ * Width of the data elements CRC is computed over. When input reflection is
+ * enabled, bits are reflected within each element.
+ */
+typedef enum {
+    CRC_input_8 = 0,  /*!< Data is an array of bytes */
+    CRC_input_16 = 1, /*!< Data is an array of half words */
+    CRC_input_32 = 2, /*!< Data is an array of words */
+} CRC_input_width_t;
+
+/**
+ * CRC configuration structure
+ */
+typedef struct CRC_config {
+    uint32_t CRC_poly;                   /*!< Polynomial (must be odd) */
+    CRC_poly_size_t CRC_poly_size;       /*!< Polynomial size */
+    uint32_t CRC_init;                   /*!< Initial CRC value */
+    CRC_input_width_t CRC_input_width;   /*!< Input data element width */
+    bool CRC_reflect_in;                 /*!< Reflect input elements */
+    bool CRC_reflect_out;                /*!< Reflect CRC result */
+    uint32_t CRC_xor_out;                /*!< Value XORed with CRC result */
+} CRC_config_t;
+
+/**
+ * Default CRC configuration:
+ * IEEE 802.3 CRC-32 over bytes (same result as CRC_sw_crc32)
+ */
+#define CRC_DEFAULT_CONFIG                                                     \
+    {                                                                          \
+        .CRC_poly = 0x04C11DB7, .CRC_poly_size = CRC_poly_32,                  \
+        .CRC_init = 0xFFFFFFFF, .CRC_input_width = CRC_input_8,                \
+        .CRC_reflect_in = true, .CRC_reflect_out = true,                       \
+        .CRC_xor_out = 0xFFFFFFFF                                              \
+    }
+
+typedef void *CRC_handle_t;
+
+/**
+ * Opens a CRC handle with the given configuration. The CRC unit is
+ * reconfigured for each calculation, so handles may use different
+ * configurations.
+ * @param config: CRC configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or a CRC handle
+ */
+CRC_handle_t CRC_open(CRC_config_t *config, syserr_t *err);
+
+/**
+ * Computes the CRC of a buffer. Blocks while another handle is using the
+ * CRC unit. If the handle uses the default CRC-32 configuration, the CRC is
+ * instead computed in software when the unit is busy, or when called from
+ * an interrupt.
+ * @param handle: CRC handle
+ * @param data: data to compute CRC over, with elements of the configured
+ * input width
+ * @param len: number of elements in data (max 65535)
+ * @param err: Set on error. ERR_INUSE if the unit is busy and the CRC
+ * cannot be computed in software
+ * @return computed CRC value
+ */
+uint32_t CRC_compute(CRC_handle_t handle, const void *data, uint32_t len,
+                     syserr_t *err);
+
+/**
+ * Closes a CRC handle
+ * @param handle: CRC handle to close
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t CRC_close(CRC_handle_t handle);
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file crc_sw.h
+ * Implements software CRC-32 computation, for use when the CRC peripheral
+ * is unavailable. Has no hardware dependencies, so it also builds on a host.
+ */
+
+#ifndef CRC_SW_H
+#define CRC_SW_H
+
+#include <stdint.h>
+
+/**
+ * Computes the IEEE 802.3 CRC-32 (as used by zlib and Ethernet) of a buffer.
+ * Calls may be chained, by passing the result of the previous call as crc.
+ * Data is processed eight bytes at a time using slice-by-8 tables, which
+ * assumes a little endian CPU.
+ * @param crc: CRC of the preceding data, or 0 to start a new CRC
+ * @param data: data to compute CRC over
+ * @param len: length of data, in bytes
+ * @return CRC-32 of the preceding data and this buffer
+ */
+uint32_t CRC_sw_crc32(uint32_t crc, const void *data, uint32_t len);
+
+#endif
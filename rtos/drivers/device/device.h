@@ -11,4 +11,9 @@
 #ifdef STM32L433
 #include "stm32l433xx.h"
 #endif
+
+#ifdef PERIPH_MOCK
+// Host build: peripherals are simulated, see drivers/test/mock
+#include <drivers/test/mock/periph_mock.h>
+#endif
 #endif
\ No newline at end of file
@@ -0,0 +1,346 @@
+/**
+ * @file dma.c
+ * Implements DMA channel management for STM32L4xxxx
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/device/device.h>
+#include <sys/err.h>
+#include <sys/isr/isr.h>
+#include <util/bitmask.h>
+
+#include "dma.h"
+
+/**
+ * DMA channel state
+ */
+typedef enum {
+    DMA_chan_closed = 0,
+    DMA_chan_open = 1,
+} DMA_state_t;
+
+/**
+ * Configuration structure for DMA channels
+ */
+typedef struct {
+    DMA_config_t cfg;          /*!< User configuration for channel */
+    DMA_Channel_TypeDef *regs; /*!< Register access for this channel */
+    DMA_TypeDef *ctrl;         /*!< Register access for channel's controller */
+    DMA_state_t state;         /*!< Channel state (open or closed) */
+    DMA_channel_t chan_id;     /*!< Identifies the channel handle references */
+    uint32_t flag_shift;       /*!< Offset of channel flags in ISR and IFCR */
+} DMA_status_t;
+
+/** Number of channels on each DMA controller */
+#define DMA_CHANNELS_PER_CTRL 7
+/** Each channel has 4 bits of flags in the ISR and IFCR registers */
+#define DMA_FLAG_WIDTH 4
+#define DMA_FLAG_GIF 0x1UL
+#define DMA_FLAG_TCIF 0x2UL
+#define DMA_FLAG_HTIF 0x4UL
+#define DMA_FLAG_TEIF 0x8UL
+#define DMA_CSELR_WIDTH 4
+#define DMA_MAX_COUNT 0xFFFFUL
+
+static DMA_status_t DMA_CHANNELS[NUM_DMA_CHANNELS] = {0};
+
+/** Channel register blocks, indexed by DMA_channel_t */
+static DMA_Channel_TypeDef *const DMA_REGS[NUM_DMA_CHANNELS] = {
+    DMA1_Channel1, DMA1_Channel2, DMA1_Channel3, DMA1_Channel4,
+    DMA1_Channel5, DMA1_Channel6, DMA1_Channel7, DMA2_Channel1,
+    DMA2_Channel2, DMA2_Channel3, DMA2_Channel4, DMA2_Channel5,
+    DMA2_Channel6, DMA2_Channel7,
+};
+
+/** Channel interrupt numbers, indexed by DMA_channel_t */
+static const uint8_t DMA_IRQS[NUM_DMA_CHANNELS] = {
+    DMA1_Channel1_IRQn, DMA1_Channel2_IRQn, DMA1_Channel3_IRQn,
+    DMA1_Channel4_IRQn, DMA1_Channel5_IRQn, DMA1_Channel6_IRQn,
+    DMA1_Channel7_IRQn, DMA2_Channel1_IRQn, DMA2_Channel2_IRQn,
+    DMA2_Channel3_IRQn, DMA2_Channel4_IRQn, DMA2_Channel5_IRQn,
+    DMA2_Channel6_IRQn, DMA2_Channel7_IRQn,
+};
+
+static void DMA_interrupt(void);
+static bool DMA_ctrl_in_use(DMA_TypeDef *ctrl);
+
+/**
+ * Allocates a DMA channel, and routes the configured request to it.
+ * @param chan: DMA channel to allocate
+ * @param config: DMA configuration structure
+ * @param err: Set on function error. ERR_INUSE if channel is allocated
+ * @return NULL on error, or a DMA handle to the allocated channel
+ */
+DMA_handle_t DMA_open(DMA_channel_t chan, DMA_config_t *config,
+                      syserr_t *err) {
+    DMA_status_t *handle;
+    DMA_Request_TypeDef *cselr;
+    uint32_t ccr, shift;
+    *err = SYS_OK; // Set no error until one occurs
+    /**
+     * Check parameters.
+     */
+    if (chan > DMA2_CH7 || config == NULL || config->DMA_request > 0xF ||
+        config->DMA_periph_width > DMA_width_32 ||
+        config->DMA_mem_width > DMA_width_32 ||
+        config->DMA_priority > DMA_priority_vhigh) {
+        *err = ERR_BADPARAM;
+        return NULL;
+    }
+    if (config->DMA_direction == DMA_mem_to_mem &&
+        config->DMA_mode != DMA_mode_normal) {
+        // Memory to memory transfers cannot be circular
+        *err = ERR_NOSUPPORT;
+        return NULL;
+    }
+    handle = &DMA_CHANNELS[chan];
+    /**
+     * Channels may be allocated from several tasks, so the state check and
+     * update must not be interrupted
+     */
+    mask_irq();
+    if (handle->state == DMA_chan_open) {
+        unmask_irq();
+        *err = ERR_INUSE;
+        return NULL;
+    }
+    handle->state = DMA_chan_open;
+    unmask_irq();
+    memcpy(&handle->cfg, config, sizeof(DMA_config_t));
+    handle->chan_id = chan;
+    handle->regs = DMA_REGS[chan];
+    if (chan < DMA2_CH1) {
+        SETBITS(RCC->AHB1ENR, RCC_AHB1ENR_DMA1EN);
+        handle->ctrl = DMA1;
+        cselr = DMA1_CSELR;
+    } else {
+        SETBITS(RCC->AHB1ENR, RCC_AHB1ENR_DMA2EN);
+        handle->ctrl = DMA2;
+        cselr = DMA2_CSELR;
+    }
+    shift = (chan % DMA_CHANNELS_PER_CTRL);
+    handle->flag_shift = shift * DMA_FLAG_WIDTH;
+    // Channel must be disabled while it is configured
+    CLEARBITS(handle->regs->CCR, DMA_CCR_EN);
+    // Route the requested peripheral to this channel
+    MODIFY_REG(cselr->CSELR, 0xFUL << (shift * DMA_CSELR_WIDTH),
+               config->DMA_request << (shift * DMA_CSELR_WIDTH));
+    /* Build the channel configuration register value */
+    ccr = (config->DMA_periph_width << DMA_CCR_PSIZE_Pos) |
+          (config->DMA_mem_width << DMA_CCR_MSIZE_Pos) |
+          (config->DMA_priority << DMA_CCR_PL_Pos) | DMA_CCR_TEIE;
+    if (config->DMA_periph_inc) {
+        ccr |= DMA_CCR_PINC;
+    }
+    if (config->DMA_mem_inc) {
+        ccr |= DMA_CCR_MINC;
+    }
+    switch (config->DMA_direction) {
+    case DMA_periph_to_mem:
+        break;
+    case DMA_mem_to_periph:
+        ccr |= DMA_CCR_DIR;
+        break;
+    case DMA_mem_to_mem:
+        // Peripheral address is read, memory address is written
+        ccr |= DMA_CCR_MEM2MEM;
+        break;
+    default:
+        DMA_close(handle);
+        *err = ERR_BADPARAM;
+        return NULL;
+        break;
+    }
+    switch (config->DMA_mode) {
+    case DMA_mode_normal:
+        ccr |= DMA_CCR_TCIE;
+        break;
+    case DMA_mode_circular:
+        ccr |= DMA_CCR_CIRC | DMA_CCR_TCIE;
+        break;
+    case DMA_mode_double_buffer:
+        // Halves of the buffer are signalled by half and full transfer flags
+        ccr |= DMA_CCR_CIRC | DMA_CCR_TCIE | DMA_CCR_HTIE;
+        break;
+    default:
+        DMA_close(handle);
+        *err = ERR_BADPARAM;
+        return NULL;
+        break;
+    }
+    handle->regs->CCR = ccr;
+    // Clear stale flags for this channel, and enable its interrupt
+    handle->ctrl->IFCR = DMA_FLAG_GIF << handle->flag_shift;
+    enable_irq(DMA_IRQS[chan], DMA_interrupt);
+    return handle;
+}
+
+/**
+ * Starts a DMA transfer. Any transfer already running is stopped.
+ * @param handle: DMA channel handle
+ * @param periph: peripheral address (or source address for memory copies)
+ * @param mem: memory address
+ * @param count: number of data items to transfer (1-65535). For double
+ * buffer mode, this is the length of both halves together
+ * @return SYS_OK on success, or ERR_BADPARAM on invalid parameters
+ */
+syserr_t DMA_start(DMA_handle_t handle, volatile void *periph, void *mem,
+                   uint32_t count) {
+    DMA_status_t *dma = (DMA_status_t *)handle;
+    if (dma == NULL || dma->state != DMA_chan_open || periph == NULL ||
+        mem == NULL || count == 0 || count > DMA_MAX_COUNT) {
+        return ERR_BADPARAM;
+    }
+    // Address and count registers can only be written with channel disabled
+    CLEARBITS(dma->regs->CCR, DMA_CCR_EN);
+    dma->ctrl->IFCR = DMA_FLAG_GIF << dma->flag_shift;
+    dma->regs->CPAR = (uint32_t)periph;
+    dma->regs->CMAR = (uint32_t)mem;
+    dma->regs->CNDTR = count;
+    SETBITS(dma->regs->CCR, DMA_CCR_EN);
+    return SYS_OK;
+}
+
+/**
+ * Stops a DMA transfer.
+ * @param handle: DMA channel handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t DMA_stop(DMA_handle_t handle) {
+    DMA_status_t *dma = (DMA_status_t *)handle;
+    if (dma == NULL || dma->state != DMA_chan_open) {
+        return ERR_BADPARAM;
+    }
+    CLEARBITS(dma->regs->CCR, DMA_CCR_EN);
+    dma->ctrl->IFCR = DMA_FLAG_GIF << dma->flag_shift;
+    return SYS_OK;
+}
+
+/**
+ * Sets whether the memory address increments during transfers. Allows a
+ * single channel to alternate between buffers and a fixed dummy value.
+ * Must only be called while the channel is stopped.
+ * @param handle: DMA channel handle
+ * @param inc: should memory address increment
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t DMA_set_mem_inc(DMA_handle_t handle, bool inc) {
+    DMA_status_t *dma = (DMA_status_t *)handle;
+    if (dma == NULL || dma->state != DMA_chan_open ||
+        READBITS(dma->regs->CCR, DMA_CCR_EN)) {
+        return ERR_BADPARAM;
+    }
+    dma->cfg.DMA_mem_inc = inc;
+    if (inc) {
+        SETBITS(dma->regs->CCR, DMA_CCR_MINC);
+    } else {
+        CLEARBITS(dma->regs->CCR, DMA_CCR_MINC);
+    }
+    return SYS_OK;
+}
+
+/**
+ * Gets the number of data items remaining in the current transfer.
+ * @param handle: DMA channel handle
+ * @return number of items left to transfer
+ */
+uint32_t DMA_remaining(DMA_handle_t handle) {
+    DMA_status_t *dma = (DMA_status_t *)handle;
+    if (dma == NULL || dma->state != DMA_chan_open) {
+        return 0;
+    }
+    return dma->regs->CNDTR;
+}
+
+/**
+ * Frees a DMA channel, stopping any active transfer.
+ * @param handle: DMA channel handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t DMA_close(DMA_handle_t handle) {
+    DMA_status_t *dma = (DMA_status_t *)handle;
+    if (dma == NULL || dma->state != DMA_chan_open) {
+        return ERR_BADPARAM;
+    }
+    disable_irq(DMA_IRQS[dma->chan_id]);
+    // Reset the channel configuration
+    dma->regs->CCR = 0;
+    dma->ctrl->IFCR = DMA_FLAG_GIF << dma->flag_shift;
+    dma->state = DMA_chan_closed;
+    // Gate the controller clock once none of its channels are used
+    if (!DMA_ctrl_in_use(dma->ctrl)) {
+        if (dma->ctrl == DMA1) {
+            CLEARBITS(RCC->AHB1ENR, RCC_AHB1ENR_DMA1EN);
+        } else {
+            CLEARBITS(RCC->AHB1ENR, RCC_AHB1ENR_DMA2EN);
+        }
+    }
+    return SYS_OK;
+}
+
+/**
+ * Handles DMA channel interrupts
+ */
+static void DMA_interrupt(void) {
+    DMA_status_t *handle = NULL;
+    uint32_t flags, irqn;
+    int i;
+    /**
+     * Use the exception number to determine which channel caused the
+     * interrupt
+     */
+    irqn = READBITS(SCB->ICSR, SCB_ICSR_VECTACTIVE_Msk) - 16;
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (DMA_IRQS[i] == irqn) {
+            handle = &DMA_CHANNELS[i];
+            break;
+        }
+    }
+    if (handle == NULL) {
+        /**
+         * Spin here. We want to stop processor as we
+         * should not be handling this exception.
+         */
+        while (1) {
+            // Spin
+        }
+    }
+    flags = (handle->ctrl->ISR >> handle->flag_shift) & 0xFUL;
+    // Clear all flags for this channel
+    handle->ctrl->IFCR = DMA_FLAG_GIF << handle->flag_shift;
+    if (flags & DMA_FLAG_TEIF) {
+        // Hardware disables the channel on a transfer error
+        CLEARBITS(handle->regs->CCR, DMA_CCR_EN);
+        if (handle->cfg.DMA_callback) {
+            handle->cfg.DMA_callback(DMA_event_error,
+                                     handle->cfg.DMA_callback_ctx);
+        }
+        return;
+    }
+    if ((flags & DMA_FLAG_HTIF) && handle->cfg.DMA_callback &&
+        READBITS(handle->regs->CCR, DMA_CCR_HTIE)) {
+        handle->cfg.DMA_callback(DMA_event_half, handle->cfg.DMA_callback_ctx);
+    }
+    if ((flags & DMA_FLAG_TCIF) && handle->cfg.DMA_callback) {
+        handle->cfg.DMA_callback(DMA_event_complete,
+                                 handle->cfg.DMA_callback_ctx);
+    }
+}
+
+/**
+ * Checks if any channel of a DMA controller is allocated
+ * @param ctrl: DMA controller to check
+ * @return true if a channel on the controller is open
+ */
+static bool DMA_ctrl_in_use(DMA_TypeDef *ctrl) {
+    int i;
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (DMA_CHANNELS[i].state == DMA_chan_open &&
+            DMA_CHANNELS[i].ctrl == ctrl) {
+            return true;
+        }
+    }
+    return false;
+}
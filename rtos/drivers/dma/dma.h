@@ -0,0 +1,174 @@
+/**
+ * @file dma.h
+ * Implements DMA channel management for STM32L4xxxx
+ */
+
+#ifndef DMA_H
+#define DMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/err.h>
+
+/**
+ * DMA channel list. Each peripheral request is only routed to specific
+ * channels, see the DMA request mapping tables in the reference manual.
+ */
+typedef enum {
+    DMA1_CH1 = 0,
+    DMA1_CH2 = 1,
+    DMA1_CH3 = 2,
+    DMA1_CH4 = 3,
+    DMA1_CH5 = 4,
+    DMA1_CH6 = 5,
+    DMA1_CH7 = 6,
+    DMA2_CH1 = 7,
+    DMA2_CH2 = 8,
+    DMA2_CH3 = 9,
+    DMA2_CH4 = 10,
+    DMA2_CH5 = 11,
+    DMA2_CH6 = 12,
+    DMA2_CH7 = 13,
+} DMA_channel_t;
+
+#define NUM_DMA_CHANNELS 14
+
+/**
+ * DMA transfer direction
+ */
+typedef enum {
+    DMA_periph_to_mem, /*!< Read from peripheral, write to memory */
+    DMA_mem_to_periph, /*!< Read from memory, write to peripheral */
+    DMA_mem_to_mem,    /*!< Memory copy. Peripheral address is the source */
+} DMA_direction_t;
+
+/**
+ * DMA transfer data width
+ */
+typedef enum {
+    DMA_width_8 = 0,  /*!< Byte transfers */
+    DMA_width_16 = 1, /*!< Half word transfers */
+    DMA_width_32 = 2, /*!< Word transfers */
+} DMA_width_t;
+
+/**
+ * DMA transfer modes
+ */
+typedef enum {
+    DMA_mode_normal,   /*!< Single transfer, complete callback at the end */
+    DMA_mode_circular, /*!< Transfer repeats, complete callback on each wrap */
+    /**
+     * Transfer repeats over a buffer split into two halves. The half callback
+     * fires when the first half is done, and the complete callback when the
+     * second half is done, so one half can be processed while the other is
+     * being transferred.
+     */
+    DMA_mode_double_buffer,
+} DMA_mode_t;
+
+/**
+ * DMA channel priority
+ */
+typedef enum {
+    DMA_priority_low = 0,
+    DMA_priority_med = 1,
+    DMA_priority_high = 2,
+    DMA_priority_vhigh = 3,
+} DMA_priority_t;
+
+/**
+ * DMA events, passed to the channel callback
+ */
+typedef enum {
+    DMA_event_half,     /*!< First half of transfer is complete */
+    DMA_event_complete, /*!< Transfer is complete */
+    DMA_event_error,    /*!< Transfer error. Channel has been disabled */
+} DMA_event_t;
+
+/**
+ * DMA channel configuration structure
+ */
+typedef struct DMA_config {
+    uint32_t DMA_request;          /*!< Request number routed to channel */
+    DMA_direction_t DMA_direction; /*!< Transfer direction */
+    DMA_width_t DMA_periph_width;  /*!< Peripheral side data width */
+    DMA_width_t DMA_mem_width;     /*!< Memory side data width */
+    bool DMA_periph_inc;           /*!< Increment peripheral address */
+    bool DMA_mem_inc;              /*!< Increment memory address */
+    DMA_mode_t DMA_mode;           /*!< Transfer mode */
+    DMA_priority_t DMA_priority;   /*!< Channel priority */
+    /*! Optional callback, run from interrupt context on DMA events */
+    void (*DMA_callback)(DMA_event_t event, void *ctx);
+    void *DMA_callback_ctx; /*!< Context pointer passed to DMA_callback */
+} DMA_config_t;
+
+/**
+ * Default DMA configuration:
+ * Byte wide peripheral to memory transfers, incrementing memory address,
+ * normal mode, with no callback
+ */
+#define DMA_DEFAULT_CONFIG                                                     \
+    {                                                                          \
+        .DMA_request = 0, .DMA_direction = DMA_periph_to_mem,                  \
+        .DMA_periph_width = DMA_width_8, .DMA_mem_width = DMA_width_8,         \
+        .DMA_periph_inc = false, .DMA_mem_inc = true,                          \
+        .DMA_mode = DMA_mode_normal, .DMA_priority = DMA_priority_med,         \
+        .DMA_callback = NULL, .DMA_callback_ctx = NULL                         \
+    }
+
+typedef void *DMA_handle_t;
+
+/**
+ * Allocates a DMA channel, and routes the configured request to it.
+ * @param chan: DMA channel to allocate
+ * @param config: DMA configuration structure
+ * @param err: Set on function error. ERR_INUSE if channel is allocated
+ * @return NULL on error, or a DMA handle to the allocated channel
+ */
+DMA_handle_t DMA_open(DMA_channel_t chan, DMA_config_t *config, syserr_t *err);
+
+/**
+ * Starts a DMA transfer. Any transfer already running is stopped.
+ * @param handle: DMA channel handle
+ * @param periph: peripheral address (or source address for memory copies)
+ * @param mem: memory address
+ * @param count: number of data items to transfer (1-65535). For double
+ * buffer mode, this is the length of both halves together
+ * @return SYS_OK on success, or ERR_BADPARAM on invalid parameters
+ */
+syserr_t DMA_start(DMA_handle_t handle, volatile void *periph, void *mem,
+                   uint32_t count);
+
+/**
+ * Stops a DMA transfer.
+ * @param handle: DMA channel handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t DMA_stop(DMA_handle_t handle);
+
+/**
+ * Sets whether the memory address increments during transfers. Allows a
+ * single channel to alternate between buffers and a fixed dummy value.
+ * Must only be called while the channel is stopped.
+ * @param handle: DMA channel handle
+ * @param inc: should memory address increment
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t DMA_set_mem_inc(DMA_handle_t handle, bool inc);
+
+/**
+ * Gets the number of data items remaining in the current transfer.
+ * @param handle: DMA channel handle
+ * @return number of items left to transfer
+ */
+uint32_t DMA_remaining(DMA_handle_t handle);
+
+/**
+ * Frees a DMA channel, stopping any active transfer.
+ * @param handle: DMA channel handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t DMA_close(DMA_handle_t handle);
+
+#endif
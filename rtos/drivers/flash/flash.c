@@ -0,0 +1,328 @@
+/**
+ * @file flash.c
+ * Implements internal flash programming and erase for STM32L4xxxx.
+ * Programming routines execute from RAM. Page erases run in the background,
+ * and complete from the flash end of operation interrupt.
+ *
+ * The STM32L433 has a single flash bank, so the CPU stalls on any flash
+ * access while an erase is running. Tasks and interrupts continue to run
+ * during the erase only while they execute from RAM, but no task has to
+ * poll for the erase to finish.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <drivers/device/device.h>
+#include <sys/err.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+#include <util/bitmask.h>
+
+#include "flash.h"
+
+/**
+ * Places a function in RAM. The linker script copies these functions to
+ * RAM with the .data section at boot. long_call is needed since RAM is out
+ * of branch range of flash.
+ */
+#define FLASH_RAMFUNC __attribute__((section(".ramfunc"), noinline, long_call))
+
+/**
+ * Flash driver state
+ */
+typedef struct {
+    volatile bool busy;              /*!< Is a flash operation running */
+    volatile bool erase_done;        /*!< Set when background erase ends */
+    volatile syserr_t erase_status;  /*!< Status of last background erase */
+    void (*callback)(syserr_t);      /*!< Erase completion callback */
+    semaphore_t erase_sem;           /*!< Posted when background erase ends */
+} FLASH_state_t;
+
+/** Flash unlock key sequence */
+#define FLASH_KEY1 0x45670123UL
+#define FLASH_KEY2 0xCDEF89ABUL
+/** Flash status error flags */
+#define FLASH_SR_ERRORS                                                        \
+    (FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR |   \
+     FLASH_SR_SIZERR | FLASH_SR_PGSERR | FLASH_SR_MISERR | FLASH_SR_FASTERR |  \
+     FLASH_SR_RDERR)
+/** Number of words in a flash row */
+#define FLASH_ROW_WORDS (FLASH_ROW_BYTES / sizeof(uint32_t))
+
+static FLASH_state_t FLASH_STATE = {0};
+
+static syserr_t FLASH_unlock(void);
+static void FLASH_lock(void);
+static void FLASH_flush_caches(void);
+static void FLASH_interrupt(void);
+FLASH_RAMFUNC static uint32_t FLASH_program_dword(volatile uint32_t *dst,
+                                                  uint32_t lo, uint32_t hi);
+FLASH_RAMFUNC static uint32_t FLASH_fast_program(volatile uint32_t *dst,
+                                                 const uint32_t *src);
+
+/**
+ * Programs data into flash using double word programming. The target area
+ * must have been erased.
+ * @param addr: flash address to program. Must be double word aligned
+ * @param data: data to program
+ * @param len: length of data. Must be a multiple of FLASH_DWORD_BYTES
+ * @return SYS_OK on success, ERR_INUSE if an erase is running, ERR_DEVICE
+ * if the flash reported a programming error, or ERR_BADPARAM
+ */
+syserr_t FLASH_program(uint32_t addr, const void *data, uint32_t len) {
+    const uint8_t *src = data;
+    uint32_t lo, hi, i, errors = 0;
+    syserr_t err;
+    if (data == NULL || (addr % FLASH_DWORD_BYTES) != 0 ||
+        (len % FLASH_DWORD_BYTES) != 0 || addr < FLASH_BASE ||
+        addr + len > FLASH_PAGE_ADDR(FLASH_NUM_PAGES)) {
+        return ERR_BADPARAM;
+    }
+    err = FLASH_unlock();
+    if (err != SYS_OK) {
+        return err;
+    }
+    for (i = 0; i < len && errors == 0; i += FLASH_DWORD_BYTES) {
+        // Source data may be unaligned, or in flash itself
+        memcpy(&lo, src + i, sizeof(lo));
+        memcpy(&hi, src + i + sizeof(lo), sizeof(hi));
+        errors = FLASH_program_dword((volatile uint32_t *)(addr + i), lo, hi);
+    }
+    FLASH_flush_caches();
+    FLASH_lock();
+    return errors ? ERR_DEVICE : SYS_OK;
+}
+
+/**
+ * Programs a full row of flash using fast programming. The target row must
+ * have been erased. Interrupts are masked while the row is programmed, as
+ * the flash may not be read until it completes.
+ * @param addr: flash address to program. Must be row aligned
+ * @param data: FLASH_ROW_BYTES of data to program. Must be in RAM
+ * @return SYS_OK on success, ERR_INUSE if an erase is running, ERR_DEVICE
+ * if the flash reported a programming error, or ERR_BADPARAM
+ */
+syserr_t FLASH_program_row(uint32_t addr, const void *data) {
+    uint32_t errors;
+    syserr_t err;
+    if (data == NULL || ((uint32_t)data % sizeof(uint32_t)) != 0 ||
+        (addr % FLASH_ROW_BYTES) != 0 || addr < FLASH_BASE ||
+        addr + FLASH_ROW_BYTES > FLASH_PAGE_ADDR(FLASH_NUM_PAGES) ||
+        (uint32_t)data < SRAM1_BASE) {
+        return ERR_BADPARAM;
+    }
+    err = FLASH_unlock();
+    if (err != SYS_OK) {
+        return err;
+    }
+    /**
+     * The vector table lives in flash, so no interrupt may be taken until
+     * the row is programmed
+     */
+    mask_irq();
+    errors = FLASH_fast_program((volatile uint32_t *)addr, data);
+    unmask_irq();
+    FLASH_flush_caches();
+    FLASH_lock();
+    return errors ? ERR_DEVICE : SYS_OK;
+}
+
+/**
+ * Starts erasing a flash page, and returns without waiting for the erase.
+ * Completion can be waited for with FLASH_erase_wait.
+ * @param page: page number to erase
+ * @param callback: optional function called from interrupt context when
+ * the erase completes, with the erase status
+ * @return SYS_OK if the erase started, ERR_INUSE if flash is busy, or
+ * ERR_BADPARAM for an invalid page
+ */
+syserr_t FLASH_erase_start(uint32_t page, void (*callback)(syserr_t status)) {
+    syserr_t err;
+    if (page >= FLASH_NUM_PAGES) {
+        return ERR_BADPARAM;
+    }
+    if (rtos_started() && FLASH_STATE.erase_sem == NULL) {
+        FLASH_STATE.erase_sem = semaphore_create_binary();
+        if (FLASH_STATE.erase_sem == NULL) {
+            return ERR_NOMEM;
+        }
+    }
+    err = FLASH_unlock();
+    if (err != SYS_OK) {
+        return err;
+    }
+    FLASH_STATE.callback = callback;
+    FLASH_STATE.erase_done = false;
+    FLASH_STATE.erase_status = SYS_OK;
+    if (FLASH_STATE.erase_sem) {
+        // Clear any stale post
+        semaphore_pend(FLASH_STATE.erase_sem, 0);
+    }
+    // Select the page, and interrupt on completion or error
+    MODIFY_REG(FLASH->CR, FLASH_CR_PNB, page << FLASH_CR_PNB_Pos);
+    SETBITS(FLASH->CR, FLASH_CR_PER | FLASH_CR_EOPIE | FLASH_CR_ERRIE);
+    enable_irq(FLASH_IRQn, FLASH_interrupt);
+    SETBITS(FLASH->CR, FLASH_CR_STRT);
+    return SYS_OK;
+}
+
+/**
+ * Waits for a background erase to complete. The calling task sleeps until
+ * the end of operation interrupt fires.
+ * @param timeout: max time to wait, in ms
+ * @return status of the erase, or ERR_TIMEOUT on timeout
+ */
+syserr_t FLASH_erase_wait(FLASH_timeout_t timeout) {
+    while (!FLASH_STATE.erase_done) {
+        if (FLASH_STATE.erase_sem && rtos_started()) {
+            if (timeout == FLASH_TIMEOUT_INF) {
+                semaphore_pend(FLASH_STATE.erase_sem, SYS_TIMEOUT_INF);
+            } else if (semaphore_pend(FLASH_STATE.erase_sem, timeout) !=
+                       SYS_OK) {
+                return FLASH_STATE.erase_done ? FLASH_STATE.erase_status
+                                              : ERR_TIMEOUT;
+            }
+        } else if (timeout != FLASH_TIMEOUT_INF) {
+            // RTOS is not running, so poll for completion
+            if (timeout == FLASH_TIMEOUT_NONE) {
+                return ERR_TIMEOUT;
+            }
+            blocking_delay_ms(1);
+            timeout--;
+        }
+    }
+    return FLASH_STATE.erase_status;
+}
+
+/**
+ * Erases a flash page, and waits for the erase to complete.
+ * @param page: page number to erase
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t FLASH_erase_page(uint32_t page) {
+    syserr_t err = FLASH_erase_start(page, NULL);
+    if (err != SYS_OK) {
+        return err;
+    }
+    return FLASH_erase_wait(FLASH_TIMEOUT_INF);
+}
+
+/**
+ * Claims the flash controller, and unlocks the flash control register
+ * @return SYS_OK on success, or ERR_INUSE if a flash operation is running
+ */
+static syserr_t FLASH_unlock(void) {
+    bool claimed;
+    mask_irq();
+    claimed = !FLASH_STATE.busy;
+    FLASH_STATE.busy = true;
+    unmask_irq();
+    if (!claimed) {
+        return ERR_INUSE;
+    }
+    if (READBITS(FLASH->CR, FLASH_CR_LOCK)) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+    // Clear flags left by earlier operations
+    FLASH->SR = FLASH_SR_ERRORS | FLASH_SR_EOP;
+    return SYS_OK;
+}
+
+/**
+ * Locks the flash control register, and releases the flash controller
+ */
+static void FLASH_lock(void) {
+    SETBITS(FLASH->CR, FLASH_CR_LOCK);
+    FLASH_STATE.busy = false;
+}
+
+/**
+ * Resets the flash instruction and data caches, so they do not hold stale
+ * copies of modified flash
+ */
+static void FLASH_flush_caches(void) {
+    if (READBITS(FLASH->ACR, FLASH_ACR_ICEN)) {
+        CLEARBITS(FLASH->ACR, FLASH_ACR_ICEN);
+        SETBITS(FLASH->ACR, FLASH_ACR_ICRST);
+        CLEARBITS(FLASH->ACR, FLASH_ACR_ICRST);
+        SETBITS(FLASH->ACR, FLASH_ACR_ICEN);
+    }
+    if (READBITS(FLASH->ACR, FLASH_ACR_DCEN)) {
+        CLEARBITS(FLASH->ACR, FLASH_ACR_DCEN);
+        SETBITS(FLASH->ACR, FLASH_ACR_DCRST);
+        CLEARBITS(FLASH->ACR, FLASH_ACR_DCRST);
+        SETBITS(FLASH->ACR, FLASH_ACR_DCEN);
+    }
+}
+
+/**
+ * Handles flash end of operation and error interrupts, completing a
+ * background erase
+ */
+static void FLASH_interrupt(void) {
+    uint32_t sr = FLASH->SR;
+    FLASH->SR = FLASH_SR_ERRORS | FLASH_SR_EOP;
+    CLEARBITS(FLASH->CR, FLASH_CR_PER | FLASH_CR_EOPIE | FLASH_CR_ERRIE);
+    disable_irq(FLASH_IRQn);
+    FLASH_flush_caches();
+    FLASH_lock();
+    FLASH_STATE.erase_status = (sr & FLASH_SR_ERRORS) ? ERR_DEVICE : SYS_OK;
+    FLASH_STATE.erase_done = true;
+    if (FLASH_STATE.erase_sem) {
+        semaphore_post(FLASH_STATE.erase_sem);
+    }
+    if (FLASH_STATE.callback) {
+        FLASH_STATE.callback(FLASH_STATE.erase_status);
+    }
+}
+
+/**
+ * Programs one double word. Runs from RAM, so instruction fetches do not
+ * wait on the flash while it is busy programming.
+ * @param dst: double word aligned flash address
+ * @param lo: first word to program
+ * @param hi: second word to program
+ * @return flash error flags raised by the operation
+ */
+FLASH_RAMFUNC static uint32_t FLASH_program_dword(volatile uint32_t *dst,
+                                                  uint32_t lo, uint32_t hi) {
+    uint32_t errors;
+    FLASH->CR |= FLASH_CR_PG;
+    dst[0] = lo;
+    dst[1] = hi;
+    while (FLASH->SR & FLASH_SR_BSY) {
+        // Spin
+    }
+    errors = FLASH->SR & FLASH_SR_ERRORS;
+    FLASH->SR = FLASH_SR_ERRORS | FLASH_SR_EOP;
+    FLASH->CR &= ~FLASH_CR_PG;
+    return errors;
+}
+
+/**
+ * Programs one row with fast programming. Runs from RAM, since the flash
+ * must not be read until the whole row is programmed. Interrupts must be
+ * masked by the caller.
+ * @param dst: row aligned flash address
+ * @param src: row of data to program, in RAM
+ * @return flash error flags raised by the operation
+ */
+FLASH_RAMFUNC static uint32_t FLASH_fast_program(volatile uint32_t *dst,
+                                                 const uint32_t *src) {
+    uint32_t errors, i;
+    FLASH->CR |= FLASH_CR_FSTPG;
+    for (i = 0; i < FLASH_ROW_WORDS; i++) {
+        dst[i] = src[i];
+    }
+    while (FLASH->SR & FLASH_SR_BSY) {
+        // Spin
+    }
+    errors = FLASH->SR & FLASH_SR_ERRORS;
+    FLASH->SR = FLASH_SR_ERRORS | FLASH_SR_EOP;
+    FLASH->CR &= ~FLASH_CR_FSTPG;
+    return errors;
+}
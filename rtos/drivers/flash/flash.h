@@ -0,0 +1,89 @@
+/**
+ * @file flash.h
+ * Implements internal flash programming and erase for STM32L4xxxx.
+ * Programming routines execute from RAM. Page erases run in the background,
+ * and complete from the flash end of operation interrupt.
+ *
+ * The STM32L433 has a single flash bank, so the CPU stalls on any flash
+ * access while an erase is running. Tasks and interrupts continue to run
+ * during the erase only while they execute from RAM, but no task has to
+ * poll for the erase to finish.
+ */
+
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <stdint.h>
+
+#include <drivers/device/device.h>
+#include <sys/err.h>
+
+/** Size of a flash page, the smallest erasable unit */
+#define FLASH_PAGE_BYTES 2048
+/** Size of a flash row, the unit used by fast programming */
+#define FLASH_ROW_BYTES 256
+/** Size of a double word, the smallest programmable unit */
+#define FLASH_DWORD_BYTES 8
+/** Number of flash pages */
+#define FLASH_NUM_PAGES 128
+
+/**
+ * Gets the address of a flash page
+ * @param page: page number
+ */
+#define FLASH_PAGE_ADDR(page) (FLASH_BASE + ((page)*FLASH_PAGE_BYTES))
+
+/* Flash erase wait timeout (ms) */
+typedef int FLASH_timeout_t;
+#define FLASH_TIMEOUT_NONE 0 // No timeout
+#define FLASH_TIMEOUT_INF -1 // Infinite timeout
+
+/**
+ * Programs data into flash using double word programming. The target area
+ * must have been erased.
+ * @param addr: flash address to program. Must be double word aligned
+ * @param data: data to program
+ * @param len: length of data. Must be a multiple of FLASH_DWORD_BYTES
+ * @return SYS_OK on success, ERR_INUSE if an erase is running, ERR_DEVICE
+ * if the flash reported a programming error, or ERR_BADPARAM
+ */
+syserr_t FLASH_program(uint32_t addr, const void *data, uint32_t len);
+
+/**
+ * Programs a full row of flash using fast programming. The target row must
+ * have been erased. Interrupts are masked while the row is programmed, as
+ * the flash may not be read until it completes.
+ * @param addr: flash address to program. Must be row aligned
+ * @param data: FLASH_ROW_BYTES of data to program. Must be in RAM
+ * @return SYS_OK on success, ERR_INUSE if an erase is running, ERR_DEVICE
+ * if the flash reported a programming error, or ERR_BADPARAM
+ */
+syserr_t FLASH_program_row(uint32_t addr, const void *data);
+
+/**
+ * Starts erasing a flash page, and returns without waiting for the erase.
+ * Completion can be waited for with FLASH_erase_wait.
+ * @param page: page number to erase
+ * @param callback: optional function called from interrupt context when
+ * the erase completes, with the erase status
+ * @return SYS_OK if the erase started, ERR_INUSE if flash is busy, or
+ * ERR_BADPARAM for an invalid page
+ */
+syserr_t FLASH_erase_start(uint32_t page, void (*callback)(syserr_t status));
+
+/**
+ * Waits for a background erase to complete. The calling task sleeps until
+ * the end of operation interrupt fires.
+ * @param timeout: max time to wait, in ms
+ * @return status of the erase, or ERR_TIMEOUT on timeout
+ */
+syserr_t FLASH_erase_wait(FLASH_timeout_t timeout);
+
+/**
+ * Erases a flash page, and waits for the erase to complete.
+ * @param page: page number to erase
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t FLASH_erase_page(uint32_t page);
+
+#endif
@@ -0,0 +1,707 @@
+/**
+ * @file i2c.c
+ * Implements I2C master support for STM32L4xxxx.
+ * Transactions (write, read, or write then read with a repeated start) are
+ * queued per bus, and run by an interrupt driven state machine with DMA
+ * moving the data bytes.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <drivers/device/device.h>
+#include <drivers/dma/dma.h>
+#include <sys/err.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+#include <util/bitmask.h>
+#include <util/list/list.h>
+
+#include "i2c.h"
+
+/**
+ * I2C bus and device state
+ */
+typedef enum {
+    I2C_dev_closed = 0,
+    I2C_dev_open = 1,
+} I2C_state_t;
+
+/**
+ * Transaction phase of an I2C bus
+ */
+typedef enum {
+    I2C_phase_idle,  /*!< No transaction running */
+    I2C_phase_write, /*!< Writing data, or sending address only */
+    I2C_phase_read,  /*!< Reading data */
+} I2C_phase_t;
+
+/**
+ * Configuration structure for I2C buses
+ */
+typedef struct {
+    I2C_config_t cfg;          /*!< User configuration for bus */
+    I2C_TypeDef *regs;         /*!< Register access for this bus */
+    I2C_state_t state;         /*!< Bus state (open or closed) */
+    I2C_periph_t periph_id;    /*!< Identifies the peripheral handle uses */
+    DMA_handle_t rx_dma;       /*!< DMA channel reading the RX register */
+    DMA_handle_t tx_dma;       /*!< DMA channel writing the TX register */
+    list_t queue;              /*!< Queued transactions. Head is active */
+    I2C_transaction_t *active; /*!< Transaction in progress, or NULL */
+    I2C_phase_t phase;         /*!< Phase of the active transaction */
+    syserr_t status;           /*!< Error seen during active transaction */
+    uint32_t num_devices;      /*!< Number of devices attached to bus */
+} I2C_status_t;
+
+/**
+ * Configuration structure for I2C devices
+ */
+typedef struct {
+    I2C_device_config_t cfg;  /*!< User configuration for device */
+    I2C_status_t *bus;        /*!< Bus device is attached to */
+    I2C_state_t state;        /*!< Device state (open or closed) */
+    volatile uint32_t queued; /*!< Number of incomplete transactions */
+    semaphore_t done_sem;     /*!< Posted when a transaction completes */
+} I2C_device_t;
+
+/** All flags cleared through the ICR register */
+#define I2C_ICR_ALL                                                            \
+    (I2C_ICR_ADDRCF | I2C_ICR_NACKCF | I2C_ICR_STOPCF | I2C_ICR_BERRCF |      \
+     I2C_ICR_ARLOCF | I2C_ICR_OVRCF | I2C_ICR_PECCF | I2C_ICR_TIMOUTCF |      \
+     I2C_ICR_ALERTCF)
+/** Most prescaled clock ticks used for one SCL period */
+#define I2C_MAX_PERIOD_TICKS 380
+/** Fewest prescaled clock ticks usable for one SCL period */
+#define I2C_MIN_PERIOD_TICKS 20
+#define I2C_MAX_PRESC 0xFUL
+#define I2C_MAX_SCLDEL 0xFUL
+
+static I2C_status_t I2CS[NUM_I2CS] = {0};
+static I2C_device_t I2C_DEVICES[I2C_MAX_DEVICES] = {0};
+
+static void I2C_interrupt(void);
+static void I2C_start_transaction(I2C_status_t *bus);
+static void I2C_start_read(I2C_status_t *bus);
+static void I2C_finish_transaction(I2C_status_t *bus, syserr_t status);
+static void I2C_abort(I2C_status_t *bus, syserr_t status);
+static void I2C_dma_callback(DMA_event_t event, void *ctx);
+static syserr_t I2C_set_timing(I2C_status_t *handle);
+static syserr_t I2C_dma_channels(I2C_periph_t periph, DMA_channel_t *rx,
+                                 DMA_channel_t *tx, uint32_t *request);
+
+/**
+ * Opens an I2C bus in master mode. The bus is clocked from PCLK1.
+ * SCL and SDA pins must be configured by the caller (open drain).
+ * @param periph: Identifier of I2C peripheral to open
+ * @param config: I2C bus configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or an I2C handle to the open peripheral
+ */
+I2C_handle_t I2C_open(I2C_periph_t periph, I2C_config_t *config,
+                      syserr_t *err) {
+    I2C_status_t *handle;
+    DMA_config_t dma_cfg = DMA_DEFAULT_CONFIG;
+    DMA_channel_t rx_chan, tx_chan;
+    *err = SYS_OK; // Set no error until one occurs
+    /**
+     * Check parameters.
+     */
+    if (periph > I2C_3 || config == NULL) {
+        *err = ERR_BADPARAM;
+        return NULL;
+    }
+    handle = &I2CS[periph];
+    if (handle->state == I2C_dev_open) {
+        *err = ERR_INUSE;
+        return NULL;
+    }
+    // Set handle state to open
+    handle->state = I2C_dev_open;
+    handle->periph_id = periph;
+    handle->queue = NULL;
+    handle->active = NULL;
+    handle->phase = I2C_phase_idle;
+    handle->num_devices = 0;
+    handle->rx_dma = NULL;
+    handle->tx_dma = NULL;
+    memcpy(&handle->cfg, config, sizeof(I2C_config_t));
+    /**
+     * Enable the peripheral clock, and select PCLK1 as the kernel clock
+     */
+    switch (periph) {
+    case I2C_1:
+        SETBITS(RCC->APB1ENR1, RCC_APB1ENR1_I2C1EN);
+        CLEARBITS(RCC->CCIPR, RCC_CCIPR_I2C1SEL);
+        handle->regs = I2C1;
+        enable_irq(I2C1_EV_IRQn, I2C_interrupt);
+        enable_irq(I2C1_ER_IRQn, I2C_interrupt);
+        break;
+    case I2C_2:
+        SETBITS(RCC->APB1ENR1, RCC_APB1ENR1_I2C2EN);
+        CLEARBITS(RCC->CCIPR, RCC_CCIPR_I2C2SEL);
+        handle->regs = I2C2;
+        enable_irq(I2C2_EV_IRQn, I2C_interrupt);
+        enable_irq(I2C2_ER_IRQn, I2C_interrupt);
+        break;
+    case I2C_3:
+        SETBITS(RCC->APB1ENR1, RCC_APB1ENR1_I2C3EN);
+        CLEARBITS(RCC->CCIPR, RCC_CCIPR_I2C3SEL);
+        handle->regs = I2C3;
+        enable_irq(I2C3_EV_IRQn, I2C_interrupt);
+        enable_irq(I2C3_ER_IRQn, I2C_interrupt);
+        break;
+    default:
+        I2C_close(handle);
+        *err = ERR_BADPARAM;
+        return NULL;
+        break;
+    }
+    // Peripheral must be disabled while timing is configured
+    CLEARBITS(handle->regs->CR1, I2C_CR1_PE);
+    *err = I2C_set_timing(handle);
+    if (*err != SYS_OK) {
+        I2C_close(handle);
+        return NULL;
+    }
+    /**
+     * Allocate DMA channels. Only DMA errors are reported by callback, since
+     * transaction phases end on I2C transfer complete and stop events.
+     */
+    I2C_dma_channels(periph, &rx_chan, &tx_chan, &dma_cfg.DMA_request);
+    dma_cfg.DMA_callback = I2C_dma_callback;
+    dma_cfg.DMA_callback_ctx = handle;
+    dma_cfg.DMA_direction = DMA_periph_to_mem;
+    handle->rx_dma = DMA_open(rx_chan, &dma_cfg, err);
+    if (handle->rx_dma == NULL) {
+        I2C_close(handle);
+        return NULL;
+    }
+    dma_cfg.DMA_direction = DMA_mem_to_periph;
+    handle->tx_dma = DMA_open(tx_chan, &dma_cfg, err);
+    if (handle->tx_dma == NULL) {
+        I2C_close(handle);
+        return NULL;
+    }
+    // Interrupt on transfer complete, stop, NACK and bus errors
+    handle->regs->CR1 = I2C_CR1_TCIE | I2C_CR1_STOPIE | I2C_CR1_NACKIE |
+                        I2C_CR1_ERRIE | I2C_CR1_PE;
+    return handle;
+}
+
+/**
+ * Attaches a device to an open I2C bus.
+ * @param handle: I2C bus handle
+ * @param config: I2C device configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or a device handle for transactions
+ */
+I2C_device_handle_t I2C_add_device(I2C_handle_t handle,
+                                   I2C_device_config_t *config, syserr_t *err) {
+    I2C_status_t *bus = (I2C_status_t *)handle;
+    I2C_device_t *dev = NULL;
+    int i;
+    *err = SYS_OK; // Set no error until one occurs
+    if (bus == NULL || bus->state != I2C_dev_open || config == NULL ||
+        config->I2C_address > 0x7F) {
+        *err = ERR_BADPARAM;
+        return NULL;
+    }
+    mask_irq();
+    for (i = 0; i < I2C_MAX_DEVICES; i++) {
+        if (I2C_DEVICES[i].state == I2C_dev_closed) {
+            dev = &I2C_DEVICES[i];
+            dev->state = I2C_dev_open;
+            break;
+        }
+    }
+    unmask_irq();
+    if (dev == NULL) {
+        *err = ERR_NOMEM;
+        return NULL;
+    }
+    memcpy(&dev->cfg, config, sizeof(I2C_device_config_t));
+    dev->bus = bus;
+    dev->queued = 0;
+    /**
+     * Create the completion semaphore even before the scheduler starts, since
+     * devices are usually added in main and then used from tasks
+     */
+    dev->done_sem = semaphore_create_binary();
+    if (dev->done_sem == NULL) {
+        dev->state = I2C_dev_closed;
+        *err = ERR_NOMEM;
+        return NULL;
+    }
+    bus->num_devices++;
+    return dev;
+}
+
+/**
+ * Detaches a device from its I2C bus. The device must have no queued
+ * transactions.
+ * @param device: I2C device handle
+ * @return SYS_OK on success, ERR_INUSE if transactions are queued, or error
+ * value otherwise
+ */
+syserr_t I2C_remove_device(I2C_device_handle_t device) {
+    I2C_device_t *dev = (I2C_device_t *)device;
+    syserr_t err;
+    if (dev == NULL || dev->state != I2C_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (dev->queued != 0) {
+        return ERR_INUSE;
+    }
+    if (dev->done_sem) {
+        err = semaphore_destroy(dev->done_sem);
+        if (err != SYS_OK) {
+            return err;
+        }
+        dev->done_sem = NULL;
+    }
+    dev->bus->num_devices--;
+    dev->state = I2C_dev_closed;
+    return SYS_OK;
+}
+
+/**
+ * Queues a transaction on the device's I2C bus. Does not block. The
+ * transaction starts as soon as all transactions queued ahead of it finish.
+ * @param trans: transaction to queue
+ * @return SYS_OK on success, or ERR_BADPARAM on invalid transaction
+ */
+syserr_t I2C_queue_transaction(I2C_transaction_t *trans) {
+    I2C_device_t *dev;
+    I2C_status_t *bus;
+    if (trans == NULL || trans->I2C_tx_len > I2C_MAX_LEN ||
+        trans->I2C_rx_len > I2C_MAX_LEN ||
+        (trans->I2C_tx_len && trans->I2C_tx == NULL) ||
+        (trans->I2C_rx_len && trans->I2C_rx == NULL)) {
+        return ERR_BADPARAM;
+    }
+    dev = (I2C_device_t *)trans->I2C_device;
+    if (dev == NULL || dev->state != I2C_dev_open) {
+        return ERR_BADPARAM;
+    }
+    bus = dev->bus;
+    trans->_done = false;
+    trans->_status = SYS_OK;
+    /**
+     * The queue is also modified by the I2C interrupt as transactions
+     * complete, so interrupts must be masked while it is updated
+     */
+    mask_irq();
+    dev->queued++;
+    bus->queue = list_append(bus->queue, &trans->_list_state);
+    if (bus->active == NULL) {
+        // Bus is idle, start this transaction now
+        I2C_start_transaction(bus);
+    }
+    unmask_irq();
+    return SYS_OK;
+}
+
+/**
+ * Waits for a queued transaction to complete. The calling task sleeps until
+ * the transaction finishes. If the device timeout expires first, the
+ * transaction is cancelled (aborting it on the bus if it has started).
+ * @param trans: transaction to wait for
+ * @return SYS_OK on success, ERR_TIMEOUT on timeout, ERR_DEVICE if the
+ * device did not acknowledge or a bus error occurred
+ */
+syserr_t I2C_wait_transaction(I2C_transaction_t *trans) {
+    I2C_device_t *dev;
+    I2C_timeout_t timeout;
+    bool expired = false;
+    if (trans == NULL) {
+        return ERR_BADPARAM;
+    }
+    dev = (I2C_device_t *)trans->I2C_device;
+    if (dev == NULL || dev->state != I2C_dev_open) {
+        return ERR_BADPARAM;
+    }
+    timeout = dev->cfg.I2C_timeout;
+    while (!trans->_done && !expired) {
+        if (rtos_started()) {
+            /**
+             * The semaphore is posted on completion of any of this device's
+             * transactions, so recheck the transaction after each wakeup
+             */
+            if (timeout == I2C_TIMEOUT_INF) {
+                semaphore_pend(dev->done_sem, SYS_TIMEOUT_INF);
+            } else if (semaphore_pend(dev->done_sem, timeout) != SYS_OK) {
+                expired = true;
+            }
+        } else if (timeout != I2C_TIMEOUT_INF) {
+            // RTOS is not running, so poll the transaction
+            if (timeout == I2C_TIMEOUT_NONE) {
+                expired = true;
+            } else {
+                blocking_delay_ms(1);
+                timeout--;
+            }
+        }
+    }
+    mask_irq();
+    if (!trans->_done) {
+        // Timed out. Cancel the transaction so the caller may reuse it
+        if (dev->bus->active == trans) {
+            I2C_abort(dev->bus, ERR_TIMEOUT);
+        } else {
+            dev->bus->queue =
+                list_remove(dev->bus->queue, &trans->_list_state);
+            dev->queued--;
+            trans->_status = ERR_TIMEOUT;
+            trans->_done = true;
+        }
+    }
+    unmask_irq();
+    return trans->_status;
+}
+
+/**
+ * Runs a transaction with a device, and waits for it to complete.
+ * @param device: I2C device handle
+ * @param tx: data to write, or NULL for no write phase
+ * @param tx_len: write length (max I2C_MAX_LEN)
+ * @param rx: buffer for read data, or NULL for no read phase
+ * @param rx_len: read length (max I2C_MAX_LEN)
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t I2C_transfer(I2C_device_handle_t device, const uint8_t *tx,
+                      uint32_t tx_len, uint8_t *rx, uint32_t rx_len) {
+    I2C_transaction_t trans = {0};
+    syserr_t err;
+    trans.I2C_device = device;
+    trans.I2C_tx = tx;
+    trans.I2C_tx_len = tx_len;
+    trans.I2C_rx = rx;
+    trans.I2C_rx_len = rx_len;
+    err = I2C_queue_transaction(&trans);
+    if (err != SYS_OK) {
+        return err;
+    }
+    // Transaction is always complete or cancelled once wait returns
+    return I2C_wait_transaction(&trans);
+}
+
+/**
+ * Closes an I2C bus. All devices must have been removed.
+ * @param handle: Handle to open I2C bus
+ * @return SYS_OK on success, ERR_INUSE if devices are attached, or error
+ * value otherwise
+ */
+syserr_t I2C_close(I2C_handle_t handle) {
+    I2C_status_t *i2c = (I2C_status_t *)handle;
+    if (i2c == NULL || i2c->state != I2C_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (i2c->num_devices != 0) {
+        return ERR_INUSE;
+    }
+    if (i2c->regs) {
+        i2c->regs->CR1 = 0;
+    }
+    if (i2c->rx_dma) {
+        DMA_close(i2c->rx_dma);
+        i2c->rx_dma = NULL;
+    }
+    if (i2c->tx_dma) {
+        DMA_close(i2c->tx_dma);
+        i2c->tx_dma = NULL;
+    }
+    switch (i2c->periph_id) {
+    case I2C_1:
+        disable_irq(I2C1_EV_IRQn);
+        disable_irq(I2C1_ER_IRQn);
+        CLEARBITS(RCC->APB1ENR1, RCC_APB1ENR1_I2C1EN);
+        break;
+    case I2C_2:
+        disable_irq(I2C2_EV_IRQn);
+        disable_irq(I2C2_ER_IRQn);
+        CLEARBITS(RCC->APB1ENR1, RCC_APB1ENR1_I2C2EN);
+        break;
+    case I2C_3:
+        disable_irq(I2C3_EV_IRQn);
+        disable_irq(I2C3_ER_IRQn);
+        CLEARBITS(RCC->APB1ENR1, RCC_APB1ENR1_I2C3EN);
+        break;
+    default:
+        break;
+    }
+    i2c->regs = NULL;
+    i2c->state = I2C_dev_closed;
+    return SYS_OK;
+}
+
+/**
+ * Handles I2C event and error interrupts, advancing the transaction state
+ * machine of the bus that raised them
+ */
+static void I2C_interrupt(void) {
+    I2C_status_t *bus;
+    uint32_t isr;
+    /**
+     * Use the exception number to determine which I2C bus caused the
+     * interrupt
+     */
+    switch (READBITS(SCB->ICSR, SCB_ICSR_VECTACTIVE_Msk) - 16) {
+    case I2C1_EV_IRQn:
+    case I2C1_ER_IRQn:
+        bus = &I2CS[I2C_1];
+        break;
+    case I2C2_EV_IRQn:
+    case I2C2_ER_IRQn:
+        bus = &I2CS[I2C_2];
+        break;
+    case I2C3_EV_IRQn:
+    case I2C3_ER_IRQn:
+        bus = &I2CS[I2C_3];
+        break;
+    default:
+        /**
+         * Spin here. We want to stop processor as we
+         * should not be handling this exception.
+         */
+        while (1) {
+            // Spin
+        }
+        break;
+    }
+    isr = bus->regs->ISR;
+    if (isr & (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR)) {
+        /**
+         * The peripheral releases the bus on these errors without
+         * generating a stop, so the transaction must be aborted here
+         */
+        I2C_abort(bus, ERR_DEVICE);
+        return;
+    }
+    if (isr & I2C_ISR_NACKF) {
+        // A stop is generated automatically after a NACK
+        bus->regs->ICR = I2C_ICR_NACKCF;
+        bus->status = ERR_DEVICE;
+    }
+    if ((isr & I2C_ISR_TC) && bus->phase == I2C_phase_write) {
+        // Write phase done with no stop. Read after a repeated start
+        I2C_start_read(bus);
+    }
+    if (isr & I2C_ISR_STOPF) {
+        bus->regs->ICR = I2C_ICR_STOPCF;
+        I2C_finish_transaction(bus, bus->status);
+    }
+}
+
+/**
+ * Starts the transaction at the head of a bus queue. Must be called with
+ * interrupts masked, or from interrupt context.
+ * @param bus: I2C bus to start transaction on
+ */
+static void I2C_start_transaction(I2C_status_t *bus) {
+    I2C_transaction_t *trans =
+        list_get_head(bus->queue, I2C_transaction_t, _list_state);
+    I2C_device_t *dev;
+    uint32_t cr2;
+    if (trans == NULL) {
+        bus->phase = I2C_phase_idle;
+        return;
+    }
+    dev = (I2C_device_t *)trans->I2C_device;
+    bus->active = trans;
+    bus->status = SYS_OK;
+    bus->regs->ICR = I2C_ICR_ALL;
+    if (trans->I2C_tx_len == 0 && trans->I2C_rx_len != 0) {
+        // Read only transaction
+        I2C_start_read(bus);
+        return;
+    }
+    bus->phase = I2C_phase_write;
+    cr2 = (dev->cfg.I2C_address << 1) |
+          (trans->I2C_tx_len << I2C_CR2_NBYTES_Pos) | I2C_CR2_START;
+    if (trans->I2C_rx_len == 0) {
+        // No read phase, so stop once the write completes
+        cr2 |= I2C_CR2_AUTOEND;
+    }
+    if (trans->I2C_tx_len) {
+        DMA_start(bus->tx_dma, &bus->regs->TXDR, (void *)trans->I2C_tx,
+                  trans->I2C_tx_len);
+        SETBITS(bus->regs->CR1, I2C_CR1_TXDMAEN);
+    }
+    bus->regs->CR2 = cr2;
+}
+
+/**
+ * Starts the read phase of the active transaction on a bus. A start
+ * condition is generated, which is a repeated start if a write phase ran.
+ * @param bus: I2C bus with active transaction
+ */
+static void I2C_start_read(I2C_status_t *bus) {
+    I2C_transaction_t *trans = bus->active;
+    I2C_device_t *dev = (I2C_device_t *)trans->I2C_device;
+    bus->phase = I2C_phase_read;
+    CLEARBITS(bus->regs->CR1, I2C_CR1_TXDMAEN);
+    DMA_start(bus->rx_dma, &bus->regs->RXDR, trans->I2C_rx,
+              trans->I2C_rx_len);
+    SETBITS(bus->regs->CR1, I2C_CR1_RXDMAEN);
+    // Writing START also clears the transfer complete flag
+    bus->regs->CR2 = (dev->cfg.I2C_address << 1) | I2C_CR2_RD_WRN |
+                     (trans->I2C_rx_len << I2C_CR2_NBYTES_Pos) |
+                     I2C_CR2_START | I2C_CR2_AUTOEND;
+}
+
+/**
+ * Completes the active transaction on a bus, and starts the next queued
+ * transaction. Must be called with interrupts masked, or from interrupt
+ * context.
+ * @param bus: I2C bus with active transaction
+ * @param status: completion status of the transaction
+ */
+static void I2C_finish_transaction(I2C_status_t *bus, syserr_t status) {
+    I2C_transaction_t *trans = bus->active;
+    I2C_device_t *dev;
+    if (trans == NULL) {
+        return;
+    }
+    dev = (I2C_device_t *)trans->I2C_device;
+    CLEARBITS(bus->regs->CR1, I2C_CR1_TXDMAEN | I2C_CR1_RXDMAEN);
+    DMA_stop(bus->rx_dma);
+    DMA_stop(bus->tx_dma);
+    bus->queue = list_remove(bus->queue, &trans->_list_state);
+    bus->active = NULL;
+    bus->phase = I2C_phase_idle;
+    trans->_status = status;
+    trans->_done = true;
+    dev->queued--;
+    if (rtos_started()) {
+        semaphore_post(dev->done_sem);
+    }
+    if (trans->I2C_callback) {
+        trans->I2C_callback(trans);
+    }
+    // Start the next transaction, if one is queued
+    I2C_start_transaction(bus);
+}
+
+/**
+ * Aborts the active transaction on a bus by resetting the peripheral, which
+ * releases SCL and SDA. Must be called with interrupts masked, or from
+ * interrupt context.
+ * @param bus: I2C bus with active transaction
+ * @param status: completion status to report for the transaction
+ */
+static void I2C_abort(I2C_status_t *bus, syserr_t status) {
+    CLEARBITS(bus->regs->CR1, I2C_CR1_PE);
+    // PE must stay low for 3 APB cycles. Read back until reset completes
+    while (READBITS(bus->regs->CR1, I2C_CR1_PE)) {
+        // Spin
+    }
+    bus->regs->ICR = I2C_ICR_ALL;
+    SETBITS(bus->regs->CR1, I2C_CR1_PE);
+    I2C_finish_transaction(bus, status);
+}
+
+/**
+ * Handles DMA events for I2C channels. Only errors are of interest.
+ * @param event: DMA event
+ * @param ctx: I2C bus the DMA channel serves
+ */
+static void I2C_dma_callback(DMA_event_t event, void *ctx) {
+    I2C_status_t *bus = (I2C_status_t *)ctx;
+    if (event == DMA_event_error) {
+        I2C_abort(bus, ERR_DEVICE);
+    }
+}
+
+/**
+ * Sets the I2C timing register for the configured bus speed.
+ * The prescaler is chosen so one SCL period fits the SCLL and SCLH fields.
+ * Standard mode uses an even duty cycle, while fast modes hold SCL low for
+ * two thirds of the period, to meet the minimum low time.
+ * @param handle: I2C bus to configure
+ * @return SYS_OK on success, or ERR_BADPARAM if the speed is unreachable
+ */
+static syserr_t I2C_set_timing(I2C_status_t *handle) {
+    uint64_t clk_freq = pclk1_freq();
+    uint64_t tick_freq;
+    uint32_t presc, ticks, scll, sclh, scldel, speed;
+    speed = handle->cfg.I2C_speed;
+    if (speed != I2C_speed_standard && speed != I2C_speed_fast &&
+        speed != I2C_speed_fast_plus) {
+        return ERR_BADPARAM;
+    }
+    for (presc = 0; presc < I2C_MAX_PRESC; presc++) {
+        if ((clk_freq / (presc + 1)) / speed <= I2C_MAX_PERIOD_TICKS) {
+            break;
+        }
+    }
+    tick_freq = clk_freq / (presc + 1);
+    ticks = tick_freq / speed;
+    if (ticks < I2C_MIN_PERIOD_TICKS || ticks > I2C_MAX_PERIOD_TICKS) {
+        return ERR_BADPARAM;
+    }
+    if (speed == I2C_speed_standard) {
+        scll = ticks / 2;
+    } else {
+        scll = (ticks * 2) / 3;
+    }
+    sclh = ticks - scll;
+    /**
+     * Data setup time is 250ns in standard mode, 100ns in fast mode and
+     * 50ns in fast mode plus. Round the SCL delay up to cover it.
+     */
+    switch (handle->cfg.I2C_speed) {
+    case I2C_speed_standard:
+        scldel = (tick_freq / 4000000) + 1;
+        break;
+    case I2C_speed_fast:
+        scldel = (tick_freq / 10000000) + 1;
+        break;
+    default:
+        scldel = (tick_freq / 20000000) + 1;
+        break;
+    }
+    if (scldel > I2C_MAX_SCLDEL) {
+        scldel = I2C_MAX_SCLDEL;
+    }
+    // SCLL and SCLH fields hold the tick count minus one
+    handle->regs->TIMINGR = (presc << I2C_TIMINGR_PRESC_Pos) |
+                            (scldel << I2C_TIMINGR_SCLDEL_Pos) |
+                            (1UL << I2C_TIMINGR_SDADEL_Pos) |
+                            ((sclh - 1) << I2C_TIMINGR_SCLH_Pos) |
+                            ((scll - 1) << I2C_TIMINGR_SCLL_Pos);
+    return SYS_OK;
+}
+
+/**
+ * Gets the DMA channels and request mapping for an I2C peripheral
+ * @param periph: I2C peripheral
+ * @param rx: set to the DMA channel serving the receive request
+ * @param tx: set to the DMA channel serving the transmit request
+ * @param request: set to the request number for both channels
+ * @return SYS_OK on success, or ERR_BADPARAM for an invalid peripheral
+ */
+static syserr_t I2C_dma_channels(I2C_periph_t periph, DMA_channel_t *rx,
+                                 DMA_channel_t *tx, uint32_t *request) {
+    // Mappings taken from the DMA1 request table of the reference manual
+    *request = 3;
+    switch (periph) {
+    case I2C_1:
+        *rx = DMA1_CH7;
+        *tx = DMA1_CH6;
+        break;
+    case I2C_2:
+        *rx = DMA1_CH5;
+        *tx = DMA1_CH4;
+        break;
+    case I2C_3:
+        *rx = DMA1_CH3;
+        *tx = DMA1_CH2;
+        break;
+    default:
+        return ERR_BADPARAM;
+        break;
+    }
+    return SYS_OK;
+}
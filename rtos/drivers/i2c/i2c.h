@@ -0,0 +1,170 @@
+/**
+ * @file i2c.h
+ * Implements I2C master support for STM32L4xxxx.
+ * Transactions (write, read, or write then read with a repeated start) are
+ * queued per bus, and run by an interrupt driven state machine with DMA
+ * moving the data bytes.
+ */
+
+#ifndef I2C_H
+#define I2C_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/err.h>
+#include <util/list/list.h>
+
+/**
+ * I2C peripheral list. See datasheet for SCL/SDA pin connections.
+ */
+typedef enum {
+    I2C_1 = 0,
+    I2C_2 = 1,
+    I2C_3 = 2,
+} I2C_periph_t;
+
+#define NUM_I2CS 3
+
+/** Maximum number of devices attached across all I2C buses */
+#define I2C_MAX_DEVICES 8
+
+/** Maximum length of each phase of a transaction */
+#define I2C_MAX_LEN 255
+
+/**
+ * I2C bus speeds
+ */
+typedef enum {
+    I2C_speed_standard = 100000,  /*!< 100 kHz */
+    I2C_speed_fast = 400000,      /*!< 400 kHz */
+    I2C_speed_fast_plus = 1000000 /*!< 1 MHz */
+} I2C_speed_t;
+
+/* I2C transaction timeout (ms) */
+typedef int I2C_timeout_t;
+#define I2C_TIMEOUT_NONE 0 // No timeout
+#define I2C_TIMEOUT_INF -1 // Infinite timeout
+
+/**
+ * I2C bus configuration structure
+ */
+typedef struct I2C_config {
+    I2C_speed_t I2C_speed; /*!< Bus clock speed */
+} I2C_config_t;
+
+/**
+ * Default I2C bus configuration:
+ * 100 kHz bus speed
+ */
+#define I2C_DEFAULT_CONFIG                                                     \
+    { .I2C_speed = I2C_speed_standard }
+
+/**
+ * I2C device configuration structure
+ */
+typedef struct I2C_device_config {
+    uint8_t I2C_address;       /*!< 7 bit device address */
+    I2C_timeout_t I2C_timeout; /*!< Transaction wait timeout */
+} I2C_device_config_t;
+
+/**
+ * Default I2C device configuration:
+ * address 0x50, 100ms transaction timeout
+ */
+#define I2C_DEVICE_DEFAULT_CONFIG                                              \
+    { .I2C_address = 0x50, .I2C_timeout = 100 }
+
+typedef void *I2C_handle_t;
+typedef void *I2C_device_handle_t;
+
+/**
+ * I2C transaction. The write phase runs first (if any), followed by the
+ * read phase (if any) after a repeated start. A transaction with neither
+ * phase sends only the device address, and can be used to probe the bus.
+ * Allocated by the caller, and must remain valid until the transaction
+ * completes or times out.
+ */
+typedef struct I2C_transaction {
+    I2C_device_handle_t I2C_device; /*!< Device to communicate with */
+    const uint8_t *I2C_tx;          /*!< Data to write */
+    uint32_t I2C_tx_len;            /*!< Write length (max I2C_MAX_LEN) */
+    uint8_t *I2C_rx;                /*!< Buffer for read data */
+    uint32_t I2C_rx_len;            /*!< Read length (max I2C_MAX_LEN) */
+    /*! Optional callback, run from interrupt context on completion */
+    void (*I2C_callback)(struct I2C_transaction *trans);
+    /* Internal transaction state. Do NOT modify these fields */
+    volatile bool _done;
+    volatile syserr_t _status;
+    list_state_t _list_state;
+} I2C_transaction_t;
+
+/**
+ * Opens an I2C bus in master mode. The bus is clocked from PCLK1.
+ * SCL and SDA pins must be configured by the caller (open drain).
+ * @param periph: Identifier of I2C peripheral to open
+ * @param config: I2C bus configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or an I2C handle to the open peripheral
+ */
+I2C_handle_t I2C_open(I2C_periph_t periph, I2C_config_t *config,
+                      syserr_t *err);
+
+/**
+ * Attaches a device to an open I2C bus.
+ * @param handle: I2C bus handle
+ * @param config: I2C device configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or a device handle for transactions
+ */
+I2C_device_handle_t I2C_add_device(I2C_handle_t handle,
+                                   I2C_device_config_t *config, syserr_t *err);
+
+/**
+ * Detaches a device from its I2C bus. The device must have no queued
+ * transactions.
+ * @param device: I2C device handle
+ * @return SYS_OK on success, ERR_INUSE if transactions are queued, or error
+ * value otherwise
+ */
+syserr_t I2C_remove_device(I2C_device_handle_t device);
+
+/**
+ * Queues a transaction on the device's I2C bus. Does not block. The
+ * transaction starts as soon as all transactions queued ahead of it finish.
+ * @param trans: transaction to queue
+ * @return SYS_OK on success, or ERR_BADPARAM on invalid transaction
+ */
+syserr_t I2C_queue_transaction(I2C_transaction_t *trans);
+
+/**
+ * Waits for a queued transaction to complete. The calling task sleeps until
+ * the transaction finishes. If the device timeout expires first, the
+ * transaction is cancelled (aborting it on the bus if it has started).
+ * @param trans: transaction to wait for
+ * @return SYS_OK on success, ERR_TIMEOUT on timeout, ERR_DEVICE if the
+ * device did not acknowledge or a bus error occurred
+ */
+syserr_t I2C_wait_transaction(I2C_transaction_t *trans);
+
+/**
+ * Runs a transaction with a device, and waits for it to complete.
+ * @param device: I2C device handle
+ * @param tx: data to write, or NULL for no write phase
+ * @param tx_len: write length (max I2C_MAX_LEN)
+ * @param rx: buffer for read data, or NULL for no read phase
+ * @param rx_len: read length (max I2C_MAX_LEN)
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t I2C_transfer(I2C_device_handle_t device, const uint8_t *tx,
+                      uint32_t tx_len, uint8_t *rx, uint32_t rx_len);
+
+/**
+ * Closes an I2C bus. All devices must have been removed.
+ * @param handle: Handle to open I2C bus
+ * @return SYS_OK on success, ERR_INUSE if devices are attached, or error
+ * value otherwise
+ */
+syserr_t I2C_close(I2C_handle_t handle);
+
+#endif
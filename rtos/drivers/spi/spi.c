@@ -0,0 +1,565 @@
+/**
+ * @file spi.c
+ * Implements SPI master support for STM32L4xxxx.
+ * Transfers are full duplex and driven by DMA. Transactions for all devices
+ * on a bus are queued, and run back to back from interrupt context.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <drivers/device/device.h>
+#include <drivers/dma/dma.h>
+#include <drivers/gpio/gpio.h>
+#include <sys/err.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+#include <util/bitmask.h>
+#include <util/list/list.h>
+
+#include "spi.h"
+
+/**
+ * SPI bus and device state
+ */
+typedef enum {
+    SPI_dev_closed = 0,
+    SPI_dev_open = 1,
+} SPI_state_t;
+
+/**
+ * Configuration structure for SPI buses
+ */
+typedef struct {
+    SPI_config_t cfg;           /*!< User configuration for bus */
+    SPI_TypeDef *regs;          /*!< Register access for this bus */
+    SPI_state_t state;          /*!< Bus state (open or closed) */
+    SPI_periph_t periph_id;     /*!< Identifies the peripheral handle uses */
+    DMA_handle_t rx_dma;        /*!< DMA channel reading the data register */
+    DMA_handle_t tx_dma;        /*!< DMA channel writing the data register */
+    list_t queue;               /*!< Queued transactions. Head is active */
+    SPI_transaction_t *active;  /*!< Transaction in progress, or NULL */
+    uint32_t num_devices;       /*!< Number of devices attached to bus */
+    uint8_t fill;               /*!< Sent when transaction has no tx data */
+    uint8_t discard;            /*!< Written when transaction has no rx buf */
+} SPI_status_t;
+
+/**
+ * Configuration structure for SPI devices
+ */
+typedef struct {
+    SPI_device_config_t cfg;  /*!< User configuration for device */
+    SPI_status_t *bus;        /*!< Bus device is attached to */
+    SPI_state_t state;        /*!< Device state (open or closed) */
+    uint32_t cr1;             /*!< CR1 value used for device's transactions */
+    volatile uint32_t queued; /*!< Number of incomplete transactions */
+    semaphore_t done_sem;     /*!< Posted when a transaction completes */
+} SPI_device_t;
+
+/** Data size field value for 8 bit frames */
+#define SPI_DS_8BIT 0x7UL
+/** Largest baud rate prescaler field value (divide by 256) */
+#define SPI_MAX_BR 7
+
+static SPI_status_t SPIS[NUM_SPIS] = {0};
+static SPI_device_t SPI_DEVICES[SPI_MAX_DEVICES] = {0};
+
+static void SPI_start_transaction(SPI_status_t *bus);
+static void SPI_finish_transaction(SPI_status_t *bus, syserr_t status);
+static void SPI_rx_callback(DMA_event_t event, void *ctx);
+static void SPI_tx_callback(DMA_event_t event, void *ctx);
+static syserr_t SPI_dma_channels(SPI_periph_t periph, DMA_channel_t *rx,
+                                 DMA_channel_t *tx, uint32_t *request);
+
+/**
+ * Opens an SPI bus in master mode.
+ * SCK, MISO and MOSI pins must be configured by the caller.
+ * @param periph: Identifier of SPI peripheral to open
+ * @param config: SPI bus configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or an SPI handle to the open peripheral
+ */
+SPI_handle_t SPI_open(SPI_periph_t periph, SPI_config_t *config,
+                      syserr_t *err) {
+    SPI_status_t *handle;
+    DMA_config_t dma_cfg = DMA_DEFAULT_CONFIG;
+    DMA_channel_t rx_chan, tx_chan;
+    *err = SYS_OK; // Set no error until one occurs
+    /**
+     * Check parameters.
+     */
+    if (periph > SPI_3 || config == NULL) {
+        *err = ERR_BADPARAM;
+        return NULL;
+    }
+    handle = &SPIS[periph];
+    if (handle->state == SPI_dev_open) {
+        *err = ERR_INUSE;
+        return NULL;
+    }
+    // Set handle state to open
+    handle->state = SPI_dev_open;
+    handle->periph_id = periph;
+    handle->queue = NULL;
+    handle->active = NULL;
+    handle->num_devices = 0;
+    handle->rx_dma = NULL;
+    handle->tx_dma = NULL;
+    memcpy(&handle->cfg, config, sizeof(SPI_config_t));
+    handle->fill = config->SPI_fill_byte;
+    switch (periph) {
+    case SPI_1:
+        SETBITS(RCC->APB2ENR, RCC_APB2ENR_SPI1EN);
+        handle->regs = SPI1;
+        break;
+    case SPI_2:
+        SETBITS(RCC->APB1ENR1, RCC_APB1ENR1_SPI2EN);
+        handle->regs = SPI2;
+        break;
+    case SPI_3:
+        SETBITS(RCC->APB1ENR1, RCC_APB1ENR1_SPI3EN);
+        handle->regs = SPI3;
+        break;
+    default:
+        SPI_close(handle);
+        *err = ERR_BADPARAM;
+        return NULL;
+        break;
+    }
+    /**
+     * Allocate DMA channels. Both channels move single bytes to and from the
+     * data register. RX is given the higher priority so that received data
+     * is always drained before the next byte arrives.
+     */
+    SPI_dma_channels(periph, &rx_chan, &tx_chan, &dma_cfg.DMA_request);
+    dma_cfg.DMA_direction = DMA_periph_to_mem;
+    dma_cfg.DMA_priority = DMA_priority_vhigh;
+    dma_cfg.DMA_callback = SPI_rx_callback;
+    dma_cfg.DMA_callback_ctx = handle;
+    handle->rx_dma = DMA_open(rx_chan, &dma_cfg, err);
+    if (handle->rx_dma == NULL) {
+        SPI_close(handle);
+        return NULL;
+    }
+    dma_cfg.DMA_direction = DMA_mem_to_periph;
+    dma_cfg.DMA_priority = DMA_priority_high;
+    dma_cfg.DMA_callback = SPI_tx_callback;
+    handle->tx_dma = DMA_open(tx_chan, &dma_cfg, err);
+    if (handle->tx_dma == NULL) {
+        SPI_close(handle);
+        return NULL;
+    }
+    /**
+     * Master mode with software slave management, so chip select pins are
+     * driven as GPIOs. RXNE is set on each received byte (FRXTH), as frames
+     * are 8 bits wide.
+     */
+    handle->regs->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI;
+    handle->regs->CR2 = (SPI_DS_8BIT << SPI_CR2_DS_Pos) | SPI_CR2_FRXTH;
+    return handle;
+}
+
+/**
+ * Attaches a device to an open SPI bus. The chip select pin is configured
+ * as an output, and driven high.
+ * @param handle: SPI bus handle
+ * @param config: SPI device configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or a device handle for transactions
+ */
+SPI_device_handle_t SPI_add_device(SPI_handle_t handle,
+                                   SPI_device_config_t *config, syserr_t *err) {
+    SPI_status_t *bus = (SPI_status_t *)handle;
+    SPI_device_t *dev = NULL;
+    GPIO_config_t cs_cfg = GPIO_DEFAULT_CONFIG;
+    uint64_t pclk;
+    uint32_t br;
+    int i;
+    *err = SYS_OK; // Set no error until one occurs
+    if (bus == NULL || bus->state != SPI_dev_open || config == NULL ||
+        config->SPI_mode > SPI_mode_3 || config->SPI_frequency == 0) {
+        *err = ERR_BADPARAM;
+        return NULL;
+    }
+    /**
+     * Select the fastest clock that does not exceed the device maximum.
+     * The SPI clock is the bus clock divided by 2^(BR + 1)
+     */
+    pclk = (bus->periph_id == SPI_1) ? pclk2_freq() : pclk1_freq();
+    for (br = 0; br <= SPI_MAX_BR; br++) {
+        if ((pclk >> (br + 1)) <= config->SPI_frequency) {
+            break;
+        }
+    }
+    if (br > SPI_MAX_BR) {
+        // Device cannot run this slowly
+        *err = ERR_BADPARAM;
+        return NULL;
+    }
+    mask_irq();
+    for (i = 0; i < SPI_MAX_DEVICES; i++) {
+        if (SPI_DEVICES[i].state == SPI_dev_closed) {
+            dev = &SPI_DEVICES[i];
+            dev->state = SPI_dev_open;
+            break;
+        }
+    }
+    unmask_irq();
+    if (dev == NULL) {
+        *err = ERR_NOMEM;
+        return NULL;
+    }
+    memcpy(&dev->cfg, config, sizeof(SPI_device_config_t));
+    dev->bus = bus;
+    dev->queued = 0;
+    dev->done_sem = NULL;
+    dev->cr1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI |
+               (br << SPI_CR1_BR_Pos);
+    if (config->SPI_mode & 0x2) {
+        dev->cr1 |= SPI_CR1_CPOL;
+    }
+    if (config->SPI_mode & 0x1) {
+        dev->cr1 |= SPI_CR1_CPHA;
+    }
+    if (config->SPI_bit_order == SPI_lsb_first) {
+        dev->cr1 |= SPI_CR1_LSBFIRST;
+    }
+    /**
+     * Create the completion semaphore even before the scheduler starts, since
+     * devices are usually added in main and then used from tasks
+     */
+    dev->done_sem = semaphore_create_binary();
+    if (dev->done_sem == NULL) {
+        dev->state = SPI_dev_closed;
+        *err = ERR_NOMEM;
+        return NULL;
+    }
+    // Deselect the device before driving its chip select
+    GPIO_write(config->SPI_cs_pin, GPIO_HIGH);
+    cs_cfg.output_speed = GPIO_speed_vhigh;
+    *err = GPIO_config(config->SPI_cs_pin, &cs_cfg);
+    if (*err != SYS_OK) {
+        semaphore_destroy(dev->done_sem);
+        dev->done_sem = NULL;
+        dev->state = SPI_dev_closed;
+        return NULL;
+    }
+    GPIO_write(config->SPI_cs_pin, GPIO_HIGH);
+    bus->num_devices++;
+    return dev;
+}
+
+/**
+ * Detaches a device from its SPI bus. The device must have no queued
+ * transactions.
+ * @param device: SPI device handle
+ * @return SYS_OK on success, ERR_INUSE if transactions are queued, or error
+ * value otherwise
+ */
+syserr_t SPI_remove_device(SPI_device_handle_t device) {
+    SPI_device_t *dev = (SPI_device_t *)device;
+    syserr_t err;
+    if (dev == NULL || dev->state != SPI_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (dev->queued != 0) {
+        return ERR_INUSE;
+    }
+    if (dev->done_sem) {
+        err = semaphore_destroy(dev->done_sem);
+        if (err != SYS_OK) {
+            return err;
+        }
+        dev->done_sem = NULL;
+    }
+    dev->bus->num_devices--;
+    dev->state = SPI_dev_closed;
+    return SYS_OK;
+}
+
+/**
+ * Queues a transaction on the device's SPI bus. Does not block. The
+ * transaction starts as soon as all transactions queued ahead of it finish.
+ * @param trans: transaction to queue
+ * @return SYS_OK on success, or ERR_BADPARAM on invalid transaction
+ */
+syserr_t SPI_queue_transaction(SPI_transaction_t *trans) {
+    SPI_device_t *dev;
+    SPI_status_t *bus;
+    if (trans == NULL || trans->SPI_len == 0 || trans->SPI_len > 0xFFFF) {
+        return ERR_BADPARAM;
+    }
+    dev = (SPI_device_t *)trans->SPI_device;
+    if (dev == NULL || dev->state != SPI_dev_open) {
+        return ERR_BADPARAM;
+    }
+    bus = dev->bus;
+    trans->_done = false;
+    trans->_status = SYS_OK;
+    /**
+     * The queue is also modified by the DMA interrupt as transactions
+     * complete, so interrupts must be masked while it is updated
+     */
+    mask_irq();
+    dev->queued++;
+    bus->queue = list_append(bus->queue, &trans->_list_state);
+    if (bus->active == NULL) {
+        // Bus is idle, start this transaction now
+        SPI_start_transaction(bus);
+    }
+    unmask_irq();
+    return SYS_OK;
+}
+
+/**
+ * Waits for a queued transaction to complete. The calling task sleeps until
+ * the transaction finishes, or the device wait timeout expires.
+ * @param trans: transaction to wait for
+ * @return SYS_OK on success, ERR_TIMEOUT on timeout, or the transaction
+ * error otherwise
+ */
+syserr_t SPI_wait_transaction(SPI_transaction_t *trans) {
+    SPI_device_t *dev;
+    SPI_timeout_t timeout;
+    if (trans == NULL) {
+        return ERR_BADPARAM;
+    }
+    dev = (SPI_device_t *)trans->SPI_device;
+    if (dev == NULL || dev->state != SPI_dev_open) {
+        return ERR_BADPARAM;
+    }
+    timeout = dev->cfg.SPI_wait_timeout;
+    while (!trans->_done) {
+        if (rtos_started()) {
+            /**
+             * The semaphore is posted on completion of any of this device's
+             * transactions, so recheck the transaction after each wakeup
+             */
+            if (timeout == SPI_TIMEOUT_INF) {
+                semaphore_pend(dev->done_sem, SYS_TIMEOUT_INF);
+            } else if (semaphore_pend(dev->done_sem, timeout) != SYS_OK) {
+                return trans->_done ? trans->_status : ERR_TIMEOUT;
+            }
+        } else if (timeout != SPI_TIMEOUT_INF) {
+            // RTOS is not running, so poll the transaction
+            if (timeout == SPI_TIMEOUT_NONE) {
+                return ERR_TIMEOUT;
+            }
+            blocking_delay_ms(1);
+            timeout--;
+        }
+    }
+    return trans->_status;
+}
+
+/**
+ * Runs a full duplex transfer with a device, and waits for it to complete.
+ * @param device: SPI device handle
+ * @param tx: data to send, or NULL to send fill bytes
+ * @param rx: buffer for received data, or NULL to discard it
+ * @param len: number of bytes to transfer (max 65535)
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t SPI_transfer(SPI_device_handle_t device, const uint8_t *tx,
+                      uint8_t *rx, uint32_t len) {
+    SPI_transaction_t trans = {0};
+    syserr_t err;
+    trans.SPI_device = device;
+    trans.SPI_tx = tx;
+    trans.SPI_rx = rx;
+    trans.SPI_len = len;
+    err = SPI_queue_transaction(&trans);
+    if (err != SYS_OK) {
+        return err;
+    }
+    /**
+     * The transaction lives on this stack, so it must not be abandoned
+     * while still queued. Wait without a timeout.
+     */
+    while (!trans._done) {
+        SPI_wait_transaction(&trans);
+    }
+    return trans._status;
+}
+
+/**
+ * Closes an SPI bus. All devices must have been removed.
+ * @param handle: Handle to open SPI bus
+ * @return SYS_OK on success, ERR_INUSE if devices are attached, or error
+ * value otherwise
+ */
+syserr_t SPI_close(SPI_handle_t handle) {
+    SPI_status_t *spi = (SPI_status_t *)handle;
+    if (spi == NULL || spi->state != SPI_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (spi->num_devices != 0) {
+        return ERR_INUSE;
+    }
+    if (spi->regs) {
+        spi->regs->CR1 = 0;
+        spi->regs->CR2 = 0;
+    }
+    if (spi->rx_dma) {
+        DMA_close(spi->rx_dma);
+        spi->rx_dma = NULL;
+    }
+    if (spi->tx_dma) {
+        DMA_close(spi->tx_dma);
+        spi->tx_dma = NULL;
+    }
+    switch (spi->periph_id) {
+    case SPI_1:
+        CLEARBITS(RCC->APB2ENR, RCC_APB2ENR_SPI1EN);
+        break;
+    case SPI_2:
+        CLEARBITS(RCC->APB1ENR1, RCC_APB1ENR1_SPI2EN);
+        break;
+    case SPI_3:
+        CLEARBITS(RCC->APB1ENR1, RCC_APB1ENR1_SPI3EN);
+        break;
+    default:
+        break;
+    }
+    spi->regs = NULL;
+    spi->state = SPI_dev_closed;
+    return SYS_OK;
+}
+
+/**
+ * Starts the transaction at the head of a bus queue. Must be called with
+ * interrupts masked, or from interrupt context.
+ * @param bus: SPI bus to start transaction on
+ */
+static void SPI_start_transaction(SPI_status_t *bus) {
+    SPI_transaction_t *trans =
+        list_get_head(bus->queue, SPI_transaction_t, _list_state);
+    SPI_device_t *dev;
+    void *rx, *tx;
+    if (trans == NULL) {
+        return;
+    }
+    dev = (SPI_device_t *)trans->SPI_device;
+    bus->active = trans;
+    // Mode and clock may only change while the peripheral is disabled
+    bus->regs->CR1 = dev->cr1;
+    /**
+     * Missing buffers are replaced with a single fill or discard byte, with
+     * the memory address held fixed
+     */
+    rx = trans->SPI_rx ? (void *)trans->SPI_rx : (void *)&bus->discard;
+    tx = trans->SPI_tx ? (void *)trans->SPI_tx : (void *)&bus->fill;
+    DMA_set_mem_inc(bus->rx_dma, trans->SPI_rx != NULL);
+    DMA_set_mem_inc(bus->tx_dma, trans->SPI_tx != NULL);
+    // Reference manual requires RX DMA be enabled before TX DMA
+    SETBITS(bus->regs->CR2, SPI_CR2_RXDMAEN);
+    DMA_start(bus->rx_dma, &bus->regs->DR, rx, trans->SPI_len);
+    DMA_start(bus->tx_dma, &bus->regs->DR, tx, trans->SPI_len);
+    SETBITS(bus->regs->CR2, SPI_CR2_TXDMAEN);
+    GPIO_write(dev->cfg.SPI_cs_pin, GPIO_LOW);
+    SETBITS(bus->regs->CR1, SPI_CR1_SPE);
+}
+
+/**
+ * Completes the active transaction on a bus, and starts the next queued
+ * transaction. Called from interrupt context.
+ * @param bus: SPI bus with active transaction
+ * @param status: completion status of the transaction
+ */
+static void SPI_finish_transaction(SPI_status_t *bus, syserr_t status) {
+    SPI_transaction_t *trans = bus->active;
+    SPI_device_t *dev;
+    if (trans == NULL) {
+        return;
+    }
+    dev = (SPI_device_t *)trans->SPI_device;
+    /**
+     * All bytes have been received, so the bus is idle or finishing the
+     * final clock edge. Wait for it before releasing chip select
+     */
+    while (READBITS(bus->regs->SR, SPI_SR_BSY)) {
+        // Spin
+    }
+    CLEARBITS(bus->regs->CR1, SPI_CR1_SPE);
+    CLEARBITS(bus->regs->CR2, SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+    DMA_stop(bus->rx_dma);
+    DMA_stop(bus->tx_dma);
+    GPIO_write(dev->cfg.SPI_cs_pin, GPIO_HIGH);
+    bus->queue = list_remove(bus->queue, &trans->_list_state);
+    bus->active = NULL;
+    trans->_status = status;
+    trans->_done = true;
+    dev->queued--;
+    if (rtos_started()) {
+        semaphore_post(dev->done_sem);
+    }
+    if (trans->SPI_callback) {
+        trans->SPI_callback(trans);
+    }
+    // Start the next transaction, if one is queued
+    SPI_start_transaction(bus);
+}
+
+/**
+ * Handles receive DMA events. Receive completion marks the end of a
+ * transaction, since the final byte has been clocked in.
+ * @param event: DMA event
+ * @param ctx: SPI bus the DMA channel serves
+ */
+static void SPI_rx_callback(DMA_event_t event, void *ctx) {
+    SPI_status_t *bus = (SPI_status_t *)ctx;
+    if (event == DMA_event_complete) {
+        SPI_finish_transaction(bus, SYS_OK);
+    } else if (event == DMA_event_error) {
+        SPI_finish_transaction(bus, ERR_DEVICE);
+    }
+}
+
+/**
+ * Handles transmit DMA events. Only errors are of interest, as transmit
+ * completes before the final byte is received.
+ * @param event: DMA event
+ * @param ctx: SPI bus the DMA channel serves
+ */
+static void SPI_tx_callback(DMA_event_t event, void *ctx) {
+    SPI_status_t *bus = (SPI_status_t *)ctx;
+    if (event == DMA_event_error) {
+        SPI_finish_transaction(bus, ERR_DEVICE);
+    }
+}
+
+/**
+ * Gets the DMA channels and request mapping for an SPI peripheral
+ * @param periph: SPI peripheral
+ * @param rx: set to the DMA channel serving the receive request
+ * @param tx: set to the DMA channel serving the transmit request
+ * @param request: set to the request number for both channels
+ * @return SYS_OK on success, or ERR_BADPARAM for an invalid peripheral
+ */
+static syserr_t SPI_dma_channels(SPI_periph_t periph, DMA_channel_t *rx,
+                                 DMA_channel_t *tx, uint32_t *request) {
+    // Mappings taken from the DMA request tables of the reference manual
+    switch (periph) {
+    case SPI_1:
+        *rx = DMA1_CH2;
+        *tx = DMA1_CH3;
+        *request = 1;
+        break;
+    case SPI_2:
+        *rx = DMA1_CH4;
+        *tx = DMA1_CH5;
+        *request = 1;
+        break;
+    case SPI_3:
+        *rx = DMA2_CH1;
+        *tx = DMA2_CH2;
+        *request = 3;
+        break;
+    default:
+        return ERR_BADPARAM;
+        break;
+    }
+    return SYS_OK;
+}
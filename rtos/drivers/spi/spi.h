@@ -0,0 +1,178 @@
+/**
+ * @file spi.h
+ * Implements SPI master support for STM32L4xxxx.
+ * Transfers are full duplex and driven by DMA. Transactions for all devices
+ * on a bus are queued, and run back to back from interrupt context.
+ */
+
+#ifndef SPI_H
+#define SPI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <drivers/gpio/gpio.h>
+#include <sys/err.h>
+#include <util/list/list.h>
+
+/**
+ * SPI peripheral list. See datasheet for SCK/MISO/MOSI pin connections.
+ */
+typedef enum {
+    SPI_1 = 0,
+    SPI_2 = 1,
+    SPI_3 = 2,
+} SPI_periph_t;
+
+#define NUM_SPIS 3
+
+/** Maximum number of devices attached across all SPI buses */
+#define SPI_MAX_DEVICES 8
+
+/**
+ * SPI clock modes
+ */
+typedef enum {
+    SPI_mode_0 = 0, /*!< Clock idles low, data sampled on rising edge */
+    SPI_mode_1 = 1, /*!< Clock idles low, data sampled on falling edge */
+    SPI_mode_2 = 2, /*!< Clock idles high, data sampled on falling edge */
+    SPI_mode_3 = 3, /*!< Clock idles high, data sampled on rising edge */
+} SPI_mode_t;
+
+/**
+ * SPI data bit order
+ */
+typedef enum {
+    SPI_msb_first,
+    SPI_lsb_first,
+} SPI_bit_order_t;
+
+/* SPI transaction wait timeout (ms) */
+typedef int SPI_timeout_t;
+#define SPI_TIMEOUT_NONE 0 // No timeout
+#define SPI_TIMEOUT_INF -1 // Infinite timeout
+
+/**
+ * SPI bus configuration structure
+ */
+typedef struct SPI_config {
+    uint8_t SPI_fill_byte; /*!< Byte sent when transaction has no tx data */
+} SPI_config_t;
+
+/**
+ * Default SPI bus configuration:
+ * 0xFF sent when no transmit data is given
+ */
+#define SPI_DEFAULT_CONFIG                                                     \
+    { .SPI_fill_byte = 0xFF }
+
+/**
+ * SPI device configuration structure
+ */
+typedef struct SPI_device_config {
+    GPIO_pin_t SPI_cs_pin;          /*!< Chip select pin (active low) */
+    SPI_mode_t SPI_mode;            /*!< Clock polarity and phase */
+    uint32_t SPI_frequency;         /*!< Max clock frequency, in Hz */
+    SPI_bit_order_t SPI_bit_order;  /*!< Data bit order */
+    SPI_timeout_t SPI_wait_timeout; /*!< Transaction wait timeout */
+} SPI_device_config_t;
+
+/**
+ * Default SPI device configuration:
+ * CS on PA4, mode 0 at up to 1MHz, MSB first, infinite wait timeout
+ */
+#define SPI_DEVICE_DEFAULT_CONFIG                                              \
+    {                                                                          \
+        .SPI_cs_pin = GPIO_PA4, .SPI_mode = SPI_mode_0,                        \
+        .SPI_frequency = 1000000, .SPI_bit_order = SPI_msb_first,              \
+        .SPI_wait_timeout = SPI_TIMEOUT_INF                                    \
+    }
+
+typedef void *SPI_handle_t;
+typedef void *SPI_device_handle_t;
+
+/**
+ * SPI transaction. Allocated by the caller, and must remain valid until the
+ * transaction completes.
+ */
+typedef struct SPI_transaction {
+    SPI_device_handle_t SPI_device; /*!< Device to communicate with */
+    const uint8_t *SPI_tx;          /*!< Data to send, or NULL to send fill */
+    uint8_t *SPI_rx;                /*!< Buffer for received data, or NULL */
+    uint32_t SPI_len;               /*!< Transaction length (max 65535) */
+    /*! Optional callback, run from interrupt context on completion */
+    void (*SPI_callback)(struct SPI_transaction *trans);
+    /* Internal transaction state. Do NOT modify these fields */
+    volatile bool _done;
+    volatile syserr_t _status;
+    list_state_t _list_state;
+} SPI_transaction_t;
+
+/**
+ * Opens an SPI bus in master mode.
+ * SCK, MISO and MOSI pins must be configured by the caller.
+ * @param periph: Identifier of SPI peripheral to open
+ * @param config: SPI bus configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or an SPI handle to the open peripheral
+ */
+SPI_handle_t SPI_open(SPI_periph_t periph, SPI_config_t *config,
+                      syserr_t *err);
+
+/**
+ * Attaches a device to an open SPI bus. The chip select pin is configured
+ * as an output, and driven high.
+ * @param handle: SPI bus handle
+ * @param config: SPI device configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or a device handle for transactions
+ */
+SPI_device_handle_t SPI_add_device(SPI_handle_t handle,
+                                   SPI_device_config_t *config, syserr_t *err);
+
+/**
+ * Detaches a device from its SPI bus. The device must have no queued
+ * transactions.
+ * @param device: SPI device handle
+ * @return SYS_OK on success, ERR_INUSE if transactions are queued, or error
+ * value otherwise
+ */
+syserr_t SPI_remove_device(SPI_device_handle_t device);
+
+/**
+ * Queues a transaction on the device's SPI bus. Does not block. The
+ * transaction starts as soon as all transactions queued ahead of it finish.
+ * @param trans: transaction to queue
+ * @return SYS_OK on success, or ERR_BADPARAM on invalid transaction
+ */
+syserr_t SPI_queue_transaction(SPI_transaction_t *trans);
+
+/**
+ * Waits for a queued transaction to complete. The calling task sleeps until
+ * the transaction finishes, or the device wait timeout expires.
+ * @param trans: transaction to wait for
+ * @return SYS_OK on success, ERR_TIMEOUT on timeout, or the transaction
+ * error otherwise
+ */
+syserr_t SPI_wait_transaction(SPI_transaction_t *trans);
+
+/**
+ * Runs a full duplex transfer with a device, and waits for it to complete.
+ * @param device: SPI device handle
+ * @param tx: data to send, or NULL to send fill bytes
+ * @param rx: buffer for received data, or NULL to discard it
+ * @param len: number of bytes to transfer (max 65535)
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t SPI_transfer(SPI_device_handle_t device, const uint8_t *tx,
+                      uint8_t *rx, uint32_t len);
+
+/**
+ * Closes an SPI bus. All devices must have been removed.
+ * @param handle: Handle to open SPI bus
+ * @return SYS_OK on success, ERR_INUSE if devices are attached, or error
+ * value otherwise
+ */
+syserr_t SPI_close(SPI_handle_t handle);
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file adc_test.c
+ * Tests timer triggered ADC sampling into a DMA double buffer.
+ *
+ * PA0 (ADC1 channel 5) is sampled at 1kHz into a buffer of two 50 sample
+ * halves, so a half should complete every 50ms. Connect PA0 to any voltage
+ * between 0V and 3.3V before running this test.
+ *
+ * Expected output:
+ * Test 1 passed: read a half buffer of 50 samples
+ * Test 2 passed: all samples were in range
+ * Test 3 passed: 10 halves completed in 500ms
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <drivers/adc/adc.h>
+#include <drivers/clock/clock.h>
+#include <drivers/gpio/gpio.h>
+#include <util/logging/logging.h>
+
+#define SAMPLE_RATE 1000
+#define HALF_LEN 50
+#define NUM_HALVES 10
+#define ADC_MAX_VALUE 4095
+
+static const char *TAG = "adc_test";
+static uint16_t sample_buf[2 * HALF_LEN];
+static volatile int half_count = 0;
+
+/**
+ * Initializes system clock and ADC input pin
+ */
+static void system_init() {
+    syserr_t err;
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    GPIO_config_t gpio_config = GPIO_DEFAULT_CONFIG;
+    clock_init(&clk_cfg);
+    gpio_config.mode = GPIO_mode_analog;
+    err = GPIO_config(GPIO_PA0, &gpio_config);
+    if (err != SYS_OK) {
+        LOG_E(TAG, "Could not init GPIO A0");
+        exit(err);
+    }
+}
+
+/**
+ * Callback run when half of the sample buffer completes
+ * @param samples: completed half buffer
+ * @param count: number of samples in half buffer
+ */
+static void half_callback(uint16_t *samples, uint32_t count) {
+    half_count++;
+}
+
+int main() {
+    syserr_t err;
+    ADC_handle_t adc;
+    ADC_config_t adc_cfg = ADC_DEFAULT_CONFIG;
+    uint16_t *samples;
+    bool in_range = true;
+    int num_read, start_count, i;
+    system_init();
+    adc_cfg.ADC_sample_rate = SAMPLE_RATE;
+    adc_cfg.ADC_read_timeout = 200;
+    adc_cfg.ADC_callback = half_callback;
+    adc = ADC_open(ADC_1, &adc_cfg, sample_buf, 2 * HALF_LEN, &err);
+    if (adc == NULL) {
+        LOG_E(TAG, "Could not open ADC");
+        exit(err);
+    }
+    err = ADC_start(adc);
+    if (err != SYS_OK) {
+        LOG_E(TAG, "Could not start ADC");
+        exit(err);
+    }
+    /* Wait for one half buffer */
+    num_read = ADC_read(adc, &samples, &err);
+    if (num_read == HALF_LEN) {
+        printf("Test 1 passed: read a half buffer of %d samples\n", HALF_LEN);
+    } else {
+        printf("Test 1 failed: read returned %d\n", num_read);
+    }
+    /* Samples are 12 bit, right aligned */
+    for (i = 0; i < num_read; i++) {
+        if (samples[i] > ADC_MAX_VALUE) {
+            in_range = false;
+        }
+    }
+    if (num_read > 0 && in_range) {
+        printf("Test 2 passed: all samples were in range\n");
+    } else {
+        printf("Test 2 failed\n");
+    }
+    /* Check the half completion rate. Allow one half of error */
+    start_count = half_count;
+    blocking_delay_ms(NUM_HALVES * HALF_LEN * 1000 / SAMPLE_RATE);
+    i = half_count - start_count;
+    if (i >= NUM_HALVES - 1 && i <= NUM_HALVES + 1) {
+        printf("Test 3 passed: %d halves completed in %dms\n", NUM_HALVES,
+               NUM_HALVES * HALF_LEN * 1000 / SAMPLE_RATE);
+    } else {
+        printf("Test 3 failed: %d halves completed\n", i);
+    }
+    ADC_stop(adc);
+    ADC_close(adc);
+    return SYS_OK;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file crc_bench.c
+ * Benchmarks the slice-by-8 software CRC-32 against a byte-at-a-time table
+ * implementation. Built and run on the host, see Makefile.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "crc_sw.h"
+
+#define BUF_LEN (64 * 1024)
+#define ITERATIONS 2000
+
+static uint8_t buf[BUF_LEN];
+static uint32_t byte_table[256];
+
+/**
+ * Builds the byte-at-a-time lookup table
+ */
+static void byte_table_init(void) {
+    uint32_t i, crc;
+    int j;
+    for (i = 0; i < 256; i++) {
+        crc = i;
+        for (j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320UL : 0);
+        }
+        byte_table[i] = crc;
+    }
+}
+
+/**
+ * Byte-at-a-time table CRC-32
+ * @param data: data to compute CRC over
+ * @param len: length of data
+ * @return CRC-32 of data
+ */
+static uint32_t crc32_bytewise(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--) {
+        crc = byte_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * Gets monotonic time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main() {
+    double start, sliced, bytewise, mbytes;
+    volatile uint32_t sink = 0;
+    int i;
+    byte_table_init();
+    for (i = 0; i < BUF_LEN; i++) {
+        buf[i] = rand();
+    }
+    mbytes = (double)BUF_LEN * ITERATIONS / (1024 * 1024);
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        sink ^= CRC_sw_crc32(0, buf, BUF_LEN);
+    }
+    sliced = now() - start;
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        sink ^= crc32_bytewise(buf, BUF_LEN);
+    }
+    bytewise = now() - start;
+    printf("slice-by-8: %8.1f MB/s\n", mbytes / sliced);
+    printf("bytewise:   %8.1f MB/s\n", mbytes / bytewise);
+    printf("speedup:    %8.2fx\n", bytewise / sliced);
+    return sink == 0xFFFFFFFF;
+}
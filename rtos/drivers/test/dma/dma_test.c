@@ -0,0 +1,129 @@
+/**
+ * @file dma_test.c
+ * Tests DMA channel allocation and memory to memory transfers.
+ *
+ * A source buffer is copied to a destination buffer using byte and word wide
+ * transfers, and the completion callback must fire once per copy. Opening a
+ * channel that is already allocated must fail.
+ *
+ * Expected output:
+ * Test 1 passed: byte copy complete
+ * Test 2 passed: word copy complete
+ * Test 3 passed: allocated channel could not be reopened
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <drivers/dma/dma.h>
+#include <util/logging/logging.h>
+
+#define BUF_LEN 64
+
+static const char *TAG = "dma_test";
+static uint8_t src_buf[BUF_LEN] __attribute__((aligned(4)));
+static uint8_t dst_buf[BUF_LEN] __attribute__((aligned(4)));
+static volatile int complete_count = 0;
+static volatile int error_count = 0;
+
+/**
+ * Initializes system clock
+ */
+static void system_init() {
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    clock_init(&clk_cfg);
+}
+
+/**
+ * DMA event callback. Counts completion and error events
+ * @param event: DMA event that occurred
+ * @param ctx: unused
+ */
+static void dma_callback(DMA_event_t event, void *ctx) {
+    if (event == DMA_event_complete) {
+        complete_count++;
+    } else if (event == DMA_event_error) {
+        error_count++;
+    }
+}
+
+/**
+ * Copies the source buffer to the destination buffer with DMA, and verifies
+ * the result
+ * @param chan: DMA channel to use
+ * @param width: transfer width
+ * @return true if the copy completed and the buffers match
+ */
+static bool dma_copy(DMA_channel_t chan, DMA_width_t width) {
+    DMA_handle_t dma;
+    DMA_config_t cfg = DMA_DEFAULT_CONFIG;
+    syserr_t err;
+    uint32_t count;
+    int expected = complete_count + 1;
+    cfg.DMA_direction = DMA_mem_to_mem;
+    cfg.DMA_periph_inc = true;
+    cfg.DMA_periph_width = width;
+    cfg.DMA_mem_width = width;
+    cfg.DMA_callback = dma_callback;
+    memset(dst_buf, 0, BUF_LEN);
+    dma = DMA_open(chan, &cfg, &err);
+    if (dma == NULL) {
+        LOG_E(TAG, "Could not open DMA channel");
+        exit(err);
+    }
+    count = BUF_LEN >> width;
+    err = DMA_start(dma, src_buf, dst_buf, count);
+    if (err != SYS_OK) {
+        LOG_E(TAG, "Could not start DMA transfer");
+        exit(err);
+    }
+    blocking_delay_ms(10);
+    if (DMA_remaining(dma) != 0) {
+        LOG_E(TAG, "DMA transfer did not finish");
+        DMA_close(dma);
+        return false;
+    }
+    DMA_close(dma);
+    if (complete_count != expected || error_count != 0) {
+        LOG_E(TAG, "Unexpected callback count %d", complete_count);
+        return false;
+    }
+    return memcmp(src_buf, dst_buf, BUF_LEN) == 0;
+}
+
+int main() {
+    syserr_t err;
+    DMA_handle_t dma, dup;
+    DMA_config_t cfg = DMA_DEFAULT_CONFIG;
+    int i;
+    system_init();
+    for (i = 0; i < BUF_LEN; i++) {
+        src_buf[i] = i;
+    }
+    if (dma_copy(DMA1_CH1, DMA_width_8)) {
+        printf("Test 1 passed: byte copy complete\n");
+    } else {
+        printf("Test 1 failed\n");
+    }
+    if (dma_copy(DMA2_CH7, DMA_width_32)) {
+        printf("Test 2 passed: word copy complete\n");
+    } else {
+        printf("Test 2 failed\n");
+    }
+    dma = DMA_open(DMA1_CH3, &cfg, &err);
+    if (dma == NULL) {
+        LOG_E(TAG, "Could not open DMA channel");
+        exit(err);
+    }
+    dup = DMA_open(DMA1_CH3, &cfg, &err);
+    if (dup == NULL && err == ERR_INUSE) {
+        printf("Test 3 passed: allocated channel could not be reopened\n");
+    } else {
+        printf("Test 3 failed\n");
+    }
+    DMA_close(dma);
+    return SYS_OK;
+}
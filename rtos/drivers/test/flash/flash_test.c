@@ -0,0 +1,108 @@
+/**
+ * @file flash_test.c
+ * Tests the internal flash driver.
+ *
+ * The last flash page is erased in the background, and the completion
+ * callback is checked. Double words and a fast programmed row are then
+ * written to the page and read back.
+ *
+ * Expected output:
+ * Test 1 passed: background erase completed
+ * Test 2 passed: double word programming verified
+ * Test 3 passed: fast row programming verified
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <drivers/flash/flash.h>
+#include <util/logging/logging.h>
+
+#define TEST_PAGE (FLASH_NUM_PAGES - 1)
+#define DWORD_LEN 40
+
+static const char *TAG = "flash_test";
+static uint32_t row[FLASH_ROW_BYTES / sizeof(uint32_t)];
+static volatile bool callback_ran = false;
+
+/**
+ * Initializes system clock
+ */
+static void system_init() {
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    clock_init(&clk_cfg);
+}
+
+/**
+ * Called from interrupt context when the background erase completes
+ * @param status: erase status
+ */
+static void erase_callback(syserr_t status) {
+    callback_ran = (status == SYS_OK);
+}
+
+/**
+ * Checks that a flash region is erased
+ * @param addr: flash address to check
+ * @param len: length to check
+ * @return true if every byte is erased
+ */
+static bool is_erased(uint32_t addr, uint32_t len) {
+    const uint8_t *flash = (const uint8_t *)addr;
+    uint32_t i;
+    for (i = 0; i < len; i++) {
+        if (flash[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    syserr_t err;
+    uint32_t page_addr = FLASH_PAGE_ADDR(TEST_PAGE);
+    uint32_t row_addr = page_addr + FLASH_ROW_BYTES;
+    const char *dwords = "double words programmed into flash!!!!!";
+    int i;
+    system_init();
+    for (i = 0; i < FLASH_ROW_BYTES / sizeof(uint32_t); i++) {
+        row[i] = 0xA5000000 | i;
+    }
+    /* Background erase */
+    err = FLASH_erase_start(TEST_PAGE, erase_callback);
+    if (err != SYS_OK) {
+        LOG_E(TAG, "Could not start erase");
+        exit(err);
+    }
+    if (FLASH_erase_start(TEST_PAGE, NULL) != ERR_INUSE) {
+        LOG_W(TAG, "Second erase was not rejected");
+    }
+    err = FLASH_erase_wait(FLASH_TIMEOUT_INF);
+    if (err == SYS_OK && callback_ran &&
+        is_erased(page_addr, FLASH_PAGE_BYTES)) {
+        printf("Test 1 passed: background erase completed\n");
+    } else {
+        printf("Test 1 failed\n");
+    }
+    /* Double word programming */
+    err = FLASH_program(page_addr, dwords, DWORD_LEN);
+    if (err == SYS_OK &&
+        memcmp((const void *)page_addr, dwords, DWORD_LEN) == 0) {
+        printf("Test 2 passed: double word programming verified\n");
+    } else {
+        printf("Test 2 failed\n");
+    }
+    /* Fast row programming */
+    err = FLASH_program_row(row_addr, row);
+    if (err == SYS_OK &&
+        memcmp((const void *)row_addr, row, FLASH_ROW_BYTES) == 0) {
+        printf("Test 3 passed: fast row programming verified\n");
+    } else {
+        printf("Test 3 failed\n");
+    }
+    FLASH_erase_page(TEST_PAGE);
+    return SYS_OK;
+}
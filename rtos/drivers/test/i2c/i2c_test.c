@@ -0,0 +1,192 @@
+/**
+ * @file i2c_test.c
+ * Tests I2C transactions against a 24xx series EEPROM.
+ *
+ * Connect a 24xx EEPROM (address 0x50) to PB6 (I2C1 SCL) and PB7 (I2C1 SDA),
+ * with pullup resistors on both lines, before running this test.
+ *
+ * Tests 1 to 3 run before the scheduler starts, so transactions are polled.
+ * Test 4 reads from a task, using the devices added in main, and checks that
+ * the task slept on the transfer while a lower priority task ran.
+ *
+ * Expected output:
+ * Test 1 passed: absent device was not acknowledged
+ * Test 2 passed: EEPROM write then read matched
+ * Test 3 passed: queued transactions completed
+ * Test 4 passed: task slept during transfer
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <drivers/gpio/gpio.h>
+#include <drivers/i2c/i2c.h>
+#include <sys/task/task.h>
+#include <util/logging/logging.h>
+
+#define EEPROM_ADDR 0x50
+#define ABSENT_ADDR 0x7F
+#define DATA_LEN 8
+/** EEPROM internal write cycle time */
+#define EEPROM_WRITE_MS 10
+
+static const char *TAG = "i2c_test";
+static volatile int complete_count = 0;
+static volatile uint32_t spin_count = 0;
+static I2C_device_handle_t eeprom;
+static uint8_t write_buf[DATA_LEN + 1];
+
+/**
+ * Initializes system clock and I2C pins
+ */
+static void system_init() {
+    syserr_t err;
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    GPIO_config_t gpio_config = GPIO_DEFAULT_CONFIG;
+    clock_init(&clk_cfg);
+    // PB6 and PB7 are I2C1 SCL and SDA on alternate function 4
+    gpio_config.mode = GPIO_mode_afunc;
+    gpio_config.output_type = GPIO_opendrain;
+    gpio_config.output_speed = GPIO_speed_high;
+    gpio_config.alternate_func = GPIO_af4;
+    err = GPIO_config(GPIO_PB6, &gpio_config);
+    if (err != SYS_OK) {
+        LOG_E(TAG, "Could not init GPIO B6");
+        exit(err);
+    }
+    err = GPIO_config(GPIO_PB7, &gpio_config);
+    if (err != SYS_OK) {
+        LOG_E(TAG, "Could not init GPIO B7");
+        exit(err);
+    }
+}
+
+/**
+ * Transaction completion callback
+ * @param trans: completed transaction
+ */
+static void transaction_callback(I2C_transaction_t *trans) {
+    complete_count++;
+}
+
+/**
+ * Low priority task entry point. Counts while the test task sleeps.
+ * @param arg: unused
+ */
+static void spin_task(void *arg) {
+    while (1) {
+        spin_count++;
+        task_yield();
+    }
+}
+
+/**
+ * Test task entry point. Reads the EEPROM, which must put the task to sleep
+ * on the device's completion semaphore rather than polling.
+ * @param arg: unused
+ */
+static void test_task(void *arg) {
+    syserr_t err;
+    uint8_t read_buf[DATA_LEN];
+    uint8_t mem_addr = 0;
+    uint32_t spins;
+    memset(read_buf, 0, DATA_LEN);
+    spins = spin_count;
+    err = I2C_transfer(eeprom, &mem_addr, 1, read_buf, DATA_LEN);
+    spins = spin_count - spins;
+    if (err == SYS_OK && memcmp(write_buf + 1, read_buf, DATA_LEN) == 0 &&
+        spins != 0) {
+        printf("Test 4 passed: task slept during transfer\n");
+    } else {
+        printf("Test 4 failed: error %d, %lu spins\n", err, spins);
+    }
+    while (1) {
+        task_delay(1000);
+    }
+}
+
+int main() {
+    syserr_t err;
+    I2C_handle_t i2c;
+    I2C_device_handle_t absent;
+    I2C_config_t i2c_cfg = I2C_DEFAULT_CONFIG;
+    I2C_device_config_t dev_cfg = I2C_DEVICE_DEFAULT_CONFIG;
+    task_config_t spin_conf = DEFAULT_TASK_CONFIG;
+    I2C_transaction_t trans[2] = {0};
+    uint8_t read_buf[DATA_LEN];
+    uint8_t mem_addr = 0;
+    int i;
+    system_init();
+    i2c_cfg.I2C_speed = I2C_speed_fast;
+    i2c = I2C_open(I2C_1, &i2c_cfg, &err);
+    if (i2c == NULL) {
+        LOG_E(TAG, "Could not open I2C bus");
+        exit(err);
+    }
+    dev_cfg.I2C_address = EEPROM_ADDR;
+    eeprom = I2C_add_device(i2c, &dev_cfg, &err);
+    if (eeprom == NULL) {
+        LOG_E(TAG, "Could not add EEPROM device");
+        exit(err);
+    }
+    dev_cfg.I2C_address = ABSENT_ADDR;
+    absent = I2C_add_device(i2c, &dev_cfg, &err);
+    if (absent == NULL) {
+        LOG_E(TAG, "Could not add absent device");
+        exit(err);
+    }
+    /* Probe an address with no device */
+    err = I2C_transfer(absent, NULL, 0, NULL, 0);
+    if (err == ERR_DEVICE) {
+        printf("Test 1 passed: absent device was not acknowledged\n");
+    } else {
+        printf("Test 1 failed: probe returned %d\n", err);
+    }
+    /* Write a page, then read it back with a repeated start */
+    write_buf[0] = mem_addr;
+    for (i = 0; i < DATA_LEN; i++) {
+        write_buf[i + 1] = 0xA0 + i;
+    }
+    err = I2C_transfer(eeprom, write_buf, DATA_LEN + 1, NULL, 0);
+    if (err != SYS_OK) {
+        LOG_E(TAG, "EEPROM write failed");
+        exit(err);
+    }
+    blocking_delay_ms(EEPROM_WRITE_MS);
+    memset(read_buf, 0, DATA_LEN);
+    err = I2C_transfer(eeprom, &mem_addr, 1, read_buf, DATA_LEN);
+    if (err == SYS_OK && memcmp(write_buf + 1, read_buf, DATA_LEN) == 0) {
+        printf("Test 2 passed: EEPROM write then read matched\n");
+    } else {
+        printf("Test 2 failed\n");
+    }
+    /* Queue a failing and a succeeding transaction back to back */
+    trans[0].I2C_device = absent;
+    trans[0].I2C_callback = transaction_callback;
+    trans[1].I2C_device = eeprom;
+    trans[1].I2C_tx = &mem_addr;
+    trans[1].I2C_tx_len = 1;
+    trans[1].I2C_rx = read_buf;
+    trans[1].I2C_rx_len = DATA_LEN;
+    trans[1].I2C_callback = transaction_callback;
+    I2C_queue_transaction(&trans[0]);
+    I2C_queue_transaction(&trans[1]);
+    if (I2C_wait_transaction(&trans[0]) == ERR_DEVICE &&
+        I2C_wait_transaction(&trans[1]) == SYS_OK && complete_count == 2) {
+        printf("Test 3 passed: queued transactions completed\n");
+    } else {
+        printf("Test 3 failed\n");
+    }
+    /* Read again from a task, now the scheduler is running */
+    spin_conf.task_priority = DEFAULT_PRIORITY - 1;
+    if (task_create(test_task, NULL, NULL) == NULL ||
+        task_create(spin_task, NULL, &spin_conf) == NULL) {
+        LOG_E(TAG, "Failed to create rtos tasks");
+        exit(ERR_FAIL);
+    }
+    rtos_start();
+    return SYS_OK;
+}
@@ -0,0 +1,617 @@
+/**
+ * @file periph_mock.c
+ * Register level peripheral mock, for host builds of the drivers.
+ *
+ * The models run from a periodic timer signal, which preempts the caller
+ * the way an interrupt preempts thread code on the target. While the
+ * caller has interrupts masked, the tick is held pending and runs from
+ * unmask_irq. Each tick runs the models for up to MOCK_TICK_FRAMES steps,
+ * stopping early once a step runs no handler. A step is one frame time on
+ * the USART lines: it updates derived register state, and runs at most one
+ * handler per interrupting peripheral. Ticks never drain a full UART ring
+ * buffer, so the caller gets to refill it as it would at the line rate.
+ *
+ * A USART line may be paced to a baud rate, in which case a step only moves
+ * a frame once enough line time has built up across ticks. Unpaced lines
+ * move a frame every step.
+ *
+ * Register writes can't be trapped on the host, so USART data registers
+ * are observed around each handler call: TDR is loaded with a value no
+ * 9 bit frame can hold before the handler runs, and any other value after
+ * it returns is a transmitted frame. A handler entered with RXNE set has
+ * read RDR, so RXNE is cleared once it returns.
+ *
+ * A model update lost to a driver's read, modify, write sequence (such as
+ * a ready flag) is restored by the next tick.
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <drivers/device/device.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+
+#include <util/bitmask.h>
+
+#include "periph_mock.h"
+
+/** Number of interrupt vectors modelled */
+#define MOCK_NUM_IRQS 128
+/** TDR value that no frame can hold */
+#define MOCK_TDR_IDLE 0xFFFF
+/** Size of USART receive and capture buffers */
+#define MOCK_UART_BUFSIZE 65536
+/** Number of USARTs modelled */
+#define MOCK_NUM_UARTS 4
+/** Model tick period, in microseconds */
+#define MOCK_TICK_US 50
+/** Most model steps (USART frames) run in one tick */
+#define MOCK_TICK_FRAMES 16
+/** Line time of one 8N1 frame, in baud microseconds */
+#define MOCK_FRAME_COST (10 * 1000000ULL)
+
+/**
+ * Byte queue used for USART receive and capture
+ */
+typedef struct {
+    uint8_t data[MOCK_UART_BUFSIZE]; /*!< Queue storage */
+    uint32_t head;                   /*!< Index of next byte to take */
+    uint32_t tail;                   /*!< Index of next byte to add */
+} mock_queue_t;
+
+/**
+ * USART line model
+ */
+typedef struct mock_uart {
+    USART_TypeDef *regs; /*!< USART register block */
+    IRQn_Type irq;       /*!< USART interrupt */
+    struct mock_uart *peer; /*!< Receiver of transmitted frames, or NULL */
+    uint32_t baud;          /*!< Line rate, or 0 to move a frame each step */
+    uint64_t credit;     /*!< Line time built up, in baud microseconds */
+    uint64_t tx_count;   /*!< Bytes transmitted */
+    mock_queue_t rx;     /*!< Bytes waiting to be received */
+    mock_queue_t tx;     /*!< Captured transmitted bytes */
+} mock_uart_t;
+
+mock_periph_t MOCK_PERIPH;
+
+static volatile sig_atomic_t mask_depth = 0;
+static volatile sig_atomic_t tick_pending = 0;
+static volatile uint64_t tick_count = 0;
+static uint64_t run_ticks = 0;
+static volatile uint64_t irq_count = 0;
+static volatile uint64_t irq_ns = 0;
+static uint64_t timing_overhead_ns = 0;
+static void (*irq_handlers[MOCK_NUM_IRQS])(void);
+static mock_uart_t mock_uarts[MOCK_NUM_UARTS];
+
+static void mock_tick(int sig);
+static void mock_model_run(void);
+static uint64_t mock_now_ns(void);
+static void mock_rcc_step(void);
+static void mock_gpio_step(void);
+static void mock_uart_step(mock_uart_t *uart);
+static void mock_uart_irq(mock_uart_t *uart);
+static void mock_run_handler(IRQn_Type irq);
+static mock_uart_t *mock_uart_lookup(USART_TypeDef *usart);
+static bool mock_queue_put(mock_queue_t *queue, uint8_t byte);
+static bool mock_queue_get(mock_queue_t *queue, uint8_t *byte);
+
+/**
+ * Resets all register blocks to their reset values, and starts the model
+ * tick. Must be called before any driver is used.
+ */
+void mock_init(void) {
+    struct sigaction action;
+    struct itimerval timer = {{0, MOCK_TICK_US}, {0, MOCK_TICK_US}};
+    uint64_t start;
+    USART_TypeDef *usarts[MOCK_NUM_UARTS] = {USART1, USART2, USART3,
+                                             LPUART1};
+    IRQn_Type irqs[MOCK_NUM_UARTS] = {USART1_IRQn, USART2_IRQn, USART3_IRQn,
+                                      LPUART1_IRQn};
+    int i;
+    memset(&MOCK_PERIPH, 0, sizeof(MOCK_PERIPH));
+    memset(irq_handlers, 0, sizeof(irq_handlers));
+    irq_count = irq_ns = 0;
+    tick_count = run_ticks = 0;
+    // Handler times exclude the cost of reading the clock
+    start = mock_now_ns();
+    for (i = 0; i < 1000; i++) {
+        mock_now_ns();
+    }
+    timing_overhead_ns = (mock_now_ns() - start) / 1000;
+    mask_depth = tick_pending = 0;
+    // Reset values the drivers depend on
+    RCC->CR = RCC_CR_MSION | RCC_CR_MSIRDY | RCC_CR_MSIRANGE_6;
+    PWR->CR1 = PWR_CR1_VOS_0;
+    for (i = 0; i < MOCK_NUM_UARTS; i++) {
+        memset(&mock_uarts[i], 0, sizeof(mock_uart_t));
+        mock_uarts[i].regs = usarts[i];
+        mock_uarts[i].irq = irqs[i];
+        usarts[i]->TDR = MOCK_TDR_IDLE;
+    }
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = mock_tick;
+    // Interrupted system calls resume, as thread code would on the target
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGALRM, &action, NULL) != 0 ||
+        setitimer(ITIMER_REAL, &timer, NULL) != 0) {
+        abort();
+    }
+}
+
+/**
+ * Stops the model tick
+ */
+void mock_stop(void) {
+    struct itimerval timer = {{0, 0}, {0, 0}};
+    setitimer(ITIMER_REAL, &timer, NULL);
+    signal(SIGALRM, SIG_DFL);
+}
+
+/**
+ * Delays the caller. Replaces the cycle counted delay loop on the host.
+ * @param delay: length to delay in ms
+ */
+void mock_delay_ms(uint32_t delay) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += delay / 1000;
+    ts.tv_nsec += (delay % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    /**
+     * The model tick interrupts the sleep, so sleep until a deadline. The
+     * remaining time nanosleep reports can fail to shrink when it is
+     * interrupted this often, so resuming from it may never finish.
+     */
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR) {
+    }
+}
+
+/**
+ * Connects a USART transmitter to its own receiver
+ * @param usart: USART register block
+ * @param enable: should transmitted data be looped back
+ */
+void mock_uart_loopback(USART_TypeDef *usart, bool enable) {
+    mock_uart_t *uart = mock_uart_lookup(usart);
+    uart->peer = enable ? uart : NULL;
+}
+
+/**
+ * Connects two USARTs, so each one's transmitter drives the other's receiver
+ * @param a: first USART register block
+ * @param b: second USART register block
+ */
+void mock_uart_connect(USART_TypeDef *a, USART_TypeDef *b) {
+    mock_uart_t *uart_a = mock_uart_lookup(a), *uart_b = mock_uart_lookup(b);
+    uart_a->peer = uart_b;
+    uart_b->peer = uart_a;
+}
+
+/**
+ * Paces a USART line to a baud rate, with 10 bit (8N1) frames. The rate is
+ * set separately from the BRR register the driver programs.
+ * @param usart: USART register block
+ * @param baud: line rate, or 0 to move a frame every model step
+ */
+void mock_uart_set_baud(USART_TypeDef *usart, uint32_t baud) {
+    mock_uart_t *uart = mock_uart_lookup(usart);
+    mask_irq();
+    uart->baud = baud;
+    uart->credit = 0;
+    unmask_irq();
+}
+
+/**
+ * Queues data to arrive on a USART receiver
+ * @param usart: USART register block
+ * @param data: data to receive
+ * @param len: length of data
+ * @return number of bytes queued
+ */
+uint32_t mock_uart_inject(USART_TypeDef *usart, const uint8_t *data,
+                          uint32_t len) {
+    mock_uart_t *uart = mock_uart_lookup(usart);
+    uint32_t i;
+    mask_irq();
+    for (i = 0; i < len && mock_queue_put(&uart->rx, data[i]); i++) {
+    }
+    unmask_irq();
+    return i;
+}
+
+/**
+ * Takes data transmitted by a USART. Captured data is kept until taken, up
+ * to the capture buffer size, after which it is counted but dropped.
+ * @param usart: USART register block
+ * @param buf: buffer to copy transmitted data into
+ * @param len: length of buffer
+ * @return number of bytes copied
+ */
+uint32_t mock_uart_take_tx(USART_TypeDef *usart, uint8_t *buf, uint32_t len) {
+    mock_uart_t *uart = mock_uart_lookup(usart);
+    uint32_t i;
+    mask_irq();
+    for (i = 0; i < len && mock_queue_get(&uart->tx, &buf[i]); i++) {
+    }
+    unmask_irq();
+    return i;
+}
+
+/**
+ * Gets the number of bytes a USART has transmitted since mock_init
+ * @param usart: USART register block
+ * @return number of bytes transmitted
+ */
+uint64_t mock_uart_tx_count(USART_TypeDef *usart) {
+    return mock_uart_lookup(usart)->tx_count;
+}
+
+/**
+ * Gets the number of interrupt handler calls since mock_init
+ * @return number of handler calls
+ */
+uint64_t mock_irq_count(void) { return irq_count; }
+
+/**
+ * Gets the model time since mock_init. Model time advances by one tick
+ * period per tick signal, so it runs slow if the host misses ticks.
+ * @return model time in microseconds
+ */
+uint64_t mock_time_us(void) { return tick_count * MOCK_TICK_US; }
+
+/**
+ * Drives a GPIO input pin. Edges on a pin routed to EXTI raise the EXTI
+ * interrupt before this call returns.
+ * @param port: GPIO register block
+ * @param pin: pin number, 0-15
+ * @param level: level to drive
+ */
+void mock_gpio_set_input(GPIO_TypeDef *port, uint32_t pin, bool level) {
+    GPIO_TypeDef *ports[] = {GPIOA, GPIOB, GPIOC, GPIOD,
+                             GPIOE, NULL,  NULL,  GPIOH};
+    uint32_t mask = 1UL << pin, exti_port, old;
+    bool edge;
+    IRQn_Type irq;
+    mask_irq();
+    old = port->IDR;
+    port->IDR = level ? (old | mask) : (old & ~mask);
+    // Check if the EXTI line for this pin is routed to this port
+    exti_port = (SYSCFG->EXTICR[pin / 4] >> ((pin % 4) * 4)) & 0xF;
+    edge = level ? ((EXTI->RTSR1 & mask) && !(old & mask))
+                 : ((EXTI->FTSR1 & mask) && (old & mask));
+    if (edge && ports[exti_port] == port && (EXTI->IMR1 & mask)) {
+        EXTI->PR1 |= mask;
+        if (pin < 5) {
+            irq = EXTI0_IRQn + pin;
+        } else if (pin < 10) {
+            irq = EXTI9_5_IRQn;
+        } else {
+            irq = EXTI15_10_IRQn;
+        }
+        mock_run_handler(irq);
+        // The handler acknowledges the lines it was entered for
+        EXTI->PR1 &= ~mask;
+    }
+    unmask_irq();
+}
+
+/**
+ * Gets the time spent in interrupt handlers since mock_init
+ * @return handler time in nanoseconds
+ */
+uint64_t mock_irq_ns(void) { return irq_ns; }
+
+/**
+ * Masks interrupts. On the host, this holds off the model tick. Calls nest.
+ */
+void mask_irq() { mask_depth++; }
+
+/**
+ * Unmasks interrupts. A model tick that arrived while interrupts were
+ * masked runs now.
+ */
+void unmask_irq() {
+    if (--mask_depth == 0 && tick_pending) {
+        tick_pending = 0;
+        mock_model_run();
+    }
+}
+
+/**
+ * Disables an interrupt, and removes its handler
+ * @param num: Interrupt number to disable
+ */
+void disable_irq(uint32_t num) {
+    mask_irq();
+    irq_handlers[num] = NULL;
+    unmask_irq();
+}
+
+/**
+ * Enables an interrupt, and installs its handler
+ * @param num: Interrupt number to enable
+ * @param handler: Handler function, called from the model tick
+ */
+void enable_irq(uint32_t num, void (*handler)(void)) {
+    mask_irq();
+    irq_handlers[num] = handler;
+    unmask_irq();
+}
+
+/**
+ * The RTOS never runs on the host. Drivers poll rather than pend.
+ */
+bool rtos_started() { return false; }
+
+semaphore_t semaphore_create_binary() { return NULL; }
+
+syserr_t semaphore_pend(semaphore_t sem, int delay) { abort(); }
+
+void semaphore_post(semaphore_t sem) { abort(); }
+
+syserr_t semaphore_destroy(semaphore_t sem) { abort(); }
+
+/**
+ * Model tick signal handler. Runs the models, unless interrupts are masked.
+ * @param sig: unused
+ */
+static void mock_tick(int sig) {
+    tick_count++;
+    if (mask_depth > 0) {
+        tick_pending = 1;
+    } else {
+        mock_model_run();
+    }
+}
+
+/**
+ * Steps the peripheral models for one tick. Interrupts are masked
+ * while the models run, so handlers do not nest.
+ */
+static void mock_model_run(void) {
+    uint64_t count, ticks = tick_count - run_ticks;
+    int i, step;
+    mask_depth++;
+    run_ticks += ticks;
+    // Paced lines build up line time for every tick since the last run
+    for (i = 0; i < MOCK_NUM_UARTS; i++) {
+        mock_uarts[i].credit += (uint64_t)mock_uarts[i].baud * MOCK_TICK_US *
+                                ticks;
+        if (mock_uarts[i].credit > MOCK_FRAME_COST * MOCK_TICK_FRAMES) {
+            mock_uarts[i].credit = MOCK_FRAME_COST * MOCK_TICK_FRAMES;
+        }
+    }
+    for (step = 0; step < MOCK_TICK_FRAMES; step++) {
+        count = irq_count;
+        mock_rcc_step();
+        mock_gpio_step();
+        for (i = 0; i < MOCK_NUM_UARTS; i++) {
+            mock_uart_step(&mock_uarts[i]);
+        }
+        if (count == irq_count) {
+            break;
+        }
+    }
+    mask_depth--;
+}
+
+/**
+ * Oscillators are ready as soon as they are enabled, and the system clock
+ * switch takes effect immediately
+ */
+static void mock_rcc_step(void) {
+    uint32_t cr = RCC->CR, ready = 0;
+    if (cr & RCC_CR_MSION) {
+        ready |= RCC_CR_MSIRDY;
+    }
+    if (cr & RCC_CR_HSION) {
+        ready |= RCC_CR_HSIRDY;
+    }
+    if (cr & RCC_CR_HSEON) {
+        ready |= RCC_CR_HSERDY;
+    }
+    if (cr & RCC_CR_PLLON) {
+        ready |= RCC_CR_PLLRDY;
+    }
+    MODIFY_REG(RCC->CR,
+               RCC_CR_MSIRDY | RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY,
+               ready);
+    MODIFY_REG(RCC->CSR, RCC_CSR_LSIRDY,
+               (RCC->CSR & RCC_CSR_LSION) ? RCC_CSR_LSIRDY : 0);
+    MODIFY_REG(RCC->BDCR, RCC_BDCR_LSERDY,
+               (RCC->BDCR & RCC_BDCR_LSEON) ? RCC_BDCR_LSERDY : 0);
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_SWS,
+               (RCC->CFGR & RCC_CFGR_SW) << RCC_CFGR_SWS_Pos);
+}
+
+/**
+ * Output pins read back the level they drive
+ */
+static void mock_gpio_step(void) {
+    GPIO_TypeDef *ports[] = {GPIOA, GPIOB, GPIOC, GPIOD, GPIOE, GPIOH};
+    uint32_t moder, outputs, pin, i;
+    for (i = 0; i < sizeof(ports) / sizeof(ports[0]); i++) {
+        moder = ports[i]->MODER;
+        outputs = 0;
+        for (pin = 0; pin < 16; pin++) {
+            if (((moder >> (pin * 2)) & 0x3) == 0x1) {
+                outputs |= 1UL << pin;
+            }
+        }
+        ports[i]->IDR = (ports[i]->IDR & ~outputs) | (ports[i]->ODR & outputs);
+    }
+}
+
+/**
+ * Moves one frame in each direction, and runs the USART handler if an
+ * enabled flag is set. Each step is one frame time on the line.
+ * @param uart: USART model to step
+ */
+static void mock_uart_step(mock_uart_t *uart) {
+    USART_TypeDef *regs = uart->regs;
+    uint32_t cr1 = regs->CR1, isr = regs->ISR;
+    uint8_t byte;
+    if (!(cr1 & USART_CR1_UE)) {
+        return;
+    }
+    if (uart->baud != 0) {
+        // A paced line waits until a frame time has passed
+        if (uart->credit < MOCK_FRAME_COST) {
+            return;
+        }
+        uart->credit -= MOCK_FRAME_COST;
+    }
+    /* Request registers act immediately */
+    if (regs->RQR & USART_RQR_RXFRQ) {
+        isr &= ~USART_ISR_RXNE;
+        regs->RQR = 0;
+    }
+    if (regs->ICR & USART_ICR_TCCF) {
+        isr &= ~USART_ISR_TC;
+        regs->ICR = 0;
+    }
+    /* Receiver */
+    if ((cr1 & USART_CR1_RE) && !(isr & USART_ISR_RXNE) &&
+        mock_queue_get(&uart->rx, &byte)) {
+        regs->RDR = byte;
+        isr |= USART_ISR_RXNE;
+    }
+    /* Transmitter. The data register is always free */
+    if (cr1 & USART_CR1_TE) {
+        isr |= USART_ISR_TXE;
+    } else {
+        isr &= ~(USART_ISR_TXE | USART_ISR_TC);
+    }
+    regs->ISR = isr;
+    mock_uart_irq(uart);
+    if (!(cr1 & USART_CR1_TE) && (regs->CR1 & USART_CR1_TE)) {
+        /**
+         * The handler enabled the transmitter, so TXE is raised now rather
+         * than a frame later. Echo relies on this to keep up with receive.
+         */
+        regs->ISR |= USART_ISR_TXE;
+        mock_uart_irq(uart);
+    }
+}
+
+/**
+ * Runs the USART handler if an enabled flag is set, and observes the data
+ * registers around the call
+ * @param uart: USART model to run the handler for
+ */
+static void mock_uart_irq(mock_uart_t *uart) {
+    USART_TypeDef *regs = uart->regs;
+    uint32_t cr1 = regs->CR1, isr = regs->ISR;
+    uint8_t byte;
+    if (!(((cr1 & USART_CR1_RXNEIE) && (isr & USART_ISR_RXNE)) ||
+          ((cr1 & USART_CR1_TXEIE) && (isr & USART_ISR_TXE)) ||
+          ((cr1 & USART_CR1_TCIE) && (isr & USART_ISR_TC)))) {
+        return;
+    }
+    regs->TDR = MOCK_TDR_IDLE;
+    mock_run_handler(uart->irq);
+    if (isr & USART_ISR_RXNE) {
+        // Handler read RDR
+        regs->ISR &= ~USART_ISR_RXNE;
+    }
+    if (regs->TDR != MOCK_TDR_IDLE) {
+        // Handler wrote a frame. The line is busy until the next step
+        byte = regs->TDR;
+        uart->tx_count++;
+        mock_queue_put(&uart->tx, byte);
+        if (uart->peer != NULL) {
+            mock_queue_put(&uart->peer->rx, byte);
+        }
+        regs->ISR &= ~USART_ISR_TC;
+    } else if (cr1 & regs->CR1 & USART_CR1_TE) {
+        // Nothing was sent for a frame, so the line is idle
+        regs->ISR |= USART_ISR_TC;
+    }
+    regs->TDR = MOCK_TDR_IDLE;
+}
+
+/**
+ * Runs an interrupt handler, with the active vector set as the hardware
+ * would. Interrupts must be masked.
+ * @param irq: interrupt to run
+ */
+static void mock_run_handler(IRQn_Type irq) {
+    uint64_t start;
+    if (irq_handlers[irq] == NULL) {
+        return;
+    }
+    irq_count++;
+    SCB->ICSR = (SCB->ICSR & ~SCB_ICSR_VECTACTIVE_Msk) | (irq + 16);
+    start = mock_now_ns();
+    irq_handlers[irq]();
+    irq_ns += mock_now_ns() - start - timing_overhead_ns;
+    SCB->ICSR &= ~SCB_ICSR_VECTACTIVE_Msk;
+}
+
+/**
+ * Gets monotonic time, for handler time accounting
+ * @return time in nanoseconds
+ */
+static uint64_t mock_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Finds the model for a USART
+ * @param usart: USART register block
+ * @return USART model
+ */
+static mock_uart_t *mock_uart_lookup(USART_TypeDef *usart) {
+    int i;
+    for (i = 0; i < MOCK_NUM_UARTS; i++) {
+        if (mock_uarts[i].regs == usart) {
+            return &mock_uarts[i];
+        }
+    }
+    abort();
+}
+
+/**
+ * Adds a byte to a queue
+ * @param queue: queue to add to
+ * @param byte: byte to add
+ * @return false if the queue is full
+ */
+static bool mock_queue_put(mock_queue_t *queue, uint8_t byte) {
+    uint32_t next = (queue->tail + 1) % MOCK_UART_BUFSIZE;
+    if (next == queue->head) {
+        return false;
+    }
+    queue->data[queue->tail] = byte;
+    queue->tail = next;
+    return true;
+}
+
+/**
+ * Takes a byte from a queue
+ * @param queue: queue to take from
+ * @param byte: set to the byte taken
+ * @return false if the queue is empty
+ */
+static bool mock_queue_get(mock_queue_t *queue, uint8_t *byte) {
+    if (queue->head == queue->tail) {
+        return false;
+    }
+    *byte = queue->data[queue->head];
+    queue->head = (queue->head + 1) % MOCK_UART_BUFSIZE;
+    return true;
+}
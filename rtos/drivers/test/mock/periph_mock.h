@@ -0,0 +1,178 @@
+/**
+ * @file periph_mock.h
+ * Register level peripheral mock, for host builds of the drivers.
+ *
+ * Building with -DPERIPH_MOCK makes device.h include this header after the
+ * device register definitions. The peripheral instance macros (USART1,
+ * GPIOA, RCC, EXTI, ...) are redefined to point at register blocks in host
+ * memory, so drivers build and run unmodified on the host.
+ *
+ * A periodic timer signal stands in for the hardware and the NVIC. It keeps
+ * derived register state up to date (RCC ready flags, switch status, GPIO
+ * output readback, USART status flags), and calls enabled interrupt
+ * handlers when their peripheral raises a flag. mask_irq holds off the
+ * signal's models, just as it holds off interrupts on the target. Data
+ * written to a USART is captured, and data can be injected into its
+ * receiver. A USART can be looped back or connected to another, and its
+ * line paced to a baud rate. Host builds are single threaded.
+ */
+
+#ifndef PERIPH_MOCK_H
+#define PERIPH_MOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Simulated register blocks
+ */
+typedef struct {
+    USART_TypeDef usart1;
+    USART_TypeDef usart2;
+    USART_TypeDef usart3;
+    USART_TypeDef lpuart1;
+    GPIO_TypeDef gpioa;
+    GPIO_TypeDef gpiob;
+    GPIO_TypeDef gpioc;
+    GPIO_TypeDef gpiod;
+    GPIO_TypeDef gpioe;
+    GPIO_TypeDef gpioh;
+    RCC_TypeDef rcc;
+    EXTI_TypeDef exti;
+    SYSCFG_TypeDef syscfg;
+    FLASH_TypeDef flash;
+    PWR_TypeDef pwr;
+    SCB_Type scb;
+} mock_periph_t;
+
+extern mock_periph_t MOCK_PERIPH;
+
+#undef USART1
+#undef USART2
+#undef USART3
+#undef LPUART1
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef GPIOD
+#undef GPIOE
+#undef GPIOH
+#undef RCC
+#undef EXTI
+#undef SYSCFG
+#undef FLASH
+#undef PWR
+#undef SCB
+
+#define USART1 (&MOCK_PERIPH.usart1)
+#define USART2 (&MOCK_PERIPH.usart2)
+#define USART3 (&MOCK_PERIPH.usart3)
+#define LPUART1 (&MOCK_PERIPH.lpuart1)
+#define GPIOA (&MOCK_PERIPH.gpioa)
+#define GPIOB (&MOCK_PERIPH.gpiob)
+#define GPIOC (&MOCK_PERIPH.gpioc)
+#define GPIOD (&MOCK_PERIPH.gpiod)
+#define GPIOE (&MOCK_PERIPH.gpioe)
+#define GPIOH (&MOCK_PERIPH.gpioh)
+#define RCC (&MOCK_PERIPH.rcc)
+#define EXTI (&MOCK_PERIPH.exti)
+#define SYSCFG (&MOCK_PERIPH.syscfg)
+#define FLASH (&MOCK_PERIPH.flash)
+#define PWR (&MOCK_PERIPH.pwr)
+#define SCB (&MOCK_PERIPH.scb)
+
+/**
+ * Resets all register blocks to their reset values, and starts the model
+ * tick. Must be called before any driver is used.
+ */
+void mock_init(void);
+
+/**
+ * Stops the model tick
+ */
+void mock_stop(void);
+
+/**
+ * Delays the caller. Replaces the cycle counted delay loop on the host.
+ * @param delay: length to delay in ms
+ */
+void mock_delay_ms(uint32_t delay);
+
+/**
+ * Connects a USART transmitter to its own receiver
+ * @param usart: USART register block
+ * @param enable: should transmitted data be looped back
+ */
+void mock_uart_loopback(USART_TypeDef *usart, bool enable);
+
+/**
+ * Connects two USARTs, so each one's transmitter drives the other's receiver
+ * @param a: first USART register block
+ * @param b: second USART register block
+ */
+void mock_uart_connect(USART_TypeDef *a, USART_TypeDef *b);
+
+/**
+ * Paces a USART line to a baud rate, with 10 bit (8N1) frames. The rate is
+ * set separately from the BRR register the driver programs.
+ * @param usart: USART register block
+ * @param baud: line rate, or 0 to move a frame every model step
+ */
+void mock_uart_set_baud(USART_TypeDef *usart, uint32_t baud);
+
+/**
+ * Queues data to arrive on a USART receiver
+ * @param usart: USART register block
+ * @param data: data to receive
+ * @param len: length of data
+ * @return number of bytes queued
+ */
+uint32_t mock_uart_inject(USART_TypeDef *usart, const uint8_t *data,
+                          uint32_t len);
+
+/**
+ * Takes data transmitted by a USART. Captured data is kept until taken, up
+ * to the capture buffer size, after which it is counted but dropped.
+ * @param usart: USART register block
+ * @param buf: buffer to copy transmitted data into
+ * @param len: length of buffer
+ * @return number of bytes copied
+ */
+uint32_t mock_uart_take_tx(USART_TypeDef *usart, uint8_t *buf, uint32_t len);
+
+/**
+ * Gets the number of bytes a USART has transmitted since mock_init
+ * @param usart: USART register block
+ * @return number of bytes transmitted
+ */
+uint64_t mock_uart_tx_count(USART_TypeDef *usart);
+
+/**
+ * Gets the number of interrupt handler calls since mock_init
+ * @return number of handler calls
+ */
+uint64_t mock_irq_count(void);
+
+/**
+ * Gets the model time since mock_init. Model time advances by one tick
+ * period per tick signal, so it runs slow if the host misses ticks.
+ * @return model time in microseconds
+ */
+uint64_t mock_time_us(void);
+
+/**
+ * Gets the time spent in interrupt handlers since mock_init
+ * @return handler time in nanoseconds
+ */
+uint64_t mock_irq_ns(void);
+
+/**
+ * Drives a GPIO input pin. Edges on a pin routed to EXTI raise the EXTI
+ * interrupt before this call returns.
+ * @param port: GPIO register block
+ * @param pin: pin number, 0-15
+ * @param level: level to drive
+ */
+void mock_gpio_set_input(GPIO_TypeDef *port, uint32_t pin, bool level);
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * @file spi_test.c
+ * Tests SPI DMA transfers and transaction queueing.
+ *
+ * Connect PA7 (SPI1 MOSI) to PA6 (SPI1 MISO) with a jumper wire before
+ * running this test, so that every byte sent is received back.
+ *
+ * Tests 1 to 3 run before the scheduler starts, so transactions are polled.
+ * Test 4 transfers from a task, using the device added in main, and checks
+ * that the task slept on the transfer while a lower priority task ran.
+ *
+ * Expected output:
+ * Test 1 passed: loopback transfer matched
+ * Test 2 passed: queued transactions completed in order
+ * Test 3 passed: fill bytes received
+ * Test 4 passed: task slept during transfer
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <drivers/gpio/gpio.h>
+#include <drivers/spi/spi.h>
+#include <sys/task/task.h>
+#include <util/logging/logging.h>
+
+#define BUF_LEN 64
+#define NUM_QUEUED 3
+
+static const char *TAG = "spi_test";
+static uint8_t tx_buf[BUF_LEN];
+static uint8_t rx_bufs[NUM_QUEUED][BUF_LEN];
+static SPI_transaction_t transactions[NUM_QUEUED];
+static volatile int complete_order[NUM_QUEUED];
+static volatile int complete_count = 0;
+static volatile uint32_t spin_count = 0;
+static SPI_device_handle_t dev;
+
+/**
+ * Initializes system clock and SPI pins
+ */
+static void system_init() {
+    syserr_t err;
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    GPIO_config_t gpio_config = GPIO_DEFAULT_CONFIG;
+    GPIO_pin_t pins[] = {GPIO_PA5, GPIO_PA6, GPIO_PA7};
+    int i;
+    clock_init(&clk_cfg);
+    // PA5, PA6 and PA7 are SPI1 SCK, MISO and MOSI on alternate function 5
+    gpio_config.mode = GPIO_mode_afunc;
+    gpio_config.output_speed = GPIO_speed_vhigh;
+    gpio_config.alternate_func = GPIO_af5;
+    for (i = 0; i < 3; i++) {
+        err = GPIO_config(pins[i], &gpio_config);
+        if (err != SYS_OK) {
+            LOG_E(TAG, "Could not init SPI GPIO");
+            exit(err);
+        }
+    }
+}
+
+/**
+ * Transaction completion callback. Records completion order
+ * @param trans: completed transaction
+ */
+static void transaction_callback(SPI_transaction_t *trans) {
+    if (complete_count < NUM_QUEUED) {
+        complete_order[complete_count] = trans - transactions;
+    }
+    complete_count++;
+}
+
+/**
+ * Low priority task entry point. Counts while the test task sleeps.
+ * @param arg: unused
+ */
+static void spin_task(void *arg) {
+    while (1) {
+        spin_count++;
+        task_yield();
+    }
+}
+
+/**
+ * Test task entry point. Runs a loopback transfer, which must put the task
+ * to sleep on the device's completion semaphore rather than polling.
+ * @param arg: unused
+ */
+static void test_task(void *arg) {
+    syserr_t err;
+    uint32_t spins;
+    memset(rx_bufs[0], 0, BUF_LEN);
+    spins = spin_count;
+    err = SPI_transfer(dev, tx_buf, rx_bufs[0], BUF_LEN);
+    spins = spin_count - spins;
+    if (err == SYS_OK && memcmp(tx_buf, rx_bufs[0], BUF_LEN) == 0 &&
+        spins != 0) {
+        printf("Test 4 passed: task slept during transfer\n");
+    } else {
+        printf("Test 4 failed: error %d, %lu spins\n", err, spins);
+    }
+    while (1) {
+        task_delay(1000);
+    }
+}
+
+int main() {
+    syserr_t err;
+    SPI_handle_t spi;
+    SPI_config_t spi_cfg = SPI_DEFAULT_CONFIG;
+    SPI_device_config_t dev_cfg = SPI_DEVICE_DEFAULT_CONFIG;
+    task_config_t spin_conf = DEFAULT_TASK_CONFIG;
+    bool passed;
+    int i;
+    system_init();
+    for (i = 0; i < BUF_LEN; i++) {
+        tx_buf[i] = i;
+    }
+    spi = SPI_open(SPI_1, &spi_cfg, &err);
+    if (spi == NULL) {
+        LOG_E(TAG, "Could not open SPI bus");
+        exit(err);
+    }
+    dev_cfg.SPI_frequency = 10000000;
+    dev_cfg.SPI_wait_timeout = 100;
+    dev = SPI_add_device(spi, &dev_cfg, &err);
+    if (dev == NULL) {
+        LOG_E(TAG, "Could not add SPI device");
+        exit(err);
+    }
+    /* Single blocking transfer */
+    err = SPI_transfer(dev, tx_buf, rx_bufs[0], BUF_LEN);
+    if (err == SYS_OK && memcmp(tx_buf, rx_bufs[0], BUF_LEN) == 0) {
+        printf("Test 1 passed: loopback transfer matched\n");
+    } else {
+        printf("Test 1 failed\n");
+    }
+    /* Queue several transactions, then wait for the last one */
+    memset(rx_bufs, 0, sizeof(rx_bufs));
+    for (i = 0; i < NUM_QUEUED; i++) {
+        transactions[i].SPI_device = dev;
+        transactions[i].SPI_tx = tx_buf + i;
+        transactions[i].SPI_rx = rx_bufs[i];
+        transactions[i].SPI_len = BUF_LEN - i;
+        transactions[i].SPI_callback = transaction_callback;
+        err = SPI_queue_transaction(&transactions[i]);
+        if (err != SYS_OK) {
+            LOG_E(TAG, "Could not queue transaction %d", i);
+            exit(err);
+        }
+    }
+    err = SPI_wait_transaction(&transactions[NUM_QUEUED - 1]);
+    passed = (err == SYS_OK && complete_count == NUM_QUEUED);
+    for (i = 0; i < NUM_QUEUED && passed; i++) {
+        passed = complete_order[i] == i &&
+                 memcmp(tx_buf + i, rx_bufs[i], BUF_LEN - i) == 0;
+    }
+    if (passed) {
+        printf("Test 2 passed: queued transactions completed in order\n");
+    } else {
+        printf("Test 2 failed\n");
+    }
+    /* Transfer with no transmit buffer should clock out fill bytes */
+    err = SPI_transfer(dev, NULL, rx_bufs[0], BUF_LEN);
+    passed = (err == SYS_OK);
+    for (i = 0; i < BUF_LEN && passed; i++) {
+        passed = rx_bufs[0][i] == spi_cfg.SPI_fill_byte;
+    }
+    if (passed) {
+        printf("Test 3 passed: fill bytes received\n");
+    } else {
+        printf("Test 3 failed\n");
+    }
+    /* Transfer again from a task, now the scheduler is running */
+    spin_conf.task_priority = DEFAULT_PRIORITY - 1;
+    if (task_create(test_task, NULL, NULL) == NULL ||
+        task_create(spin_task, NULL, &spin_conf) == NULL) {
+        LOG_E(TAG, "Failed to create rtos tasks");
+        exit(ERR_FAIL);
+    }
+    rtos_start();
+    return SYS_OK;
+}
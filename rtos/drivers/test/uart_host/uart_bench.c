@@ -0,0 +1,127 @@
+/**
+ * @file uart_bench.c
+ * Benchmarks the UART driver against the peripheral mock. Reports
+ * interrupts and handler time per byte for raw and text mode writes and
+ * for reads, along with the cost of the ring buffer operations the driver
+ * is built on. Throughput is bounded by the model tick rather than the
+ * driver, so handler time is the figure to compare between driver changes.
+ * Built and run on the host, see Makefile.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <drivers/device/device.h>
+#include <drivers/uart/uart.h>
+#include <util/ringbuf/ringbuf.h>
+
+#define TX_BYTES 200000
+#define RX_BYTES 200000
+#define RX_CHUNK 64
+#define LINE_LEN 32
+#define RINGBUF_OPS 10000000
+#define RINGBUF_LEN 80
+
+static uint8_t data[TX_BYTES];
+
+/**
+ * Gets monotonic time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Reports interrupt statistics for a test
+ * @param name: name of the test
+ * @param bytes: bytes moved on the line
+ * @param irqs: interrupts taken
+ * @param ns: time spent in handlers
+ * @param elapsed: test duration in seconds
+ */
+static void report(const char *name, uint64_t bytes, uint64_t irqs,
+                   uint64_t ns, double elapsed) {
+    printf("%-18s %9.0f bytes/s, %4.2f irq/byte, %6.1f ns/byte in handler\n",
+           name, bytes / elapsed, (double)irqs / bytes, (double)ns / bytes);
+}
+
+/**
+ * Writes the data buffer to a UART, and reports interrupt statistics
+ * @param name: name of the test
+ * @param uart: UART handle to write to
+ */
+static void bench_write(const char *name, UART_handle_t uart) {
+    uint64_t sent = mock_uart_tx_count(USART2);
+    uint64_t irqs = mock_irq_count(), ns = mock_irq_ns();
+    double start = now();
+    syserr_t err;
+    UART_write(uart, data, TX_BYTES, &err);
+    report(name, mock_uart_tx_count(USART2) - sent, mock_irq_count() - irqs,
+           mock_irq_ns() - ns, now() - start);
+}
+
+int main() {
+    UART_config_t cfg = UART_DEFAULT_CONFIG;
+    UART_handle_t uart;
+    RingBuf_t ring;
+    uint8_t store[RINGBUF_LEN], chunk[RX_CHUNK];
+    uint64_t irqs, ns;
+    uint32_t i, received;
+    double start, elapsed;
+    char c;
+    volatile uint32_t sink = 0;
+    syserr_t err;
+    mock_init();
+    for (i = 0; i < TX_BYTES; i++) {
+        data[i] = (i % LINE_LEN == LINE_LEN - 1) ? '\n' : 'a' + i % 26;
+    }
+    /* Transmit, raw then with LF replaced by CRLF */
+    uart = UART_open(USART_2, &cfg, &err);
+    bench_write("raw write:", uart);
+    UART_close(uart);
+    cfg.UART_textmode = UART_txtmode_en;
+    uart = UART_open(USART_2, &cfg, &err);
+    bench_write("text mode write:", uart);
+    UART_close(uart);
+    // Discard captured data
+    while (mock_uart_take_tx(USART2, data, TX_BYTES) != 0) {
+    }
+    /* Receive, one ring buffer's worth at a time */
+    cfg.UART_textmode = UART_txtmode_dis;
+    uart = UART_open(USART_2, &cfg, &err);
+    irqs = mock_irq_count();
+    ns = mock_irq_ns();
+    start = now();
+    for (received = 0; received < RX_BYTES; received += RX_CHUNK) {
+        mock_uart_inject(USART2, data, RX_CHUNK);
+        UART_read(uart, chunk, RX_CHUNK, &err);
+    }
+    report("read:", RX_BYTES, mock_irq_count() - irqs, mock_irq_ns() - ns,
+           now() - start);
+    UART_close(uart);
+    mock_stop();
+    /* Ring buffer operations, as used by the ISR and the block copies */
+    buf_init(&ring, store, RINGBUF_LEN);
+    start = now();
+    for (i = 0; i < RINGBUF_OPS; i++) {
+        buf_write(&ring, i);
+        buf_read(&ring, &c);
+        sink += c;
+    }
+    elapsed = now() - start;
+    printf("%-18s %9.2f ns/op\n", "ringbuf byte:", elapsed * 1e9 /
+           (RINGBUF_OPS * 2));
+    start = now();
+    for (i = 0; i < RINGBUF_OPS / RX_CHUNK; i++) {
+        buf_writeblock(&ring, data, RX_CHUNK);
+        sink += buf_readblock(&ring, chunk, RX_CHUNK);
+    }
+    elapsed = now() - start;
+    printf("%-18s %9.2f ns/byte\n", "ringbuf block:",
+           elapsed * 1e9 / (RINGBUF_OPS / RX_CHUNK * RX_CHUNK * 2));
+    return sink == 0;
+}
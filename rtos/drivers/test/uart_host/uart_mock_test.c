@@ -0,0 +1,153 @@
+/**
+ * @file uart_mock_test.c
+ * Tests the UART, GPIO and clock drivers against the peripheral mock.
+ * Built and run on the host, see Makefile.
+ *
+ * Expected output:
+ * Test 1 passed: clocks configured
+ * Test 2 passed: raw write transmitted unchanged
+ * Test 3 passed: text mode write sent CRLF line endings
+ * Test 4 passed: text mode read replaced CR, and echoed input
+ * Test 5 passed: loopback write read back
+ * Test 6 passed: GPIO output read back
+ * Test 7 passed: GPIO interrupt ran on rising edge only
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/clock/clock.h>
+#include <drivers/device/device.h>
+#include <drivers/gpio/gpio.h>
+#include <drivers/uart/uart.h>
+
+#define LOOPBACK_LEN 1000
+#define LOOPBACK_CHUNK 40
+
+static volatile int gpio_callbacks = 0;
+
+/**
+ * GPIO interrupt callback
+ */
+static void gpio_callback(void) { gpio_callbacks++; }
+
+/**
+ * Takes transmitted data from a USART, and checks it against what was
+ * expected
+ * @param usart: USART register block
+ * @param expected: expected data, NULL terminated
+ * @return true if the data matched
+ */
+static bool check_tx(USART_TypeDef *usart, const char *expected) {
+    char buf[64];
+    uint32_t len = mock_uart_take_tx(usart, (uint8_t *)buf, sizeof(buf));
+    return len == strlen(expected) && memcmp(buf, expected, len) == 0;
+}
+
+int main() {
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    UART_config_t uart_cfg = UART_DEFAULT_CONFIG;
+    GPIO_config_t gpio_cfg = GPIO_DEFAULT_CONFIG;
+    UART_handle_t uart;
+    uint8_t out[LOOPBACK_LEN], in[LOOPBACK_LEN];
+    char line[16];
+    int failures = 0, i, len;
+    syserr_t err;
+    mock_init();
+    /* Clock init waits on oscillator ready and clock switch flags */
+    err = clock_init(&clk_cfg);
+    if (err == SYS_OK && sysclock_freq() == 80000000) {
+        printf("Test 1 passed: clocks configured\n");
+    } else {
+        printf("Test 1 failed: error %d\n", err);
+        failures++;
+    }
+    /* Raw write */
+    uart = UART_open(USART_2, &uart_cfg, &err);
+    if (uart == NULL) {
+        printf("Could not open USART2\n");
+        return EXIT_FAILURE;
+    }
+    UART_write(uart, (uint8_t *)"raw\n", 4, &err);
+    if (err == SYS_OK && check_tx(USART2, "raw\n")) {
+        printf("Test 2 passed: raw write transmitted unchanged\n");
+    } else {
+        printf("Test 2 failed\n");
+        failures++;
+    }
+    UART_close(uart);
+    /* Text mode write, then read with echo */
+    uart_cfg.UART_textmode = UART_txtmode_en;
+    uart_cfg.UART_echomode = UART_echo_en;
+    uart = UART_open(USART_2, &uart_cfg, &err);
+    len = UART_write(uart, (uint8_t *)"a\nb\n", 4, &err);
+    if (len == 4 && check_tx(USART2, "a\r\nb\r\n")) {
+        printf("Test 3 passed: text mode write sent CRLF line endings\n");
+    } else {
+        printf("Test 3 failed\n");
+        failures++;
+    }
+    mock_uart_inject(USART2, (uint8_t *)"hi\r", 3);
+    len = UART_read(uart, (uint8_t *)line, 3, &err);
+    // Wait for echo to finish
+    while (mock_uart_tx_count(USART2) < 14) {
+    }
+    if (len == 3 && memcmp(line, "hi\n", 3) == 0 &&
+        check_tx(USART2, "hi\r\n")) {
+        printf("Test 4 passed: text mode read replaced CR, and echoed "
+               "input\n");
+    } else {
+        printf("Test 4 failed\n");
+        failures++;
+    }
+    UART_close(uart);
+    /* Loopback. Data must survive both ring buffers in order */
+    uart_cfg.UART_textmode = UART_txtmode_dis;
+    uart_cfg.UART_echomode = UART_echo_dis;
+    uart = UART_open(USART_1, &uart_cfg, &err);
+    mock_uart_loopback(USART1, true);
+    for (i = 0; i < LOOPBACK_LEN; i++) {
+        out[i] = rand();
+    }
+    // Read back each chunk before the receive ring buffer can overflow
+    for (i = 0, len = 0; i < LOOPBACK_LEN; i += LOOPBACK_CHUNK) {
+        UART_write(uart, out + i, LOOPBACK_CHUNK, &err);
+        len += UART_read(uart, in + i, LOOPBACK_CHUNK, &err);
+    }
+    if (len == LOOPBACK_LEN && memcmp(in, out, LOOPBACK_LEN) == 0) {
+        printf("Test 5 passed: loopback write read back\n");
+    } else {
+        printf("Test 5 failed\n");
+        failures++;
+    }
+    UART_close(uart);
+    /* GPIO output readback */
+    GPIO_config(GPIO_PA5, &gpio_cfg);
+    GPIO_write(GPIO_PA5, GPIO_HIGH);
+    while (GPIO_read(GPIO_PA5) != GPIO_HIGH) {
+        // Wait for the model to update IDR
+    }
+    GPIO_write(GPIO_PA5, GPIO_LOW);
+    while (GPIO_read(GPIO_PA5) != GPIO_LOW) {
+    }
+    printf("Test 6 passed: GPIO output read back\n");
+    /* GPIO interrupt */
+    gpio_cfg.mode = GPIO_mode_input;
+    GPIO_config(GPIO_PB3, &gpio_cfg);
+    err = GPIO_interrupt_enable(GPIO_PB3, GPIO_trig_rising, gpio_callback);
+    mock_gpio_set_input(GPIOB, 3, true);
+    mock_gpio_set_input(GPIOB, 3, false);
+    // Same line on another port must not interrupt
+    mock_gpio_set_input(GPIOC, 3, true);
+    if (err == SYS_OK && gpio_callbacks == 1 &&
+        GPIO_read(GPIO_PB3) == GPIO_LOW && EXTI->PR1 == 0) {
+        printf("Test 7 passed: GPIO interrupt ran on rising edge only\n");
+    } else {
+        printf("Test 7 failed: %d callbacks\n", gpio_callbacks);
+        failures++;
+    }
+    mock_stop();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,814 @@
+/**
+ * @file timer.c
+ * Implements general purpose and low power timer support for STM32L4xxxx.
+ * Supports PWM output, input capture, and one shot pulse generation
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <config.h>
+#include <drivers/clock/clock.h>
+#include <drivers/device/device.h>
+#include <drivers/dma/dma.h>
+#include <sys/err.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+#include <util/bitmask.h>
+#include <util/logging/logging.h>
+#include <util/ringbuf/ringbuf.h>
+
+#include "timer.h"
+
+/**
+ * Timer device state
+ */
+typedef enum {
+    TIMER_dev_closed = 0,
+    TIMER_dev_open = 1,
+} TIMER_state_t;
+
+/**
+ * Configuration structure for timer devices
+ */
+typedef struct {
+    TIMER_config_t cfg;        /*!< User configuration for timer */
+    TIM_TypeDef *regs;         /*!< Register access (general purpose timers) */
+    LPTIM_TypeDef *lp_regs;    /*!< Register access (low power timers) */
+    TIMER_state_t state;       /*!< Timer state (open or closed) */
+    TIMER_periph_t periph_id;  /*!< Identifies the peripheral handle uses */
+    uint32_t max_count;        /*!< Largest value the counter can hold */
+    uint32_t num_channels;     /*!< Number of capture/compare channels */
+    uint32_t duty;             /*!< Last compare value set for output */
+    uint32_t last_capture;     /*!< Counter value at the previous capture */
+    bool capture_valid;        /*!< Is last_capture valid */
+    RingBuf_t capture_buf;     /*!< Capture results (incoming data) */
+    semaphore_t capture_sem;   /*!< Posted to when capture results exist */
+    DMA_handle_t dma;          /*!< DMA channel used for duty updates */
+} TIMER_status_t;
+
+/** Capture ring buffer size, in bytes. Each result uses 4 bytes */
+#define TIMER_RINGBUF_SIZE 64
+#define TIMER_CAPTURE_SIZE sizeof(uint32_t)
+
+/** Maximum LPTIM prescaler shift (divide by 128) */
+#define LPTIM_MAX_PRESC 7
+
+static TIMER_status_t TIMERS[NUM_TIMERS] = {0};
+static uint8_t TIMER_CBUFFS[NUM_TIMERS][TIMER_RINGBUF_SIZE];
+
+static void TIMER_interrupt(void);
+static void TIMER_capture(TIMER_status_t *handle, uint32_t value);
+static syserr_t TIMER_enable_periph(TIMER_status_t *handle,
+                                    TIMER_periph_t periph);
+static syserr_t TIMER_set_timebase(TIMER_status_t *handle);
+static syserr_t TIMER_config_channel(TIMER_status_t *handle);
+static syserr_t LPTIMER_config(TIMER_status_t *handle);
+static syserr_t TIMER_dma_channel(TIMER_status_t *handle, DMA_channel_t *chan,
+                                  uint32_t *request);
+static uint64_t TIMER_clock_freq(TIMER_status_t *handle);
+
+/**
+ * Opens a timer device. The timer is configured but not started.
+ * GPIO pins used by the timer channel must be configured by the caller.
+ * @param periph: Identifier of timer to open
+ * @param config: Timer configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or a timer handle to the open peripheral
+ */
+TIMER_handle_t TIMER_open(TIMER_periph_t periph, TIMER_config_t *config,
+                          syserr_t *err) {
+    TIMER_status_t *handle;
+    *err = SYS_OK; // Set no error until one occurs
+    /**
+     * Check parameters.
+     */
+    if (periph > LPTIMER_1 || config == NULL) {
+        *err = ERR_BADPARAM;
+        return NULL;
+    }
+    handle = &TIMERS[periph];
+    if (handle->state == TIMER_dev_open) {
+        *err = ERR_INUSE;
+        return NULL;
+    }
+    // Set handle state to open
+    handle->state = TIMER_dev_open;
+    /**
+     * Record the peripheral before any failure can close the handle, so
+     * TIMER_close never resets a timer this handle does not own
+     */
+    handle->periph_id = periph;
+    handle->regs = NULL;
+    handle->lp_regs = NULL;
+    handle->capture_valid = false;
+    handle->capture_sem = NULL;
+    handle->dma = NULL;
+    handle->duty = 0;
+    memcpy(&handle->cfg, config, sizeof(TIMER_config_t));
+    // Setup capture buffer
+    buf_init(&handle->capture_buf, TIMER_CBUFFS[periph], TIMER_RINGBUF_SIZE);
+    /**
+     * Create the capture semaphore even before the scheduler starts, since
+     * the capture interrupt posts to it once the scheduler is running
+     */
+    if (config->TIMER_mode == TIMER_mode_capture) {
+        handle->capture_sem = semaphore_create_binary();
+        if (handle->capture_sem == NULL) {
+            *err = ERR_NOMEM;
+            TIMER_close(handle);
+            return NULL;
+        }
+    }
+    /**
+     * Record the timer peripheral address into the config structure, and
+     * enable the clock for the timer as well as its interrupt
+     */
+    *err = TIMER_enable_periph(handle, periph);
+    if (*err != SYS_OK) {
+        TIMER_close(handle);
+        return NULL;
+    }
+    if (handle->lp_regs) {
+        // Low power timers use a separate register layout
+        *err = LPTIMER_config(handle);
+    } else {
+        /* Configure the counter prescaler and period */
+        *err = TIMER_set_timebase(handle);
+        if (*err != SYS_OK) {
+            TIMER_close(handle);
+            return NULL;
+        }
+        /* Configure the capture/compare channel */
+        *err = TIMER_config_channel(handle);
+    }
+    if (*err != SYS_OK) {
+        TIMER_close(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+/**
+ * Starts a timer. In one shot mode, each call starts a new single period.
+ * @param handle: Timer handle to start
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t TIMER_start(TIMER_handle_t handle) {
+    TIMER_status_t *timer = (TIMER_status_t *)handle;
+    if (timer == NULL || timer->state != TIMER_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (timer->lp_regs) {
+        if (timer->cfg.TIMER_mode == TIMER_mode_oneshot) {
+            SETBITS(timer->lp_regs->CR, LPTIM_CR_SNGSTRT);
+        } else {
+            SETBITS(timer->lp_regs->CR, LPTIM_CR_CNTSTRT);
+        }
+    } else {
+        // Restart counter from zero, then enable it
+        timer->regs->CNT = 0;
+        timer->capture_valid = false;
+        SETBITS(timer->regs->CR1, TIM_CR1_CEN);
+    }
+    return SYS_OK;
+}
+
+/**
+ * Stops a timer. The counter is halted but the configuration is retained.
+ * @param handle: Timer handle to stop
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t TIMER_stop(TIMER_handle_t handle) {
+    TIMER_status_t *timer = (TIMER_status_t *)handle;
+    if (timer == NULL || timer->state != TIMER_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (timer->lp_regs) {
+        /**
+         * Disabling the LPTIM resets its counter. Compare and autoreload
+         * values must be rewritten after the timer is reenabled.
+         */
+        CLEARBITS(timer->lp_regs->CR, LPTIM_CR_ENABLE);
+        return LPTIMER_config(timer);
+    } else {
+        CLEARBITS(timer->regs->CR1, TIM_CR1_CEN);
+    }
+    return SYS_OK;
+}
+
+/**
+ * Sets the compare value for PWM or one shot output.
+ * In PWM mode, the output is active for the first 'duty' ticks of a period.
+ * In one shot mode, the output becomes active after 'duty' ticks and stays
+ * active until the period ends.
+ * @param handle: Timer handle
+ * @param duty: compare value, in ticks. Must not exceed the period
+ * @return SYS_OK on success, or ERR_BADPARAM on invalid duty or mode
+ */
+syserr_t TIMER_set_duty(TIMER_handle_t handle, uint32_t duty) {
+    TIMER_status_t *timer = (TIMER_status_t *)handle;
+    if (timer == NULL || timer->state != TIMER_dev_open ||
+        timer->cfg.TIMER_mode == TIMER_mode_capture ||
+        duty > timer->cfg.TIMER_period) {
+        return ERR_BADPARAM;
+    }
+    timer->duty = duty;
+    if (timer->lp_regs) {
+        /**
+         * LPTIM compare register cannot exceed autoreload register, so
+         * clamp a full duty cycle to the autoreload value.
+         */
+        if (duty > timer->lp_regs->ARR) {
+            duty = timer->lp_regs->ARR;
+        }
+        timer->lp_regs->CMP = duty;
+        // Wait for the compare write to propagate before another write
+        while (READBITS(timer->lp_regs->ISR, LPTIM_ISR_CMPOK) == 0) {
+            // Spin
+        }
+        SETBITS(timer->lp_regs->ICR, LPTIM_ICR_CMPOKCF);
+    } else {
+        // CCR registers are laid out sequentially
+        (&timer->regs->CCR1)[timer->cfg.TIMER_channel] = duty;
+    }
+    return SYS_OK;
+}
+
+/**
+ * Starts DMA driven duty cycle updates for a PWM timer. On each period, the
+ * next entry of 'duty' is loaded as the compare value. The buffer is used
+ * circularly until TIMER_pwm_dma_stop is called, so it must remain valid.
+ * @param handle: Timer handle (must be in PWM mode)
+ * @param duty: buffer of compare values, in ticks
+ * @param count: number of entries in duty buffer (max 65535)
+ * @return SYS_OK on success, ERR_NOSUPPORT if timer has no DMA support, or
+ * ERR_BADPARAM on invalid parameters
+ */
+syserr_t TIMER_pwm_dma_start(TIMER_handle_t handle, uint32_t *duty,
+                             uint32_t count) {
+    TIMER_status_t *timer = (TIMER_status_t *)handle;
+    DMA_config_t dma_cfg = DMA_DEFAULT_CONFIG;
+    DMA_channel_t chan;
+    syserr_t ret;
+    if (timer == NULL || duty == NULL || count == 0 || count > 0xFFFF ||
+        timer->state != TIMER_dev_open ||
+        timer->cfg.TIMER_mode != TIMER_mode_pwm) {
+        return ERR_BADPARAM;
+    }
+    // Restart any sweep already running with the new buffer
+    TIMER_pwm_dma_stop(timer);
+    ret = TIMER_dma_channel(timer, &chan, &dma_cfg.DMA_request);
+    if (ret != SYS_OK) {
+        return ret;
+    }
+    /**
+     * Memory to peripheral, 32 bit transfers, incrementing memory address,
+     * in circular mode so the duty buffer repeats with no CPU involvement
+     */
+    dma_cfg.DMA_direction = DMA_mem_to_periph;
+    dma_cfg.DMA_periph_width = DMA_width_32;
+    dma_cfg.DMA_mem_width = DMA_width_32;
+    dma_cfg.DMA_mode = DMA_mode_circular;
+    dma_cfg.DMA_priority = DMA_priority_high;
+    timer->dma = DMA_open(chan, &dma_cfg, &ret);
+    if (timer->dma == NULL) {
+        return ret;
+    }
+    ret = DMA_start(timer->dma,
+                    &((&timer->regs->CCR1)[timer->cfg.TIMER_channel]), duty,
+                    count);
+    if (ret != SYS_OK) {
+        DMA_close(timer->dma);
+        timer->dma = NULL;
+        return ret;
+    }
+    // Request a DMA transfer on every update event
+    SETBITS(timer->regs->DIER, TIM_DIER_UDE);
+    return SYS_OK;
+}
+
+/**
+ * Stops DMA driven duty cycle updates. The last compare value loaded remains
+ * active.
+ * @param handle: Timer handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t TIMER_pwm_dma_stop(TIMER_handle_t handle) {
+    TIMER_status_t *timer = (TIMER_status_t *)handle;
+    if (timer == NULL || timer->state != TIMER_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (timer->dma == NULL) {
+        return SYS_OK;
+    }
+    CLEARBITS(timer->regs->DIER, TIM_DIER_UDE);
+    DMA_close(timer->dma);
+    timer->dma = NULL;
+    return SYS_OK;
+}
+
+/**
+ * Sets the timer's trigger output (TRGO) to pulse on each update event, so
+ * other peripherals (such as the ADC) can be paced by the timer period.
+ * @param handle: Timer handle
+ * @return SYS_OK on success, ERR_NOSUPPORT for low power timers, or error
+ * value otherwise
+ */
+syserr_t TIMER_enable_trigger(TIMER_handle_t handle) {
+    TIMER_status_t *timer = (TIMER_status_t *)handle;
+    if (timer == NULL || timer->state != TIMER_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (timer->regs == NULL) {
+        // LPTIM has no trigger output
+        return ERR_NOSUPPORT;
+    }
+    // Master mode "update": TRGO pulses on each counter update event
+    MODIFY_REG(timer->regs->CR2, TIM_CR2_MMS, 0x2UL << TIM_CR2_MMS_Pos);
+    return SYS_OK;
+}
+
+/**
+ * Reads input capture results from a timer in capture mode. Each result is
+ * the number of counter ticks between two consecutive capture edges.
+ * Blocks until at least one result is available, or the read timeout expires
+ * @param handle: Timer handle
+ * @param buf: buffer to read capture results into
+ * @param len: number of entries in buf
+ * @param err: Set on error
+ * @return number of capture results read, or -1 on error
+ */
+int TIMER_read_capture(TIMER_handle_t handle, uint32_t *buf, uint32_t len,
+                       syserr_t *err) {
+    int timeout;
+    uint32_t num_read;
+    TIMER_status_t *timer = (TIMER_status_t *)handle;
+    // Verify inputs
+    if (timer == NULL || buf == NULL || timer->state != TIMER_dev_open ||
+        timer->cfg.TIMER_mode != TIMER_mode_capture) {
+        *err = ERR_BADPARAM;
+        return -1;
+    }
+    *err = SYS_OK;
+    timeout = timer->cfg.TIMER_read_timeout;
+    if (rtos_started()) {
+        // Pend on the capture semaphore with no timeout to ensure it is 0
+        semaphore_pend(timer->capture_sem, 0);
+    }
+    // Wait for a capture result to be available
+    while (buf_getsize(&(timer->capture_buf)) == 0 &&
+           timeout != TIMER_TIMEOUT_NONE) {
+        if (rtos_started()) {
+            if (timeout == TIMER_TIMEOUT_INF) {
+                semaphore_pend(timer->capture_sem, SYS_TIMEOUT_INF);
+            } else if (semaphore_pend(timer->capture_sem, timeout) != SYS_OK) {
+                // No capture occurred before timeout.
+                timeout = TIMER_TIMEOUT_NONE;
+            }
+        } else if (timeout != TIMER_TIMEOUT_INF) {
+            blocking_delay_ms(1);
+            timeout--;
+        }
+    }
+    /**
+     * Disable interrupts while reading, so the ISR cannot write a partial
+     * result into the ring buffer
+     */
+    mask_irq();
+    num_read = buf_readblock(&(timer->capture_buf), (uint8_t *)buf,
+                             len * TIMER_CAPTURE_SIZE) /
+               TIMER_CAPTURE_SIZE;
+    unmask_irq();
+    if (num_read == 0 && timer->cfg.TIMER_read_timeout != TIMER_TIMEOUT_NONE) {
+        *err = ERR_TIMEOUT;
+    }
+    return num_read;
+}
+
+/**
+ * Closes a timer device
+ * @param handle: Handle to open timer device
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t TIMER_close(TIMER_handle_t handle) {
+    syserr_t err;
+    TIMER_status_t *timer = (TIMER_status_t *)handle;
+    if (timer == NULL || timer->state != TIMER_dev_open) {
+        return ERR_BADPARAM;
+    }
+    if (timer->regs) {
+        TIMER_pwm_dma_stop(timer);
+    }
+    if (timer->capture_sem) {
+        err = semaphore_destroy(timer->capture_sem);
+        if (err != SYS_OK) {
+            return err;
+        }
+        timer->capture_sem = NULL;
+    }
+    switch (timer->periph_id) {
+    case TIMER_2:
+        // Reset peripheral by toggling reset bit
+        SETBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_TIM2RST);
+        CLEARBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_TIM2RST);
+        CLEARBITS(RCC->APB1ENR1, RCC_APB1ENR1_TIM2EN); // Disable peripheral
+        disable_irq(TIM2_IRQn);
+        break;
+    case TIMER_15:
+        SETBITS(RCC->APB2RSTR, RCC_APB2RSTR_TIM15RST);
+        CLEARBITS(RCC->APB2RSTR, RCC_APB2RSTR_TIM15RST);
+        CLEARBITS(RCC->APB2ENR, RCC_APB2ENR_TIM15EN);
+        disable_irq(TIM1_BRK_TIM15_IRQn);
+        break;
+    case TIMER_16:
+        SETBITS(RCC->APB2RSTR, RCC_APB2RSTR_TIM16RST);
+        CLEARBITS(RCC->APB2RSTR, RCC_APB2RSTR_TIM16RST);
+        CLEARBITS(RCC->APB2ENR, RCC_APB2ENR_TIM16EN);
+        disable_irq(TIM1_UP_TIM16_IRQn);
+        break;
+    case LPTIMER_1:
+        SETBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_LPTIM1RST);
+        CLEARBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_LPTIM1RST);
+        CLEARBITS(RCC->APB1ENR1, RCC_APB1ENR1_LPTIM1EN);
+        disable_irq(LPTIM1_IRQn);
+        break;
+    default:
+        return ERR_BADPARAM;
+        break;
+    }
+    timer->regs = NULL;
+    timer->lp_regs = NULL;
+    // Close timer device
+    timer->state = TIMER_dev_closed;
+    return SYS_OK;
+}
+
+/**
+ * Handles timer interrupts
+ */
+static void TIMER_interrupt(void) {
+    TIMER_status_t *handle;
+    uint32_t status, channel;
+    /**
+     * Use the exception number to determine which timer caused the interrupt
+     */
+    switch (READBITS(SCB->ICSR, SCB_ICSR_VECTACTIVE_Msk) - 16) {
+    case TIM2_IRQn:
+        handle = &TIMERS[TIMER_2];
+        break;
+    case TIM1_BRK_TIM15_IRQn:
+        handle = &TIMERS[TIMER_15];
+        break;
+    case TIM1_UP_TIM16_IRQn:
+        handle = &TIMERS[TIMER_16];
+        break;
+    case LPTIM1_IRQn:
+        handle = &TIMERS[LPTIMER_1];
+        break;
+    default:
+        /**
+         * Spin here. We want to stop processor as we
+         * should not be handling this exception.
+         */
+        while (1) {
+            // Spin
+        }
+        break;
+    }
+    if (handle->lp_regs) {
+        // Only the autoreload match interrupt is enabled for LPTIM
+        if (READBITS(handle->lp_regs->ISR, LPTIM_ISR_ARRM)) {
+            SETBITS(handle->lp_regs->ICR, LPTIM_ICR_ARRMCF);
+            if (handle->cfg.TIMER_callback) {
+                handle->cfg.TIMER_callback();
+            }
+        }
+        return;
+    }
+    status = handle->regs->SR;
+    channel = handle->cfg.TIMER_channel;
+    if (READBITS(status, TIM_SR_CC1IF << channel) &&
+        handle->cfg.TIMER_mode == TIMER_mode_capture) {
+        // Reading the capture register clears the capture flag
+        TIMER_capture(handle, (&handle->regs->CCR1)[channel]);
+        // Overcaptures are dropped. Clear the overcapture flag
+        CLEARBITS(handle->regs->SR, TIM_SR_CC1OF << channel);
+    }
+    if (READBITS(status, TIM_SR_UIF)) {
+        // Write zero to clear the update flag
+        CLEARBITS(handle->regs->SR, TIM_SR_UIF);
+        if (handle->cfg.TIMER_callback) {
+            handle->cfg.TIMER_callback();
+        }
+    }
+}
+
+/**
+ * Records a capture result into a timer's capture buffer. Called from
+ * interrupt context.
+ * @param handle: Timer that captured a value
+ * @param value: counter value latched by the capture
+ */
+static void TIMER_capture(TIMER_status_t *handle, uint32_t value) {
+    uint32_t delta;
+    if (handle->capture_valid) {
+        // Counter wraps at max_count, so mask the difference
+        delta = (value - handle->last_capture) & handle->max_count;
+        if (buf_getspace(&(handle->capture_buf)) < TIMER_CAPTURE_SIZE) {
+            LOG_MIN(SYSLOG_LEVEL_DEBUG, __FILE__, "Dropping timer capture");
+        } else {
+            buf_writeblock(&(handle->capture_buf), (uint8_t *)&delta,
+                           TIMER_CAPTURE_SIZE);
+            if (rtos_started()) {
+                semaphore_post(handle->capture_sem);
+            }
+        }
+    }
+    handle->last_capture = value;
+    handle->capture_valid = true;
+}
+
+/**
+ * Selects a timer peripheral and enables it.
+ * Also records the register value for the selected timer into the
+ * "regs" or "lp_regs" field of handle
+ * @param handle: Timer handle to open peripheral with
+ * @param periph: Timer peripheral ID to enable
+ */
+static syserr_t TIMER_enable_periph(TIMER_status_t *handle,
+                                    TIMER_periph_t periph) {
+    handle->regs = NULL;
+    handle->lp_regs = NULL;
+    switch (periph) {
+    case TIMER_2:
+        SETBITS(RCC->APB1ENR1, RCC_APB1ENR1_TIM2EN); // Enable peripheral
+        // Reset peripheral by toggling reset bit
+        SETBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_TIM2RST);
+        CLEARBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_TIM2RST);
+        enable_irq(TIM2_IRQn, TIMER_interrupt);
+        handle->regs = TIM2;
+        handle->max_count = 0xFFFFFFFFUL;
+        handle->num_channels = 4;
+        break;
+    case TIMER_15:
+        SETBITS(RCC->APB2ENR, RCC_APB2ENR_TIM15EN);
+        SETBITS(RCC->APB2RSTR, RCC_APB2RSTR_TIM15RST);
+        CLEARBITS(RCC->APB2RSTR, RCC_APB2RSTR_TIM15RST);
+        enable_irq(TIM1_BRK_TIM15_IRQn, TIMER_interrupt);
+        handle->regs = TIM15;
+        handle->max_count = 0xFFFFUL;
+        handle->num_channels = 2;
+        break;
+    case TIMER_16:
+        SETBITS(RCC->APB2ENR, RCC_APB2ENR_TIM16EN);
+        SETBITS(RCC->APB2RSTR, RCC_APB2RSTR_TIM16RST);
+        CLEARBITS(RCC->APB2RSTR, RCC_APB2RSTR_TIM16RST);
+        enable_irq(TIM1_UP_TIM16_IRQn, TIMER_interrupt);
+        handle->regs = TIM16;
+        handle->max_count = 0xFFFFUL;
+        handle->num_channels = 1;
+        break;
+    case LPTIMER_1:
+        SETBITS(RCC->APB1ENR1, RCC_APB1ENR1_LPTIM1EN);
+        SETBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_LPTIM1RST);
+        CLEARBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_LPTIM1RST);
+        enable_irq(LPTIM1_IRQn, TIMER_interrupt);
+        handle->lp_regs = LPTIM1;
+        handle->max_count = 0xFFFFUL;
+        handle->num_channels = 1;
+        break;
+    default:
+        return ERR_BADPARAM;
+        break;
+    }
+    return SYS_OK;
+}
+
+/**
+ * Configures the prescaler and period of a general purpose timer
+ * @param handle: Timer handle to configure
+ * @return SYS_OK on success, or ERR_BADPARAM if the tick frequency or period
+ * cannot be achieved
+ */
+static syserr_t TIMER_set_timebase(TIMER_status_t *handle) {
+    uint64_t clk_freq, prescaler;
+    if (handle->cfg.TIMER_frequency == 0) {
+        return ERR_BADPARAM;
+    }
+    clk_freq = TIMER_clock_freq(handle);
+    prescaler = clk_freq / handle->cfg.TIMER_frequency;
+    if (prescaler == 0 || prescaler > 0x10000) {
+        return ERR_BADPARAM;
+    }
+    handle->regs->PSC = prescaler - 1;
+    if (handle->cfg.TIMER_mode == TIMER_mode_capture) {
+        // Capture mode runs the counter freely across its full range
+        handle->regs->ARR = handle->max_count;
+    } else {
+        if (handle->cfg.TIMER_period == 0 ||
+            (handle->cfg.TIMER_period - 1) > handle->max_count) {
+            return ERR_BADPARAM;
+        }
+        handle->regs->ARR = handle->cfg.TIMER_period - 1;
+        // Buffer period updates until the next update event
+        SETBITS(handle->regs->CR1, TIM_CR1_ARPE);
+    }
+    if (handle->cfg.TIMER_mode == TIMER_mode_oneshot) {
+        // Counter stops at the next update event
+        SETBITS(handle->regs->CR1, TIM_CR1_OPM);
+    }
+    // Generate an update event to load the prescaler, then clear its flag
+    SETBITS(handle->regs->EGR, TIM_EGR_UG);
+    CLEARBITS(handle->regs->SR, TIM_SR_UIF);
+    if (handle->cfg.TIMER_callback || handle->cfg.TIMER_mode ==
+                                          TIMER_mode_oneshot) {
+        SETBITS(handle->regs->DIER, TIM_DIER_UIE);
+    }
+    return SYS_OK;
+}
+
+/**
+ * Configures the capture/compare channel of a general purpose timer
+ * @param handle: Timer handle to configure
+ * @return SYS_OK on success, or ERR_BADPARAM on invalid configuration
+ */
+static syserr_t TIMER_config_channel(TIMER_status_t *handle) {
+    __IO uint32_t *ccmr;
+    uint32_t channel, shift, ccer;
+    channel = handle->cfg.TIMER_channel;
+    if (channel >= handle->num_channels) {
+        return ERR_BADPARAM;
+    }
+    // Channels 1 and 2 use CCMR1, channels 3 and 4 use CCMR2
+    ccmr = channel < TIMER_channel_3 ? &handle->regs->CCMR1
+                                     : &handle->regs->CCMR2;
+    shift = (channel & 0x1) << 3;
+    ccer = 0;
+    switch (handle->cfg.TIMER_mode) {
+    case TIMER_mode_pwm:
+        // PWM mode 1: Output active while counter is below compare value
+        MODIFY_REG(*ccmr,
+                   (TIM_CCMR1_OC1M | TIM_CCMR1_OC1PE | TIM_CCMR1_CC1S) << shift,
+                   (TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1PE)
+                       << shift);
+        if (handle->cfg.TIMER_polarity == TIMER_polarity_low) {
+            ccer |= TIM_CCER_CC1P;
+        }
+        break;
+    case TIMER_mode_oneshot:
+        // PWM mode 2: Output active once counter reaches compare value
+        MODIFY_REG(*ccmr,
+                   (TIM_CCMR1_OC1M | TIM_CCMR1_OC1PE | TIM_CCMR1_CC1S) << shift,
+                   (TIM_CCMR1_OC1M_0 | TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1M_2)
+                       << shift);
+        if (handle->cfg.TIMER_polarity == TIMER_polarity_low) {
+            ccer |= TIM_CCER_CC1P;
+        }
+        break;
+    case TIMER_mode_capture:
+        // Map input capture to its own timer input, with no filter
+        MODIFY_REG(*ccmr,
+                   (TIM_CCMR1_CC1S | TIM_CCMR1_IC1F | TIM_CCMR1_IC1PSC)
+                       << shift,
+                   TIM_CCMR1_CC1S_0 << shift);
+        switch (handle->cfg.TIMER_capture_edge) {
+        case TIMER_edge_rising:
+            break;
+        case TIMER_edge_falling:
+            ccer |= TIM_CCER_CC1P;
+            break;
+        case TIMER_edge_both:
+            ccer |= TIM_CCER_CC1P | TIM_CCER_CC1NP;
+            break;
+        default:
+            return ERR_BADPARAM;
+            break;
+        }
+        // Enable capture interrupt for this channel
+        SETBITS(handle->regs->DIER, TIM_DIER_CC1IE << channel);
+        break;
+    default:
+        return ERR_BADPARAM;
+        break;
+    }
+    // Each channel uses 4 bits of CCER
+    MODIFY_REG(handle->regs->CCER,
+               (TIM_CCER_CC1E | TIM_CCER_CC1P | TIM_CCER_CC1NP)
+                   << (channel << 2),
+               (ccer | TIM_CCER_CC1E) << (channel << 2));
+    if (handle->periph_id != TIMER_2) {
+        // TIM15 and TIM16 gate all outputs with the main output enable bit
+        SETBITS(handle->regs->BDTR, TIM_BDTR_MOE);
+    }
+    return SYS_OK;
+}
+
+/**
+ * Configures a low power timer. Low power timers only support PWM and one
+ * shot output.
+ * @param handle: Timer handle to configure
+ * @return SYS_OK on success, ERR_NOSUPPORT for capture mode, or ERR_BADPARAM
+ * on invalid configuration
+ */
+static syserr_t LPTIMER_config(TIMER_status_t *handle) {
+    uint64_t clk_freq;
+    uint32_t presc;
+    if (handle->cfg.TIMER_mode == TIMER_mode_capture) {
+        return ERR_NOSUPPORT;
+    }
+    if (handle->cfg.TIMER_frequency == 0 || handle->cfg.TIMER_period < 2 ||
+        (handle->cfg.TIMER_period - 1) > handle->max_count ||
+        handle->cfg.TIMER_channel != TIMER_channel_1) {
+        return ERR_BADPARAM;
+    }
+    /**
+     * The LPTIM prescaler divides by powers of two. Select the smallest
+     * divider that does not exceed the requested tick frequency
+     */
+    clk_freq = TIMER_clock_freq(handle);
+    presc = 0;
+    while ((clk_freq >> presc) > handle->cfg.TIMER_frequency &&
+           presc < LPTIM_MAX_PRESC) {
+        presc++;
+    }
+    /**
+     * CFGR and IER can only be written while the timer is disabled.
+     * The output is set at a compare match and reset at autoreload, so
+     * invert the waveform in PWM mode to make it active from the period start
+     */
+    CLEARBITS(handle->lp_regs->CR, LPTIM_CR_ENABLE);
+    handle->lp_regs->CFGR = presc << LPTIM_CFGR_PRESC_Pos;
+    if ((handle->cfg.TIMER_mode == TIMER_mode_pwm) ==
+        (handle->cfg.TIMER_polarity == TIMER_polarity_high)) {
+        SETBITS(handle->lp_regs->CFGR, LPTIM_CFGR_WAVPOL);
+    }
+    if (handle->cfg.TIMER_callback ||
+        handle->cfg.TIMER_mode == TIMER_mode_oneshot) {
+        handle->lp_regs->IER = LPTIM_IER_ARRMIE;
+    }
+    // ARR and CMP can only be written while the timer is enabled
+    SETBITS(handle->lp_regs->CR, LPTIM_CR_ENABLE);
+    handle->lp_regs->ARR = handle->cfg.TIMER_period - 1;
+    while (READBITS(handle->lp_regs->ISR, LPTIM_ISR_ARROK) == 0) {
+        // Spin
+    }
+    SETBITS(handle->lp_regs->ICR, LPTIM_ICR_ARROKCF);
+    // Restore the last compare value set
+    return TIMER_set_duty(handle, handle->duty);
+}
+
+/**
+ * Gets the DMA channel and request mapping for a timer's update event
+ * @param handle: Timer handle
+ * @param chan: set to the DMA channel serving the update request
+ * @param request: set to the request number for the update event
+ * @return SYS_OK on success, or ERR_NOSUPPORT if timer has no update request
+ */
+static syserr_t TIMER_dma_channel(TIMER_status_t *handle, DMA_channel_t *chan,
+                                  uint32_t *request) {
+    // Mappings taken from the DMA1 request table of the reference manual
+    switch (handle->periph_id) {
+    case TIMER_2:
+        *chan = DMA1_CH2;
+        *request = 4;
+        break;
+    case TIMER_15:
+        *chan = DMA1_CH5;
+        *request = 7;
+        break;
+    case TIMER_16:
+        *chan = DMA1_CH6;
+        *request = 4;
+        break;
+    default:
+        return ERR_NOSUPPORT;
+        break;
+    }
+    return SYS_OK;
+}
+
+/**
+ * Gets the input clock frequency of a timer.
+ * APB timers run at twice the APB clock when the APB prescaler is not 1.
+ * @param handle: Timer handle
+ * @return timer input clock frequency, in Hz
+ */
+static uint64_t TIMER_clock_freq(TIMER_status_t *handle) {
+    uint64_t pclk;
+    switch (handle->periph_id) {
+    case TIMER_2:
+        pclk = pclk1_freq();
+        break;
+    case LPTIMER_1:
+        // LPTIM1 is clocked from PCLK1 directly (default clock selection)
+        return pclk1_freq();
+        break;
+    default:
+        // TIM15 and TIM16 are on APB2
+        pclk = pclk2_freq();
+        break;
+    }
+    return pclk == hclk_freq() ? pclk : pclk << 1;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file timer.h
+ * Implements general purpose and low power timer support for STM32L4xxxx.
+ * Supports PWM output, input capture, and one shot pulse generation
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+#include <sys/err.h>
+
+/**
+ * Timer peripheral list. See datasheet for channel pin connections.
+ */
+typedef enum {
+    TIMER_2 = 0,   /*!< 32 bit general purpose timer, 4 channels */
+    TIMER_15 = 1,  /*!< 16 bit general purpose timer, 2 channels */
+    TIMER_16 = 2,  /*!< 16 bit general purpose timer, 1 channel */
+    LPTIMER_1 = 3, /*!< 16 bit low power timer, 1 output (no capture) */
+} TIMER_periph_t;
+
+#define NUM_TIMERS 4
+
+/**
+ * Timer operating modes
+ */
+typedef enum {
+    TIMER_mode_pwm,     /*!< Continuous PWM output on the selected channel */
+    TIMER_mode_capture, /*!< Input capture on the selected channel */
+    TIMER_mode_oneshot, /*!< Timer runs for one period, then stops */
+} TIMER_mode_t;
+
+/**
+ * Timer channel selection. Channel availability depends on the timer.
+ */
+typedef enum {
+    TIMER_channel_1 = 0,
+    TIMER_channel_2 = 1,
+    TIMER_channel_3 = 2,
+    TIMER_channel_4 = 3,
+} TIMER_channel_t;
+
+/**
+ * Output polarity for PWM and one shot modes
+ */
+typedef enum {
+    TIMER_polarity_high, /*!< Output is high while active */
+    TIMER_polarity_low,  /*!< Output is low while active */
+} TIMER_polarity_t;
+
+/**
+ * Input capture trigger edge
+ */
+typedef enum {
+    TIMER_edge_rising,  /*!< Capture on rising edges */
+    TIMER_edge_falling, /*!< Capture on falling edges */
+    TIMER_edge_both,    /*!< Capture on both edges */
+} TIMER_edge_t;
+
+/* Timer capture read timeout (ms) */
+typedef int TIMER_timeout_t;
+#define TIMER_TIMEOUT_NONE 0 // No timeout
+#define TIMER_TIMEOUT_INF -1 // Infinite timeout
+
+/**
+ * Timer configuration structure
+ */
+typedef struct TIMER_config {
+    TIMER_mode_t TIMER_mode;         /*!< Timer operating mode */
+    TIMER_channel_t TIMER_channel;   /*!< Timer channel for output/capture */
+    uint32_t TIMER_frequency;        /*!< Counter tick frequency, in Hz */
+    uint32_t TIMER_period;           /*!< Counter period, in ticks */
+    TIMER_polarity_t TIMER_polarity; /*!< Output polarity (pwm/oneshot) */
+    TIMER_edge_t TIMER_capture_edge; /*!< Capture edge (capture mode) */
+    TIMER_timeout_t TIMER_read_timeout; /*!< Capture read timeout */
+    /*! Optional callback, run from interrupt context when a period elapses */
+    void (*TIMER_callback)(void);
+} TIMER_config_t;
+
+/**
+ * Default timer configuration:
+ * 1kHz PWM output on channel 1, with a 1MHz counter tick
+ */
+#define TIMER_DEFAULT_CONFIG                                                   \
+    {                                                                          \
+        .TIMER_mode = TIMER_mode_pwm, .TIMER_channel = TIMER_channel_1,        \
+        .TIMER_frequency = 1000000, .TIMER_period = 1000,                      \
+        .TIMER_polarity = TIMER_polarity_high,                                 \
+        .TIMER_capture_edge = TIMER_edge_rising,                               \
+        .TIMER_read_timeout = TIMER_TIMEOUT_INF, .TIMER_callback = NULL        \
+    }
+
+typedef void *TIMER_handle_t;
+
+/**
+ * Opens a timer device. The timer is configured but not started.
+ * GPIO pins used by the timer channel must be configured by the caller.
+ * @param periph: Identifier of timer to open
+ * @param config: Timer configuration structure
+ * @param err: Set on function error
+ * @return NULL on error, or a timer handle to the open peripheral
+ */
+TIMER_handle_t TIMER_open(TIMER_periph_t periph, TIMER_config_t *config,
+                          syserr_t *err);
+
+/**
+ * Starts a timer. In one shot mode, each call starts a new single period.
+ * @param handle: Timer handle to start
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t TIMER_start(TIMER_handle_t handle);
+
+/**
+ * Stops a timer. The counter is halted but the configuration is retained.
+ * @param handle: Timer handle to stop
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t TIMER_stop(TIMER_handle_t handle);
+
+/**
+ * Sets the compare value for PWM or one shot output.
+ * In PWM mode, the output is active for the first 'duty' ticks of a period.
+ * In one shot mode, the output becomes active after 'duty' ticks and stays
+ * active until the period ends.
+ * @param handle: Timer handle
+ * @param duty: compare value, in ticks. Must not exceed the period
+ * @return SYS_OK on success, or ERR_BADPARAM on invalid duty or mode
+ */
+syserr_t TIMER_set_duty(TIMER_handle_t handle, uint32_t duty);
+
+/**
+ * Starts DMA driven duty cycle updates for a PWM timer. On each period, the
+ * next entry of 'duty' is loaded as the compare value. The buffer is used
+ * circularly until TIMER_pwm_dma_stop is called, so it must remain valid.
+ * @param handle: Timer handle (must be in PWM mode)
+ * @param duty: buffer of compare values, in ticks
+ * @param count: number of entries in duty buffer (max 65535)
+ * @return SYS_OK on success, ERR_NOSUPPORT if timer has no DMA support, or
+ * ERR_BADPARAM on invalid parameters
+ */
+syserr_t TIMER_pwm_dma_start(TIMER_handle_t handle, uint32_t *duty,
+                             uint32_t count);
+
+/**
+ * Stops DMA driven duty cycle updates. The last compare value loaded remains
+ * active.
+ * @param handle: Timer handle
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t TIMER_pwm_dma_stop(TIMER_handle_t handle);
+
+/**
+ * Sets the timer's trigger output (TRGO) to pulse on each update event, so
+ * other peripherals (such as the ADC) can be paced by the timer period.
+ * @param handle: Timer handle
+ * @return SYS_OK on success, ERR_NOSUPPORT for low power timers, or error
+ * value otherwise
+ */
+syserr_t TIMER_enable_trigger(TIMER_handle_t handle);
+
+/**
+ * Reads input capture results from a timer in capture mode. Each result is
+ * the number of counter ticks between two consecutive capture edges.
+ * Blocks until at least one result is available, or the read timeout expires
+ * @param handle: Timer handle
+ * @param buf: buffer to read capture results into
+ * @param len: number of entries in buf
+ * @param err: Set on error
+ * @return number of capture results read, or -1 on error
+ */
+int TIMER_read_capture(TIMER_handle_t handle, uint32_t *buf, uint32_t len,
+                       syserr_t *err);
+
+/**
+ * Closes a timer device
+ * @param handle: Handle to open timer device
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t TIMER_close(TIMER_handle_t handle);
+
+#endif
@@ -15,6 +15,7 @@ typedef enum syserr {
     ERR_TIMEOUT,   /*!< Device or system timeout */
     ERR_NOTINIT,   /*!< Device not initialized */
     ERR_SCHEDULER, /*!< RTOS scheduler error */
+    ERR_NOTFOUND,  /*!< Requested item does not exist */
 } syserr_t;
 
 #endif
\ No newline at end of file
@@ -5,7 +5,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <config.h>
 #include <drivers/clock/clock.h>
+#include <sys/isr/isr.h>
+#include <sys/trace/trace.h>
 
 // Variables declared in linker script
 extern unsigned char _srcdata;
@@ -35,6 +38,13 @@ void system_init(void) {
     init_data_bss();
     // Now that data and BSS segments are populated, initialize clocks
     reset_clocks();
+#if SYS_USE_TRACE == TRACE_ENABLED
+    // Start the cycle counter before any kernel event can be recorded
+    trace_init();
+#endif
+#if SYS_USE_IRQ_STATS == IRQ_STATS_ENABLED
+    irq_stats_reset();
+#endif
     // Init libs
     __libc_init_array();
     // init is done. Call the main entry point.
@@ -8,8 +8,12 @@
 #include <stdlib.h>
 
 #include <drivers/device/device.h>
+#include <sys/profile/profile.h>
 #include <sys/task/task.h>
+#include <sys/trace/trace.h>
 #include <util/bitmask.h>
+#include <util/logging/logging.h>
+#include <util/perf/perf.h>
 
 #include "isr.h"
 
@@ -19,7 +23,14 @@ extern void system_init(void);
 extern unsigned char _stack_ptr;
 
 // Dynamic array of exception handlers
-static void (*exception_handlers[84])(void) = { 0 };
+static void (*exception_handlers[NUM_IRQS])(void) = { 0 };
+
+#if SYS_USE_IRQ_STATS == IRQ_STATS_ENABLED
+// Per interrupt statistics, and handler cycles at the last dump
+static irq_stats_t irq_stats[NUM_IRQS];
+static uint64_t irq_dumped_cycles[NUM_IRQS];
+static uint32_t irq_dump_stamp; // Cycle counter at the last dump
+#endif
 
 /**
  * System interrupt handler definitions. These should not be called, they
@@ -32,11 +43,24 @@ static void (*exception_handlers[84])(void) = { 0 };
 static void DefaultISRHandler(void) {
     /** Read ICSR to determine exception number */
     uint8_t vecactive = (READBITS(SCB->ICSR, SCB_ICSR_VECTACTIVE_Msk) - 16);
+#if SYS_USE_IRQ_STATS == IRQ_STATS_ENABLED
+    irq_stats_t *stats = &irq_stats[vecactive];
+    uint32_t cycles = DWT->CYCCNT;
+#endif
+    TRACE_EVENT(TRACE_EV_ISR_ENTER, vecactive);
     // Check if a handler is installed for this function
     if (exception_handlers[vecactive] != NULL) {
         exception_handlers[vecactive]();
     }
-
+    TRACE_EVENT(TRACE_EV_ISR_EXIT, vecactive);
+#if SYS_USE_IRQ_STATS == IRQ_STATS_ENABLED
+    cycles = DWT->CYCCNT - cycles;
+    stats->count++;
+    stats->total_cycles += cycles;
+    if (cycles > stats->max_cycles) {
+        stats->max_cycles = cycles;
+    }
+#endif
 }
 
 /**
@@ -192,7 +216,11 @@ __attribute__((section(".vectors"))) const uint32_t exception_vectors[] = {
     0,                           /*!< 53 Reserved */
     (uint32_t)DefaultISRHandler, /*!< 54 TIM6 global and DAC1&2 underrun error
                                     interrupts */
+#if SYS_USE_PROFILE == PROFILE_ENABLED
+    (uint32_t)ProfileHandler, /*!< 55 TIM7 global interrupt (profiler) */
+#else
     (uint32_t)DefaultISRHandler, /*!< 55 TIM7 global interrupt */
+#endif
     (uint32_t)DefaultISRHandler, /*!< 56 DMA2 Channel 1 global Interrupt */
     (uint32_t)DefaultISRHandler, /*!< 57 DMA2 Channel 2 global Interrupt */
     (uint32_t)DefaultISRHandler, /*!< 58 DMA2 Channel 3 global Interrupt */
@@ -241,6 +269,90 @@ void enable_irq(uint32_t num, void (*handler)(void)) {
     SETFIELD(NVIC->ISER[reg_sel], 1UL, num);
 }
 
+#if SYS_USE_IRQ_STATS == IRQ_STATS_ENABLED
+/**
+ * Gets the statistics of an interrupt. Cycle counts include any interrupts
+ * that preempted the handler.
+ * @param num: Interrupt number
+ * @param stats: set to the interrupt's statistics
+ * @return SYS_OK on success, ERR_BADPARAM for an invalid interrupt number,
+ * or ERR_NOSUPPORT if interrupt statistics are disabled
+ */
+syserr_t irq_stats_get(uint32_t num, irq_stats_t *stats) {
+    if (num >= NUM_IRQS || stats == NULL) {
+        return ERR_BADPARAM;
+    }
+    // Mask interrupts so the 64 bit total is copied consistently
+    mask_irq();
+    *stats = irq_stats[num];
+    unmask_irq();
+    return SYS_OK;
+}
+
+/**
+ * Clears all interrupt statistics, and starts the DWT cycle counter if it is
+ * not running. Called by system_init when interrupt statistics are enabled.
+ */
+void irq_stats_reset(void) {
+    uint32_t i;
+    // The counter may already be running for the trace recorder
+    perf_enable(PERF_CYCLES);
+    mask_irq();
+    for (i = 0; i < NUM_IRQS; i++) {
+        irq_stats[i].count = 0;
+        irq_stats[i].total_cycles = 0;
+        irq_stats[i].max_cycles = 0;
+        irq_dumped_cycles[i] = 0;
+    }
+    irq_dump_stamp = DWT->CYCCNT;
+    unmask_irq();
+}
+
+/**
+ * Logs the statistics of every interrupt that ran since the last dump,
+ * including the share of CPU time its handler used over that period. Call
+ * periodically from a low priority task, at least once per cycle counter
+ * wrap (53 seconds at 80 MHz), to find interrupt sources starving the system.
+ */
+void irq_stats_dump(void) {
+    const char *TAG = "irq_stats";
+    irq_stats_t stats;
+    uint32_t i, now, elapsed, load;
+    uint64_t cycles;
+    now = DWT->CYCCNT;
+    elapsed = now - irq_dump_stamp;
+    irq_dump_stamp = now;
+    for (i = 0; i < NUM_IRQS; i++) {
+        irq_stats_get(i, &stats);
+        cycles = stats.total_cycles - irq_dumped_cycles[i];
+        irq_dumped_cycles[i] = stats.total_cycles;
+        if (cycles == 0) {
+            // Handler has not run since the last dump
+            continue;
+        }
+        // CPU share in hundredths of a percent
+        load = elapsed ? (uint32_t)((cycles * 10000) / elapsed) : 0;
+        LOG_I(TAG,
+              "IRQ %lu: %lu calls, avg %lu cycles, max %lu cycles, "
+              "%lu.%02lu%% CPU",
+              i, stats.count, (uint32_t)(stats.total_cycles / stats.count),
+              stats.max_cycles, load / 100, load % 100);
+    }
+}
+
+#else
+/** Statistics are disabled, so define functions as stubs */
+syserr_t irq_stats_get(uint32_t num, irq_stats_t *stats) {
+    (void)num;
+    (void)stats;
+    return ERR_NOSUPPORT;
+}
+
+void irq_stats_reset(void) {}
+
+void irq_stats_dump(void) {}
+#endif
+
 /**
  * Disable interrupt number "num" (in Nested vector interrupt controller).
  * Resets handler function.
@@ -269,3 +381,28 @@ void mask_irq() { asm volatile("CPSID i"); }
  * This sets PRIMASK to 0, effectively allowing preemption
  */
 void unmask_irq() { asm volatile("CPSIE i"); }
+
+/**
+ * Disables interrupts, and returns the previous PRIMASK value. Calls may be
+ * nested, as long as each is paired with a call to unmask_irq_restore.
+ * @return PRIMASK value before interrupts were disabled
+ */
+uint32_t mask_irq_save() {
+    uint32_t primask;
+    asm volatile("mrs %[primask], PRIMASK\n" // Save current PRIMASK
+                 "cpsid i\n"                 // Disable interrupts
+                 : [ primask ] "=r"(primask)
+                 :
+                 : "memory");
+    return primask;
+}
+
+/**
+ * Restores PRIMASK to a value returned by mask_irq_save. Interrupts are only
+ * reenabled if they were enabled when the matching mask_irq_save was called.
+ * @param primask: value returned by mask_irq_save
+ */
+void unmask_irq_restore(uint32_t primask) {
+    asm volatile("msr PRIMASK, %[primask]\n" : : [ primask ] "r"(primask)
+                 : "memory");
+}
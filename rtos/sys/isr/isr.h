@@ -1,9 +1,25 @@
 #ifndef ISR_H
 #define ISR_H
 
+#include <stdint.h>
+
+#include <sys/err.h>
+
 /** Macro to convert IRQ number to exception number */
 #define IRQN_TO_EXCEPTION(irq) (irq) + 16
 
+/** Number of peripheral interrupts */
+#define NUM_IRQS 84
+
+/**
+ * Interrupt statistics, collected when SYS_USE_IRQ_STATS is enabled
+ */
+typedef struct {
+    uint32_t count;        /*!< Number of times the handler ran */
+    uint64_t total_cycles; /*!< Total cycles spent in the handler */
+    uint32_t max_cycles;   /*!< Longest single run of the handler */
+} irq_stats_t;
+
 /**
  * Simple function to disable interrupts.
  * This sets PRIMASK to 1, effectively disabling preemption
@@ -16,6 +32,20 @@ void mask_irq();
  */
 void unmask_irq();
 
+/**
+ * Disables interrupts, and returns the previous PRIMASK value. Calls may be
+ * nested, as long as each is paired with a call to unmask_irq_restore.
+ * @return PRIMASK value before interrupts were disabled
+ */
+uint32_t mask_irq_save();
+
+/**
+ * Restores PRIMASK to a value returned by mask_irq_save. Interrupts are only
+ * reenabled if they were enabled when the matching mask_irq_save was called.
+ * @param primask: value returned by mask_irq_save
+ */
+void unmask_irq_restore(uint32_t primask);
+
 /**
  * Disable interrupt number "num" (in Nested vector interrupt controller).
  * Resets handler function.
@@ -31,4 +61,28 @@ void disable_irq(uint32_t num);
  */
 void enable_irq(uint32_t num, void (*handler)(void));
 
+/**
+ * Gets the statistics of an interrupt. Cycle counts include any interrupts
+ * that preempted the handler.
+ * @param num: Interrupt number
+ * @param stats: set to the interrupt's statistics
+ * @return SYS_OK on success, ERR_BADPARAM for an invalid interrupt number,
+ * or ERR_NOSUPPORT if interrupt statistics are disabled
+ */
+syserr_t irq_stats_get(uint32_t num, irq_stats_t *stats);
+
+/**
+ * Clears all interrupt statistics, and starts the DWT cycle counter if it is
+ * not running. Called by system_init when interrupt statistics are enabled.
+ */
+void irq_stats_reset(void);
+
+/**
+ * Logs the statistics of every interrupt that ran since the last dump,
+ * including the share of CPU time its handler used over that period. Call
+ * periodically from a low priority task, at least once per cycle counter
+ * wrap (53 seconds at 80 MHz), to find interrupt sources starving the system.
+ */
+void irq_stats_dump(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,210 @@
+/**
+ * @file profile.c
+ * Implements the statistical sampling profiler
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <config.h>
+
+#include "profile.h"
+
+#if SYS_USE_PROFILE == PROFILE_DISABLED
+/** Define all functions as stubs, so the profiler costs nothing */
+syserr_t profile_start(uint32_t rate) {
+    (void)rate;
+    return ERR_NOSUPPORT;
+}
+
+syserr_t profile_stop(void) { return ERR_NOSUPPORT; }
+
+uint32_t profile_read(profile_sample_t *samples, uint32_t len) {
+    (void)samples;
+    (void)len;
+    return 0;
+}
+
+uint32_t profile_stream_swo(void) { return 0; }
+
+uint32_t profile_dropped(void) { return 0; }
+
+#else
+
+#include <drivers/clock/clock.h>
+#include <drivers/device/device.h>
+#include <sys/isr/isr.h>
+#include <sys/task/task.h>
+#include <util/bitmask.h>
+
+#if (SYS_PROFILE_BUFLEN & (SYS_PROFILE_BUFLEN - 1)) != 0
+#error "SYS_PROFILE_BUFLEN must be a power of two"
+#endif
+
+#define PROFILE_BUF_MASK (SYS_PROFILE_BUFLEN - 1)
+
+/** Stacked register offsets in an exception frame, in words */
+#define FRAME_PC 6
+#define FRAME_XPSR 7
+/** Exception number field of the stacked xPSR */
+#define XPSR_EXCEPTION_Msk 0x1FFUL
+
+static profile_sample_t profile_buf[SYS_PROFILE_BUFLEN];
+static uint32_t profile_head = 0;  // Count of samples written
+static uint32_t profile_tail = 0;  // Count of samples read or overwritten
+static uint32_t profile_drops = 0; // Samples overwritten before being read
+
+static void profile_sample(uint32_t *frame) __attribute__((used));
+
+/**
+ * Starts sampling with TIM7. A rate that does not divide the system tick
+ * rate evenly (such as 997 Hz) avoids sampling in step with periodic tasks.
+ * @param rate: sampling rate, in Hz
+ * @return SYS_OK on success, ERR_BADPARAM if the rate cannot be generated
+ * from the TIM7 clock, or ERR_NOSUPPORT if the profiler is disabled
+ */
+syserr_t profile_start(uint32_t rate) {
+    uint64_t clk_freq, ticks, prescaler;
+    if (rate == 0) {
+        return ERR_BADPARAM;
+    }
+    // TIM7 runs at twice PCLK1 when the APB1 prescaler is not 1
+    clk_freq = pclk1_freq();
+    if (clk_freq != hclk_freq()) {
+        clk_freq <<= 1;
+    }
+    ticks = clk_freq / rate;
+    // Use the smallest prescaler that lets the period fit in 16 bits
+    prescaler = (ticks - 1) >> 16;
+    if (ticks < 2 || prescaler > 0xFFFF) {
+        return ERR_BADPARAM;
+    }
+    SETBITS(RCC->APB1ENR1, RCC_APB1ENR1_TIM7EN);
+    SETBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_TIM7RST);
+    CLEARBITS(RCC->APB1RSTR1, RCC_APB1RSTR1_TIM7RST);
+    TIM7->PSC = prescaler;
+    TIM7->ARR = (ticks / (prescaler + 1)) - 1;
+    // Load the prescaler without raising an update interrupt
+    SETBITS(TIM7->CR1, TIM_CR1_URS);
+    SETBITS(TIM7->EGR, TIM_EGR_UG);
+    CLEARBITS(TIM7->SR, TIM_SR_UIF);
+    SETBITS(TIM7->DIER, TIM_DIER_UIE);
+    profile_head = profile_tail = profile_drops = 0;
+    // ProfileHandler is in the vector table, so no handler is registered
+    enable_irq(TIM7_IRQn, NULL);
+    SETBITS(TIM7->CR1, TIM_CR1_CEN);
+    return SYS_OK;
+}
+
+/**
+ * Stops sampling. Samples already recorded can still be read.
+ * @return SYS_OK on success, or ERR_NOSUPPORT if the profiler is disabled
+ */
+syserr_t profile_stop(void) {
+    if (READBITS(RCC->APB1ENR1, RCC_APB1ENR1_TIM7EN) == 0UL) {
+        // Never started
+        return SYS_OK;
+    }
+    CLEARBITS(TIM7->CR1, TIM_CR1_CEN);
+    disable_irq(TIM7_IRQn);
+    CLEARBITS(TIM7->SR, TIM_SR_UIF);
+    CLEARBITS(RCC->APB1ENR1, RCC_APB1ENR1_TIM7EN);
+    return SYS_OK;
+}
+
+/**
+ * Copies the oldest unread samples out of the profiler buffer
+ * @param samples: buffer to copy samples into
+ * @param len: length of samples buffer, in samples
+ * @return number of samples copied
+ */
+uint32_t profile_read(profile_sample_t *samples, uint32_t len) {
+    uint32_t primask, count = 0;
+    while (count < len) {
+        // Lock per sample, so readers never hold off interrupts for long
+        primask = mask_irq_save();
+        if (profile_tail == profile_head) {
+            unmask_irq_restore(primask);
+            break;
+        }
+        samples[count++] = profile_buf[profile_tail & PROFILE_BUF_MASK];
+        profile_tail++;
+        unmask_irq_restore(primask);
+    }
+    return count;
+}
+
+/**
+ * Streams all unread samples to ITM stimulus port PROFILE_ITM_PORT. The
+ * debugger must enable the port. Does nothing if ITM or the port is
+ * disabled.
+ * @return number of samples streamed
+ */
+uint32_t profile_stream_swo(void) {
+    profile_sample_t sample;
+    uint32_t count = 0;
+    if (READBITS(ITM->TCR, ITM_TCR_ITMENA_Msk) == 0UL ||
+        READBITS(ITM->TER, 1UL << PROFILE_ITM_PORT) == 0UL) {
+        return 0;
+    }
+    while (profile_read(&sample, 1) == 1) {
+        // Wait for the stimulus port FIFO before each word
+        while (ITM->PORT[PROFILE_ITM_PORT].u32 == 0) {
+        }
+        ITM->PORT[PROFILE_ITM_PORT].u32 = sample.pc;
+        while (ITM->PORT[PROFILE_ITM_PORT].u32 == 0) {
+        }
+        ITM->PORT[PROFILE_ITM_PORT].u32 = sample.context;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Gets the number of samples overwritten before they were read
+ * @return number of samples dropped since profile_start
+ */
+uint32_t profile_dropped(void) { return profile_drops; }
+
+/**
+ * TIM7 interrupt handler. Locates the exception frame of the interrupted
+ * code, and records a sample from it.
+ *
+ * This function SHOULD NOT BE CALLED BY THE USER. It is installed directly in
+ * the vector table when the profiler is enabled.
+ */
+__attribute__((naked)) void ProfileHandler(void) {
+    /**
+     * This is a naked function, so the stack pointer is still the one the
+     * core pushed the exception frame to. EXC_RETURN (in lr) selects the
+     * stack: tasks run on the process stack, interrupts on the main stack.
+     * profile_sample returns with the untouched EXC_RETURN value, ending the
+     * exception.
+     */
+    asm volatile("tst lr, #4\n" // Test EXC_RETURN stack selection bit
+                 "ite eq\n"
+                 "mrseq r0, msp\n" // Frame is on main stack
+                 "mrsne r0, psp\n" // Frame is on process stack
+                 "b profile_sample\n");
+}
+
+/**
+ * Records a sample from an exception frame. Called from ProfileHandler.
+ * @param frame: exception frame of the interrupted code
+ */
+static void profile_sample(uint32_t *frame) {
+    profile_sample_t *sample = &profile_buf[profile_head & PROFILE_BUF_MASK];
+    uint32_t exception = frame[FRAME_XPSR] & XPSR_EXCEPTION_Msk;
+    CLEARBITS(TIM7->SR, TIM_SR_UIF);
+    if (profile_head - profile_tail == SYS_PROFILE_BUFLEN) {
+        // Buffer is full. The oldest sample is lost
+        profile_tail++;
+        profile_drops++;
+    }
+    sample->pc = frame[FRAME_PC];
+    sample->context =
+        exception != 0 ? exception : (uint32_t)get_active_task();
+    profile_head++;
+}
+
+#endif
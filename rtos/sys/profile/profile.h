@@ -0,0 +1,97 @@
+/**
+ * @file profile.h
+ * Statistical sampling profiler.
+ *
+ * When SYS_USE_PROFILE is PROFILE_ENABLED, profile_start runs TIM7 at the
+ * requested rate. Each TIM7 interrupt reads the program counter from the
+ * exception frame of the code it interrupted, and records it in a RAM ring
+ * buffer along with the context it ran in: the active task if the processor
+ * was in thread mode, or the exception number if it was in an interrupt.
+ * Code that runs with interrupts masked is not sampled, and interrupts at the
+ * same priority as TIM7 can only be sampled if they are assigned a lower
+ * priority.
+ *
+ * Samples can be drained with profile_read, or streamed to ITM stimulus port
+ * PROFILE_ITM_PORT with profile_stream_swo. The stream is the raw samples,
+ * back to back, in little endian byte order. sys/test/profile_host builds a
+ * tool that symbolizes a captured stream against the application ELF file,
+ * and prints a flat profile or folded stacks for flame graphs.
+ *
+ * This header has no device dependencies, so host tools may include it.
+ */
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#include <config.h>
+#include <sys/err.h>
+
+/** ITM stimulus port profile_stream_swo writes to */
+#define PROFILE_ITM_PORT 2
+
+/** Sample contexts below this value are exception numbers, not tasks */
+#define PROFILE_CONTEXT_EXCEPTION_MAX 0x200
+
+/**
+ * Profiler sample record
+ */
+typedef struct {
+    uint32_t pc;      /*!< Program counter of the interrupted code */
+    uint32_t context; /*!< Active task handle in thread mode (0 before the
+                           scheduler starts), or exception number (below
+                           PROFILE_CONTEXT_EXCEPTION_MAX) in an interrupt */
+} profile_sample_t;
+
+/** Checks if a sample was taken while an interrupt handler was running */
+#define PROFILE_SAMPLE_IN_ISR(sample)                                          \
+    ((sample)->context != 0 &&                                                 \
+     (sample)->context < PROFILE_CONTEXT_EXCEPTION_MAX)
+
+/**
+ * Starts sampling with TIM7. A rate that does not divide the system tick
+ * rate evenly (such as 997 Hz) avoids sampling in step with periodic tasks.
+ * @param rate: sampling rate, in Hz
+ * @return SYS_OK on success, ERR_BADPARAM if the rate cannot be generated
+ * from the TIM7 clock, or ERR_NOSUPPORT if the profiler is disabled
+ */
+syserr_t profile_start(uint32_t rate);
+
+/**
+ * Stops sampling. Samples already recorded can still be read.
+ * @return SYS_OK on success, or ERR_NOSUPPORT if the profiler is disabled
+ */
+syserr_t profile_stop(void);
+
+/**
+ * Copies the oldest unread samples out of the profiler buffer
+ * @param samples: buffer to copy samples into
+ * @param len: length of samples buffer, in samples
+ * @return number of samples copied
+ */
+uint32_t profile_read(profile_sample_t *samples, uint32_t len);
+
+/**
+ * Streams all unread samples to ITM stimulus port PROFILE_ITM_PORT. The
+ * debugger must enable the port. Does nothing if ITM or the port is
+ * disabled.
+ * @return number of samples streamed
+ */
+uint32_t profile_stream_swo(void);
+
+/**
+ * Gets the number of samples overwritten before they were read
+ * @return number of samples dropped since profile_start
+ */
+uint32_t profile_dropped(void);
+
+/**
+ * TIM7 interrupt handler. Locates the exception frame of the interrupted
+ * code, and records a sample from it.
+ *
+ * This function SHOULD NOT BE CALLED BY THE USER. It is installed directly in
+ * the vector table when the profiler is enabled.
+ */
+void ProfileHandler(void);
+
+#endif
@@ -3,9 +3,13 @@
  * implements binary and counting semaphores
  */
 #include <stdlib.h>
+#include <string.h>
 
+#include <config.h>
 #include <sys/err.h>
+#include <sys/isr/isr.h>
 #include <sys/task/task.h>
+#include <sys/trace/trace.h>
 #include <util/list/list.h>
 #include <util/logging/logging.h>
 
@@ -27,6 +31,11 @@ typedef struct semaphore_state {
     volatile unsigned int value; /*!< Semaphore value */
     semaphore_type_t type;       /*!< Semaphore type */
     list_t waiting_tasks;        /*!< List of tasks waiting on the semaphore */
+#if SYS_USE_SEM_STATS == SEM_STATS_ENABLED
+    const char *name;             /*!< Optional semaphore name */
+    semaphore_stats_t stats;      /*!< Contention statistics */
+    list_state_t registry_state;  /*!< Semaphore registry list state */
+#endif
 } semaphore_state_t;
 
 /** Waiting task structure */
@@ -38,7 +47,12 @@ typedef struct waiting_task {
 
 static const char *TAG = "semaphore.c";
 
+#if SYS_USE_SEM_STATS == SEM_STATS_ENABLED
+static list_t semaphore_registry = NULL; // Live semaphores, oldest first
+#endif
+
 // Static functions
+static semaphore_t create_semaphore(semaphore_type_t type, unsigned int start);
 static void get_semaphore_lock(semaphore_state_t *sem);
 static void drop_semaphore_lock(semaphore_state_t *sem);
 
@@ -48,16 +62,7 @@ static void drop_semaphore_lock(semaphore_state_t *sem);
  * @return handle to created semaphore, or null on error
  */
 semaphore_t semaphore_create_counting(unsigned int start) {
-    semaphore_state_t *sem = malloc(sizeof(semaphore_state_t));
-    if (sem == NULL) {
-        return NULL;
-    }
-    // Initialize semaphore
-    sem->lock = SEMAPHORE_UNLOCKED;
-    sem->type = SEMAPHORE_COUNTING;
-    sem->value = start;
-    sem->waiting_tasks = NULL;
-    return (semaphore_t)sem;
+    return create_semaphore(SEMAPHORE_COUNTING, start);
 }
 
 /**
@@ -65,16 +70,7 @@ semaphore_t semaphore_create_counting(unsigned int start) {
  * @return handle to created semaphore, or null on error
  */
 semaphore_t semaphore_create_binary() {
-    semaphore_state_t *sem = malloc(sizeof(semaphore_state_t));
-    if (sem == NULL) {
-        return NULL;
-    }
-    // Initialize semaphore
-    sem->lock = SEMAPHORE_UNLOCKED;
-    sem->type = SEMAPHORE_BINARY;
-    sem->value = 0;
-    sem->waiting_tasks = NULL;
-    return (semaphore_t)sem;
+    return create_semaphore(SEMAPHORE_BINARY, 0);
 }
 
 /**
@@ -90,13 +86,21 @@ syserr_t semaphore_pend(semaphore_t sem, int delay) {
     syserr_t ret;
     semaphore_state_t *semaphore = (semaphore_state_t *)sem;
     waiting_task_t *queue_entry;
+#if SYS_USE_SEM_STATS == SEM_STATS_ENABLED
+    uint32_t blocked_ticks;
+#endif
+    TRACE_EVENT(TRACE_EV_SEM_PEND, semaphore);
     // Get the semaphore lock
     get_semaphore_lock(semaphore);
+#if SYS_USE_SEM_STATS == SEM_STATS_ENABLED
+    semaphore->stats.pends++;
+#endif
     // Check semaphore value
     if (semaphore->value > 0) {
         semaphore->value--;
         // Release semaphore lock and return
         drop_semaphore_lock(semaphore);
+        TRACE_EVENT(TRACE_EV_SEM_TAKE, semaphore);
         return SYS_OK;
     }
     /**
@@ -111,8 +115,16 @@ syserr_t semaphore_pend(semaphore_t sem, int delay) {
     queue_entry->task = get_active_task();
     queue_entry->delay = delay;
     // Add queue entry to semaphore queue
-    semaphore->waiting_tasks = list_append(
-        semaphore->waiting_tasks, queue_entry, &(queue_entry->list_state));
+    semaphore->waiting_tasks =
+        list_append(semaphore->waiting_tasks, &(queue_entry->list_state));
+#if SYS_USE_SEM_STATS == SEM_STATS_ENABLED
+    semaphore->stats.contended++;
+    semaphore->stats.queue_depth++;
+    if (semaphore->stats.queue_depth > semaphore->stats.max_queue_depth) {
+        semaphore->stats.max_queue_depth = semaphore->stats.queue_depth;
+    }
+    blocked_ticks = get_system_ticks();
+#endif
     // Drop semaphore lock
     drop_semaphore_lock(semaphore);
     if (delay == SYS_TIMEOUT_INF) {
@@ -150,8 +162,21 @@ syserr_t semaphore_pend(semaphore_t sem, int delay) {
         list_remove(semaphore->waiting_tasks, &(queue_entry->list_state));
     // Free queue entry
     free(queue_entry);
+#if SYS_USE_SEM_STATS == SEM_STATS_ENABLED
+    blocked_ticks = get_system_ticks() - blocked_ticks;
+    semaphore->stats.queue_depth--;
+    semaphore->stats.total_blocked_ticks += blocked_ticks;
+    if (blocked_ticks > semaphore->stats.max_blocked_ticks) {
+        semaphore->stats.max_blocked_ticks = blocked_ticks;
+    }
+    if (ret == ERR_TIMEOUT) {
+        semaphore->stats.timeouts++;
+    }
+#endif
     // Drop semaphore lock
     drop_semaphore_lock(semaphore);
+    TRACE_EVENT(ret == SYS_OK ? TRACE_EV_SEM_TAKE : TRACE_EV_SEM_TIMEOUT,
+                semaphore);
     return ret;
 }
 
@@ -164,6 +189,7 @@ syserr_t semaphore_pend(semaphore_t sem, int delay) {
 void semaphore_post(semaphore_t sem) {
     semaphore_state_t *semaphore = (semaphore_state_t *)sem;
     waiting_task_t *runnable_queue_entry;
+    TRACE_EVENT(TRACE_EV_SEM_POST, semaphore);
     // Get the semaphore lock
     get_semaphore_lock(semaphore);
     if (semaphore->type == SEMAPHORE_BINARY && semaphore->value == 1) {
@@ -175,7 +201,8 @@ void semaphore_post(semaphore_t sem) {
     semaphore->value++;
     // If tasks are waiting, unblock one
     if (semaphore->waiting_tasks != NULL) {
-        runnable_queue_entry = list_get_head(semaphore->waiting_tasks);
+        runnable_queue_entry = list_get_head(
+            semaphore->waiting_tasks, waiting_task_t, list_state);
         drop_semaphore_lock(semaphore);
         // Mark the selected task as runnable
         if (runnable_queue_entry->delay == SYS_TIMEOUT_INF) {
@@ -206,12 +233,163 @@ syserr_t semaphore_destroy(semaphore_t sem) {
         drop_semaphore_lock(semaphore);
         return ERR_BADPARAM;
     } else {
+#if SYS_USE_SEM_STATS == SEM_STATS_ENABLED
+        mask_irq();
+        semaphore_registry = list_remove(semaphore_registry,
+                                         &(semaphore->registry_state));
+        unmask_irq();
+#endif
         // Free semaphore resources
         free(semaphore);
         return SYS_OK; // No need to drop lock, we just freed it
     }
 }
 
+#if SYS_USE_SEM_STATS == SEM_STATS_ENABLED
+/**
+ * names a semaphore, so it can be identified in statistics. the name is not
+ * copied, and must remain valid while the semaphore exists. has no effect if
+ * semaphore statistics are disabled.
+ * @param sem: semaphore to name
+ * @param name: NULL terminated semaphore name
+ */
+void semaphore_set_name(semaphore_t sem, const char *name) {
+    ((semaphore_state_t *)sem)->name = name;
+}
+
+/**
+ * gets the name of a semaphore
+ * @param sem: semaphore to get name of
+ * @return semaphore name, or NULL if it has none
+ */
+const char *semaphore_get_name(semaphore_t sem) {
+    return ((semaphore_state_t *)sem)->name;
+}
+
+/**
+ * gets the statistics of a semaphore
+ * @param sem: semaphore to get statistics of
+ * @param stats: set to the semaphore's statistics
+ * @return SYS_OK on success, ERR_BADPARAM on invalid parameters, or
+ * ERR_NOSUPPORT if semaphore statistics are disabled
+ */
+syserr_t semaphore_get_stats(semaphore_t sem, semaphore_stats_t *stats) {
+    semaphore_state_t *semaphore = (semaphore_state_t *)sem;
+    if (semaphore == NULL || stats == NULL) {
+        return ERR_BADPARAM;
+    }
+    // Hold the lock so the statistics are copied consistently
+    get_semaphore_lock(semaphore);
+    *stats = semaphore->stats;
+    drop_semaphore_lock(semaphore);
+    return SYS_OK;
+}
+
+/**
+ * lists live semaphores, oldest first. handles are only valid until the
+ * semaphore is destroyed.
+ * @param sems: buffer to store semaphore handles in
+ * @param len: length of sems buffer
+ * @return number of live semaphores, which may exceed len. 0 if semaphore
+ * statistics are disabled.
+ */
+uint32_t semaphore_list(semaphore_t *sems, uint32_t len) {
+    list_state_t *pos;
+    uint32_t count = 0;
+    mask_irq();
+    LIST_FOR_EACH(semaphore_registry, pos) {
+        if (count < len) {
+            sems[count] = LIST_ENTRY(pos, semaphore_state_t, registry_state);
+        }
+        count++;
+    }
+    unmask_irq();
+    return count;
+}
+
+/**
+ * logs the name and statistics of every live semaphore
+ */
+void semaphore_stats_dump(void) {
+    semaphore_t *sems;
+    semaphore_stats_t stats;
+    const char *name;
+    uint32_t i, count;
+    count = semaphore_list(NULL, 0);
+    sems = malloc(count * sizeof(semaphore_t));
+    if (sems == NULL) {
+        return;
+    }
+    // Semaphores may have been destroyed since they were counted
+    count = semaphore_list(sems, count);
+    for (i = 0; i < count; i++) {
+        semaphore_get_stats(sems[i], &stats);
+        name = semaphore_get_name(sems[i]);
+        LOG_I(TAG,
+              "%s (%p): %lu pends, %lu contended, %lu timeouts, "
+              "queue %lu (max %lu), blocked %lu ticks (max %lu ticks)",
+              name ? name : "unnamed", sems[i], stats.pends, stats.contended,
+              stats.timeouts, stats.queue_depth, stats.max_queue_depth,
+              stats.total_blocked_ticks, stats.max_blocked_ticks);
+    }
+    free(sems);
+}
+
+#else
+/** Statistics are disabled, so define functions as stubs */
+void semaphore_set_name(semaphore_t sem, const char *name) {
+    (void)sem;
+    (void)name;
+}
+
+const char *semaphore_get_name(semaphore_t sem) {
+    (void)sem;
+    return NULL;
+}
+
+syserr_t semaphore_get_stats(semaphore_t sem, semaphore_stats_t *stats) {
+    (void)sem;
+    (void)stats;
+    return ERR_NOSUPPORT;
+}
+
+uint32_t semaphore_list(semaphore_t *sems, uint32_t len) {
+    (void)sems;
+    (void)len;
+    return 0;
+}
+
+void semaphore_stats_dump(void) {}
+#endif
+
+/**
+ * Allocates and initializes a semaphore, and adds it to the registry
+ * @param type: semaphore type
+ * @param start: starting semaphore value
+ * @return handle to created semaphore, or null on error
+ */
+static semaphore_t create_semaphore(semaphore_type_t type,
+                                    unsigned int start) {
+    semaphore_state_t *sem = malloc(sizeof(semaphore_state_t));
+    if (sem == NULL) {
+        return NULL;
+    }
+    // Initialize semaphore
+    sem->lock = SEMAPHORE_UNLOCKED;
+    sem->type = type;
+    sem->value = start;
+    sem->waiting_tasks = NULL;
+#if SYS_USE_SEM_STATS == SEM_STATS_ENABLED
+    sem->name = NULL;
+    memset(&sem->stats, 0, sizeof(sem->stats));
+    mask_irq();
+    semaphore_registry =
+        list_append(semaphore_registry, &(sem->registry_state));
+    unmask_irq();
+#endif
+    return (semaphore_t)sem;
+}
+
 /**
  * Gets semaphore lock. Returns when lock is acquired
  * @param sem: Semaphore state to get lock for.
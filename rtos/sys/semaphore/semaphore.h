@@ -4,6 +4,8 @@
  */
 #ifndef SEMAPHORE_H
 #define SEMAPHORE_H
+#include <stdint.h>
+
 #include <sys/err.h>
 
 #define SYS_TIMEOUT_INF -1  /*!< Infinite timeout on semaphore pend */
@@ -11,6 +13,20 @@
 // typedef to obscure internal definition of semaphore
 typedef void *semaphore_t;
 
+/**
+ * Semaphore statistics, collected when SYS_USE_SEM_STATS is enabled.
+ * Blocked times are in system ticks, see SYSTICK_FREQ.
+ */
+typedef struct {
+    uint32_t pends;               /*!< Number of pends */
+    uint32_t contended;           /*!< Pends that had to wait for a post */
+    uint32_t timeouts;            /*!< Pends that timed out */
+    uint32_t queue_depth;         /*!< Tasks waiting on the semaphore now */
+    uint32_t max_queue_depth;     /*!< Most tasks waiting at once */
+    uint32_t total_blocked_ticks; /*!< Total ticks tasks spent waiting */
+    uint32_t max_blocked_ticks;   /*!< Most ticks a task spent waiting */
+} semaphore_stats_t;
+
 /**
  * creates a new counting semaphore
  * @param start: starting value for counting semaphore
@@ -50,4 +66,44 @@ void semaphore_post(semaphore_t sem);
  */
 syserr_t semaphore_destroy(semaphore_t sem);
 
+/**
+ * names a semaphore, so it can be identified in statistics. the name is not
+ * copied, and must remain valid while the semaphore exists. has no effect if
+ * semaphore statistics are disabled.
+ * @param sem: semaphore to name
+ * @param name: NULL terminated semaphore name
+ */
+void semaphore_set_name(semaphore_t sem, const char *name);
+
+/**
+ * gets the name of a semaphore
+ * @param sem: semaphore to get name of
+ * @return semaphore name, or NULL if it has none
+ */
+const char *semaphore_get_name(semaphore_t sem);
+
+/**
+ * gets the statistics of a semaphore
+ * @param sem: semaphore to get statistics of
+ * @param stats: set to the semaphore's statistics
+ * @return SYS_OK on success, ERR_BADPARAM on invalid parameters, or
+ * ERR_NOSUPPORT if semaphore statistics are disabled
+ */
+syserr_t semaphore_get_stats(semaphore_t sem, semaphore_stats_t *stats);
+
+/**
+ * lists live semaphores, oldest first. handles are only valid until the
+ * semaphore is destroyed.
+ * @param sems: buffer to store semaphore handles in
+ * @param len: length of sems buffer
+ * @return number of live semaphores, which may exceed len. 0 if semaphore
+ * statistics are disabled.
+ */
+uint32_t semaphore_list(semaphore_t *sems, uint32_t len);
+
+/**
+ * logs the name and statistics of every live semaphore
+ */
+void semaphore_stats_dump(void);
+
 #endif
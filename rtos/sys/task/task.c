@@ -14,9 +14,12 @@
 #include <drivers/device/device.h>
 #include <sys/err.h>
 #include <sys/isr/isr.h>
+#include <sys/trace/trace.h>
 #include <util/bitmask.h>
+#include <util/heap/heap.h>
 #include <util/list/list.h>
 #include <util/logging/logging.h>
+#include <util/perf/perf.h>
 
 #include "task.h"
 
@@ -52,15 +55,41 @@ typedef struct task_status {
     bool stack_allocated;  /*!< Was the stack allocated? */
     int blockstate;        /*!< cause for task block (or delay value) */
     uint32_t priority;     /*!< Task priority */
+    uint32_t threshold;    /*!< Preemption threshold, at least priority */
+    uint32_t sched_locks;  /*!< Nesting depth of scheduler_lock calls */
     list_state_t list_state; /*!< Task list state */
+#if SYS_USE_LATENCY_STATS == LATENCY_STATS_ENABLED
+    bool woken;              /*!< Was task made ready since it last ran */
+    uint32_t ready_cycles;   /*!< Cycle counter when task was made ready */
+    task_latency_t latency;  /*!< Wake to run latency statistics */
+#endif
+#if SYS_USE_EDF == EDF_ENABLED
+    uint32_t deadline;        /*!< Absolute deadline of current job, in ticks */
+    bool job_open;            /*!< Has the current job not yet completed */
+    uint32_t deadline_misses; /*!< Jobs that missed their deadline */
+    heap_node_t edf_node;     /*!< EDF ready heap state, while ready */
+#endif
 } task_status_t;
 
 // Task control block lists
 static task_status_t *active_task = NULL;                // Running task
 static list_t ready_tasks[RTOS_PRIORITY_COUNT] = {NULL}; // Tasks ready to run
+static uint32_t ready_mask = 0; // Bit n is set while ready_tasks[n] has tasks
 static list_t delayed_tasks = NULL; // Tasks delayed by task_delay
 static list_t blocked_tasks = NULL; // Tasks blocked by system
 static list_t exited_tasks = NULL;  // Exited tasks waiting to be reaped
+static volatile uint32_t system_ticks = 0; // System ticks since RTOS start
+static bool preempt_pending = false; // Preemption deferred by scheduler lock
+static uint32_t context_switches = 0; // Context switches since RTOS start
+#if SYS_USE_EDF == EDF_ENABLED
+static bool edf_earlier(heap_node_t *a, heap_node_t *b);
+// Ready tasks at SYS_EDF_PRIORITY, ordered by deadline
+static heap_t edf_ready = HEAP_INITIALIZER(edf_earlier);
+#endif
+
+// Idle task hook
+static void (*idle_hook)(void *) = NULL;
+static void *idle_hook_arg = NULL;
 
 // Logging tag
 static const char *TAG = "task.c";
@@ -73,12 +102,19 @@ static inline void trigger_svcall();
 static void idle_entry(void *arg);
 static uint32_t *init_task_stack(uint32_t *stack_ptr, void *return_pc,
                                  void *arg0);
-static inline list_return_t decrement_task_delay(void *taskptr);
 static inline void mark_task_ready(void *taskptr);
-static inline list_return_t delete_list(void *taskptr);
-static inline list_return_t check_stack(void *taskptr);
+static inline void preempt_active_task();
+static inline void ready_append(task_status_t *task);
+static inline void ready_remove(task_status_t *task);
+static inline int highest_ready_priority();
+static inline bool preempts_active(task_status_t *task);
+static inline bool ready_preempts_active();
+static inline bool check_stack(task_status_t *task);
 static inline void free_task(void *task);
 static void task_exithandler();
+#if SYS_USE_LATENCY_STATS == LATENCY_STATS_ENABLED
+static inline void record_latency(task_status_t *task);
+#endif
 
 /**
  * Creates a system task. Requires memory allocation to be enabled to succeed.
@@ -115,8 +151,10 @@ task_handle_t task_create(void (*entry)(void *), void *arg,
         }
         task->stack_start = task->stack_end + (DEFAULT_STACKSIZE);
     } else {
-        // Check priority
-        if (cfg->task_priority > RTOS_PRIORITY_COUNT) {
+        // Check priority and preemption threshold
+        if (cfg->task_priority >= RTOS_PRIORITY_COUNT ||
+            cfg->task_preempt_threshold >= RTOS_PRIORITY_COUNT) {
+            free(task);
             return NULL;
         }
         // Check if a stack was provided
@@ -144,6 +182,11 @@ task_handle_t task_create(void (*entry)(void *), void *arg,
         }
         task->priority = cfg->task_priority;
     }
+    // Thresholds below the task's priority have no effect
+    task->threshold = task->priority;
+    if (cfg != NULL && cfg->task_preempt_threshold > task->priority) {
+        task->threshold = cfg->task_preempt_threshold;
+    }
     /**
      * Setup stack padding. 'stack_softend' is the memory location where padding
      * starts, and where we consider a stack to have overflowed.
@@ -156,9 +199,22 @@ task_handle_t task_create(void (*entry)(void *), void *arg,
     // Update task state and place in ready queue
     task->entry = entry;
     task->arg = arg;
+    task->sched_locks = 0;
+#if SYS_USE_EDF == EDF_ENABLED
+    // Tasks created in the EDF class are due at once, until their first release
+    task->deadline = system_ticks;
+    task->job_open = false;
+    task->deadline_misses = 0;
+#endif
+#if SYS_USE_LATENCY_STATS == LATENCY_STATS_ENABLED
+    task->woken = false;
+    memset(&task->latency, 0, sizeof(task->latency));
+#endif
     // Initialize task stack
     task->stack_ptr =
         init_task_stack((uint32_t *)task->stack_start, task->entry, task->arg);
+    TRACE_EVENT(TRACE_EV_TASK_CREATE, task);
+    TRACE_NAME(task, task->name);
     // Place this task into the ready queue (scheduler can select it)
     mark_task_ready(task);
     // Return task handle
@@ -184,26 +240,98 @@ void rtos_start() {
         LOG_E(TAG, "Could not create idle task");
         exit(ERR_SCHEDULER);
     }
+#if SYS_USE_LATENCY_STATS == LATENCY_STATS_ENABLED
+    // Start the cycle counter wakeups are timestamped with
+    perf_enable(PERF_CYCLES);
+#endif
     // Trigger an SVCall to start the scheduler. Will not return.
     trigger_svcall();
     LOG_E(TAG, "Scheduler returned without starting RTOS");
     exit(ERR_SCHEDULER);
 }
 
+/**
+ * Sets a function the idle task calls on every pass of its loop, before
+ * waiting for an interrupt. The hook runs on the idle task stack
+ * (IDLE_TASK_STACK_SIZE), and must never block.
+ * @param hook: function to call, or NULL to remove the hook
+ * @param arg: argument passed to hook
+ */
+void task_set_idle_hook(void (*hook)(void *), void *arg) {
+    mask_irq();
+    idle_hook = hook;
+    idle_hook_arg = arg;
+    unmask_irq();
+}
+
 /**
  * Yields task execution. This function will stop execution of the current
- * task, and yield execution to the highest priority task able to run
+ * task, and yield execution to the highest priority task able to run. A task
+ * in the EDF class keeps running if its deadline is still the earliest there.
  */
 void task_yield() {
     if (!active_task) {
         return;
     }
+    /**
+     * If no other task is ready, the scheduler would select this task again.
+     * Skip the context switch entirely. Yields hand the CPU to lower priority
+     * tasks too, so any ready task must be switched to.
+     */
+    if (ready_mask == 0) {
+        return;
+    }
+#if SYS_USE_EDF == EDF_ENABLED
+    /**
+     * A running EDF task is not in edf_ready, so the scheduler would pick the
+     * next deadline in the class even if this task's is earlier. Keep running
+     * while this task is still due first.
+     */
+    if (active_task->priority == SYS_EDF_PRIORITY &&
+        highest_ready_priority() == SYS_EDF_PRIORITY &&
+        edf_earlier(&(active_task->edf_node), heap_peek(&edf_ready))) {
+        return;
+    }
+#endif
     // Mark task as ready, not active
     active_task->state = TASK_READY;
     // Trigger a system context switch switch by setting pendsv bit
     set_pendsv();
 }
 
+/**
+ * Locks the scheduler. Until the matching call to scheduler_unlock, the
+ * running task will not be preempted by other tasks becoming ready, but
+ * interrupts stay enabled. Calls may be nested. The lock belongs to the
+ * running task, so if it blocks or yields other tasks run as usual, and the
+ * lock applies again once it resumes. Must not be called from an interrupt.
+ */
+void scheduler_lock() {
+    if (!active_task) {
+        return;
+    }
+    // Only the running task changes its own count, so no masking is needed
+    active_task->sched_locks++;
+}
+
+/**
+ * Unlocks the scheduler. Once every scheduler_lock call has been matched,
+ * a preemption deferred while the scheduler was locked is performed.
+ */
+void scheduler_unlock() {
+    uint32_t primask;
+    if (!active_task || active_task->sched_locks == 0) {
+        return;
+    }
+    primask = mask_irq_save();
+    active_task->sched_locks--;
+    if (active_task->sched_locks == 0 && preempt_pending) {
+        preempt_pending = false;
+        task_yield();
+    }
+    unmask_irq_restore(primask);
+}
+
 /**
  * Blocks a task for at least 'delay' milliseconds.
  * Task will transition out of blocked state after 'delay' milliseconds,
@@ -227,13 +355,14 @@ void task_delay(uint32_t delay) {
  */
 void task_destroy(task_handle_t task) {
     task_status_t *tsk = (task_status_t *)task;
+    TRACE_EVENT(TRACE_EV_TASK_DELETE, tsk);
     // Check if the task handle is the active one
     if (tsk == active_task) {
         /**
          * We cannot free this task. Instead, place it in exited task list.
          * idle task will reap resources.
          */
-        exited_tasks = list_append(exited_tasks, tsk, &(tsk->list_state));
+        exited_tasks = list_append(exited_tasks, &(tsk->list_state));
         active_task = NULL;
         // Trigger an SVCall to switch to a new active task (not context switch)
         trigger_svcall();
@@ -244,8 +373,7 @@ void task_destroy(task_handle_t task) {
             blocked_tasks = list_remove(blocked_tasks, &(tsk->list_state));
             break;
         case TASK_READY:
-            ready_tasks[tsk->priority] =
-                list_remove(ready_tasks[tsk->priority], &(tsk->list_state));
+            ready_remove(tsk);
             break;
         case TASK_DELAYED:
             delayed_tasks = list_remove(delayed_tasks, &(tsk->list_state));
@@ -265,6 +393,192 @@ void task_destroy(task_handle_t task) {
  */
 task_handle_t get_active_task() { return (task_handle_t)active_task; }
 
+#if SYS_USE_LATENCY_STATS == LATENCY_STATS_ENABLED
+/**
+ * Gets the wake to run latency statistics of a task
+ * @param task: task to get statistics of
+ * @param latency: set to the task's latency statistics
+ * @return SYS_OK on success, ERR_BADPARAM on invalid parameters, or
+ * ERR_NOSUPPORT if latency statistics are disabled
+ */
+syserr_t task_get_latency(task_handle_t task, task_latency_t *latency) {
+    if (task == NULL || latency == NULL) {
+        return ERR_BADPARAM;
+    }
+    // Mask interrupts so the scheduler cannot update the statistics mid copy
+    mask_irq();
+    *latency = ((task_status_t *)task)->latency;
+    unmask_irq();
+    return SYS_OK;
+}
+
+/**
+ * Clears the wake to run latency statistics of a task
+ * @param task: task to clear statistics of
+ */
+void task_reset_latency(task_handle_t task) {
+    if (task == NULL) {
+        return;
+    }
+    mask_irq();
+    memset(&((task_status_t *)task)->latency, 0, sizeof(task_latency_t));
+    unmask_irq();
+}
+#else
+/** Statistics are disabled, so define functions as stubs */
+syserr_t task_get_latency(task_handle_t task, task_latency_t *latency) {
+    (void)task;
+    (void)latency;
+    return ERR_NOSUPPORT;
+}
+
+void task_reset_latency(task_handle_t task) { (void)task; }
+#endif
+
+#if SYS_USE_EDF == EDF_ENABLED
+/**
+ * Releases a new job of the running task, with a deadline relative to now.
+ * The task joins the earliest deadline first class (priority
+ * SYS_EDF_PRIORITY) if it is not already in it, and is then scheduled by
+ * its absolute deadline. If the previous job was never completed and its
+ * deadline has passed, it is counted as a deadline miss.
+ * @param deadline: relative deadline of the job in ms. Must be nonzero, and
+ * under 2^31 system ticks, since deadlines are compared across tick wrap.
+ * @return SYS_OK on success, ERR_BADPARAM on invalid parameters, or
+ * ERR_NOSUPPORT if EDF scheduling is disabled
+ */
+syserr_t task_edf_release(uint32_t deadline) {
+    uint32_t primask;
+    // Convert in 64 bits, so long deadlines cannot wrap to near ones
+    uint64_t ticks = (uint64_t)deadline * SYSTICK_FREQ / 1000;
+    if (!active_task || ticks == 0 || ticks > INT32_MAX) {
+        return ERR_BADPARAM;
+    }
+    primask = mask_irq_save();
+    if (active_task->job_open &&
+        (int32_t)(system_ticks - active_task->deadline) > 0) {
+        active_task->deadline_misses++;
+    }
+    // The running task is in no ready list, so its priority can change
+    active_task->priority = SYS_EDF_PRIORITY;
+    if (active_task->threshold < SYS_EDF_PRIORITY) {
+        active_task->threshold = SYS_EDF_PRIORITY;
+    }
+    active_task->deadline = system_ticks + (uint32_t)ticks;
+    active_task->job_open = true;
+#if SYS_USE_PREEMPTION == PREEMPTION_ENABLED
+    // Another task may now be due first
+    if (ready_preempts_active()) {
+        preempt_active_task();
+    }
+#endif
+    unmask_irq_restore(primask);
+    return SYS_OK;
+}
+
+/**
+ * Completes the running task's current job. If it completed after its
+ * deadline, it is counted as a deadline miss. The task keeps its deadline
+ * until its next release.
+ */
+void task_edf_complete() {
+    if (!active_task || !active_task->job_open) {
+        return;
+    }
+    if ((int32_t)(system_ticks - active_task->deadline) > 0) {
+        active_task->deadline_misses++;
+    }
+    active_task->job_open = false;
+}
+
+/**
+ * Gets the number of deadline misses of a task
+ * @param task: task to get deadline misses of
+ * @param misses: set to the number of jobs that missed their deadline
+ * @return SYS_OK on success, ERR_BADPARAM on invalid parameters, or
+ * ERR_NOSUPPORT if EDF scheduling is disabled
+ */
+syserr_t task_get_deadline_misses(task_handle_t task, uint32_t *misses) {
+    if (task == NULL || misses == NULL) {
+        return ERR_BADPARAM;
+    }
+    *misses = ((task_status_t *)task)->deadline_misses;
+    return SYS_OK;
+}
+
+/**
+ * Orders EDF tasks by absolute deadline, allowing for tick count wrap
+ * @param a: heap node of first task
+ * @param b: heap node of second task
+ * @return true if a's deadline is before b's
+ */
+static bool edf_earlier(heap_node_t *a, heap_node_t *b) {
+    return (int32_t)(HEAP_ENTRY(a, task_status_t, edf_node)->deadline -
+                     HEAP_ENTRY(b, task_status_t, edf_node)->deadline) < 0;
+}
+#else
+/** EDF scheduling is disabled, so define functions as stubs */
+syserr_t task_edf_release(uint32_t deadline) {
+    (void)deadline;
+    return ERR_NOSUPPORT;
+}
+
+void task_edf_complete() {}
+
+syserr_t task_get_deadline_misses(task_handle_t task, uint32_t *misses) {
+    (void)task;
+    (void)misses;
+    return ERR_NOSUPPORT;
+}
+#endif
+
+/**
+ * Estimates a latency percentile from a latency histogram. The estimate is
+ * the upper bound of the bucket holding the percentile, so it is at most
+ * twice the true value, and never more than the maximum latency.
+ * @param latency: latency statistics from task_get_latency
+ * @param percentile: percentile to estimate, from 0 to 100
+ * @return latency percentile in cycles, or 0 if no latencies were measured
+ */
+uint32_t task_latency_percentile(const task_latency_t *latency,
+                                 uint32_t percentile) {
+    uint32_t rank, seen = 0, bound;
+    int i;
+    if (latency == NULL || latency->count == 0) {
+        return 0;
+    }
+    if (percentile > 100) {
+        percentile = 100;
+    }
+    // Rank of the percentile latency, rounded up so p100 is the maximum
+    rank = (uint32_t)(((uint64_t)latency->count * percentile + 99) / 100);
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (i = 0; i < TASK_LATENCY_BUCKETS; i++) {
+        seen += latency->buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    bound = i >= TASK_LATENCY_BUCKETS - 1 ? UINT32_MAX : (2UL << i) - 1;
+    return bound < latency->max_cycles ? bound : latency->max_cycles;
+}
+
+/**
+ * Gets the number of system ticks since the RTOS started. Ticks occur at
+ * SYSTICK_FREQ, and the count wraps after 2^32 ticks.
+ * @return system tick count
+ */
+uint32_t get_system_ticks() { return system_ticks; }
+
+/**
+ * Gets the number of context switches since the RTOS started. The count
+ * wraps after 2^32 switches.
+ * @return context switch count
+ */
+uint32_t get_context_switches() { return context_switches; }
+
 /**
  * Returns if the RTOS has started.
  * @return boolean indicating RTOS status
@@ -299,6 +613,7 @@ void block_active_task(block_reason_t reason) {
  */
 void unblock_task(task_handle_t task, block_reason_t reason) {
     task_status_t *tsk = (task_status_t *)task;
+    uint32_t primask;
     // Check paramters
     if (task == NULL) {
         return;
@@ -309,20 +624,20 @@ void unblock_task(task_handle_t task, block_reason_t reason) {
     if (tsk->state != TASK_BLOCKED || tsk->blockstate != reason) {
         return;
     }
-    // Disable interrupts
-    mask_irq();
+    // Disable interrupts. Callers may already have them disabled
+    primask = mask_irq_save();
     blocked_tasks = list_remove(blocked_tasks, &(tsk->list_state));
     // Mark task as ready
     mark_task_ready(tsk);
 #if SYS_USE_PREEMPTION == PREEMPTION_ENABLED
-    // Check to see if this task is higher priority than the active one.
-    if (tsk->priority > active_task->priority) {
+    // Check to see if this task should preempt the active one.
+    if (preempts_active(tsk)) {
         // Force a context switch
-        task_yield();
+        preempt_active_task();
     }
 #endif
-    // Unmask interrupts
-    unmask_irq();
+    // Restore interrupt mask
+    unmask_irq_restore(primask);
 }
 
 /**
@@ -332,25 +647,26 @@ void unblock_task(task_handle_t task, block_reason_t reason) {
  */
 void unblock_delayed_task(task_handle_t task) {
     task_status_t *tsk = (task_status_t *)task;
+    uint32_t primask;
     // Check parameters
     if (tsk == NULL) {
         return;
     }
-    // Mask interrupts here
-    mask_irq();
+    // Mask interrupts here. Callers may already have them disabled
+    primask = mask_irq_save();
     // Remove list from delayed list
     delayed_tasks = list_remove(delayed_tasks, &(tsk->list_state));
     // Mark task as ready
     mark_task_ready(tsk);
 #if SYS_USE_PREEMPTION == PREEMPTION_ENABLED
-    // Check to see if this task is higher priority than the active one.
-    if (tsk->priority > active_task->priority) {
+    // Check to see if this task should preempt the active one.
+    if (preempts_active(tsk)) {
         // Force a context switch
-        task_yield();
+        preempt_active_task();
     }
 #endif
-    // Unmask interrupts
-    unmask_irq();
+    // Restore interrupt mask
+    unmask_irq_restore(primask);
 }
 
 /**
@@ -442,25 +758,26 @@ __attribute__((naked)) void PendSVHandler() {
  * Handler mode, as the PendSV isr
  */
 void SysTickHandler() {
+    list_state_t *pos, *next;
+    task_status_t *task;
+    system_ticks++;
     /**
-     * Use list filter to decrement task delay counts, and if task delay is
-     * zero, remove the delayed task from the delayed_task lists, and mark it
-     * as ready and move it to the ready list.
-     * We accomplish this by using the "destructor" function of list_filter
-     * to instead copy the task to the ready list
+     * Decrement task delay counts, and if task delay is zero, remove the
+     * delayed task from the delayed_task list and move it to the ready list.
+     * The loop runs inline, so expiring tasks cost no extra stack.
      */
-    delayed_tasks =
-        list_filter(delayed_tasks, decrement_task_delay, mark_task_ready);
+    LIST_FOR_EACH_SAFE(delayed_tasks, pos, next) {
+        task = LIST_ENTRY(pos, task_status_t, list_state);
+        if (--task->blockstate == 0) {
+            delayed_tasks = list_remove(delayed_tasks, pos);
+            mark_task_ready(task);
+        }
+    }
 #if SYS_USE_PREEMPTION == PREEMPTION_ENABLED
-    /** Check if preemption should occur **/
-    int i = RTOS_PRIORITY_COUNT - 1;
-    // Check to see if a higher priority task is ready
-    while (ready_tasks[i] == NULL && i > active_task->priority) {
-        i--;
-    }
-    if (i > active_task->priority) {
-        // A higher priority task is ready. Run it.
-        task_yield();
+    // Check to see if a task that should preempt the active one is ready
+    if (ready_preempts_active()) {
+        // A higher priority or earlier deadline task is ready. Run it.
+        preempt_active_task();
     }
 #endif
 }
@@ -475,16 +792,9 @@ void SysTickHandler() {
 void select_active_task() {
     int i;
     task_status_t *new_active;
-    /**
-     * Examine task lists to find the highest priority list with tasks ready
-     * to run
-     */
-    for (i = RTOS_PRIORITY_COUNT - 1; i > 0; i--) {
-        // If task list has tasks, break
-        if (ready_tasks[i] != NULL)
-            break;
-    }
-    if (ready_tasks[i] == NULL) {
+    // Find the highest priority list with tasks ready to run
+    i = highest_ready_priority();
+    if (i < 0) {
         /**
          * There is only one task (idle task). It should be active task, so just
          * leave it running
@@ -492,30 +802,41 @@ void select_active_task() {
         return;
     }
     // Select the head of this ready task list
-    new_active = list_get_head(ready_tasks[i]);
-    ready_tasks[i] = list_remove(ready_tasks[i], &(new_active->list_state));
+    new_active = list_get_head(ready_tasks[i], task_status_t, list_state);
+#if SYS_USE_EDF == EDF_ENABLED
+    if (i == SYS_EDF_PRIORITY) {
+        // Select the task with the earliest deadline instead
+        new_active = HEAP_ENTRY(heap_peek(&edf_ready), task_status_t, edf_node);
+    }
+#endif
+    ready_remove(new_active);
     if (active_task != NULL) { // active task will be null on scheduler start
         /**
          * Based on the block state of the active task, store it in the blocked,
          * delayed, or ready list
          */
         if (active_task->state == TASK_BLOCKED) {
-            blocked_tasks = list_append(blocked_tasks, active_task,
-                                        &(active_task->list_state));
+            blocked_tasks =
+                list_append(blocked_tasks, &(active_task->list_state));
         } else if (active_task->state == TASK_DELAYED) {
             // Append task to delayed list
-            delayed_tasks = list_append(delayed_tasks, active_task,
-                                        &(active_task->list_state));
+            delayed_tasks =
+                list_append(delayed_tasks, &(active_task->list_state));
         } else {
             // Append active task to appropriate ready list
-            ready_tasks[active_task->priority] =
-                list_append(ready_tasks[active_task->priority], active_task,
-                            &(active_task->list_state));
+            ready_append(active_task);
         }
     }
+    // The new active task is the highest priority one, so nothing is deferred
+    preempt_pending = false;
     // Change the active task
+    context_switches++;
     active_task = new_active;
     active_task->state = TASK_ACTIVE;
+#if SYS_USE_LATENCY_STATS == LATENCY_STATS_ENABLED
+    record_latency(active_task);
+#endif
+    TRACE_EVENT(TRACE_EV_SWITCH, active_task);
 }
 
 /**
@@ -600,6 +921,8 @@ static void task_exithandler() {
  * @param arg: unused.
  */
 static void idle_entry(void *arg) {
+    list_state_t *pos, *next;
+    task_status_t *task;
     int i;
     /* Idle task should never exit */
     while (1) {
@@ -607,7 +930,11 @@ static void idle_entry(void *arg) {
          * Reap resources of exited tasks
          */
         mask_irq();
-        exited_tasks = list_filter(exited_tasks, delete_list, free_task);
+        while ((task = list_get_head(exited_tasks, task_status_t,
+                                      list_state)) != NULL) {
+            exited_tasks = list_remove(exited_tasks, &(task->list_state));
+            free_task(task);
+        }
         unmask_irq();
         /**
          * Check all task lists, and see if any are breaking stack boundaries
@@ -615,10 +942,19 @@ static void idle_entry(void *arg) {
         for (i = 0; i < RTOS_PRIORITY_COUNT; i++) {
             // Check each ready task list for overflowed tasks
             mask_irq();
-            ready_tasks[i] =
-                list_filter(ready_tasks[i], check_stack, free_task);
+            LIST_FOR_EACH_SAFE(ready_tasks[i], pos, next) {
+                task = LIST_ENTRY(pos, task_status_t, list_state);
+                if (!check_stack(task)) {
+                    ready_remove(task);
+                    free_task(task);
+                }
+            }
             unmask_irq();
         }
+        // Run background work registered by drivers
+        if (idle_hook) {
+            idle_hook(idle_hook_arg);
+        }
         // Flush logging output
         fsync(STDOUT_FILENO);
         // Wait for an interrupt to fire
@@ -628,25 +964,12 @@ static void idle_entry(void *arg) {
     }
 }
 
-/**
- * Used by the system tick handler to decrement task delay counts,
- * and remove any tasks that are ready to run
- * @param taskptr: pointer to the task
- * @return LST_REM if the task is ready, or LST_CONT otherwise
- */
-static inline list_return_t decrement_task_delay(void *taskptr) {
-    task_status_t *task = (task_status_t *)taskptr;
-    task->blockstate--;
-    return task->blockstate == 0 ? LST_REM : LST_CONT;
-}
-
 /**
  * Checks stack boundaries of a task
- * @param taskptr: Task to check stack boundaries of
- * @return LST_REM if task overflowed stack, or LST_CONT if all is well
+ * @param task: Task to check stack boundaries of
+ * @return false if task overflowed stack, or true if all is well
  */
-static inline list_return_t check_stack(void *taskptr) {
-    task_status_t *task = (task_status_t *)taskptr;
+static inline bool check_stack(task_status_t *task) {
     if (task->stack_ptr < (uint32_t*)task->stack_softend) {
         // Log error to warn user that task overflowed stack.
         LOG_MIN(SYSLOG_LEVEL_ERROR, TAG, "Task overflowed boundaries!!");
@@ -656,12 +979,36 @@ static inline list_return_t check_stack(void *taskptr) {
             write(STDOUT_FILENO, task->name, strlen(task->name));
             write(STDOUT_FILENO, "\n", 1);
         }
-        return LST_REM;
+        return false;
     } else {
-        return LST_CONT; // All is well.
+        return true; // All is well.
     }
 }
 
+#if SYS_USE_LATENCY_STATS == LATENCY_STATS_ENABLED
+/**
+ * Records the wake to run latency of a task the scheduler switched to, if
+ * it was made ready since it last ran. Called with interrupts masked.
+ * @param task: task being switched to
+ */
+static inline void record_latency(task_status_t *task) {
+    uint32_t cycles, bucket;
+    if (!task->woken) {
+        // Task was preempted or yielded, rather than woken
+        return;
+    }
+    task->woken = false;
+    cycles = DWT->CYCCNT - task->ready_cycles;
+    // Bucket is the index of the highest set bit
+    bucket = cycles > 1 ? 31 - __builtin_clz(cycles) : 0;
+    task->latency.buckets[bucket]++;
+    task->latency.count++;
+    if (cycles > task->latency.max_cycles) {
+        task->latency.max_cycles = cycles;
+    }
+}
+#endif
+
 /**
  * Marks a task as ready, and moves it to the correct ready list. Task MUST not
  * be in another list
@@ -672,20 +1019,115 @@ static inline void mark_task_ready(void *taskptr) {
     // Update task state
     task->state = TASK_READY;
     task->blockstate = BLOCK_NONE;
+#if SYS_USE_LATENCY_STATS == LATENCY_STATS_ENABLED
+    // Tasks made ready before the scheduler starts are not timed
+    if (active_task != NULL) {
+        task->woken = true;
+        task->ready_cycles = DWT->CYCCNT;
+    }
+#endif
     // Add task to correct ready list
+    ready_append(task);
+}
+
+/**
+ * Appends a task to the ready list for its priority
+ * @param task: task to append. Must not be in another list
+ */
+static inline void ready_append(task_status_t *task) {
     ready_tasks[task->priority] =
-        list_append(ready_tasks[task->priority], task, &(task->list_state));
+        list_append(ready_tasks[task->priority], &(task->list_state));
+    ready_mask |= (1UL << task->priority);
+#if SYS_USE_EDF == EDF_ENABLED
+    // EDF tasks are also kept in deadline order
+    if (task->priority == SYS_EDF_PRIORITY) {
+        heap_insert(&edf_ready, &(task->edf_node));
+    }
+#endif
+}
+
+/**
+ * Removes a task from the ready list for its priority
+ * @param task: task to remove. Must be in its ready list
+ */
+static inline void ready_remove(task_status_t *task) {
+    ready_tasks[task->priority] =
+        list_remove(ready_tasks[task->priority], &(task->list_state));
+    if (ready_tasks[task->priority] == NULL) {
+        ready_mask &= ~(1UL << task->priority);
+    }
+#if SYS_USE_EDF == EDF_ENABLED
+    if (task->priority == SYS_EDF_PRIORITY) {
+        heap_remove(&edf_ready, &(task->edf_node));
+    }
+#endif
+}
+
+/**
+ * Gets the highest priority with tasks ready to run. Compiles to a single
+ * CLZ instruction on the Cortex-M4.
+ * @return highest ready priority, or -1 if no task is ready
+ */
+static inline int highest_ready_priority() {
+    if (ready_mask == 0) {
+        return -1;
+    }
+    return 31 - __builtin_clz(ready_mask);
+}
+
+/**
+ * Checks if a ready task should preempt the running task
+ * @param task: ready task to check
+ * @return true if task has a priority above the running task's preemption
+ * threshold, or is in the EDF class with it and has an earlier deadline
+ */
+static inline bool preempts_active(task_status_t *task) {
+    if (task->priority > active_task->threshold) {
+        return true;
+    }
+#if SYS_USE_EDF == EDF_ENABLED
+    if (task->priority == SYS_EDF_PRIORITY &&
+        active_task->priority == SYS_EDF_PRIORITY &&
+        active_task->threshold == SYS_EDF_PRIORITY) {
+        return edf_earlier(&(task->edf_node), &(active_task->edf_node));
+    }
+#endif
+    return false;
 }
 
 /**
- * Utility function to remove tasks from a list. Unconditionally returns
- * LST_REM
- * @param taskptr: unused
- * @return LST_REM
+ * Checks if any ready task should preempt the running task
+ * @return true if a task with a priority above the running task's
+ * preemption threshold is ready, or an EDF task with an earlier deadline
+ * than the running one
  */
-static inline list_return_t delete_list(void *taskptr) {
-    (void)taskptr; // Prevent unused variable warnings
-    return LST_REM;
+static inline bool ready_preempts_active() {
+    if ((ready_mask >> (active_task->threshold + 1)) != 0) {
+        return true;
+    }
+#if SYS_USE_EDF == EDF_ENABLED
+    if (active_task->priority == SYS_EDF_PRIORITY &&
+        active_task->threshold == SYS_EDF_PRIORITY &&
+        !heap_empty(&edf_ready)) {
+        return preempts_active(
+            HEAP_ENTRY(heap_peek(&edf_ready), task_status_t, edf_node));
+    }
+#endif
+    return false;
+}
+
+/**
+ * Preempts the running task in favour of a higher priority ready task. If
+ * the running task holds the scheduler lock, the preemption is deferred
+ * until it unlocks. Must be called with interrupts disabled, or from an
+ * interrupt.
+ */
+static inline void preempt_active_task() {
+    if (active_task->sched_locks != 0) {
+        preempt_pending = true;
+        return;
+    }
+    task_yield();
 }
 
 /**
@@ -20,6 +20,24 @@
 
 typedef void *task_handle_t;
 
+/** Number of latency histogram buckets, one per power of two cycles */
+#define TASK_LATENCY_BUCKETS 32
+
+/**
+ * Wake to run latency statistics of a task, collected when
+ * SYS_USE_LATENCY_STATS is enabled. Latency is measured in core clock cycles
+ * from when a task is made ready (by a delay expiring, a semaphore post, or
+ * creation) until the scheduler switches to it. Tasks made ready by yielding
+ * or being preempted are not measured.
+ */
+typedef struct {
+    uint32_t count;      /*!< Number of latencies measured */
+    uint32_t max_cycles; /*!< Longest latency */
+    /*! Bucket n counts latencies of 2^n to 2^(n+1) - 1 cycles. Bucket 0 also
+        counts latencies of 0 cycles */
+    uint32_t buckets[TASK_LATENCY_BUCKETS];
+} task_latency_t;
+
 /**
  * Task configuration structure
  */
@@ -28,6 +46,10 @@ typedef struct task_config {
     int task_stacksize; /*!< Desired size of task stack. If stack is provided
                            set this to size of task stack*/
     uint32_t task_priority; /*!< Task priority */
+    /*! Preemption threshold. While the task runs, only tasks with a priority
+        above this can preempt it. Values below task_priority (such as the
+        default, 0) use task_priority */
+    uint32_t task_preempt_threshold;
     const char *task_name;  /*< Optional task name */
 } task_config_t;
 
@@ -45,10 +67,26 @@ task_handle_t task_create(void (*entry)(void *), void *arg, task_config_t *cfg);
 
 /**
  * Yields task execution. This function will stop execution of the current
- * task, and yield execution to the highest priority task able to run
+ * task, and yield execution to the highest priority task able to run. A task
+ * in the EDF class keeps running if its deadline is still the earliest there.
  */
 void task_yield();
 
+/**
+ * Locks the scheduler. Until the matching call to scheduler_unlock, the
+ * running task will not be preempted by other tasks becoming ready, but
+ * interrupts stay enabled. Calls may be nested. The lock belongs to the
+ * running task, so if it blocks or yields other tasks run as usual, and the
+ * lock applies again once it resumes. Must not be called from an interrupt.
+ */
+void scheduler_lock();
+
+/**
+ * Unlocks the scheduler. Once every scheduler_lock call has been matched,
+ * a preemption deferred while the scheduler was locked is performed.
+ */
+void scheduler_unlock();
+
 /**
  * Blocks a task for at least 'delay' milliseconds.
  * Task will transition out of blocked state after 'delay' milliseconds,
@@ -72,13 +110,78 @@ void task_destroy(task_handle_t task);
  */
 void rtos_start();
 
+/**
+ * Sets a function the idle task calls on every pass of its loop, before
+ * waiting for an interrupt. The hook runs on the idle task stack
+ * (IDLE_TASK_STACK_SIZE), and must never block.
+ * @param hook: function to call, or NULL to remove the hook
+ * @param arg: argument passed to hook
+ */
+void task_set_idle_hook(void (*hook)(void *), void *arg);
+
+/**
+ * Gets the wake to run latency statistics of a task
+ * @param task: task to get statistics of
+ * @param latency: set to the task's latency statistics
+ * @return SYS_OK on success, ERR_BADPARAM on invalid parameters, or
+ * ERR_NOSUPPORT if latency statistics are disabled
+ */
+syserr_t task_get_latency(task_handle_t task, task_latency_t *latency);
+
+/**
+ * Clears the wake to run latency statistics of a task
+ * @param task: task to clear statistics of
+ */
+void task_reset_latency(task_handle_t task);
+
+/**
+ * Estimates a latency percentile from a latency histogram. The estimate is
+ * the upper bound of the bucket holding the percentile, so it is at most
+ * twice the true value, and never more than the maximum latency.
+ * @param latency: latency statistics from task_get_latency
+ * @param percentile: percentile to estimate, from 0 to 100
+ * @return latency percentile in cycles, or 0 if no latencies were measured
+ */
+uint32_t task_latency_percentile(const task_latency_t *latency,
+                                 uint32_t percentile);
+
+/**
+ * Releases a new job of the running task, with a deadline relative to now.
+ * The task joins the earliest deadline first class (priority
+ * SYS_EDF_PRIORITY) if it is not already in it, and is then scheduled by
+ * its absolute deadline. If the previous job was never completed and its
+ * deadline has passed, it is counted as a deadline miss.
+ * @param deadline: relative deadline of the job in ms. Must be nonzero, and
+ * under 2^31 system ticks, since deadlines are compared across tick wrap.
+ * @return SYS_OK on success, ERR_BADPARAM on invalid parameters, or
+ * ERR_NOSUPPORT if EDF scheduling is disabled
+ */
+syserr_t task_edf_release(uint32_t deadline);
+
+/**
+ * Completes the running task's current job. If it completed after its
+ * deadline, it is counted as a deadline miss. The task keeps its deadline
+ * until its next release.
+ */
+void task_edf_complete();
+
+/**
+ * Gets the number of deadline misses of a task
+ * @param task: task to get deadline misses of
+ * @param misses: set to the number of jobs that missed their deadline
+ * @return SYS_OK on success, ERR_BADPARAM on invalid parameters, or
+ * ERR_NOSUPPORT if EDF scheduling is disabled
+ */
+syserr_t task_get_deadline_misses(task_handle_t task, uint32_t *misses);
+
 /**
  * Default task configuration
  */
 #define DEFAULT_TASK_CONFIG                                                    \
     {                                                                          \
         .task_stack = NULL, .task_stacksize = DEFAULT_STACKSIZE,               \
-        .task_priority = DEFAULT_PRIORITY, .task_name = ""                     \
+        .task_priority = DEFAULT_PRIORITY, .task_preempt_threshold = 0,        \
+        .task_name = ""                                                        \
     }
 
 /** ------------------------ End user functions ---------------------------- */
@@ -98,6 +201,20 @@ typedef enum block_reason {
  */
 task_handle_t get_active_task();
 
+/**
+ * Gets the number of system ticks since the RTOS started. Ticks occur at
+ * SYSTICK_FREQ, and the count wraps after 2^32 ticks.
+ * @return system tick count
+ */
+uint32_t get_system_ticks();
+
+/**
+ * Gets the number of context switches since the RTOS started. The count
+ * wraps after 2^32 switches.
+ * @return context switch count
+ */
+uint32_t get_context_switches();
+
 /**
  * Blocks the running task, and switches to a new runnable one. This function
  * does not return. Used by system drivers.
@@ -0,0 +1,151 @@
+/**
+ * @file edf_test.c
+ * Tests earliest deadline first scheduling.
+ *
+ * Three EDF tasks release jobs with different deadlines at the same time,
+ * and record the order they run in, which should follow their deadlines
+ * rather than their creation order. A test task then releases its own jobs,
+ * and checks that late completions and jobs released again before
+ * completing are counted as deadline misses.
+ *
+ * Expected output:
+ * Test 1 passed: jobs ran in deadline order
+ * Test 2 passed: late completion counted as a miss
+ * Test 3 passed: completion on time not counted
+ * Test 4 passed: unfinished job counted as a miss on release
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <config.h>
+#include <drivers/clock/clock.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+#include <util/logging/logging.h>
+
+#define NUM_WORKERS 3
+
+static const char *TAG = "edf_test";
+
+// Worker deadlines in ms, in creation order
+static const uint32_t deadlines[NUM_WORKERS] = {30, 10, 20};
+// Worker indices, in the order the workers ran
+static uint32_t order[NUM_WORKERS];
+static volatile uint32_t num_ran = 0;
+static semaphore_t done_sem;
+
+/**
+ * Initializes system clock
+ */
+static void system_init() {
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    clock_init(&clk_cfg);
+}
+
+/**
+ * Spins until a number of system ticks have passed
+ * @param ticks: ticks to wait for
+ */
+static void spin_ticks(uint32_t ticks) {
+    uint32_t start = get_system_ticks();
+    while (get_system_ticks() - start < ticks) {
+    }
+}
+
+/**
+ * Worker task entry point. Releases one job, records when it runs, then
+ * delays forever.
+ * @param arg: worker index
+ */
+static void worker_task(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    task_edf_release(deadlines[index]);
+    order[num_ran++] = index;
+    task_edf_complete();
+    semaphore_post(done_sem);
+    while (1) {
+        task_delay(1000);
+    }
+}
+
+/**
+ * Test task entry point. Runs all tests.
+ * @param arg: unused
+ */
+static void test_task(void *arg) {
+    task_handle_t self = get_active_task();
+    uint32_t i, misses;
+    for (i = 0; i < NUM_WORKERS; i++) {
+        semaphore_pend(done_sem, SYS_TIMEOUT_INF);
+    }
+    if (order[0] == 1 && order[1] == 2 && order[2] == 0) {
+        printf("Test 1 passed: jobs ran in deadline order\n");
+    } else {
+        printf("Test 1 failed: order %lu %lu %lu\n", order[0], order[1],
+               order[2]);
+    }
+    task_edf_release(2);
+    spin_ticks(5);
+    task_edf_complete();
+    task_get_deadline_misses(self, &misses);
+    if (misses == 1) {
+        printf("Test 2 passed: late completion counted as a miss\n");
+    } else {
+        printf("Test 2 failed: %lu misses\n", misses);
+    }
+    task_edf_release(100);
+    task_edf_complete();
+    task_get_deadline_misses(self, &misses);
+    if (misses == 1) {
+        printf("Test 3 passed: completion on time not counted\n");
+    } else {
+        printf("Test 3 failed: %lu misses\n", misses);
+    }
+    task_edf_release(1);
+    spin_ticks(3);
+    task_edf_release(100);
+    task_edf_complete();
+    task_get_deadline_misses(self, &misses);
+    if (misses == 2) {
+        printf("Test 4 passed: unfinished job counted as a miss on "
+               "release\n");
+    } else {
+        printf("Test 4 failed: %lu misses\n", misses);
+    }
+    while (1) {
+        task_delay(1000);
+    }
+}
+
+/**
+ * Testing entry point. Creates the test task, and the workers in the EDF
+ * class, so they run before the test task
+ */
+int main() {
+    task_config_t test_conf = DEFAULT_TASK_CONFIG;
+    task_config_t worker_conf = DEFAULT_TASK_CONFIG;
+    uint32_t i;
+    system_init();
+    done_sem = semaphore_create_counting(0);
+    if (done_sem == NULL) {
+        LOG_E(TAG, "Failed to create semaphore");
+        return ERR_NOMEM;
+    }
+    test_conf.task_name = "Test Task";
+    if (task_create(test_task, NULL, &test_conf) == NULL) {
+        LOG_E(TAG, "Failed to create rtos tasks");
+        return ERR_FAIL;
+    }
+    worker_conf.task_name = "Worker Task";
+    worker_conf.task_priority = SYS_EDF_PRIORITY;
+    for (i = 0; i < NUM_WORKERS; i++) {
+        if (task_create(worker_task, (void *)(uintptr_t)i, &worker_conf) ==
+            NULL) {
+            LOG_E(TAG, "Failed to create rtos tasks");
+            return ERR_FAIL;
+        }
+    }
+    rtos_start();
+    return SYS_OK;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file latency_test.c
+ * Tests per task wake to run latency histograms.
+ *
+ * A high priority task delays for 1ms NUM_WAKEUPS times, so it is woken by
+ * the system tick each time. A low priority task spins meanwhile, so the
+ * latency includes preempting it. The high priority task's histogram is then
+ * printed along with its p50, p99 and maximum latency, and checked.
+ *
+ * Expected output (latencies vary):
+ * Latency over 100 wakeups: p50 511 cycles, p99 700 cycles, max 700 cycles
+ * Bucket 8: 60
+ * Bucket 9: 40
+ * Test 1 passed: every wakeup measured
+ * Test 2 passed: percentiles ordered and bounded by maximum
+ * Test 3 passed: yields not measured
+ * Test 4 passed: latency statistics cleared
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <drivers/clock/clock.h>
+#include <sys/task/task.h>
+#include <util/logging/logging.h>
+
+#define NUM_WAKEUPS 100
+
+static const char *TAG = "latency_test";
+
+/**
+ * Initializes system clock
+ */
+static void system_init() {
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    clock_init(&clk_cfg);
+}
+
+/**
+ * Spinning task entry point. Keeps the CPU busy at low priority.
+ * @param arg: unused
+ */
+static void spin_task(void *arg) {
+    while (1) {
+    }
+}
+
+/**
+ * Test task entry point. Runs all tests.
+ * @param arg: unused
+ */
+static void test_task(void *arg) {
+    task_handle_t self = get_active_task();
+    task_latency_t latency;
+    uint32_t p50, p99;
+    int i;
+    task_reset_latency(self);
+    for (i = 0; i < NUM_WAKEUPS; i++) {
+        task_delay(1);
+    }
+    task_get_latency(self, &latency);
+    p50 = task_latency_percentile(&latency, 50);
+    p99 = task_latency_percentile(&latency, 99);
+    printf("Latency over %lu wakeups: p50 %lu cycles, p99 %lu cycles, "
+           "max %lu cycles\n",
+           latency.count, p50, p99, latency.max_cycles);
+    for (i = 0; i < TASK_LATENCY_BUCKETS; i++) {
+        if (latency.buckets[i] != 0) {
+            printf("Bucket %d: %lu\n", i, latency.buckets[i]);
+        }
+    }
+    if (latency.count == NUM_WAKEUPS) {
+        printf("Test 1 passed: every wakeup measured\n");
+    } else {
+        printf("Test 1 failed: %lu wakeups measured\n", latency.count);
+    }
+    if (p50 <= p99 && p99 <= latency.max_cycles && latency.max_cycles > 0 &&
+        task_latency_percentile(&latency, 100) == latency.max_cycles) {
+        printf("Test 2 passed: percentiles ordered and bounded by maximum\n");
+    } else {
+        printf("Test 2 failed\n");
+    }
+    /* Yielding does not wake the task, so no latency is recorded */
+    for (i = 0; i < 10; i++) {
+        task_yield();
+    }
+    task_get_latency(self, &latency);
+    if (latency.count == NUM_WAKEUPS) {
+        printf("Test 3 passed: yields not measured\n");
+    } else {
+        printf("Test 3 failed: %lu wakeups measured\n", latency.count);
+    }
+    task_reset_latency(self);
+    task_get_latency(self, &latency);
+    if (latency.count == 0 && latency.max_cycles == 0 &&
+        task_latency_percentile(&latency, 50) == 0) {
+        printf("Test 4 passed: latency statistics cleared\n");
+    } else {
+        printf("Test 4 failed\n");
+    }
+    while (1) {
+        task_delay(1000);
+    }
+}
+
+/**
+ * Testing entry point. Creates the test and spinning tasks
+ */
+int main() {
+    task_config_t test_conf = DEFAULT_TASK_CONFIG;
+    task_config_t spin_conf = DEFAULT_TASK_CONFIG;
+    system_init();
+    test_conf.task_name = "Test Task";
+    test_conf.task_priority = DEFAULT_PRIORITY + 1;
+    spin_conf.task_name = "Spin Task";
+    if (task_create(test_task, NULL, &test_conf) == NULL ||
+        task_create(spin_task, NULL, &spin_conf) == NULL) {
+        LOG_E(TAG, "Failed to create rtos tasks");
+        return ERR_FAIL;
+    }
+    rtos_start();
+    return SYS_OK;
+}
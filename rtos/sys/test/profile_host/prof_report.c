@@ -0,0 +1,302 @@
+/**
+ * @file prof_report.c
+ * Symbolizes profiler samples, and writes flat profiles and folded stacks
+ */
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prof_report.h"
+
+/** Name used for samples outside any function */
+#define UNKNOWN_NAME "[unknown]"
+/** Longest context name, such as "task 0x20001000" */
+#define CONTEXT_NAME_MAX 24
+
+/**
+ * Sample count of one function, or one context and function pair
+ */
+typedef struct {
+    char context[CONTEXT_NAME_MAX]; /*!< Context name, or empty */
+    const char *function;           /*!< Function name */
+    uint32_t count;                 /*!< Number of samples */
+} prof_count_t;
+
+static prof_count_t *count_samples(const prof_symtab_t *tab,
+                                   const profile_sample_t *samples,
+                                   uint32_t len, int with_context,
+                                   uint32_t *num_counts);
+static void context_name(uint32_t context, char *name);
+static int compare_symbols(const void *a, const void *b);
+static int compare_keys(const void *a, const void *b);
+static int compare_counts(const void *a, const void *b);
+
+/**
+ * Loads the function symbols of a 32 bit little endian ELF file
+ * @param tab: symbol table to fill
+ * @param elf: ELF file stream
+ * @return 0 on success, or -1 if the file is not a valid ELF file with a
+ * symbol table
+ */
+int prof_symtab_load(prof_symtab_t *tab, FILE *elf) {
+    Elf32_Ehdr *ehdr;
+    Elf32_Shdr *shdrs, *symtab = NULL, *strtab;
+    Elf32_Sym *sym;
+    uint8_t *image = NULL;
+    size_t size = 0, cap = 0, got;
+    uint32_t i, num_syms;
+    memset(tab, 0, sizeof(*tab));
+    // Read the whole file, so sections can be accessed by offset
+    do {
+        if (size == cap) {
+            cap = cap ? cap * 2 : 65536;
+            image = realloc(image, cap);
+            if (image == NULL) {
+                return -1;
+            }
+        }
+        got = fread(image + size, 1, cap - size, elf);
+        size += got;
+    } while (got != 0);
+    ehdr = (Elf32_Ehdr *)image;
+    if (size < sizeof(*ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS32 ||
+        ehdr->e_ident[EI_DATA] != ELFDATA2LSB ||
+        ehdr->e_shentsize != sizeof(Elf32_Shdr) ||
+        ehdr->e_shoff + (uint64_t)ehdr->e_shnum * sizeof(Elf32_Shdr) > size) {
+        free(image);
+        return -1;
+    }
+    shdrs = (Elf32_Shdr *)(image + ehdr->e_shoff);
+    for (i = 0; i < ehdr->e_shnum; i++) {
+        if (shdrs[i].sh_type == SHT_SYMTAB) {
+            symtab = &shdrs[i];
+            break;
+        }
+    }
+    if (symtab == NULL || symtab->sh_link >= ehdr->e_shnum ||
+        symtab->sh_offset + (uint64_t)symtab->sh_size > size) {
+        free(image);
+        return -1;
+    }
+    strtab = &shdrs[symtab->sh_link];
+    // Names are only safe to use if the string table is NULL terminated
+    if (strtab->sh_size == 0 ||
+        strtab->sh_offset + (uint64_t)strtab->sh_size > size ||
+        image[strtab->sh_offset + strtab->sh_size - 1] != '\0') {
+        free(image);
+        return -1;
+    }
+    num_syms = symtab->sh_size / sizeof(Elf32_Sym);
+    tab->syms = malloc((num_syms + 1) * sizeof(prof_symbol_t));
+    if (tab->syms == NULL) {
+        free(image);
+        return -1;
+    }
+    for (i = 0; i < num_syms; i++) {
+        sym = (Elf32_Sym *)(image + symtab->sh_offset) + i;
+        if (ELF32_ST_TYPE(sym->st_info) != STT_FUNC || sym->st_size == 0 ||
+            sym->st_name >= strtab->sh_size) {
+            continue;
+        }
+        tab->syms[tab->count].addr = sym->st_value & ~1UL; // Clear thumb bit
+        tab->syms[tab->count].size = sym->st_size;
+        tab->syms[tab->count].name =
+            (const char *)image + strtab->sh_offset + sym->st_name;
+        tab->count++;
+    }
+    qsort(tab->syms, tab->count, sizeof(prof_symbol_t), compare_symbols);
+    tab->image = image;
+    return 0;
+}
+
+/**
+ * Finds the function containing an address
+ * @param tab: symbol table
+ * @param pc: address to look up
+ * @return function symbol, or NULL if no function contains pc
+ */
+const prof_symbol_t *prof_symtab_lookup(const prof_symtab_t *tab,
+                                        uint32_t pc) {
+    uint32_t low = 0, high = tab->count, mid;
+    // Find the last symbol starting at or before pc
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (tab->syms[mid].addr <= pc) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == 0 || pc - tab->syms[low - 1].addr >= tab->syms[low - 1].size) {
+        return NULL;
+    }
+    return &tab->syms[low - 1];
+}
+
+/**
+ * Frees a symbol table loaded by prof_symtab_load
+ * @param tab: symbol table
+ */
+void prof_symtab_free(prof_symtab_t *tab) {
+    free(tab->syms);
+    free(tab->image);
+    memset(tab, 0, sizeof(*tab));
+}
+
+/**
+ * Writes a flat profile: sample counts per function, most sampled first
+ * @param tab: symbol table
+ * @param samples: profiler samples
+ * @param len: number of samples
+ * @param out: stream to write profile to
+ */
+void prof_report_flat(const prof_symtab_t *tab,
+                      const profile_sample_t *samples, uint32_t len,
+                      FILE *out) {
+    prof_count_t *counts;
+    uint32_t i, num_counts, in_isr = 0;
+    for (i = 0; i < len; i++) {
+        if (PROFILE_SAMPLE_IN_ISR(&samples[i])) {
+            in_isr++;
+        }
+    }
+    fprintf(out, "Samples: %u (%u in interrupts)\n", len, in_isr);
+    counts = count_samples(tab, samples, len, 0, &num_counts);
+    if (counts == NULL) {
+        return;
+    }
+    qsort(counts, num_counts, sizeof(prof_count_t), compare_counts);
+    fprintf(out, "%10s %7s  %s\n", "samples", "%", "function");
+    for (i = 0; i < num_counts; i++) {
+        fprintf(out, "%10u %7.2f  %s\n", counts[i].count,
+                100.0 * counts[i].count / len, counts[i].function);
+    }
+    free(counts);
+}
+
+/**
+ * Writes folded stacks, sorted by context and function
+ * @param tab: symbol table
+ * @param samples: profiler samples
+ * @param len: number of samples
+ * @param out: stream to write folded stacks to
+ */
+void prof_report_folded(const prof_symtab_t *tab,
+                        const profile_sample_t *samples, uint32_t len,
+                        FILE *out) {
+    prof_count_t *counts;
+    uint32_t i, num_counts;
+    counts = count_samples(tab, samples, len, 1, &num_counts);
+    if (counts == NULL) {
+        return;
+    }
+    for (i = 0; i < num_counts; i++) {
+        fprintf(out, "%s;%s %u\n", counts[i].context, counts[i].function,
+                counts[i].count);
+    }
+    free(counts);
+}
+
+/**
+ * Counts samples per function, or per context and function pair
+ * @param tab: symbol table
+ * @param samples: profiler samples
+ * @param len: number of samples
+ * @param with_context: nonzero to count context and function pairs
+ * @param num_counts: set to the number of counts returned
+ * @return counts sorted by context and function, or NULL if there are no
+ * samples or memory runs out. Must be freed by the caller.
+ */
+static prof_count_t *count_samples(const prof_symtab_t *tab,
+                                   const profile_sample_t *samples,
+                                   uint32_t len, int with_context,
+                                   uint32_t *num_counts) {
+    prof_count_t *keys;
+    const prof_symbol_t *sym;
+    uint32_t i, n = 0;
+    *num_counts = 0;
+    if (len == 0) {
+        return NULL;
+    }
+    keys = calloc(len, sizeof(prof_count_t));
+    if (keys == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < len; i++) {
+        sym = prof_symtab_lookup(tab, samples[i].pc);
+        keys[i].function = sym ? sym->name : UNKNOWN_NAME;
+        keys[i].count = 1;
+        if (with_context) {
+            context_name(samples[i].context, keys[i].context);
+        }
+    }
+    // Sort so equal keys are adjacent, then merge them in place
+    qsort(keys, len, sizeof(prof_count_t), compare_keys);
+    for (i = 1; i < len; i++) {
+        if (compare_keys(&keys[n], &keys[i]) == 0) {
+            keys[n].count++;
+        } else {
+            keys[++n] = keys[i];
+        }
+    }
+    *num_counts = n + 1;
+    return keys;
+}
+
+/**
+ * Names the context a sample was taken in
+ * @param context: sample context
+ * @param name: set to context name, at least CONTEXT_NAME_MAX bytes
+ */
+static void context_name(uint32_t context, char *name) {
+    if (context == 0) {
+        // Thread mode before the scheduler started
+        strcpy(name, "main");
+    } else if (context >= PROFILE_CONTEXT_EXCEPTION_MAX) {
+        snprintf(name, CONTEXT_NAME_MAX, "task 0x%08x", context);
+    } else if (context >= 16) {
+        snprintf(name, CONTEXT_NAME_MAX, "IRQ %u", context - 16);
+    } else if (context == 11) {
+        strcpy(name, "SVCall");
+    } else if (context == 14) {
+        strcpy(name, "PendSV");
+    } else if (context == 15) {
+        strcpy(name, "SysTick");
+    } else {
+        snprintf(name, CONTEXT_NAME_MAX, "exception %u", context);
+    }
+}
+
+/**
+ * Orders symbols by address
+ */
+static int compare_symbols(const void *a, const void *b) {
+    const prof_symbol_t *sa = a, *sb = b;
+    if (sa->addr != sb->addr) {
+        return sa->addr < sb->addr ? -1 : 1;
+    }
+    return strcmp(sa->name, sb->name);
+}
+
+/**
+ * Orders counts by context, then function name
+ */
+static int compare_keys(const void *a, const void *b) {
+    const prof_count_t *ca = a, *cb = b;
+    int ret = strcmp(ca->context, cb->context);
+    return ret != 0 ? ret : strcmp(ca->function, cb->function);
+}
+
+/**
+ * Orders counts by sample count, highest first, then function name
+ */
+static int compare_counts(const void *a, const void *b) {
+    const prof_count_t *ca = a, *cb = b;
+    if (ca->count != cb->count) {
+        return ca->count > cb->count ? -1 : 1;
+    }
+    return strcmp(ca->function, cb->function);
+}
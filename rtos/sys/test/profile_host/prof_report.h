@@ -0,0 +1,83 @@
+/**
+ * @file prof_report.h
+ * Symbolizes profiler samples against a 32 bit ARM ELF file, and writes
+ * flat profiles and folded stacks.
+ *
+ * Folded stacks have one line per distinct context and function, in the
+ * form "context;function count", which flamegraph.pl and speedscope accept.
+ * The profiler records only the interrupted program counter, so each stack
+ * is the sampled context (task or interrupt) and the function it was in.
+ */
+#ifndef PROF_REPORT_H
+#define PROF_REPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sys/profile/profile.h>
+
+/**
+ * Function symbol
+ */
+typedef struct {
+    uint32_t addr;    /*!< Start address, with the thumb bit cleared */
+    uint32_t size;    /*!< Size in bytes */
+    const char *name; /*!< Symbol name */
+} prof_symbol_t;
+
+/**
+ * Function symbol table, sorted by address
+ */
+typedef struct {
+    prof_symbol_t *syms; /*!< Symbols */
+    uint32_t count;      /*!< Number of symbols */
+    uint8_t *image;      /*!< ELF file contents, which hold symbol names */
+} prof_symtab_t;
+
+/**
+ * Loads the function symbols of a 32 bit little endian ELF file
+ * @param tab: symbol table to fill
+ * @param elf: ELF file stream
+ * @return 0 on success, or -1 if the file is not a valid ELF file with a
+ * symbol table
+ */
+int prof_symtab_load(prof_symtab_t *tab, FILE *elf);
+
+/**
+ * Finds the function containing an address
+ * @param tab: symbol table
+ * @param pc: address to look up
+ * @return function symbol, or NULL if no function contains pc
+ */
+const prof_symbol_t *prof_symtab_lookup(const prof_symtab_t *tab,
+                                        uint32_t pc);
+
+/**
+ * Frees a symbol table loaded by prof_symtab_load
+ * @param tab: symbol table
+ */
+void prof_symtab_free(prof_symtab_t *tab);
+
+/**
+ * Writes a flat profile: sample counts per function, most sampled first
+ * @param tab: symbol table
+ * @param samples: profiler samples
+ * @param len: number of samples
+ * @param out: stream to write profile to
+ */
+void prof_report_flat(const prof_symtab_t *tab,
+                      const profile_sample_t *samples, uint32_t len,
+                      FILE *out);
+
+/**
+ * Writes folded stacks, sorted by context and function
+ * @param tab: symbol table
+ * @param samples: profiler samples
+ * @param len: number of samples
+ * @param out: stream to write folded stacks to
+ */
+void prof_report_folded(const prof_symtab_t *tab,
+                        const profile_sample_t *samples, uint32_t len,
+                        FILE *out);
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @file prof_report_test.c
+ * Tests symbolizing profiler samples, using a minimal ELF file with a symbol
+ * table written by the test. Built and run on the host, see Makefile.
+ *
+ * Expected output:
+ * Test 1 passed: function symbols loaded
+ * Test 2 passed: addresses resolved to functions
+ * Test 3 passed: flat profile sorted by samples
+ * Test 4 passed: interrupt samples counted
+ * Test 5 passed: folded stacks grouped by context
+ * Test 6 passed: invalid ELF file rejected
+ */
+
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prof_report.h"
+
+#define TASK_A 0x20001000UL
+#define TASK_B 0x20002000UL
+#define UART_IRQ 38
+
+/** Symbol names, at the offsets used by write_elf */
+static const char strings[] = "\0main\0task_loop\0uart_isr\0buffer\0empty";
+
+/**
+ * Writes a minimal ELF file holding only a symbol table
+ * @param out: stream to write to
+ */
+static void write_elf(FILE *out) {
+    Elf32_Ehdr ehdr;
+    Elf32_Shdr shdrs[3];
+    Elf32_Sym syms[] = {
+        { 0 },
+        // Thumb functions have the low address bit set
+        { .st_name = 1, .st_value = 0x08000101, .st_size = 0x40,
+          .st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC) },
+        { .st_name = 6, .st_value = 0x08000201, .st_size = 0x80,
+          .st_info = ELF32_ST_INFO(STB_LOCAL, STT_FUNC) },
+        { .st_name = 16, .st_value = 0x08000301, .st_size = 0x20,
+          .st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC) },
+        // Data and zero sized symbols are not functions that can be sampled
+        { .st_name = 25, .st_value = 0x20000000, .st_size = 0x100,
+          .st_info = ELF32_ST_INFO(STB_GLOBAL, STT_OBJECT) },
+        { .st_name = 32, .st_value = 0x08000400, .st_size = 0,
+          .st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC) },
+    };
+    memset(&ehdr, 0, sizeof(ehdr));
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS32;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_type = ET_EXEC;
+    ehdr.e_machine = EM_ARM;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_ehsize = sizeof(ehdr);
+    ehdr.e_shentsize = sizeof(Elf32_Shdr);
+    ehdr.e_shnum = 3;
+    ehdr.e_shoff = sizeof(ehdr) + sizeof(syms) + sizeof(strings);
+    memset(shdrs, 0, sizeof(shdrs));
+    shdrs[1].sh_type = SHT_SYMTAB;
+    shdrs[1].sh_offset = sizeof(ehdr);
+    shdrs[1].sh_size = sizeof(syms);
+    shdrs[1].sh_link = 2;
+    shdrs[1].sh_entsize = sizeof(Elf32_Sym);
+    shdrs[2].sh_type = SHT_STRTAB;
+    shdrs[2].sh_offset = sizeof(ehdr) + sizeof(syms);
+    shdrs[2].sh_size = sizeof(strings);
+    fwrite(&ehdr, sizeof(ehdr), 1, out);
+    fwrite(syms, sizeof(syms), 1, out);
+    fwrite(strings, sizeof(strings), 1, out);
+    fwrite(shdrs, sizeof(shdrs), 1, out);
+}
+
+int main() {
+    prof_symtab_t tab;
+    profile_sample_t samples[] = {
+        { 0x08000210, TASK_A }, { 0x08000220, TASK_A },
+        { 0x08000230, TASK_A }, { 0x08000200, TASK_A },
+        { 0x0800027E, TASK_A }, { 0x08000250, TASK_B },
+        { 0x08000100, 0 },      { 0x08000120, 0 },
+        { 0x0800013E, 0 },      { 0x08000300, UART_IRQ + 16 },
+        { 0x08000310, UART_IRQ + 16 }, { 0x08001000, TASK_B },
+    };
+    uint32_t len = sizeof(samples) / sizeof(samples[0]);
+    const prof_symbol_t *sym;
+    char *report, *folded;
+    size_t report_len, folded_len;
+    int failures = 0;
+    FILE *f;
+    f = tmpfile();
+    write_elf(f);
+    rewind(f);
+    if (prof_symtab_load(&tab, f) == 0 && tab.count == 3 &&
+        tab.syms[0].addr == 0x08000100 &&
+        strcmp(tab.syms[2].name, "uart_isr") == 0) {
+        printf("Test 1 passed: function symbols loaded\n");
+    } else {
+        printf("Test 1 failed: %u symbols\n", tab.count);
+        return EXIT_FAILURE;
+    }
+    fclose(f);
+    sym = prof_symtab_lookup(&tab, 0x0800013F);
+    if (sym && strcmp(sym->name, "main") == 0 &&
+        prof_symtab_lookup(&tab, 0x08000140) == NULL &&
+        prof_symtab_lookup(&tab, 0x080000FF) == NULL &&
+        prof_symtab_lookup(&tab, 0x0800031F) == &tab.syms[2]) {
+        printf("Test 2 passed: addresses resolved to functions\n");
+    } else {
+        printf("Test 2 failed\n");
+        failures++;
+    }
+    f = open_memstream(&report, &report_len);
+    prof_report_flat(&tab, samples, len, f);
+    fclose(f);
+    if (strstr(report, "         6   50.00  task_loop\n"
+                       "         3   25.00  main\n"
+                       "         2   16.67  uart_isr\n"
+                       "         1    8.33  [unknown]\n")) {
+        printf("Test 3 passed: flat profile sorted by samples\n");
+    } else {
+        printf("Test 3 failed:\n%s", report);
+        failures++;
+    }
+    if (strncmp(report, "Samples: 12 (2 in interrupts)\n", 30) == 0) {
+        printf("Test 4 passed: interrupt samples counted\n");
+    } else {
+        printf("Test 4 failed\n");
+        failures++;
+    }
+    f = open_memstream(&folded, &folded_len);
+    prof_report_folded(&tab, samples, len, f);
+    fclose(f);
+    if (strcmp(folded, "IRQ 38;uart_isr 2\n"
+                       "main;main 3\n"
+                       "task 0x20001000;task_loop 5\n"
+                       "task 0x20002000;[unknown] 1\n"
+                       "task 0x20002000;task_loop 1\n") == 0) {
+        printf("Test 5 passed: folded stacks grouped by context\n");
+    } else {
+        printf("Test 5 failed:\n%s", folded);
+        failures++;
+    }
+    prof_symtab_free(&tab);
+    // A 64 bit ELF header is not a target image
+    f = tmpfile();
+    write_elf(f);
+    fseek(f, EI_CLASS, SEEK_SET);
+    fputc(ELFCLASS64, f);
+    rewind(f);
+    if (prof_symtab_load(&tab, f) != 0) {
+        printf("Test 6 passed: invalid ELF file rejected\n");
+    } else {
+        printf("Test 6 failed\n");
+        prof_symtab_free(&tab);
+        failures++;
+    }
+    fclose(f);
+    free(report);
+    free(folded);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
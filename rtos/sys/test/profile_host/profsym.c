@@ -0,0 +1,87 @@
+/**
+ * @file profsym.c
+ * Symbolizes a captured profiler sample stream against the application ELF
+ * file, and prints a flat profile or folded stacks.
+ *
+ * Usage: profsym [-g] app.elf samples.bin
+ *
+ * samples.bin holds the raw samples as streamed by profile_stream_swo (ITM
+ * stimulus port 2, with ITM framing removed) or as read by profile_read and
+ * sent over a UART. A flat profile is printed by default. With -g, folded
+ * stacks are printed instead, which can be rendered as a flame graph:
+ *   profsym -g app.elf samples.bin | flamegraph.pl > profile.svg
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prof_report.h"
+
+#define SAMPLE_BYTES 8
+
+/**
+ * Decodes a little endian 32 bit word
+ * @param buf: word bytes
+ * @return word value
+ */
+static uint32_t get_le32(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+int main(int argc, char **argv) {
+    prof_symtab_t tab;
+    FILE *elf, *in;
+    uint8_t raw[SAMPLE_BYTES];
+    profile_sample_t *samples = NULL;
+    uint32_t len = 0, cap = 0;
+    int folded = 0, arg = 1;
+    if (argc > 1 && strcmp(argv[1], "-g") == 0) {
+        folded = 1;
+        arg = 2;
+    }
+    if (arg + 2 != argc) {
+        fprintf(stderr, "Usage: %s [-g] app.elf samples.bin\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    elf = fopen(argv[arg], "rb");
+    if (elf == NULL) {
+        perror(argv[arg]);
+        return EXIT_FAILURE;
+    }
+    if (prof_symtab_load(&tab, elf) != 0) {
+        fprintf(stderr, "%s: not a 32 bit ELF file with symbols\n",
+                argv[arg]);
+        fclose(elf);
+        return EXIT_FAILURE;
+    }
+    fclose(elf);
+    in = fopen(argv[arg + 1], "rb");
+    if (in == NULL) {
+        perror(argv[arg + 1]);
+        prof_symtab_free(&tab);
+        return EXIT_FAILURE;
+    }
+    while (fread(raw, 1, SAMPLE_BYTES, in) == SAMPLE_BYTES) {
+        if (len == cap) {
+            cap = cap ? cap * 2 : 1024;
+            samples = realloc(samples, cap * sizeof(profile_sample_t));
+            if (samples == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                return EXIT_FAILURE;
+            }
+        }
+        samples[len].pc = get_le32(raw);
+        samples[len].context = get_le32(raw + 4);
+        len++;
+    }
+    fclose(in);
+    if (folded) {
+        prof_report_folded(&tab, samples, len, stdout);
+    } else {
+        prof_report_flat(&tab, samples, len, stdout);
+    }
+    free(samples);
+    prof_symtab_free(&tab);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file sched_lock_test.c
+ * Tests the scheduler lock and nestable interrupt masking.
+ *
+ * A test task wakes a higher priority task while holding the scheduler
+ * lock, and checks that the woken task only runs once the lock is fully
+ * released. It also checks that the system tick keeps running while the
+ * scheduler is locked, and that nested mask_irq_save calls only reenable
+ * interrupts when the outermost call is restored.
+ *
+ * Expected output:
+ * Test 1 passed: preemption deferred while locked
+ * Test 2 passed: preemption deferred until outermost unlock
+ * Test 3 passed: deferred preemption performed on unlock
+ * Test 4 passed: interrupts stayed enabled while locked
+ * Test 5 passed: nested interrupt masking restored correctly
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <drivers/clock/clock.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+#include <util/logging/logging.h>
+
+// Spin iterations to wait for ticks before giving up, well over 5 ticks
+#define TICK_SPIN_LIMIT 10000000UL
+
+static const char *TAG = "sched_lock_test";
+
+static semaphore_t wake_sem;
+static volatile uint32_t high_runs = 0;
+
+/**
+ * Initializes system clock
+ */
+static void system_init() {
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    clock_init(&clk_cfg);
+}
+
+/**
+ * High priority task entry point. Counts each time it is woken.
+ * @param arg: unused
+ */
+static void high_task(void *arg) {
+    while (1) {
+        semaphore_pend(wake_sem, SYS_TIMEOUT_INF);
+        high_runs++;
+    }
+}
+
+/**
+ * Test task entry point. Runs all tests.
+ * @param arg: unused
+ */
+static void test_task(void *arg) {
+    uint32_t ticks, elapsed, primask, outer, inner, check, i;
+    // The high priority task ran first, and is blocked on the semaphore
+    scheduler_lock();
+    semaphore_post(wake_sem);
+    if (high_runs == 0) {
+        printf("Test 1 passed: preemption deferred while locked\n");
+    } else {
+        printf("Test 1 failed\n");
+    }
+    scheduler_lock();
+    scheduler_unlock();
+    if (high_runs == 0) {
+        printf("Test 2 passed: preemption deferred until outermost unlock\n");
+    } else {
+        printf("Test 2 failed\n");
+    }
+    // Interrupts must stay enabled, and ticks advance, while locked
+    asm volatile("mrs %0, PRIMASK\n" : "=r"(primask));
+    ticks = get_system_ticks();
+    for (i = 0; i < TICK_SPIN_LIMIT; i++) {
+        if (get_system_ticks() - ticks >= 5) {
+            break;
+        }
+    }
+    elapsed = get_system_ticks() - ticks;
+    scheduler_unlock();
+    if (high_runs == 1) {
+        printf("Test 3 passed: deferred preemption performed on unlock\n");
+    } else {
+        printf("Test 3 failed: high priority task ran %lu times\n",
+               high_runs);
+    }
+    if (primask == 0 && elapsed >= 5) {
+        printf("Test 4 passed: interrupts stayed enabled while locked\n");
+    } else {
+        printf("Test 4 failed: PRIMASK %lu, %lu ticks while locked\n",
+               primask, elapsed);
+    }
+    outer = mask_irq_save();
+    inner = mask_irq_save();
+    unmask_irq_restore(inner);
+    // Interrupts must still be masked after the inner restore
+    check = mask_irq_save();
+    unmask_irq_restore(check);
+    unmask_irq_restore(outer);
+    if (outer == 0 && inner == 1 && check == 1) {
+        printf("Test 5 passed: nested interrupt masking restored "
+               "correctly\n");
+    } else {
+        printf("Test 5 failed\n");
+    }
+    while (1) {
+        task_delay(1000);
+    }
+}
+
+/**
+ * Testing entry point. Creates the test and high priority tasks
+ */
+int main() {
+    task_config_t test_conf = DEFAULT_TASK_CONFIG;
+    task_config_t high_conf = DEFAULT_TASK_CONFIG;
+    system_init();
+    wake_sem = semaphore_create_binary();
+    if (wake_sem == NULL) {
+        LOG_E(TAG, "Failed to create semaphore");
+        return ERR_NOMEM;
+    }
+    test_conf.task_name = "Test Task";
+    high_conf.task_name = "High Task";
+    high_conf.task_priority = DEFAULT_PRIORITY + 1;
+    if (task_create(test_task, NULL, &test_conf) == NULL ||
+        task_create(high_task, NULL, &high_conf) == NULL) {
+        LOG_E(TAG, "Failed to create rtos tasks");
+        return ERR_FAIL;
+    }
+    rtos_start();
+    return SYS_OK;
+}
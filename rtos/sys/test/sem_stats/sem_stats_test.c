@@ -0,0 +1,142 @@
+/**
+ * @file sem_stats_test.c
+ * Tests semaphore contention statistics and the semaphore registry.
+ *
+ * The test task takes an available counting semaphore, then pends on a
+ * binary semaphore with a 50ms timeout, which should time out. Two higher
+ * priority waiter tasks then pend on the binary semaphore, so its queue
+ * reaches a depth of two, and the test task posts to wake them. The binary
+ * semaphore's statistics are then checked, and all semaphore statistics are
+ * logged.
+ *
+ * Expected output:
+ * Test 1 passed: uncontended pend counted
+ * Test 2 passed: timeout and blocked time recorded
+ * Test 3 passed: queue depth tracked
+ * Test 4 passed: live semaphores listed with names
+ * Test 5 passed: destroyed semaphore removed from registry
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <drivers/clock/clock.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+#include <util/logging/logging.h>
+
+#define TIMEOUT_MS 50
+#define NUM_WAITERS 2
+
+static const char *TAG = "sem_stats_test";
+
+static semaphore_t binary_sem;
+static semaphore_t counting_sem;
+
+/**
+ * Initializes system clock
+ */
+static void system_init() {
+    clock_cfg_t clk_cfg = CLOCK_DEFAULT_CONFIG;
+    clock_init(&clk_cfg);
+}
+
+/**
+ * Waiter task entry point. Pends on the binary semaphore once, then exits.
+ * @param arg: unused
+ */
+static void waiter_task(void *arg) {
+    semaphore_pend(binary_sem, SYS_TIMEOUT_INF);
+}
+
+/**
+ * Test task entry point. Runs all tests.
+ * @param arg: unused
+ */
+static void test_task(void *arg) {
+    task_config_t waiter_conf = DEFAULT_TASK_CONFIG;
+    semaphore_stats_t stats;
+    semaphore_t sems[4];
+    uint32_t count;
+    int i;
+    /* Semaphore is available, so this pend does not wait */
+    semaphore_pend(counting_sem, SYS_TIMEOUT_INF);
+    semaphore_get_stats(counting_sem, &stats);
+    if (stats.pends == 1 && stats.contended == 0 && stats.timeouts == 0) {
+        printf("Test 1 passed: uncontended pend counted\n");
+    } else {
+        printf("Test 1 failed: %lu pends, %lu contended\n", stats.pends,
+               stats.contended);
+    }
+    /* Nothing posts, so this pend times out */
+    semaphore_pend(binary_sem, TIMEOUT_MS);
+    semaphore_get_stats(binary_sem, &stats);
+    if (stats.contended == 1 && stats.timeouts == 1 &&
+        stats.max_blocked_ticks >= TIMEOUT_MS * SYSTICK_FREQ / 1000) {
+        printf("Test 2 passed: timeout and blocked time recorded\n");
+    } else {
+        printf("Test 2 failed: %lu timeouts, blocked %lu ticks\n",
+               stats.timeouts, stats.max_blocked_ticks);
+    }
+    /* Higher priority waiters block on the semaphore as soon as created */
+    waiter_conf.task_priority = DEFAULT_PRIORITY + 1;
+    for (i = 0; i < NUM_WAITERS; i++) {
+        if (task_create(waiter_task, NULL, &waiter_conf) == NULL) {
+            LOG_E(TAG, "Could not create waiter task");
+            exit(ERR_FAIL);
+        }
+    }
+    task_delay(10);
+    for (i = 0; i < NUM_WAITERS; i++) {
+        semaphore_post(binary_sem);
+        task_delay(10);
+    }
+    semaphore_get_stats(binary_sem, &stats);
+    if (stats.pends == NUM_WAITERS + 1 && stats.queue_depth == 0 &&
+        stats.max_queue_depth == NUM_WAITERS) {
+        printf("Test 3 passed: queue depth tracked\n");
+    } else {
+        printf("Test 3 failed: %lu pends, max queue %lu\n", stats.pends,
+               stats.max_queue_depth);
+    }
+    semaphore_stats_dump();
+    count = semaphore_list(sems, 4);
+    if (count == 2 && sems[0] == binary_sem && sems[1] == counting_sem &&
+        semaphore_get_name(sems[1]) == NULL) {
+        printf("Test 4 passed: live semaphores listed with names\n");
+    } else {
+        printf("Test 4 failed: %lu semaphores listed\n", count);
+    }
+    semaphore_destroy(counting_sem);
+    count = semaphore_list(sems, 4);
+    if (count == 1 && sems[0] == binary_sem) {
+        printf("Test 5 passed: destroyed semaphore removed from registry\n");
+    } else {
+        printf("Test 5 failed: %lu semaphores listed\n", count);
+    }
+    while (1) {
+        task_delay(1000);
+    }
+}
+
+/**
+ * Testing entry point. Creates semaphores and starts the test task
+ */
+int main() {
+    task_config_t test_conf = DEFAULT_TASK_CONFIG;
+    system_init();
+    binary_sem = semaphore_create_binary();
+    counting_sem = semaphore_create_counting(1);
+    if (binary_sem == NULL || counting_sem == NULL) {
+        LOG_E(TAG, "Could not create semaphores");
+        return ERR_NOMEM;
+    }
+    semaphore_set_name(binary_sem, "binary");
+    test_conf.task_name = "Test Task";
+    if (task_create(test_task, NULL, &test_conf) == NULL) {
+        LOG_E(TAG, "Failed to create rtos task");
+        return ERR_FAIL;
+    }
+    rtos_start();
+    return SYS_OK;
+}
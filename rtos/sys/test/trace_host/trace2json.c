@@ -0,0 +1,91 @@
+/**
+ * @file trace2json.c
+ * Converts a captured kernel trace stream to Chrome trace event JSON, for
+ * viewing in Perfetto (ui.perfetto.dev) or chrome://tracing.
+ *
+ * Usage: trace2json [-f core_clock_hz] trace.bin [trace.json]
+ *
+ * trace.bin holds the raw events as streamed by trace_stream_swo (ITM
+ * stimulus port 1, with ITM framing removed) or as read by trace_read and
+ * sent over a UART. The core clock defaults to 80 MHz. Output goes to
+ * stdout if no output file is given.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace_json.h"
+
+#define DEFAULT_FREQ 80000000ULL
+#define EVENT_BYTES 8
+
+/**
+ * Decodes a little endian 32 bit word
+ * @param buf: word bytes
+ * @return word value
+ */
+static uint32_t get_le32(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+int main(int argc, char **argv) {
+    uint64_t freq = DEFAULT_FREQ;
+    const char *in_path, *out_path = NULL;
+    FILE *in, *out = stdout;
+    uint8_t raw[EVENT_BYTES];
+    trace_event_t *events = NULL;
+    uint32_t len = 0, cap = 0, unknown;
+    int arg = 1;
+    if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+        freq = strtoull(argv[2], NULL, 0);
+        arg = 3;
+    }
+    if (arg >= argc || freq == 0) {
+        fprintf(stderr,
+                "Usage: %s [-f core_clock_hz] trace.bin [trace.json]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    in_path = argv[arg];
+    if (arg + 1 < argc) {
+        out_path = argv[arg + 1];
+    }
+    in = fopen(in_path, "rb");
+    if (in == NULL) {
+        perror(in_path);
+        return EXIT_FAILURE;
+    }
+    while (fread(raw, 1, EVENT_BYTES, in) == EVENT_BYTES) {
+        if (len == cap) {
+            cap = cap ? cap * 2 : 1024;
+            events = realloc(events, cap * sizeof(trace_event_t));
+            if (events == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                return EXIT_FAILURE;
+            }
+        }
+        events[len].timestamp = get_le32(raw);
+        events[len].info = get_le32(raw + 4);
+        len++;
+    }
+    fclose(in);
+    if (out_path) {
+        out = fopen(out_path, "w");
+        if (out == NULL) {
+            perror(out_path);
+            return EXIT_FAILURE;
+        }
+    }
+    unknown = trace_json_convert(events, len, freq, out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    fprintf(stderr, "Converted %u events", len - unknown);
+    if (unknown) {
+        fprintf(stderr, ", skipped %u unknown events", unknown);
+    }
+    fprintf(stderr, "\n");
+    free(events);
+    return EXIT_SUCCESS;
+}
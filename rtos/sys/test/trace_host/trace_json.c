@@ -0,0 +1,275 @@
+/**
+ * @file trace_json.c
+ * Converts kernel trace events to Chrome trace event JSON
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "trace_json.h"
+
+/** Process IDs used to group timeline tracks */
+#define PID_TASKS 1
+#define PID_IRQS 2
+#define PID_SEMS 3
+
+/** Most tasks whose names are tracked */
+#define MAX_TASKS 64
+/** Deepest interrupt nesting tracked */
+#define MAX_IRQ_DEPTH 16
+
+/**
+ * Name of a traced task
+ */
+typedef struct {
+    uint32_t task;                    /*!< Task address */
+    char name[TRACE_NAME_MAX + 1];    /*!< Task name, NULL terminated */
+} task_name_t;
+
+/**
+ * Conversion state
+ */
+typedef struct {
+    FILE *out;                        /*!< JSON output stream */
+    bool first;                       /*!< Is the next event the first */
+    double us_per_cycle;              /*!< Timestamp scale */
+    uint64_t cycles;                  /*!< Unwrapped time of last event */
+    uint32_t last_stamp;              /*!< Raw timestamp of last event */
+    bool started;                     /*!< Has a timed event been seen */
+    uint32_t active;                  /*!< Running task, or 0 */
+    uint32_t irqs[MAX_IRQ_DEPTH];     /*!< Active interrupt stack */
+    int irq_depth;                    /*!< Active interrupt count */
+    task_name_t tasks[MAX_TASKS];     /*!< Known task names */
+    int num_tasks;                    /*!< Number of known tasks */
+} convert_state_t;
+
+static void emit(convert_state_t *state, const char *ph, int pid,
+                 uint32_t tid, const char *name, const char *extra);
+static void emit_thread_name(convert_state_t *state, int pid,
+                             const task_name_t *task);
+static task_name_t *lookup_task(convert_state_t *state, uint32_t task);
+static void add_name_chars(convert_state_t *state, uint32_t task,
+                           uint32_t chars);
+
+/**
+ * Writes trace events as Chrome trace event JSON
+ * @param events: trace events, in recorded order
+ * @param len: number of events
+ * @param freq: cycle counter frequency in Hz (the core clock)
+ * @param out: stream to write JSON to
+ * @return number of events that could not be converted
+ */
+uint32_t trace_json_convert(const trace_event_t *events, uint32_t len,
+                            uint64_t freq, FILE *out) {
+    static convert_state_t state;
+    const trace_event_t *ev;
+    uint32_t i, arg, obj, unknown = 0, prev_name_task = 0;
+    char name[48];
+    int t;
+    memset(&state, 0, sizeof(state));
+    state.out = out;
+    state.first = true;
+    state.us_per_cycle = 1e6 / (double)freq;
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (i = 0; i < len; i++) {
+        ev = &events[i];
+        arg = TRACE_EVENT_ARG(ev);
+        obj = TRACE_OBJ_BASE | arg;
+        if (TRACE_EVENT_TYPE(ev) == TRACE_EV_TASK_NAME) {
+            // Timestamp field holds name characters, not a time
+            if (obj != prev_name_task) {
+                // First chunk of a new name
+                lookup_task(&state, obj)->name[0] = '\0';
+            }
+            add_name_chars(&state, obj, ev->timestamp);
+            prev_name_task = obj;
+            continue;
+        }
+        prev_name_task = 0;
+        /**
+         * Unwrap the 32 bit cycle counter. Events more than one wrap apart
+         * (53 seconds at 80 MHz) will be placed too close together.
+         */
+        if (state.started) {
+            state.cycles += (uint32_t)(ev->timestamp - state.last_stamp);
+        }
+        state.started = true;
+        state.last_stamp = ev->timestamp;
+        switch (TRACE_EVENT_TYPE(ev)) {
+        case TRACE_EV_SWITCH:
+            if (obj == state.active) {
+                break;
+            }
+            if (state.active != 0) {
+                emit(&state, "E", PID_TASKS, state.active, NULL, NULL);
+            }
+            lookup_task(&state, obj);
+            emit(&state, "B", PID_TASKS, obj, "running", NULL);
+            state.active = obj;
+            break;
+        case TRACE_EV_ISR_ENTER:
+            if (state.irq_depth < MAX_IRQ_DEPTH) {
+                state.irqs[state.irq_depth] = arg;
+            }
+            state.irq_depth++;
+            snprintf(name, sizeof(name), "IRQ %u", arg);
+            emit(&state, "B", PID_IRQS, arg, name, NULL);
+            break;
+        case TRACE_EV_ISR_EXIT:
+            if (state.irq_depth > 0) {
+                state.irq_depth--;
+            }
+            emit(&state, "E", PID_IRQS, arg, NULL, NULL);
+            break;
+        case TRACE_EV_SEM_PEND:
+            snprintf(name, sizeof(name), "pend 0x%08x", obj);
+            emit(&state, "B", PID_SEMS, state.active, name, NULL);
+            break;
+        case TRACE_EV_SEM_TAKE:
+            emit(&state, "E", PID_SEMS, state.active, NULL,
+                 "\"args\":{\"result\":\"taken\"}");
+            break;
+        case TRACE_EV_SEM_TIMEOUT:
+            emit(&state, "E", PID_SEMS, state.active, NULL,
+                 "\"args\":{\"result\":\"timeout\"}");
+            snprintf(name, sizeof(name), "timeout 0x%08x", obj);
+            emit(&state, "i", PID_SEMS, state.active, name, "\"s\":\"t\"");
+            break;
+        case TRACE_EV_SEM_POST:
+            snprintf(name, sizeof(name), "post 0x%08x", obj);
+            if (state.irq_depth > 0 && state.irq_depth <= MAX_IRQ_DEPTH) {
+                // Posted from an interrupt
+                emit(&state, "i", PID_IRQS,
+                     state.irqs[state.irq_depth - 1], name, "\"s\":\"t\"");
+            } else {
+                emit(&state, "i", PID_TASKS, state.active, name,
+                     "\"s\":\"t\"");
+            }
+            break;
+        case TRACE_EV_TASK_CREATE:
+            lookup_task(&state, obj);
+            emit(&state, "i", PID_TASKS, obj, "created", "\"s\":\"t\"");
+            break;
+        case TRACE_EV_TASK_DELETE:
+            emit(&state, "i", PID_TASKS, obj, "deleted", "\"s\":\"t\"");
+            if (obj == state.active) {
+                emit(&state, "E", PID_TASKS, obj, NULL, NULL);
+                state.active = 0;
+            }
+            break;
+        case TRACE_EV_MARKER:
+            snprintf(name, sizeof(name), "marker %u", arg);
+            emit(&state, "i", PID_TASKS, state.active, name, "\"s\":\"g\"");
+            break;
+        default:
+            unknown++;
+            break;
+        }
+    }
+    /* Metadata names the processes and task threads */
+    emit(&state, "M", PID_TASKS, 0, "process_name",
+         "\"args\":{\"name\":\"Tasks\"}");
+    emit(&state, "M", PID_IRQS, 0, "process_name",
+         "\"args\":{\"name\":\"Interrupts\"}");
+    emit(&state, "M", PID_SEMS, 0, "process_name",
+         "\"args\":{\"name\":\"Semaphores\"}");
+    for (t = 0; t < state.num_tasks; t++) {
+        if (state.tasks[t].name[0] == '\0') {
+            snprintf(state.tasks[t].name, sizeof(state.tasks[t].name),
+                     "0x%08x", state.tasks[t].task);
+        }
+        // Task and semaphore wait tracks both carry the task name
+        emit_thread_name(&state, PID_TASKS, &state.tasks[t]);
+        emit_thread_name(&state, PID_SEMS, &state.tasks[t]);
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    return unknown;
+}
+
+/**
+ * Writes one JSON trace event, at the time of the last event
+ * @param state: conversion state
+ * @param ph: event phase
+ * @param pid: process ID
+ * @param tid: thread ID
+ * @param name: event name, or NULL
+ * @param extra: additional JSON members, or NULL
+ */
+static void emit(convert_state_t *state, const char *ph, int pid,
+                 uint32_t tid, const char *name, const char *extra) {
+    fprintf(state->out, "%s{\"ph\":\"%s\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f",
+            state->first ? "" : ",\n", ph, pid, tid,
+            state->cycles * state->us_per_cycle);
+    if (name) {
+        fprintf(state->out, ",\"name\":\"%s\"", name);
+    }
+    if (extra) {
+        fprintf(state->out, ",%s", extra);
+    }
+    fprintf(state->out, "}");
+    state->first = false;
+}
+
+/**
+ * Writes a metadata event naming a thread after a task
+ * @param state: conversion state
+ * @param pid: process ID of the thread
+ * @param task: task name entry
+ */
+static void emit_thread_name(convert_state_t *state, int pid,
+                             const task_name_t *task) {
+    const char *c;
+    fprintf(state->out,
+            ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+            "\"name\":\"thread_name\",\"args\":{\"name\":\"",
+            pid, task->task);
+    for (c = task->name; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            // Escape characters JSON strings cannot hold directly
+            fputc('\\', state->out);
+        }
+        fputc(*c >= ' ' ? *c : '?', state->out);
+    }
+    fprintf(state->out, "\"}}");
+}
+
+/**
+ * Finds a task's name entry, adding it if it is not known
+ * @param state: conversion state
+ * @param task: task address
+ * @return name entry. Tasks past MAX_TASKS share the last entry.
+ */
+static task_name_t *lookup_task(convert_state_t *state, uint32_t task) {
+    int i;
+    for (i = 0; i < state->num_tasks; i++) {
+        if (state->tasks[i].task == task) {
+            return &state->tasks[i];
+        }
+    }
+    if (state->num_tasks == MAX_TASKS) {
+        return &state->tasks[MAX_TASKS - 1];
+    }
+    state->tasks[state->num_tasks].task = task;
+    state->tasks[state->num_tasks].name[0] = '\0';
+    return &state->tasks[state->num_tasks++];
+}
+
+/**
+ * Appends up to four characters to a task's name
+ * @param state: conversion state
+ * @param task: task address
+ * @param chars: characters, first in the low byte. Zero bytes are skipped
+ */
+static void add_name_chars(convert_state_t *state, uint32_t task,
+                           uint32_t chars) {
+    task_name_t *entry = lookup_task(state, task);
+    size_t len = strlen(entry->name);
+    int i;
+    for (i = 0; i < 4 && len < TRACE_NAME_MAX; i++, chars >>= 8) {
+        if ((chars & 0xFF) != 0) {
+            entry->name[len++] = chars & 0xFF;
+        }
+    }
+    entry->name[len] = '\0';
+}
@@ -0,0 +1,31 @@
+/**
+ * @file trace_json.h
+ * Converts kernel trace events to Chrome trace event JSON, which Perfetto
+ * (ui.perfetto.dev) and chrome://tracing can display.
+ *
+ * Tasks are shown as threads of a "Tasks" process, with a slice for each
+ * period a task runs. Interrupts are threads of an "Interrupts" process,
+ * and semaphore waits are slices on a per task thread of a "Semaphores"
+ * process, so they may span context switches. Posts, task creation and
+ * deletion, and user markers are instant events.
+ */
+#ifndef TRACE_JSON_H
+#define TRACE_JSON_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sys/trace/trace.h>
+
+/**
+ * Writes trace events as Chrome trace event JSON
+ * @param events: trace events, in recorded order
+ * @param len: number of events
+ * @param freq: cycle counter frequency in Hz (the core clock)
+ * @param out: stream to write JSON to
+ * @return number of events that could not be converted
+ */
+uint32_t trace_json_convert(const trace_event_t *events, uint32_t len,
+                            uint64_t freq, FILE *out);
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * @file trace_json_test.c
+ * Tests conversion of kernel trace events to Chrome trace JSON, using a
+ * synthetic trace laid out as the recorder writes it. Built and run on the
+ * host, see Makefile.
+ *
+ * Expected output:
+ * Test 1 passed: task names reassembled
+ * Test 2 passed: timestamps unwrapped across counter overflow
+ * Test 3 passed: all slices closed
+ * Test 4 passed: interrupt post placed on interrupt track
+ * Test 5 passed: semaphore timeout recorded
+ * Test 6 passed: unknown events skipped
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace_json.h"
+
+#define FREQ 80000000ULL
+#define TASK_A 0x20001000UL
+#define TASK_B 0x20002000UL
+#define SEM 0x20003000UL
+#define MAX_EVENTS 64
+
+static trace_event_t events[MAX_EVENTS];
+static uint32_t num_events = 0;
+
+/**
+ * Adds an event to the synthetic trace
+ * @param timestamp: event timestamp field
+ * @param type: event type
+ * @param arg: event argument, addresses are truncated as the recorder does
+ */
+static void add(uint32_t timestamp, uint32_t type, uint32_t arg) {
+    events[num_events].timestamp = timestamp;
+    events[num_events].info = type | ((arg & 0xFFFFFF) << 8);
+    num_events++;
+}
+
+/**
+ * Adds a task's name to the synthetic trace, as trace_name records it
+ * @param task: task address
+ * @param name: task name
+ */
+static void add_name(uint32_t task, const char *name) {
+    uint32_t chars, i, j, len = strlen(name);
+    for (i = 0; i <= len; i += 4) {
+        chars = 0;
+        for (j = 0; j < 4 && i + j < len; j++) {
+            chars |= (uint32_t)(uint8_t)name[i + j] << (j * 8);
+        }
+        add(chars, TRACE_EV_TASK_NAME, task);
+    }
+}
+
+/**
+ * Counts occurrences of a string in another
+ * @param haystack: string to search
+ * @param needle: string to count
+ * @return number of occurrences
+ */
+static int count(const char *haystack, const char *needle) {
+    int n = 0;
+    while ((haystack = strstr(haystack, needle)) != NULL) {
+        n++;
+        haystack++;
+    }
+    return n;
+}
+
+int main() {
+    char *json, *post, *line;
+    size_t json_len;
+    uint32_t unknown;
+    int failures = 0;
+    FILE *out;
+    /* Two tasks, switching across a cycle counter overflow */
+    add(0xFFFFF000, TRACE_EV_TASK_CREATE, TASK_A);
+    add_name(TASK_A, "Sensor Task");
+    add(0xFFFFF010, TRACE_EV_TASK_CREATE, TASK_B);
+    add_name(TASK_B, "Logger");
+    add(0xFFFFFF00, TRACE_EV_SWITCH, TASK_A);
+    add(0xFFFFFF10, TRACE_EV_SEM_PEND, SEM);
+    add(0x00000100, TRACE_EV_SWITCH, TASK_B);
+    add(0x00000200, TRACE_EV_ISR_ENTER, 37);
+    add(0x00000210, TRACE_EV_SEM_POST, SEM);
+    add(0x00000220, TRACE_EV_ISR_EXIT, 37);
+    add(0x00000300, TRACE_EV_SWITCH, TASK_A);
+    add(0x00000310, TRACE_EV_SEM_TAKE, SEM);
+    add(0x00000400, TRACE_EV_MARKER, 7);
+    add(0x00000500, TRACE_EV_SEM_PEND, SEM);
+    add(0x00000600, TRACE_EV_SEM_TIMEOUT, SEM);
+    add(0x00000700, 0x7F, 0);
+    add(0x00000800, TRACE_EV_TASK_DELETE, TASK_A);
+    out = open_memstream(&json, &json_len);
+    unknown = trace_json_convert(events, num_events, FREQ, out);
+    fclose(out);
+    if (strstr(json, "\"thread_name\",\"args\":{\"name\":\"Sensor Task\"}") &&
+        strstr(json, "\"thread_name\",\"args\":{\"name\":\"Logger\"}")) {
+        printf("Test 1 passed: task names reassembled\n");
+    } else {
+        printf("Test 1 failed\n");
+        failures++;
+    }
+    /* Second task runs 0x1100 cycles after the first event, at 80 MHz */
+    line = strstr(json, "\"ph\":\"B\",\"pid\":1,\"tid\":536879104");
+    if (strstr(json, "\"ts\":0.000") && line &&
+        strncmp(strstr(line, "\"ts\":"), "\"ts\":54.400", 11) == 0) {
+        printf("Test 2 passed: timestamps unwrapped across counter "
+               "overflow\n");
+    } else {
+        printf("Test 2 failed\n");
+        failures++;
+    }
+    if (count(json, "\"ph\":\"B\"") == count(json, "\"ph\":\"E\"") &&
+        count(json, "\"ph\":\"B\"") == 6) {
+        printf("Test 3 passed: all slices closed\n");
+    } else {
+        printf("Test 3 failed: %d begins, %d ends\n",
+               count(json, "\"ph\":\"B\""), count(json, "\"ph\":\"E\""));
+        failures++;
+    }
+    post = strstr(json, "\"name\":\"post 0x20003000\"");
+    line = post;
+    while (line && line > json && *line != '{') {
+        line--;
+    }
+    if (post && strncmp(line, "{\"ph\":\"i\",\"pid\":2,\"tid\":37,", 26) == 0) {
+        printf("Test 4 passed: interrupt post placed on interrupt track\n");
+    } else {
+        printf("Test 4 failed\n");
+        failures++;
+    }
+    if (strstr(json, "\"result\":\"timeout\"") &&
+        strstr(json, "\"name\":\"timeout 0x20003000\"")) {
+        printf("Test 5 passed: semaphore timeout recorded\n");
+    } else {
+        printf("Test 5 failed\n");
+        failures++;
+    }
+    if (unknown == 1) {
+        printf("Test 6 passed: unknown events skipped\n");
+    } else {
+        printf("Test 6 failed: %u unknown\n", unknown);
+        failures++;
+    }
+    free(json);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
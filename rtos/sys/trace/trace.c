@@ -0,0 +1,190 @@
+/**
+ * @file trace.c
+ * Implements the kernel event trace recorder
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <config.h>
+
+#include "trace.h"
+
+#if SYS_USE_TRACE == TRACE_DISABLED
+/** Define all functions as stubs, so user markers cost nothing */
+void trace_init(void) {}
+
+void trace_record(trace_type_t type, uint32_t arg) {
+    (void)type;
+    (void)arg;
+}
+
+void trace_name(void *task, const char *name) {
+    (void)task;
+    (void)name;
+}
+
+void trace_marker(uint32_t id) { (void)id; }
+
+uint32_t trace_read(trace_event_t *events, uint32_t len) {
+    (void)events;
+    (void)len;
+    return 0;
+}
+
+uint32_t trace_stream_swo(void) { return 0; }
+
+uint32_t trace_dropped(void) { return 0; }
+
+#else
+
+#include <drivers/device/device.h>
+#include <sys/isr/isr.h>
+#include <util/bitmask.h>
+#include <util/perf/perf.h>
+
+#if (SYS_TRACE_BUFLEN & (SYS_TRACE_BUFLEN - 1)) != 0
+#error "SYS_TRACE_BUFLEN must be a power of two"
+#endif
+
+#define TRACE_BUF_MASK (SYS_TRACE_BUFLEN - 1)
+
+static trace_event_t trace_buf[SYS_TRACE_BUFLEN];
+static uint32_t trace_head = 0;  // Count of events written
+static uint32_t trace_tail = 0;  // Count of events read or overwritten
+static uint32_t trace_drops = 0; // Events overwritten before being read
+
+static inline void trace_put(uint32_t timestamp, uint32_t info);
+
+/**
+ * Starts the DWT cycle counter, and empties the trace buffer. Called by
+ * system_init when tracing is enabled.
+ */
+void trace_init(void) {
+    // Start the cycle counter from zero
+    perf_reset(PERF_CYCLES);
+    perf_enable(PERF_CYCLES);
+    trace_head = trace_tail = trace_drops = 0;
+}
+
+/**
+ * Records an event. Safe to call from any context, including with
+ * interrupts masked. Kernel code should use TRACE_EVENT instead.
+ * @param type: event type
+ * @param arg: event argument, truncated to 24 bits
+ */
+void trace_record(trace_type_t type, uint32_t arg) {
+    uint32_t primask = mask_irq_save();
+    // Timestamp inside the lock, so buffer order is timestamp order
+    trace_put(DWT->CYCCNT, (uint32_t)type | (arg << 8));
+    unmask_irq_restore(primask);
+}
+
+/**
+ * Records the name of a task, as a sequence of TRACE_EV_TASK_NAME events.
+ * At most TRACE_NAME_MAX characters are recorded.
+ * @param task: task the name belongs to
+ * @param name: NULL terminated task name
+ */
+void trace_name(void *task, const char *name) {
+    uint32_t primask, chars, i, j;
+    bool done = false;
+    if (name == NULL) {
+        return;
+    }
+    // Hold the lock so the name's events are contiguous
+    primask = mask_irq_save();
+    for (i = 0; i < TRACE_NAME_MAX && !done; i += 4) {
+        chars = 0;
+        for (j = 0; j < 4 && !done; j++) {
+            if (i + j == TRACE_NAME_MAX || name[i + j] == '\0') {
+                done = true;
+            } else {
+                chars |= (uint32_t)(uint8_t)name[i + j] << (j * 8);
+            }
+        }
+        trace_put(chars,
+                  (uint32_t)TRACE_EV_TASK_NAME | ((uint32_t)task << 8));
+    }
+    unmask_irq_restore(primask);
+}
+
+/**
+ * Records a user marker, shown as an instant event on the timeline
+ * @param id: marker ID, truncated to 24 bits
+ */
+void trace_marker(uint32_t id) { trace_record(TRACE_EV_MARKER, id); }
+
+/**
+ * Copies the oldest unread events out of the trace buffer
+ * @param events: buffer to copy events into
+ * @param len: length of events buffer, in events
+ * @return number of events copied
+ */
+uint32_t trace_read(trace_event_t *events, uint32_t len) {
+    uint32_t primask, count = 0;
+    while (count < len) {
+        // Lock per event, so readers never hold off interrupts for long
+        primask = mask_irq_save();
+        if (trace_tail == trace_head) {
+            unmask_irq_restore(primask);
+            break;
+        }
+        events[count++] = trace_buf[trace_tail & TRACE_BUF_MASK];
+        trace_tail++;
+        unmask_irq_restore(primask);
+    }
+    return count;
+}
+
+/**
+ * Streams all unread events to ITM stimulus port TRACE_ITM_PORT. The
+ * debugger must enable the port. Does nothing if ITM or the port is
+ * disabled.
+ * @return number of events streamed
+ */
+uint32_t trace_stream_swo(void) {
+    trace_event_t ev;
+    uint32_t count = 0;
+    if (READBITS(ITM->TCR, ITM_TCR_ITMENA_Msk) == 0UL ||
+        READBITS(ITM->TER, 1UL << TRACE_ITM_PORT) == 0UL) {
+        return 0;
+    }
+    while (trace_read(&ev, 1) == 1) {
+        // Wait for the stimulus port FIFO before each word
+        while (ITM->PORT[TRACE_ITM_PORT].u32 == 0) {
+        }
+        ITM->PORT[TRACE_ITM_PORT].u32 = ev.timestamp;
+        while (ITM->PORT[TRACE_ITM_PORT].u32 == 0) {
+        }
+        ITM->PORT[TRACE_ITM_PORT].u32 = ev.info;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Gets the number of events overwritten before they were read
+ * @return number of events dropped since trace_init
+ */
+uint32_t trace_dropped(void) { return trace_drops; }
+
+/**
+ * Adds an event to the trace buffer, overwriting the oldest event if the
+ * buffer is full. Must be called with the trace lock held.
+ * @param timestamp: event timestamp field
+ * @param info: event info field
+ */
+static inline void trace_put(uint32_t timestamp, uint32_t info) {
+    trace_event_t *ev = &trace_buf[trace_head & TRACE_BUF_MASK];
+    if (trace_head - trace_tail == SYS_TRACE_BUFLEN) {
+        // Buffer is full. The oldest event is lost
+        trace_tail++;
+        trace_drops++;
+    }
+    ev->timestamp = timestamp;
+    ev->info = info;
+    trace_head++;
+}
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @file trace.h
+ * Kernel event trace recorder.
+ *
+ * When SYS_USE_TRACE is TRACE_ENABLED, the kernel records scheduling events
+ * into a RAM ring buffer. Each event is 8 bytes: a DWT cycle counter
+ * timestamp, an event type, and a 24 bit argument. Kernel objects (tasks and
+ * semaphores) are identified by the low 24 bits of their address, which is
+ * unique as all RAM lies within TRACE_OBJ_BASE to TRACE_OBJ_BASE + 16MB.
+ *
+ * Events can be drained with trace_read (to send over a UART, for example),
+ * or streamed to ITM stimulus port TRACE_ITM_PORT with trace_stream_swo.
+ * The stream is the raw events, back to back, in little endian byte order.
+ * sys/test/trace_host converts a captured stream to Chrome trace JSON, which
+ * Perfetto and chrome://tracing can display.
+ *
+ * This header has no device dependencies, so host tools may include it.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#include <config.h>
+
+/** ITM stimulus port trace_stream_swo writes to. Port 0 carries logging */
+#define TRACE_ITM_PORT 1
+
+/** Base address kernel object arguments are relative to */
+#define TRACE_OBJ_BASE 0x20000000UL
+
+/** Longest task name recorded, in characters */
+#define TRACE_NAME_MAX 16
+
+/**
+ * Trace event types
+ */
+typedef enum {
+    TRACE_EV_SWITCH = 1,      /*!< Task switched in. Arg is task */
+    TRACE_EV_ISR_ENTER = 2,   /*!< Interrupt entered. Arg is IRQ number */
+    TRACE_EV_ISR_EXIT = 3,    /*!< Interrupt exited. Arg is IRQ number */
+    TRACE_EV_SEM_PEND = 4,    /*!< Active task pends. Arg is semaphore */
+    TRACE_EV_SEM_TAKE = 5,    /*!< Active task took semaphore. Arg is sem */
+    TRACE_EV_SEM_TIMEOUT = 6, /*!< Active task's pend timed out. Arg is sem */
+    TRACE_EV_SEM_POST = 7,    /*!< Semaphore posted. Arg is semaphore */
+    TRACE_EV_TASK_CREATE = 8, /*!< Task created. Arg is task */
+    TRACE_EV_TASK_DELETE = 9, /*!< Task destroyed. Arg is task */
+    TRACE_EV_TASK_NAME = 10,  /*!< Four characters of a task name, held in
+                                   the timestamp field. Arg is task */
+    TRACE_EV_MARKER = 11,     /*!< User marker. Arg is marker ID */
+} trace_type_t;
+
+/**
+ * Trace event record
+ */
+typedef struct {
+    uint32_t timestamp; /*!< DWT cycle count when the event was recorded */
+    uint32_t info;      /*!< Event type (bits 0-7) and argument (bits 8-31) */
+} trace_event_t;
+
+/** Gets the type of an event */
+#define TRACE_EVENT_TYPE(ev) ((trace_type_t)((ev)->info & 0xFF))
+/** Gets the argument of an event */
+#define TRACE_EVENT_ARG(ev) ((ev)->info >> 8)
+
+#if SYS_USE_TRACE == TRACE_ENABLED
+/** Records a kernel event. Arguments are truncated to 24 bits */
+#define TRACE_EVENT(type, arg) trace_record((type), (uint32_t)(arg))
+/** Records a task's name */
+#define TRACE_NAME(task, name) trace_name((task), (name))
+#else
+#define TRACE_EVENT(type, arg)
+#define TRACE_NAME(task, name)
+#endif
+
+/**
+ * Starts the DWT cycle counter, and empties the trace buffer. Called by
+ * system_init when tracing is enabled.
+ */
+void trace_init(void);
+
+/**
+ * Records an event. Safe to call from any context, including with
+ * interrupts masked. Kernel code should use TRACE_EVENT instead.
+ * @param type: event type
+ * @param arg: event argument, truncated to 24 bits
+ */
+void trace_record(trace_type_t type, uint32_t arg);
+
+/**
+ * Records the name of a task, as a sequence of TRACE_EV_TASK_NAME events.
+ * At most TRACE_NAME_MAX characters are recorded.
+ * @param task: task the name belongs to
+ * @param name: NULL terminated task name
+ */
+void trace_name(void *task, const char *name);
+
+/**
+ * Records a user marker, shown as an instant event on the timeline
+ * @param id: marker ID, truncated to 24 bits
+ */
+void trace_marker(uint32_t id);
+
+/**
+ * Copies the oldest unread events out of the trace buffer
+ * @param events: buffer to copy events into
+ * @param len: length of events buffer, in events
+ * @return number of events copied
+ */
+uint32_t trace_read(trace_event_t *events, uint32_t len);
+
+/**
+ * Streams all unread events to ITM stimulus port TRACE_ITM_PORT. The
+ * debugger must enable the port. Does nothing if ITM or the port is
+ * disabled.
+ * @return number of events streamed
+ */
+uint32_t trace_stream_swo(void);
+
+/**
+ * Gets the number of events overwritten before they were read
+ * @return number of events dropped since trace_init
+ */
+uint32_t trace_dropped(void);
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file heap.c
+ * Implements a generic intrusive priority heap (pairing heap)
+ * Each subtree's root orders before all its descendants. Children of a node
+ * are kept in a doubly linked sibling list, so any node can be unlinked in
+ * constant time. Removing a root merges its children pairwise from left to
+ * right, then merges the pairs from right to left, which keeps the amortized
+ * cost logarithmic. Both passes are iterative, so stack use is constant.
+ */
+
+#include <stddef.h>
+
+#include "heap.h"
+
+static heap_node_t *heap_meld(heap_t *heap, heap_node_t *a, heap_node_t *b);
+static heap_node_t *heap_combine(heap_t *heap, heap_node_t *first);
+
+/**
+ * Initializes an empty heap
+ * @param heap: heap to initialize
+ * @param less: comparison function, returning true if its first argument
+ * must be ordered before its second
+ */
+void heap_init(heap_t *heap, heap_less_t less) {
+    heap->_root = NULL;
+    heap->_less = less;
+}
+
+/**
+ * Inserts an element into a heap. Elements that compare equal are not
+ * guaranteed to leave the heap in insertion order.
+ * @param heap: heap to insert into
+ * @param node: heap node of the element to insert
+ */
+void heap_insert(heap_t *heap, heap_node_t *node) {
+    node->_child = node->_next = node->_prev = NULL;
+    heap->_root = heap_meld(heap, heap->_root, node);
+}
+
+/**
+ * Removes the least element from a heap
+ * @param heap: heap to remove from
+ * @return heap node of the least element, or NULL for an empty heap
+ */
+heap_node_t *heap_pop(heap_t *heap) {
+    heap_node_t *root = heap->_root;
+    if (root == NULL) {
+        return NULL;
+    }
+    heap->_root = heap_combine(heap, root->_child);
+    root->_child = NULL;
+    return root;
+}
+
+/**
+ * Removes an element from a heap
+ * @param heap: heap to remove from
+ * @param node: heap node of the element to remove. Must be in the heap.
+ */
+void heap_remove(heap_t *heap, heap_node_t *node) {
+    if (node == heap->_root) {
+        heap_pop(heap);
+        return;
+    }
+    // Unlink node from its parent's child list
+    if (node->_prev->_child == node) {
+        node->_prev->_child = node->_next;
+    } else {
+        node->_prev->_next = node->_next;
+    }
+    if (node->_next != NULL) {
+        node->_next->_prev = node->_prev;
+    }
+    // Merge the node's children back into the heap
+    heap->_root =
+        heap_meld(heap, heap->_root, heap_combine(heap, node->_child));
+    node->_child = node->_next = node->_prev = NULL;
+}
+
+/**
+ * Merges two heaps. The root that orders later becomes the leftmost child of
+ * the other. On a tie, a stays the root.
+ * @param heap: heap providing the comparison function
+ * @param a: root of first heap, with no siblings (may be NULL)
+ * @param b: root of second heap, with no siblings (may be NULL)
+ * @return root of merged heap
+ */
+static heap_node_t *heap_meld(heap_t *heap, heap_node_t *a, heap_node_t *b) {
+    heap_node_t *tmp;
+    if (a == NULL) {
+        return b;
+    }
+    if (b == NULL) {
+        return a;
+    }
+    if (heap->_less(b, a)) {
+        tmp = a;
+        a = b;
+        b = tmp;
+    }
+    b->_prev = a;
+    b->_next = a->_child;
+    if (a->_child != NULL) {
+        a->_child->_prev = b;
+    }
+    a->_child = b;
+    return a;
+}
+
+/**
+ * Merges a list of siblings into one heap, using the two pass method
+ * @param heap: heap providing the comparison function
+ * @param first: leftmost sibling (may be NULL)
+ * @return root of merged heap, with no siblings
+ */
+static heap_node_t *heap_combine(heap_t *heap, heap_node_t *first) {
+    heap_node_t *pairs = NULL, *a, *b, *next;
+    // Merge siblings in pairs, left to right, stacking the results
+    while (first != NULL) {
+        a = first;
+        b = a->_next;
+        next = b == NULL ? NULL : b->_next;
+        a->_next = a->_prev = NULL;
+        if (b != NULL) {
+            b->_next = b->_prev = NULL;
+            a = heap_meld(heap, a, b);
+        }
+        a->_next = pairs;
+        pairs = a;
+        first = next;
+    }
+    // Merge the pairs, right to left (the stack holds them in that order)
+    first = NULL;
+    while (pairs != NULL) {
+        next = pairs->_next;
+        pairs->_next = NULL;
+        first = heap_meld(heap, pairs, first);
+        pairs = next;
+    }
+    return first;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file heap.h
+ * Implements a generic intrusive priority heap (pairing heap)
+ * Elements store the heap's state within a heap_node_t structure, so the heap
+ * never allocates memory. The heap is ordered by a comparison function given
+ * at initialization, and the least element can be read in constant time.
+ * Insertion takes constant time, and removing the least element or any other
+ * element takes amortized logarithmic time.
+ *
+ * For example, this structure would store well in the heap:
+ * struct example {
+ *      uint32_t deadline;
+ *      heap_node_t node;
+ * };
+ *
+ * with this comparison function:
+ * bool earlier(heap_node_t *a, heap_node_t *b) {
+ *      return HEAP_ENTRY(a, struct example, node)->deadline <
+ *             HEAP_ENTRY(b, struct example, node)->deadline;
+ * }
+ *
+ * This would insert "ex" and then remove the earliest element:
+ * heap_t aheap;
+ * heap_node_t *first;
+ * struct example ex;
+ * heap_init(&aheap, earlier);
+ * heap_insert(&aheap, &ex.node);
+ * first = heap_pop(&aheap);
+ * if (first != NULL) {
+ *      struct example *elem = HEAP_ENTRY(first, struct example, node);
+ * }
+ */
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Internal heap node structure. Do NOT manipulate these fields.
+ * Declared in header file so that compiler knows type size
+ */
+typedef struct heap_node {
+    struct heap_node *_child; /*!< Leftmost child */
+    struct heap_node *_next;  /*!< Right sibling */
+    struct heap_node *_prev;  /*!< Left sibling, or parent of leftmost child */
+} heap_node_t;
+
+/**
+ * Heap comparison function. Should return true if a must be ordered before b.
+ */
+typedef bool (*heap_less_t)(heap_node_t *a, heap_node_t *b);
+
+/**
+ * Heap structure. Initialize with heap_init before use.
+ */
+typedef struct heap {
+    heap_node_t *_root; /*!< Least element of the heap */
+    heap_less_t _less;  /*!< Comparison function */
+} heap_t;
+
+/**
+ * Static initializer for an empty heap, equivalent to heap_init
+ * @param less: comparison function
+ */
+#define HEAP_INITIALIZER(less)                                                 \
+    { ._root = NULL, ._less = (less) }
+
+/**
+ * Gets the element containing a heap node structure
+ * @param node: heap_node_t pointer
+ * @param type: type of the element
+ * @param member: name of the heap_node_t member within type
+ */
+#define HEAP_ENTRY(node, type, member)                                         \
+    ((type *)((char *)(node)-offsetof(type, member)))
+
+/**
+ * Initializes an empty heap
+ * @param heap: heap to initialize
+ * @param less: comparison function, returning true if its first argument
+ * must be ordered before its second
+ */
+void heap_init(heap_t *heap, heap_less_t less);
+
+/**
+ * Inserts an element into a heap. Elements that compare equal are not
+ * guaranteed to leave the heap in insertion order.
+ * @param heap: heap to insert into
+ * @param node: heap node of the element to insert
+ */
+void heap_insert(heap_t *heap, heap_node_t *node);
+
+/**
+ * Removes the least element from a heap
+ * @param heap: heap to remove from
+ * @return heap node of the least element, or NULL for an empty heap
+ */
+heap_node_t *heap_pop(heap_t *heap);
+
+/**
+ * Removes an element from a heap
+ * @param heap: heap to remove from
+ * @param node: heap node of the element to remove. Must be in the heap.
+ */
+void heap_remove(heap_t *heap, heap_node_t *node);
+
+/**
+ * Gets the least element of a heap without removing it
+ * @param heap: heap to get least element of
+ * @return heap node of the least element, or NULL for an empty heap
+ */
+static inline heap_node_t *heap_peek(heap_t *heap) { return heap->_root; }
+
+/**
+ * Checks if a heap is empty
+ * @param heap: heap to check
+ * @return true if the heap holds no elements
+ */
+static inline bool heap_empty(heap_t *heap) { return heap->_root == NULL; }
+
+#endif
@@ -0,0 +1,953 @@
+/**
+ * @file kvstore.c
+ * Implements a log structured key-value store on flash.
+ *
+ * Each page of the store starts with a header holding a magic value and a
+ * sequence number, which orders the pages of the log. Records follow,
+ * aligned to KV_PROG_SIZE:
+ *
+ * | key_len (1) | type (1) | val_len (2) | crc (4) | key | value | padding |
+ *
+ * The CRC covers the first four header bytes, the key and the value. A
+ * record is written with a single pass of programming, so power loss leaves
+ * either an erased header (the end of the page) or a record with a bad CRC,
+ * which is skipped at mount. Deletes append a record with no value.
+ *
+ * Pages are used as a ring. The log runs from the tail page (oldest) to the
+ * head page (newest), and the remaining pages are erased. One erased page is
+ * always kept for garbage collection, which compacts the tail page into the
+ * head of the log. Deletion records can be dropped when their page is
+ * compacted, since any older records for the key are erased with it.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/crc/crc_sw.h>
+#include <sys/err.h>
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+
+#include "kvstore.h"
+
+/** Page header magic value, "KVS1" */
+#define KV_PAGE_MAGIC 0x3153564BUL
+/** Value of erased flash words */
+#define KV_ERASED 0xFFFFFFFFUL
+/** Marks an unused index entry */
+#define KV_INDEX_EMPTY 0xFFFFFFFFUL
+/** Size of buffer used to stream records to and from flash */
+#define KV_CHUNK_SIZE 64
+/** Number of erased pages kept for garbage collection */
+#define KV_RESERVE_PAGES 1
+
+/** Record types */
+#define KV_REC_VALUE 0x56  // Record holds a value
+#define KV_REC_DELETE 0x44 // Record deletes its key
+
+/** Rounds a length up to the programming unit */
+#define KV_ALIGN(len) (((len) + KV_PROG_SIZE - 1) & ~(KV_PROG_SIZE - 1))
+/** Gets the size of a record on flash */
+#define KV_REC_SIZE(hdr)                                                       \
+    KV_ALIGN(sizeof(kv_rec_hdr_t) + (hdr)->key_len + (hdr)->val_len)
+
+/**
+ * Page header, at the start of each used page
+ */
+typedef struct {
+    uint32_t magic; /*!< KV_PAGE_MAGIC */
+    uint32_t seq;   /*!< Page sequence number, increasing along the log */
+} kv_page_hdr_t;
+
+/**
+ * Record header
+ */
+typedef struct {
+    uint8_t key_len;  /*!< Length of record key */
+    uint8_t type;     /*!< Record type */
+    uint16_t val_len; /*!< Length of record value */
+    uint32_t crc;     /*!< CRC-32 of header, key and value */
+} kv_rec_hdr_t;
+
+/**
+ * Result of checking a record in flash
+ */
+typedef enum {
+    KV_SCAN_OK,      /*!< Record is valid */
+    KV_SCAN_TORN,    /*!< Record failed its CRC, and should be skipped */
+    KV_SCAN_END,     /*!< No more records in this page */
+    KV_SCAN_CORRUPT, /*!< Record header is invalid. Page can't be used */
+} kv_scan_t;
+
+/**
+ * Buffers data so the backend is only asked to program whole units
+ */
+typedef struct {
+    const kv_flash_t *flash;     /*!< Flash backend */
+    uint32_t offset;             /*!< Flash offset of next program */
+    uint32_t fill;               /*!< Bytes held in buf */
+    uint8_t buf[KV_PROG_SIZE];   /*!< Partial programming unit */
+} kv_writer_t;
+
+static syserr_t kv_lock(kv_store_t *kv, bool wait);
+static void kv_unlock(kv_store_t *kv);
+static uint32_t kv_hash(const char *key, uint32_t len);
+static uint32_t kv_index_probe(kv_store_t *kv, const char *key,
+                               uint32_t len, bool *found, syserr_t *err);
+static syserr_t kv_index_set(kv_store_t *kv, const char *key, uint32_t len,
+                             uint32_t offset);
+static void kv_index_remove(kv_store_t *kv, uint32_t slot);
+static kv_scan_t kv_check_record(kv_store_t *kv, uint32_t offset,
+                                 kv_rec_hdr_t *hdr, char *key,
+                                 syserr_t *err);
+static syserr_t kv_scan_page(kv_store_t *kv, uint32_t page, uint32_t *end);
+static bool kv_range_erased(kv_store_t *kv, uint32_t offset, uint32_t len,
+                            syserr_t *err);
+static syserr_t kv_open_page(kv_store_t *kv, uint32_t page);
+static syserr_t kv_reserve(kv_store_t *kv, uint32_t size, bool gc);
+static syserr_t kv_append(kv_store_t *kv, uint8_t type, const char *key,
+                          uint32_t key_len, const void *val,
+                          uint32_t val_len);
+static syserr_t kv_copy_record(kv_store_t *kv, uint32_t src, uint32_t size,
+                               uint32_t *dst);
+static syserr_t kv_compact(kv_store_t *kv);
+static syserr_t kv_write(kv_writer_t *w, const void *data, uint32_t len);
+static syserr_t kv_flush(kv_writer_t *w);
+
+/**
+ * Mounts a key-value store, building its index from the records in flash.
+ * A flash region holding no store is formatted, and pages left partially
+ * erased or programmed by power loss are repaired.
+ * @param kv: store to mount
+ * @param flash: flash backend. Must stay valid while the store is in use
+ * @param index: storage for the hash index
+ * @param index_len: number of index entries. Must be a power of 2. The
+ * store holds at most index_len - 1 keys
+ * @return SYS_OK on success, ERR_NOMEM if the index is too small for the
+ * stored keys, ERR_BADPARAM, or a backend error
+ */
+syserr_t kv_mount(kv_store_t *kv, const kv_flash_t *flash,
+                  kv_index_entry_t *index, uint32_t index_len) {
+    kv_page_hdr_t hdr;
+    uint32_t page, i, end = 0, min_seq = KV_ERASED, max_seq = 0;
+    bool found = false;
+    syserr_t err = SYS_OK;
+    /** Check parameters. */
+    if (kv == NULL || flash == NULL || index == NULL || index_len < 2 ||
+        (index_len & (index_len - 1)) != 0 || flash->num_pages < 3 ||
+        flash->page_size % KV_PROG_SIZE != 0 ||
+        flash->page_size < 2 * KV_CHUNK_SIZE) {
+        return ERR_BADPARAM;
+    }
+    memset(kv, 0, sizeof(*kv));
+    kv->flash = flash;
+    kv->index = index;
+    kv->index_len = index_len;
+    for (i = 0; i < index_len; i++) {
+        index[i].offset = KV_INDEX_EMPTY;
+    }
+    /* Find the ends of the log, and repair pages that are not in use */
+    for (page = 0; page < flash->num_pages; page++) {
+        err = flash->read(flash->ctx, page * flash->page_size, &hdr,
+                          sizeof(hdr));
+        if (err != SYS_OK) {
+            return err;
+        }
+        if (hdr.magic == KV_PAGE_MAGIC && hdr.seq != KV_ERASED) {
+            if (!found || hdr.seq < min_seq) {
+                min_seq = hdr.seq;
+                kv->tail_page = page;
+            }
+            if (!found || hdr.seq > max_seq) {
+                max_seq = hdr.seq;
+                kv->head_page = page;
+            }
+            found = true;
+            continue;
+        }
+        if (!kv_range_erased(kv, page * flash->page_size, flash->page_size,
+                             &err)) {
+            // Erase or page open was interrupted
+            if (err == SYS_OK) {
+                err = flash->erase(flash->ctx, page);
+            }
+            if (err != SYS_OK) {
+                return err;
+            }
+        }
+        kv->free_pages++;
+    }
+    if (!found) {
+        // Format a new store
+        kv->tail_page = 0;
+        return kv_open_page(kv, 0);
+    }
+    kv->next_seq = max_seq + 1;
+    /* Replay the log from oldest to newest page */
+    page = kv->tail_page;
+    for (i = 0; i < flash->num_pages; i++) {
+        err = flash->read(flash->ctx, page * flash->page_size, &hdr,
+                          sizeof(hdr));
+        if (err != SYS_OK) {
+            return err;
+        }
+        if (hdr.magic == KV_PAGE_MAGIC && hdr.seq != KV_ERASED) {
+            err = kv_scan_page(kv, page, &end);
+            if (err != SYS_OK) {
+                return err;
+            }
+        }
+        if (page == kv->head_page) {
+            break;
+        }
+        page = (page + 1) % flash->num_pages;
+    }
+    /* Only append to the head page if the space after its last record is
+     * still erased */
+    kv->head_offset = end;
+    if (end < flash->page_size &&
+        !kv_range_erased(kv, kv->head_page * flash->page_size + end,
+                         flash->page_size - end, &err)) {
+        kv->head_offset = flash->page_size;
+    }
+    return err;
+}
+
+/**
+ * Sets the value of a key. Writing the value a key already holds does not
+ * program flash.
+ * @param kv: store to write to
+ * @param key: null terminated key, 1 to KV_MAX_KEY_LEN characters
+ * @param val: value to store
+ * @param len: length of value
+ * @return SYS_OK on success, ERR_NOMEM if the store or index is full,
+ * ERR_BADPARAM, or a backend error
+ */
+syserr_t kv_set(kv_store_t *kv, const char *key, const void *val,
+                uint32_t len) {
+    uint8_t chunk[KV_CHUNK_SIZE];
+    const uint8_t *src = val;
+    uint32_t key_len, slot, offset, n, part;
+    kv_rec_hdr_t hdr;
+    bool found, same;
+    syserr_t err;
+    /** Check parameters. */
+    if (kv == NULL || key == NULL || (val == NULL && len != 0)) {
+        return ERR_BADPARAM;
+    }
+    key_len = strlen(key);
+    if (key_len == 0 || key_len > KV_MAX_KEY_LEN || len > UINT16_MAX ||
+        KV_ALIGN(sizeof(kv_rec_hdr_t) + key_len + len) >
+            kv->flash->page_size - sizeof(kv_page_hdr_t)) {
+        return ERR_BADPARAM;
+    }
+    err = kv_lock(kv, true);
+    if (err != SYS_OK) {
+        return err;
+    }
+    slot = kv_index_probe(kv, key, key_len, &found, &err);
+    if (err == SYS_OK && found) {
+        /* Skip the write if the key already holds this value */
+        offset = kv->index[slot].offset;
+        err = kv->flash->read(kv->flash->ctx, offset, &hdr, sizeof(hdr));
+        same = (err == SYS_OK && hdr.type == KV_REC_VALUE &&
+                hdr.val_len == len);
+        offset += sizeof(hdr) + key_len;
+        for (n = 0; same && n < len; n += part) {
+            part = len - n < sizeof(chunk) ? len - n : sizeof(chunk);
+            err = kv->flash->read(kv->flash->ctx, offset + n, chunk, part);
+            same = (err == SYS_OK && memcmp(chunk, src + n, part) == 0);
+        }
+        if (err != SYS_OK || same) {
+            kv_unlock(kv);
+            return err;
+        }
+    } else if (err == SYS_OK && kv->index_count + 1 >= kv->index_len) {
+        // No room to index a new key
+        err = ERR_NOMEM;
+    }
+    if (err == SYS_OK) {
+        err = kv_append(kv, KV_REC_VALUE, key, key_len, val, len);
+    }
+    kv_unlock(kv);
+    return err;
+}
+
+/**
+ * Gets the value of a key.
+ * @param kv: store to read from
+ * @param key: null terminated key
+ * @param val: buffer to read value into
+ * @param len: length of buffer. Longer values are truncated
+ * @param err: Set on error. ERR_NOTFOUND if the key does not exist
+ * @return length of the stored value, or -1 on error
+ */
+int kv_get(kv_store_t *kv, const char *key, void *val, uint32_t len,
+           syserr_t *err) {
+    uint32_t key_len, slot, offset;
+    kv_rec_hdr_t hdr;
+    bool found;
+    *err = SYS_OK; // Set no error until one occurs
+    /** Check parameters. */
+    if (kv == NULL || key == NULL || (val == NULL && len != 0)) {
+        *err = ERR_BADPARAM;
+        return -1;
+    }
+    key_len = strlen(key);
+    if (key_len == 0 || key_len > KV_MAX_KEY_LEN) {
+        *err = ERR_BADPARAM;
+        return -1;
+    }
+    *err = kv_lock(kv, true);
+    if (*err != SYS_OK) {
+        return -1;
+    }
+    slot = kv_index_probe(kv, key, key_len, &found, err);
+    if (*err == SYS_OK && !found) {
+        *err = ERR_NOTFOUND;
+    }
+    if (*err == SYS_OK) {
+        offset = kv->index[slot].offset;
+        *err = kv->flash->read(kv->flash->ctx, offset, &hdr, sizeof(hdr));
+    }
+    if (*err == SYS_OK && hdr.type == KV_REC_DELETE) {
+        *err = ERR_NOTFOUND;
+    }
+    if (*err == SYS_OK) {
+        if (len > hdr.val_len) {
+            len = hdr.val_len;
+        }
+        *err = kv->flash->read(kv->flash->ctx, offset + sizeof(hdr) + key_len,
+                               val, len);
+    }
+    kv_unlock(kv);
+    return *err == SYS_OK ? hdr.val_len : -1;
+}
+
+/**
+ * Deletes a key.
+ * @param kv: store to delete from
+ * @param key: null terminated key
+ * @return SYS_OK on success, ERR_NOTFOUND if the key does not exist, or
+ * other error value
+ */
+syserr_t kv_delete(kv_store_t *kv, const char *key) {
+    uint32_t key_len, slot;
+    kv_rec_hdr_t hdr;
+    bool found;
+    syserr_t err;
+    /** Check parameters. */
+    if (kv == NULL || key == NULL) {
+        return ERR_BADPARAM;
+    }
+    key_len = strlen(key);
+    if (key_len == 0 || key_len > KV_MAX_KEY_LEN) {
+        return ERR_BADPARAM;
+    }
+    err = kv_lock(kv, true);
+    if (err != SYS_OK) {
+        return err;
+    }
+    slot = kv_index_probe(kv, key, key_len, &found, &err);
+    if (err == SYS_OK && !found) {
+        err = ERR_NOTFOUND;
+    }
+    if (err == SYS_OK) {
+        err = kv->flash->read(kv->flash->ctx, kv->index[slot].offset, &hdr,
+                              sizeof(hdr));
+    }
+    if (err == SYS_OK && hdr.type == KV_REC_DELETE) {
+        err = ERR_NOTFOUND;
+    }
+    if (err == SYS_OK) {
+        err = kv_append(kv, KV_REC_DELETE, key, key_len, NULL, 0);
+    }
+    kv_unlock(kv);
+    return err;
+}
+
+/**
+ * Compacts the oldest page of the log, moving its live records to the head
+ * of the log and erasing it.
+ * @param kv: store to compact
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t kv_gc(kv_store_t *kv) {
+    syserr_t err;
+    if (kv == NULL) {
+        return ERR_BADPARAM;
+    }
+    err = kv_lock(kv, true);
+    if (err != SYS_OK) {
+        return err;
+    }
+    err = kv_compact(kv);
+    kv_unlock(kv);
+    return err;
+}
+
+/**
+ * Idle task hook, for use with task_set_idle_hook. Compacts a page when
+ * KV_GC_IDLE_PAGES or fewer pages are erased, so writes rarely need to
+ * collect garbage themselves. Does nothing if the store is in use.
+ * @param kvptr: store to compact
+ */
+void kv_idle_gc(void *kvptr) {
+    kv_store_t *kv = kvptr;
+    // The idle task may never block, so give up if the store is busy
+    if (kv == NULL || kv_lock(kv, false) != SYS_OK) {
+        return;
+    }
+    if (kv->free_pages <= KV_GC_IDLE_PAGES) {
+        kv_compact(kv);
+    }
+    kv_unlock(kv);
+}
+
+/**
+ * Gets the number of erased pages in a store
+ * @param kv: store to check
+ * @return number of erased pages
+ */
+uint32_t kv_free_pages(kv_store_t *kv) { return kv->free_pages; }
+
+/**
+ * Takes ownership of a store. If the store is busy and wait is set, the
+ * calling task sleeps until it is released.
+ * @param kv: store to lock
+ * @param wait: should the caller wait for the store
+ * @return SYS_OK if the store was taken, or ERR_INUSE
+ */
+static syserr_t kv_lock(kv_store_t *kv, bool wait) {
+    semaphore_t sem;
+    bool locked;
+    if (wait && kv->lock == NULL && rtos_started()) {
+        // Create the release semaphore on first use from a task
+        sem = semaphore_create_binary();
+        mask_irq();
+        if (kv->lock == NULL) {
+            kv->lock = sem;
+            sem = NULL;
+        }
+        unmask_irq();
+        if (sem) {
+            semaphore_destroy(sem);
+        }
+    }
+    while (1) {
+        mask_irq();
+        locked = !kv->busy;
+        kv->busy = true;
+        unmask_irq();
+        if (locked) {
+            return SYS_OK;
+        }
+        if (!wait || kv->lock == NULL) {
+            return ERR_INUSE;
+        }
+        // Wait for the store to be released, then try again
+        semaphore_pend(kv->lock, SYS_TIMEOUT_INF);
+    }
+}
+
+/**
+ * Releases a store, waking a task waiting for it
+ * @param kv: store to release
+ */
+static void kv_unlock(kv_store_t *kv) {
+    kv->busy = false;
+    if (kv->lock) {
+        semaphore_post(kv->lock);
+    }
+}
+
+/**
+ * Hashes a key with FNV-1a
+ * @param key: key to hash
+ * @param len: length of key
+ * @return key hash
+ */
+static uint32_t kv_hash(const char *key, uint32_t len) {
+    uint32_t hash = 2166136261UL;
+    while (len--) {
+        hash = (hash ^ (uint8_t)*key++) * 16777619UL;
+    }
+    return hash;
+}
+
+/**
+ * Finds the index slot for a key, using linear probing. Keys with matching
+ * hashes are compared with the key stored in flash.
+ * @param kv: store to search
+ * @param key: key to find
+ * @param len: length of key
+ * @param found: set if the key is in the index
+ * @param err: set on backend error
+ * @return slot holding the key if found, or the empty slot to insert it at
+ */
+static uint32_t kv_index_probe(kv_store_t *kv, const char *key,
+                               uint32_t len, bool *found, syserr_t *err) {
+    uint32_t hash = kv_hash(key, len);
+    uint32_t mask = kv->index_len - 1;
+    uint32_t slot = hash & mask;
+    char stored[KV_MAX_KEY_LEN];
+    kv_rec_hdr_t hdr;
+    kv_index_entry_t *entry;
+    *err = SYS_OK;
+    *found = false;
+    // The index always has an empty slot, so probing terminates
+    while (kv->index[slot].offset != KV_INDEX_EMPTY) {
+        entry = &kv->index[slot];
+        if (entry->hash == hash) {
+            *err = kv->flash->read(kv->flash->ctx, entry->offset, &hdr,
+                                   sizeof(hdr));
+            if (*err == SYS_OK && hdr.key_len == len) {
+                *err = kv->flash->read(kv->flash->ctx,
+                                       entry->offset + sizeof(hdr), stored,
+                                       len);
+                if (*err == SYS_OK && memcmp(stored, key, len) == 0) {
+                    *found = true;
+                    return slot;
+                }
+            }
+            if (*err != SYS_OK) {
+                return slot;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Points the index entry for a key at a record, adding the key if needed
+ * @param kv: store to update
+ * @param key: record key
+ * @param len: length of key
+ * @param offset: flash offset of record
+ * @return SYS_OK on success, ERR_NOMEM if the index is full, or backend
+ * error
+ */
+static syserr_t kv_index_set(kv_store_t *kv, const char *key, uint32_t len,
+                             uint32_t offset) {
+    uint32_t slot;
+    bool found;
+    syserr_t err;
+    slot = kv_index_probe(kv, key, len, &found, &err);
+    if (err != SYS_OK) {
+        return err;
+    }
+    if (!found) {
+        if (kv->index_count + 1 >= kv->index_len) {
+            return ERR_NOMEM;
+        }
+        kv->index[slot].hash = kv_hash(key, len);
+        kv->index_count++;
+    }
+    kv->index[slot].offset = offset;
+    return SYS_OK;
+}
+
+/**
+ * Removes an index entry, shifting later entries of its probe run back so
+ * lookups still find them
+ * @param kv: store to update
+ * @param slot: slot to remove
+ */
+static void kv_index_remove(kv_store_t *kv, uint32_t slot) {
+    uint32_t mask = kv->index_len - 1;
+    uint32_t next = slot, home;
+    while (1) {
+        next = (next + 1) & mask;
+        if (kv->index[next].offset == KV_INDEX_EMPTY) {
+            break;
+        }
+        home = kv->index[next].hash & mask;
+        // Move the entry back unless its home slot lies after the hole
+        if ((next > slot && (home <= slot || home > next)) ||
+            (next < slot && (home <= slot && home > next))) {
+            kv->index[slot] = kv->index[next];
+            slot = next;
+        }
+    }
+    kv->index[slot].offset = KV_INDEX_EMPTY;
+    kv->index_count--;
+}
+
+/**
+ * Checks the record at an offset in flash
+ * @param kv: store to check
+ * @param offset: flash offset of record. Must be within a page
+ * @param hdr: filled with the record header
+ * @param key: filled with the record key, KV_MAX_KEY_LEN bytes
+ * @param err: set on backend error
+ * @return record state
+ */
+static kv_scan_t kv_check_record(kv_store_t *kv, uint32_t offset,
+                                 kv_rec_hdr_t *hdr, char *key,
+                                 syserr_t *err) {
+    const kv_flash_t *flash = kv->flash;
+    uint32_t page_end = (offset / flash->page_size + 1) * flash->page_size;
+    uint8_t chunk[KV_CHUNK_SIZE];
+    uint32_t crc, n, part;
+    *err = SYS_OK;
+    if (offset + sizeof(*hdr) > page_end) {
+        return KV_SCAN_END;
+    }
+    *err = flash->read(flash->ctx, offset, hdr, sizeof(*hdr));
+    if (*err != SYS_OK) {
+        return KV_SCAN_CORRUPT;
+    }
+    if (hdr->key_len == 0xFF && hdr->type == 0xFF &&
+        hdr->val_len == 0xFFFF && hdr->crc == KV_ERASED) {
+        return KV_SCAN_END;
+    }
+    if (hdr->key_len == 0 || hdr->key_len > KV_MAX_KEY_LEN ||
+        (hdr->type != KV_REC_VALUE && hdr->type != KV_REC_DELETE) ||
+        offset + KV_REC_SIZE(hdr) > page_end) {
+        return KV_SCAN_CORRUPT;
+    }
+    *err = flash->read(flash->ctx, offset + sizeof(*hdr), key, hdr->key_len);
+    if (*err != SYS_OK) {
+        return KV_SCAN_CORRUPT;
+    }
+    crc = CRC_sw_crc32(0, hdr, sizeof(uint32_t));
+    crc = CRC_sw_crc32(crc, key, hdr->key_len);
+    offset += sizeof(*hdr) + hdr->key_len;
+    for (n = 0; n < hdr->val_len; n += part) {
+        part = hdr->val_len - n;
+        if (part > sizeof(chunk)) {
+            part = sizeof(chunk);
+        }
+        *err = flash->read(flash->ctx, offset + n, chunk, part);
+        if (*err != SYS_OK) {
+            return KV_SCAN_CORRUPT;
+        }
+        crc = CRC_sw_crc32(crc, chunk, part);
+    }
+    return crc == hdr->crc ? KV_SCAN_OK : KV_SCAN_TORN;
+}
+
+/**
+ * Adds the records in a page to the index. Later records replace earlier
+ * ones for the same key.
+ * @param kv: store to scan
+ * @param page: page to scan
+ * @param end: set to the page offset after the last record
+ * @return SYS_OK on success, or error value otherwise
+ */
+static syserr_t kv_scan_page(kv_store_t *kv, uint32_t page, uint32_t *end) {
+    uint32_t start = page * kv->flash->page_size;
+    uint32_t offset = start + sizeof(kv_page_hdr_t);
+    char key[KV_MAX_KEY_LEN];
+    kv_rec_hdr_t hdr;
+    kv_scan_t state;
+    syserr_t err;
+    while (offset < start + kv->flash->page_size) {
+        state = kv_check_record(kv, offset, &hdr, key, &err);
+        if (err != SYS_OK) {
+            return err;
+        }
+        if (state == KV_SCAN_END) {
+            break;
+        } else if (state == KV_SCAN_CORRUPT) {
+            // Nothing after a corrupt header can be trusted
+            offset = start + kv->flash->page_size;
+            break;
+        } else if (state == KV_SCAN_OK) {
+            err = kv_index_set(kv, key, hdr.key_len, offset);
+            if (err != SYS_OK) {
+                return err;
+            }
+        }
+        offset += KV_REC_SIZE(&hdr);
+    }
+    *end = offset - start;
+    return SYS_OK;
+}
+
+/**
+ * Checks if a range of flash is erased
+ * @param kv: store to check
+ * @param offset: flash offset of range
+ * @param len: length of range
+ * @param err: set on backend error
+ * @return true if every byte in the range is erased
+ */
+static bool kv_range_erased(kv_store_t *kv, uint32_t offset, uint32_t len,
+                            syserr_t *err) {
+    uint8_t chunk[KV_CHUNK_SIZE];
+    uint32_t n, i, part;
+    *err = SYS_OK;
+    for (n = 0; n < len; n += part) {
+        part = len - n < sizeof(chunk) ? len - n : sizeof(chunk);
+        *err = kv->flash->read(kv->flash->ctx, offset + n, chunk, part);
+        if (*err != SYS_OK) {
+            return false;
+        }
+        for (i = 0; i < part; i++) {
+            if (chunk[i] != 0xFF) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Starts a new head page for the log, writing its header
+ * @param kv: store to update
+ * @param page: erased page to use
+ * @return SYS_OK on success, or backend error
+ */
+static syserr_t kv_open_page(kv_store_t *kv, uint32_t page) {
+    kv_page_hdr_t hdr = {.magic = KV_PAGE_MAGIC, .seq = kv->next_seq++};
+    syserr_t err;
+    kv->head_page = page;
+    kv->free_pages--;
+    err = kv->flash->program(kv->flash->ctx, page * kv->flash->page_size,
+                             &hdr, sizeof(hdr));
+    // A page with a failed header is not appended to
+    kv->head_offset = err == SYS_OK ? sizeof(hdr) : kv->flash->page_size;
+    return err;
+}
+
+/**
+ * Makes room for a record in the head page, moving to a new page if needed
+ * @param kv: store to update
+ * @param size: size of record
+ * @param gc: is the caller garbage collection. Garbage collection may use
+ * the reserved erased page, and never collects garbage itself
+ * @return SYS_OK on success, ERR_NOMEM if the store is full, or backend
+ * error
+ */
+static syserr_t kv_reserve(kv_store_t *kv, uint32_t size, bool gc) {
+    uint32_t attempts;
+    syserr_t err;
+    while (kv->head_offset + size > kv->flash->page_size) {
+        if (gc) {
+            if (kv->free_pages == 0) {
+                return ERR_NOMEM;
+            }
+        } else {
+            // Keep the reserved page free, collecting garbage if needed
+            for (attempts = 0; kv->free_pages <= KV_RESERVE_PAGES;
+                 attempts++) {
+                if (attempts == kv->flash->num_pages) {
+                    // Every page is full of live records
+                    return ERR_NOMEM;
+                }
+                err = kv_compact(kv);
+                if (err != SYS_OK) {
+                    return err;
+                }
+            }
+            if (kv->head_offset + size <= kv->flash->page_size) {
+                // Garbage collection left room in the head page
+                break;
+            }
+        }
+        err = kv_open_page(kv, (kv->head_page + 1) % kv->flash->num_pages);
+        if (err != SYS_OK) {
+            return err;
+        }
+    }
+    return SYS_OK;
+}
+
+/**
+ * Appends a record to the log, and points the index at it
+ * @param kv: store to update
+ * @param type: record type
+ * @param key: record key
+ * @param key_len: length of key
+ * @param val: record value
+ * @param val_len: length of value
+ * @return SYS_OK on success, or error value otherwise
+ */
+static syserr_t kv_append(kv_store_t *kv, uint8_t type, const char *key,
+                          uint32_t key_len, const void *val,
+                          uint32_t val_len) {
+    kv_rec_hdr_t hdr = {
+        .key_len = key_len, .type = type, .val_len = val_len};
+    kv_writer_t w = {.flash = kv->flash};
+    uint32_t offset;
+    syserr_t err;
+    err = kv_reserve(kv, KV_REC_SIZE(&hdr), false);
+    if (err != SYS_OK) {
+        return err;
+    }
+    hdr.crc = CRC_sw_crc32(0, &hdr, sizeof(uint32_t));
+    hdr.crc = CRC_sw_crc32(hdr.crc, key, key_len);
+    hdr.crc = CRC_sw_crc32(hdr.crc, val, val_len);
+    offset = kv->head_page * kv->flash->page_size + kv->head_offset;
+    // The space is used even if programming fails
+    kv->head_offset += KV_REC_SIZE(&hdr);
+    w.offset = offset;
+    err = kv_write(&w, &hdr, sizeof(hdr));
+    if (err == SYS_OK) {
+        err = kv_write(&w, key, key_len);
+    }
+    if (err == SYS_OK) {
+        err = kv_write(&w, val, val_len);
+    }
+    if (err == SYS_OK) {
+        err = kv_flush(&w);
+    }
+    if (err == SYS_OK) {
+        err = kv_index_set(kv, key, key_len, offset);
+    }
+    return err;
+}
+
+/**
+ * Copies a record to the head of the log
+ * @param kv: store to update
+ * @param src: flash offset of record
+ * @param size: size of record
+ * @param dst: set to the new flash offset of the record
+ * @return SYS_OK on success, or error value otherwise
+ */
+static syserr_t kv_copy_record(kv_store_t *kv, uint32_t src, uint32_t size,
+                               uint32_t *dst) {
+    uint8_t chunk[KV_CHUNK_SIZE];
+    kv_writer_t w = {.flash = kv->flash};
+    uint32_t n, part;
+    syserr_t err;
+    err = kv_reserve(kv, size, true);
+    if (err != SYS_OK) {
+        return err;
+    }
+    *dst = kv->head_page * kv->flash->page_size + kv->head_offset;
+    kv->head_offset += size;
+    w.offset = *dst;
+    for (n = 0; n < size; n += part) {
+        part = size - n < sizeof(chunk) ? size - n : sizeof(chunk);
+        err = kv->flash->read(kv->flash->ctx, src + n, chunk, part);
+        if (err == SYS_OK) {
+            err = kv_write(&w, chunk, part);
+        }
+        if (err != SYS_OK) {
+            return err;
+        }
+    }
+    return kv_flush(&w);
+}
+
+/**
+ * Compacts the tail page of the log. Live values are copied to the head of
+ * the log, deletion records are dropped, and the page is erased.
+ * @param kv: store to compact
+ * @return SYS_OK on success, or error value otherwise
+ */
+static syserr_t kv_compact(kv_store_t *kv) {
+    uint32_t page = kv->tail_page;
+    uint32_t offset = page * kv->flash->page_size + sizeof(kv_page_hdr_t);
+    uint32_t page_end = (page + 1) * kv->flash->page_size;
+    uint32_t slot, dst;
+    char key[KV_MAX_KEY_LEN];
+    kv_rec_hdr_t hdr;
+    kv_scan_t state;
+    bool found;
+    syserr_t err;
+    if (page == kv->head_page) {
+        // The log is a single page, there is nothing to compact into
+        return SYS_OK;
+    }
+    while (offset < page_end) {
+        state = kv_check_record(kv, offset, &hdr, key, &err);
+        if (err != SYS_OK) {
+            return err;
+        }
+        if (state == KV_SCAN_END || state == KV_SCAN_CORRUPT) {
+            break;
+        }
+        if (state == KV_SCAN_OK) {
+            slot = kv_index_probe(kv, key, hdr.key_len, &found, &err);
+            if (err != SYS_OK) {
+                return err;
+            }
+            if (found && kv->index[slot].offset == offset) {
+                // Record is live
+                if (hdr.type == KV_REC_DELETE) {
+                    kv_index_remove(kv, slot);
+                } else {
+                    err = kv_copy_record(kv, offset, KV_REC_SIZE(&hdr), &dst);
+                    if (err != SYS_OK) {
+                        return err;
+                    }
+                    kv->index[slot].offset = dst;
+                }
+            }
+        }
+        offset += KV_REC_SIZE(&hdr);
+    }
+    err = kv->flash->erase(kv->flash->ctx, page);
+    if (err != SYS_OK) {
+        return err;
+    }
+    kv->free_pages++;
+    kv->tail_page = (page + 1) % kv->flash->num_pages;
+    return SYS_OK;
+}
+
+/**
+ * Writes data through a writer. Whole programming units are programmed
+ * directly from data, and any remainder is buffered.
+ * @param w: writer to use
+ * @param data: data to write
+ * @param len: length of data
+ * @return SYS_OK on success, or backend error
+ */
+static syserr_t kv_write(kv_writer_t *w, const void *data, uint32_t len) {
+    const uint8_t *src = data;
+    uint32_t n;
+    syserr_t err;
+    while (len) {
+        if (w->fill == 0 && len >= KV_PROG_SIZE) {
+            n = len & ~(KV_PROG_SIZE - 1);
+            err = w->flash->program(w->flash->ctx, w->offset, src, n);
+            if (err != SYS_OK) {
+                return err;
+            }
+            w->offset += n;
+        } else {
+            n = KV_PROG_SIZE - w->fill;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(w->buf + w->fill, src, n);
+            w->fill += n;
+            if (w->fill == KV_PROG_SIZE) {
+                err = w->flash->program(w->flash->ctx, w->offset, w->buf,
+                                        KV_PROG_SIZE);
+                if (err != SYS_OK) {
+                    return err;
+                }
+                w->offset += KV_PROG_SIZE;
+                w->fill = 0;
+            }
+        }
+        src += n;
+        len -= n;
+    }
+    return SYS_OK;
+}
+
+/**
+ * Programs any data buffered in a writer, padded with erased bytes
+ * @param w: writer to flush
+ * @return SYS_OK on success, or backend error
+ */
+static syserr_t kv_flush(kv_writer_t *w) {
+    syserr_t err;
+    if (w->fill == 0) {
+        return SYS_OK;
+    }
+    memset(w->buf + w->fill, 0xFF, KV_PROG_SIZE - w->fill);
+    err = w->flash->program(w->flash->ctx, w->offset, w->buf, KV_PROG_SIZE);
+    w->offset += KV_PROG_SIZE;
+    w->fill = 0;
+    return err;
+}
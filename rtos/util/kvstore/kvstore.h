@@ -0,0 +1,154 @@
+/**
+ * @file kvstore.h
+ * Implements a log structured key-value store on flash.
+ *
+ * Records are appended to a log that rotates through the store's flash
+ * pages in order, so every page is erased equally often. An in-RAM hash
+ * index maps each key to its newest record. Garbage collection compacts the
+ * oldest page by moving its live records to the head of the log, and can be
+ * run from the idle task. Each record carries a CRC, so a write interrupted
+ * by power loss is discarded when the store is next mounted, leaving the
+ * previous value in place.
+ *
+ * Flash is accessed through a kv_flash_t backend, so the store can run on
+ * the internal flash (see kvstore_flash.h) or on a simulated flash.
+ */
+
+#ifndef KVSTORE_H
+#define KVSTORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/err.h>
+#include <sys/semaphore/semaphore.h>
+
+/** Maximum key length */
+#define KV_MAX_KEY_LEN 32
+/**
+ * Size of the programming unit. Backends are only asked to program aligned
+ * multiples of this size, into erased flash.
+ */
+#define KV_PROG_SIZE 8
+/** Idle GC compacts a page when this many or fewer pages are erased */
+#define KV_GC_IDLE_PAGES 2
+
+/**
+ * Flash backend used by a store. Offsets are relative to the start of the
+ * store's flash region.
+ */
+typedef struct {
+    /** Reads len bytes at offset into buf */
+    syserr_t (*read)(void *ctx, uint32_t offset, void *buf, uint32_t len);
+    /**
+     * Programs len bytes at offset. Offset and len are multiples of
+     * KV_PROG_SIZE, and the target range is erased
+     */
+    syserr_t (*program)(void *ctx, uint32_t offset, const void *buf,
+                        uint32_t len);
+    /** Erases one page, setting it to 0xFF */
+    syserr_t (*erase)(void *ctx, uint32_t page);
+    void *ctx;          /*!< Context passed to backend functions */
+    uint32_t page_size; /*!< Size of an erasable page */
+    uint32_t num_pages; /*!< Number of pages. At least 3 */
+} kv_flash_t;
+
+/**
+ * Hash index entry. The index is supplied by the user, and limits the
+ * number of keys the store can hold.
+ */
+typedef struct {
+    uint32_t hash;   /*!< Hash of entry key */
+    uint32_t offset; /*!< Offset of the newest record for the key */
+} kv_index_entry_t;
+
+/**
+ * Key-value store state. Fields are private to the store.
+ */
+typedef struct {
+    const kv_flash_t *flash; /*!< Flash backend */
+    kv_index_entry_t *index; /*!< Hash index */
+    uint32_t index_len;      /*!< Length of index. A power of 2 */
+    uint32_t index_count;    /*!< Number of keys in index */
+    uint32_t head_page;      /*!< Page records are appended to */
+    uint32_t head_offset;    /*!< Offset of next record in head page */
+    uint32_t tail_page;      /*!< Oldest page in the log */
+    uint32_t free_pages;     /*!< Number of erased pages */
+    uint32_t next_seq;       /*!< Sequence number of next page */
+    volatile bool busy;      /*!< Is the store in use */
+    semaphore_t lock;        /*!< Posted when the store is released */
+} kv_store_t;
+
+/**
+ * Mounts a key-value store, building its index from the records in flash.
+ * A flash region holding no store is formatted, and pages left partially
+ * erased or programmed by power loss are repaired.
+ * @param kv: store to mount
+ * @param flash: flash backend. Must stay valid while the store is in use
+ * @param index: storage for the hash index
+ * @param index_len: number of index entries. Must be a power of 2. The
+ * store holds at most index_len - 1 keys
+ * @return SYS_OK on success, ERR_NOMEM if the index is too small for the
+ * stored keys, ERR_BADPARAM, or a backend error
+ */
+syserr_t kv_mount(kv_store_t *kv, const kv_flash_t *flash,
+                  kv_index_entry_t *index, uint32_t index_len);
+
+/**
+ * Sets the value of a key. Writing the value a key already holds does not
+ * program flash.
+ * @param kv: store to write to
+ * @param key: null terminated key, 1 to KV_MAX_KEY_LEN characters
+ * @param val: value to store
+ * @param len: length of value
+ * @return SYS_OK on success, ERR_NOMEM if the store or index is full,
+ * ERR_BADPARAM, or a backend error
+ */
+syserr_t kv_set(kv_store_t *kv, const char *key, const void *val,
+                uint32_t len);
+
+/**
+ * Gets the value of a key.
+ * @param kv: store to read from
+ * @param key: null terminated key
+ * @param val: buffer to read value into
+ * @param len: length of buffer. Longer values are truncated
+ * @param err: Set on error. ERR_NOTFOUND if the key does not exist
+ * @return length of the stored value, or -1 on error
+ */
+int kv_get(kv_store_t *kv, const char *key, void *val, uint32_t len,
+           syserr_t *err);
+
+/**
+ * Deletes a key.
+ * @param kv: store to delete from
+ * @param key: null terminated key
+ * @return SYS_OK on success, ERR_NOTFOUND if the key does not exist, or
+ * other error value
+ */
+syserr_t kv_delete(kv_store_t *kv, const char *key);
+
+/**
+ * Compacts the oldest page of the log, moving its live records to the head
+ * of the log and erasing it.
+ * @param kv: store to compact
+ * @return SYS_OK on success, or error value otherwise
+ */
+syserr_t kv_gc(kv_store_t *kv);
+
+/**
+ * Idle task hook, for use with task_set_idle_hook. Compacts a page when
+ * KV_GC_IDLE_PAGES or fewer pages are erased, so writes rarely need to
+ * collect garbage themselves. Does nothing if the store is in use.
+ * @param kvptr: store to compact
+ */
+void kv_idle_gc(void *kvptr);
+
+/**
+ * Gets the number of erased pages in a store
+ * @param kv: store to check
+ * @return number of erased pages
+ */
+uint32_t kv_free_pages(kv_store_t *kv);
+
+#endif
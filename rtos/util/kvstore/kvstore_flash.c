@@ -0,0 +1,90 @@
+/**
+ * @file kvstore_flash.c
+ * Key-value store backend for the internal flash
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include <drivers/flash/flash.h>
+#include <sys/err.h>
+
+#include "kvstore_flash.h"
+
+static syserr_t kv_flash_read(void *ctx, uint32_t offset, void *buf,
+                              uint32_t len);
+static syserr_t kv_flash_program(void *ctx, uint32_t offset, const void *buf,
+                                 uint32_t len);
+static syserr_t kv_flash_erase(void *ctx, uint32_t page);
+
+/**
+ * Initializes a key-value store backend using a range of internal flash
+ * pages. The pages must not hold code or data used by the program.
+ * @param flash: backend to initialize
+ * @param first_page: first flash page used by the store
+ * @param num_pages: number of flash pages used by the store. At least 3
+ * @return SYS_OK on success, or ERR_BADPARAM for an invalid page range
+ */
+syserr_t kv_flash_init(kv_flash_t *flash, uint32_t first_page,
+                       uint32_t num_pages) {
+    if (flash == NULL || num_pages < 3 ||
+        first_page + num_pages > FLASH_NUM_PAGES) {
+        return ERR_BADPARAM;
+    }
+    flash->read = kv_flash_read;
+    flash->program = kv_flash_program;
+    flash->erase = kv_flash_erase;
+    // The context is the first page of the store
+    flash->ctx = (void *)first_page;
+    flash->page_size = FLASH_PAGE_BYTES;
+    flash->num_pages = num_pages;
+    return SYS_OK;
+}
+
+/**
+ * Reads from the store's flash, which is memory mapped
+ * @param ctx: first page of the store
+ * @param offset: offset within the store
+ * @param buf: buffer to read into
+ * @param len: length to read
+ * @return SYS_OK
+ */
+static syserr_t kv_flash_read(void *ctx, uint32_t offset, void *buf,
+                              uint32_t len) {
+    memcpy(buf, (const void *)(FLASH_PAGE_ADDR((uint32_t)ctx) + offset), len);
+    return SYS_OK;
+}
+
+/**
+ * Programs the store's flash
+ * @param ctx: first page of the store
+ * @param offset: offset within the store
+ * @param buf: data to program
+ * @param len: length of data
+ * @return SYS_OK on success, or error value otherwise
+ */
+static syserr_t kv_flash_program(void *ctx, uint32_t offset, const void *buf,
+                                 uint32_t len) {
+    return FLASH_program(FLASH_PAGE_ADDR((uint32_t)ctx) + offset, buf, len);
+}
+
+/**
+ * Erases a page of the store's flash
+ * @param ctx: first page of the store
+ * @param page: page within the store
+ * @return SYS_OK on success, or error value otherwise
+ */
+static syserr_t kv_flash_erase(void *ctx, uint32_t page) {
+    syserr_t err = FLASH_erase_start((uint32_t)ctx + page, NULL);
+    if (err != SYS_OK) {
+        return err;
+    }
+    /**
+     * Poll for completion rather than sleeping, since garbage collection
+     * runs in the idle task, which may never block. The CPU stalls on flash
+     * fetches during the erase regardless.
+     */
+    do {
+        err = FLASH_erase_wait(FLASH_TIMEOUT_NONE);
+    } while (err == ERR_TIMEOUT);
+    return err;
+}
@@ -0,0 +1,25 @@
+/**
+ * @file kvstore_flash.h
+ * Key-value store backend for the internal flash
+ */
+
+#ifndef KVSTORE_FLASH_H
+#define KVSTORE_FLASH_H
+
+#include <stdint.h>
+
+#include <sys/err.h>
+#include <util/kvstore/kvstore.h>
+
+/**
+ * Initializes a key-value store backend using a range of internal flash
+ * pages. The pages must not hold code or data used by the program.
+ * @param flash: backend to initialize
+ * @param first_page: first flash page used by the store
+ * @param num_pages: number of flash pages used by the store. At least 3
+ * @return SYS_OK on success, or ERR_BADPARAM for an invalid page range
+ */
+syserr_t kv_flash_init(kv_flash_t *flash, uint32_t first_page,
+                       uint32_t num_pages);
+
+#endif
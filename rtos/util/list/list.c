@@ -10,43 +10,42 @@
 
 #include "list.h"
 
+/** Gets the element holding a list state, given the state's offset */
+#define CONTAINER(state, offset) ((void *)((char *)(state) - (offset)))
+
 // Internal functions
-static list_t list_add(list_t list, void *elem, list_state_t *state,
-                       bool prepend);
+static list_t list_add(list_t list, list_state_t *state, bool prepend);
 
 /**
  * Appends element to a list
  * @param list: List to append to (if NULL, new list is created)
- * @param elem: element to append to list
- * @param state: list element state. Should be associated with elem.
+ * @param state: list state of the element to append
  * @return new list on success, or NULL on error
  */
-list_t list_append(list_t list, void *elem, list_state_t *state) {
-    return list_add(list, elem, state, false);
+list_t list_append(list_t list, list_state_t *state) {
+    return list_add(list, state, false);
 }
 
 /**
  * Prepends element to a list
  * @param list: List to prepend to (if NULL, new list is created)
- * @param elem: element to append to list
- * @param state: list element state. Should be associated with elem.
+ * @param state: list state of the element to prepend
  * @return new list on success, or NULL on error
  */
-list_t list_prepend(list_t list, void *elem, list_state_t *state) {
-    return list_add(list, elem, state, true);
+list_t list_prepend(list_t list, list_state_t *state) {
+    return list_add(list, state, true);
 }
+
 /**
- * Iterates through linked list. If iterator function returns LST_BRK,
- * iteration will cease at that list element
+ * Iterates through linked list. Use list_iterate rather than calling this
+ * directly.
  * @param list: list to iterate over
- * @param itr: iteration function. Will be called with the element being
- * iterated over, and return value dermines if iteration should continue
- * LST_CONT: iteration continues
- * LST_BRK: iteration ends on this element
- * LST_REM: unused
+ * @param itr: iteration function, called with each element
+ * @param offset: offset of the list state within each element
  * @return last list entry touched by iteration
  */
-void *list_iterate(list_t list, list_return_t (*itr)(void *)) {
+void *list_iterate_offset(list_t list, list_return_t (*itr)(void *),
+                          size_t offset) {
     list_state_t *head, *current;
     list_return_t ret;
     // Check parameters
@@ -60,56 +59,42 @@ void *list_iterate(list_t list, list_return_t (*itr)(void *)) {
     head = current = (list_state_t *)list;
     do {
         // Call itr with the data stored by list entry
-        ret = itr(current->_container);
+        ret = itr(CONTAINER(current, offset));
         current = current->_next;
     } while (ret == LST_CONT && current != head);
     /**
      * Return data in entry before current (last one itr was called with data
      * from)
      */
-    return current->_prev->_container;
+    return CONTAINER(current->_prev, offset);
 }
 
 /**
- * Filters a linked list, using "itr" to determine if elements should be removed
+ * Filters a linked list. Use list_filter rather than calling this directly.
  * @param list: list to filter
- * @param itr: iterator function. Return value of LST_CONT continues, LST_BRK
- * stops iteration, and LST_REM removes the current element from the list and
- * continues iteration.
- * @param destructor: Function called with each element that the iterator
- * returns LST_REM for. Allows caller to free list elements.
+ * @param itr: iterator function, called with each element
+ * @param destructor: Function called with each removed element
+ * @param offset: offset of the list state within each element
  * @return new list after modification (or NULL on error/empty list)
  */
-list_t list_filter(list_t list, list_return_t (*itr)(void *),
-                   void (*destructor)(void *)) {
-    list_state_t *head, *current, *remove;
+list_t list_filter_offset(list_t list, list_return_t (*itr)(void *),
+                          void (*destructor)(void *), size_t offset) {
+    list_state_t *current, *next;
     list_return_t ret;
     // Check parameters
     if (list == NULL || itr == NULL || destructor == NULL) {
         return NULL;
     }
-    // Iterate through the list, until we cycle back around to the head.
-    head = current = (list_state_t *)list;
-    do {
-        // Call iterator
-        ret = itr(current->_container);
+    // Iterate through the list once, removing elements in place
+    LIST_FOR_EACH_SAFE(list, current, next) {
+        ret = itr(CONTAINER(current, offset));
         if (ret == LST_REM) {
-            remove = current;
-            current = current->_next;
-            list = list_remove(list, remove);
-            destructor(remove->_container);
-            if (remove == head) {
-                /**
-                 * Removed head. Call this function with new list.
-                 * Parameters check will handle base case where list is NULL
-                 */
-                return list_filter(list, itr, destructor);
-            }
-        } else {
-            // Assign current to next entry
-            current = current->_next;
+            list = list_remove(list, current);
+            destructor(CONTAINER(current, offset));
+        } else if (ret == LST_BRK) {
+            break;
         }
-    } while (head != current && ret != LST_BRK);
+    }
     return list;
 }
 
@@ -144,23 +129,28 @@ list_t list_remove(list_t list, list_state_t *target) {
 }
 
 /**
- * Gets the head of a list without removing it
+ * Gets the head of a list. Use list_get_head rather than calling this
+ * directly.
  * @param list: list to get head of
+ * @param offset: offset of the list state within each element
  * @return pointer to head element of list, or NULL for empty list
  */
-void *list_get_head(list_t list) {
+void *list_get_head_offset(list_t list, size_t offset) {
     // Simply return data in list head
-    return list == NULL ? list : ((list_state_t *)list)->_container;
+    return list == NULL ? list : CONTAINER(list, offset);
 }
 
 /**
- * Gets the tail of a list without removing it
+ * Gets the tail of a list. Use list_get_tail rather than calling this
+ * directly.
  * @param list: list to get tail of
+ * @param offset: offset of the list state within each element
  * @return pointer to tail element of list, or NULL for empty list
  */
-void *list_get_tail(list_t list) {
+void *list_get_tail_offset(list_t list, size_t offset) {
     // Get the tail from the prev ref of the head, return its data
-    return list == NULL ? list : ((list_state_t *)list)->_prev->_container;
+    return list == NULL ? list
+                        : CONTAINER(((list_state_t *)list)->_prev, offset);
 }
 
 /**
@@ -168,19 +158,16 @@ void *list_get_tail(list_t list) {
  * of the circular linked list they designate as "head", this function prevents
  * code duplication
  * @param list: list to modify
- * @param elem: element to add
  * @param state: element state structure
+ * @param prepend: should the element become the new head
  * @return new head of list
  */
-static list_t list_add(list_t list, void *elem, list_state_t *state,
-                       bool prepend) {
+static list_t list_add(list_t list, list_state_t *state, bool prepend) {
     list_state_t *head, *tail;
     // Check parameters
-    if (state == NULL || elem == NULL) {
+    if (state == NULL) {
         return NULL;
     }
-    // Associate the element with the container field of state
-    state->_container = elem;
     if (list == NULL) {
         // Single entry circular linked list
         state->_prev = state->_next = state;
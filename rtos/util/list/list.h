@@ -3,7 +3,9 @@
  * Implements a generic doubly linked list
  * This list stores the state of entries within a list_state_t
  * structure. Each element added to the list should have some form of
- * list_state_t structure associated with it.
+ * list_state_t structure associated with it. Elements are found from their
+ * list state by its offset within the element type, so functions returning
+ * elements take the element type and the name of its list_state_t member.
  *
  * For example, this structure would store well in the list:
  * struct example {
@@ -16,12 +18,26 @@
  * list_t alist;
  * struct example ex;
  * ex->data = buffer; // buffer definition emitted for clarity
- * alist = list_append(NULL, &ex, ex.state);
+ * alist = list_append(NULL, &ex.state);
+ *
+ * And this call would get "ex" back from the list:
+ * struct example *head = list_get_head(alist, struct example, state);
+ *
+ * Lists can also be walked inline, without calling an iterator function per
+ * element. LIST_FOR_EACH_SAFE allows the current element to be removed:
+ * list_state_t *pos, *next;
+ * LIST_FOR_EACH_SAFE(alist, pos, next) {
+ *      struct example *elem = LIST_ENTRY(pos, struct example, state);
+ *      alist = list_remove(alist, pos);
+ * }
  */
 
 #ifndef LIST_H
 #define LIST_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 typedef void *list_t;
 
 /**
@@ -29,37 +45,53 @@ typedef void *list_t;
  * Declared in header file so that compiler knows type size
  */
 typedef struct list_state {
-    void *_container;
     struct list_state *_next;
     struct list_state *_prev;
 } list_state_t;
 
 /**
- * List iteration function return codes
+ * Gets the element containing a list state structure
+ * @param state: list_state_t pointer
+ * @param type: type of the element
+ * @param member: name of the list_state_t member within type
  */
-typedef enum list_return {
-    LST_BRK,  /*!< End iteration */
-    LST_CONT, /*!< Continue iteration */
-    LST_REM,  /*!< Remove element */
-} list_return_t;
+#define LIST_ENTRY(state, type, member)                                        \
+    ((type *)((char *)(state) - offsetof(type, member)))
 
 /**
- * Appends element to a list
- * @param list: List to append to (if NULL, new list is created)
- * @param elem: element to append to list
- * @param state: list element state. Should be associated with elem.
- * @return new list on success, or NULL on error
+ * Iterates over a list, from head to tail. The list must not be modified
+ * within the loop.
+ * @param list: list to iterate over
+ * @param pos: list_state_t pointer, set to each element's state in turn
  */
-list_t list_append(list_t list, void *elem, list_state_t *state);
+#define LIST_FOR_EACH(list, pos)                                               \
+    for ((pos) = (list_state_t *)(list); (pos) != NULL;                        \
+         (pos) = (pos)->_next == (list_state_t *)(list) ? NULL : (pos)->_next)
 
 /**
- * Prepends element to a list
- * @param list: List to prepend to (if NULL, new list is created)
- * @param elem: element to append to list
- * @param state: list element state. Should be associated with elem.
- * @return new list on success, or NULL on error
+ * Iterates over a list, from head to tail. The current element may be
+ * removed within the loop with list_remove, as long as the result is
+ * stored back to the list variable. No other modification is allowed.
+ * @param list: list variable to iterate over
+ * @param pos: list_state_t pointer, set to each element's state in turn
+ * @param next: list_state_t pointer, used to hold the next element
  */
-list_t list_prepend(list_t list, void *elem, list_state_t *state);
+#define LIST_FOR_EACH_SAFE(list, pos, next)                                    \
+    for ((pos) = (list_state_t *)(list);                                       \
+         (pos) != NULL &&                                                      \
+         ((next) = (pos)->_next == (list_state_t *)(list) ? NULL               \
+                                                          : (pos)->_next,      \
+          true);                                                               \
+         (pos) = (next))
+
+/**
+ * List iteration function return codes
+ */
+typedef enum list_return {
+    LST_BRK,  /*!< End iteration */
+    LST_CONT, /*!< Continue iteration */
+    LST_REM,  /*!< Remove element */
+} list_return_t;
 
 /**
  * Iterates through linked list. If iterator function returns LST_BRK,
@@ -70,9 +102,12 @@ list_t list_prepend(list_t list, void *elem, list_state_t *state);
  * LST_CONT: iteration continues
  * LST_BRK: iteration ends on this element
  * LST_REM: unused
+ * @param type: type of list elements
+ * @param member: name of the list_state_t member within type
  * @return last list entry touched by iteration
  */
-void *list_iterate(list_t list, list_return_t (*itr)(void *));
+#define list_iterate(list, itr, type, member)                                  \
+    ((type *)list_iterate_offset((list), (itr), offsetof(type, member)))
 
 /**
  * Filters a linked list, using "itr" to determine if elements should be removed
@@ -82,10 +117,70 @@ void *list_iterate(list_t list, list_return_t (*itr)(void *));
  * continues iteration.
  * @param destructor: Function called with each element that the iterator
  * returns LST_REM for. Allows caller to free list elements.
+ * @param type: type of list elements
+ * @param member: name of the list_state_t member within type
  * @return new list after modification (or NULL on error/empty list)
  */
-list_t list_filter(list_t list, list_return_t (*itr)(void *),
-                   void (*destructor)(void *));
+#define list_filter(list, itr, destructor, type, member)                       \
+    list_filter_offset((list), (itr), (destructor), offsetof(type, member))
+
+/**
+ * Gets the head of a list without removing it
+ * @param list: list to get head of
+ * @param type: type of list elements
+ * @param member: name of the list_state_t member within type
+ * @return pointer to head element of list, or NULL for empty list
+ */
+#define list_get_head(list, type, member)                                      \
+    ((type *)list_get_head_offset((list), offsetof(type, member)))
+
+/**
+ * Gets the tail of a list without removing it
+ * @param list: list to get tail of
+ * @param type: type of list elements
+ * @param member: name of the list_state_t member within type
+ * @return pointer to tail element of list, or NULL for empty list
+ */
+#define list_get_tail(list, type, member)                                      \
+    ((type *)list_get_tail_offset((list), offsetof(type, member)))
+
+/**
+ * Appends element to a list
+ * @param list: List to append to (if NULL, new list is created)
+ * @param state: list state of the element to append
+ * @return new list on success, or NULL on error
+ */
+list_t list_append(list_t list, list_state_t *state);
+
+/**
+ * Prepends element to a list
+ * @param list: List to prepend to (if NULL, new list is created)
+ * @param state: list state of the element to prepend
+ * @return new list on success, or NULL on error
+ */
+list_t list_prepend(list_t list, list_state_t *state);
+
+/**
+ * Iterates through linked list. Use list_iterate rather than calling this
+ * directly.
+ * @param list: list to iterate over
+ * @param itr: iteration function, called with each element
+ * @param offset: offset of the list state within each element
+ * @return last list entry touched by iteration
+ */
+void *list_iterate_offset(list_t list, list_return_t (*itr)(void *),
+                          size_t offset);
+
+/**
+ * Filters a linked list. Use list_filter rather than calling this directly.
+ * @param list: list to filter
+ * @param itr: iterator function, called with each element
+ * @param destructor: Function called with each removed element
+ * @param offset: offset of the list state within each element
+ * @return new list after modification (or NULL on error/empty list)
+ */
+list_t list_filter_offset(list_t list, list_return_t (*itr)(void *),
+                          void (*destructor)(void *), size_t offset);
 
 /**
  * Remove the provided list_state_t from the list
@@ -97,17 +192,21 @@ list_t list_filter(list_t list, list_return_t (*itr)(void *),
 list_t list_remove(list_t list, list_state_t *target);
 
 /**
- * Gets the head of a list without removing it
+ * Gets the head of a list. Use list_get_head rather than calling this
+ * directly.
  * @param list: list to get head of
- * @return pointer to head element of list
+ * @param offset: offset of the list state within each element
+ * @return pointer to head element of list, or NULL for empty list
  */
-void *list_get_head(list_t list);
+void *list_get_head_offset(list_t list, size_t offset);
 
 /**
- * Gets the tail of a list without removing it
+ * Gets the tail of a list. Use list_get_tail rather than calling this
+ * directly.
  * @param list: list to get tail of
- * @return pointer to tail element of list
+ * @param offset: offset of the list state within each element
+ * @return pointer to tail element of list, or NULL for empty list
  */
-void *list_get_tail(list_t list);
+void *list_get_tail_offset(list_t list, size_t offset);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+/**
+ * @file mpsc.c
+ * Implements an intrusive multi-producer single-consumer queue
+ * The queue is a singly linked list from head to tail, which always holds at
+ * least one node. When it would otherwise be empty, it holds a stub node
+ * embedded in the queue structure, which the consumer skips over. Producers
+ * exchange themselves into the tail, then link the previous tail to
+ * themselves. Only the consumer moves the head.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mpsc.h"
+
+static inline mpsc_node_t *mpsc_load(mpsc_link_t *link);
+static inline void mpsc_store(mpsc_link_t *link, mpsc_node_t *node);
+static inline mpsc_node_t *mpsc_exchange(mpsc_link_t *link,
+                                         mpsc_node_t *node);
+
+/**
+ * Initializes an empty queue
+ * @param queue: queue to initialize
+ */
+void mpsc_init(mpsc_queue_t *queue) {
+    mpsc_store(&queue->_stub._next, NULL);
+    mpsc_store(&queue->_tail, &queue->_stub);
+    queue->_head = &queue->_stub;
+}
+
+/**
+ * Pushes an element to the tail of a queue. Safe to call from any task or
+ * interrupt handler, concurrently with other pushes and with mpsc_pop.
+ * @param queue: queue to push to
+ * @param node: queue node of the element to push. Must not be queued.
+ */
+void mpsc_push(mpsc_queue_t *queue, mpsc_node_t *node) {
+    mpsc_node_t *prev;
+    mpsc_store(&node->_next, NULL);
+    // Claim the tail, then link the old tail to this node
+    prev = mpsc_exchange(&queue->_tail, node);
+    mpsc_store(&prev->_next, node);
+}
+
+/**
+ * Pops an element from the head of a queue. Must only be called by one
+ * consumer at a time.
+ * If a push was interrupted between its exchange and store, elements from
+ * that push onward cannot be reached until it completes, and NULL is
+ * returned. Interrupt handlers always complete their pushes before a task
+ * can pop, so this is only seen when tasks push and are preempted.
+ * @param queue: queue to pop from
+ * @return queue node of the head element, or NULL if none can be popped
+ */
+mpsc_node_t *mpsc_pop(mpsc_queue_t *queue) {
+    mpsc_node_t *head = queue->_head;
+    mpsc_node_t *next = mpsc_load(&head->_next);
+    if (head == &queue->_stub) {
+        // Skip the stub
+        if (next == NULL) {
+            return NULL;
+        }
+        queue->_head = head = next;
+        next = mpsc_load(&head->_next);
+    }
+    if (next != NULL) {
+        queue->_head = next;
+        return head;
+    }
+    if (head != mpsc_load(&queue->_tail)) {
+        // A push has claimed the tail, but not yet linked to it
+        return NULL;
+    }
+    /**
+     * head is the last node. Push the stub behind it, so head can be popped
+     * without the queue becoming empty.
+     */
+    mpsc_push(queue, &queue->_stub);
+    next = mpsc_load(&head->_next);
+    if (next != NULL) {
+        queue->_head = next;
+        return head;
+    }
+    return NULL;
+}
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+
+/**
+ * Reads a link. The Cortex-M4 has a single core, so the compiler barrier is
+ * all that is needed to order memory accesses.
+ * @param link: link to read
+ * @return node link refers to
+ */
+static inline mpsc_node_t *mpsc_load(mpsc_link_t *link) {
+    mpsc_node_t *node = *link;
+    asm volatile("" ::: "memory");
+    return node;
+}
+
+/**
+ * Writes a link, after all earlier memory accesses
+ * @param link: link to write
+ * @param node: node to refer to
+ */
+static inline void mpsc_store(mpsc_link_t *link, mpsc_node_t *node) {
+    asm volatile("" ::: "memory");
+    *link = node;
+}
+
+/**
+ * Atomically exchanges a link. The exclusive monitor is cleared by any
+ * exception return, so STREX only fails if an exception was taken after the
+ * LDREX, and the retry then runs uninterrupted unless another one arrives.
+ * @param link: link to exchange
+ * @param node: node to refer to
+ * @return node link previously referred to
+ */
+static inline mpsc_node_t *mpsc_exchange(mpsc_link_t *link,
+                                         mpsc_node_t *node) {
+    mpsc_node_t *prev;
+    uint32_t failed;
+    asm volatile("try_exchange_%=:\n"
+                 "ldrex %[prev], [%[link]]\n" // Get current link value
+                 "strex %[failed], %[node], [%[link]]\n" // Try to replace it
+                 "cmp %[failed], #0x0\n" // Check if strex updated memory
+                 "it ne\n"
+                 "bne try_exchange_%=\n" // strex failed, retry exchange
+                 : [ prev ] "=&r"(prev), [ failed ] "=&r"(failed)
+                 : [ link ] "r"(link), [ node ] "r"(node)
+                 : "cc", "memory");
+    return prev;
+}
+
+#else
+
+/**
+ * Reads a link, before all later memory accesses
+ * @param link: link to read
+ * @return node link refers to
+ */
+static inline mpsc_node_t *mpsc_load(mpsc_link_t *link) {
+    return atomic_load_explicit(link, memory_order_acquire);
+}
+
+/**
+ * Writes a link, after all earlier memory accesses
+ * @param link: link to write
+ * @param node: node to refer to
+ */
+static inline void mpsc_store(mpsc_link_t *link, mpsc_node_t *node) {
+    atomic_store_explicit(link, node, memory_order_release);
+}
+
+/**
+ * Atomically exchanges a link
+ * @param link: link to exchange
+ * @param node: node to refer to
+ * @return node link previously referred to
+ */
+static inline mpsc_node_t *mpsc_exchange(mpsc_link_t *link,
+                                         mpsc_node_t *node) {
+    return atomic_exchange_explicit(link, node, memory_order_acq_rel);
+}
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * @file mpsc.h
+ * Implements an intrusive multi-producer single-consumer queue
+ * Any number of tasks or interrupt handlers may push to the queue, and one
+ * task pops from it. Neither side masks interrupts or takes a lock. A push
+ * is a single atomic exchange followed by a store. On the target, the
+ * exchange uses LDREX/STREX, which only retries if an exception was taken
+ * between the two instructions, so a push never waits on another context.
+ * Host builds use C11 atomics instead, so the queue can be tested there.
+ *
+ * Elements store the queue's state within an mpsc_node_t structure, so the
+ * queue never allocates memory. Elements pop in the order they were pushed.
+ *
+ * For example, this would pass an event from an interrupt handler to a task:
+ * struct event {
+ *      uint32_t data;
+ *      mpsc_node_t node;
+ * };
+ *
+ * mpsc_queue_t events; // Initialized with mpsc_init(&events) at startup
+ * // In the interrupt handler:
+ * mpsc_push(&events, &ev->node);
+ * // In the task:
+ * mpsc_node_t *node = mpsc_pop(&events);
+ * if (node != NULL) {
+ *      struct event *ev = MPSC_ENTRY(node, struct event, node);
+ * }
+ */
+
+#ifndef MPSC_H
+#define MPSC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+/** Link to a node. Exchanged with LDREX/STREX */
+typedef struct mpsc_node *volatile mpsc_link_t;
+#else
+#include <stdatomic.h>
+/** Link to a node. Exchanged with C11 atomics */
+typedef _Atomic(struct mpsc_node *) mpsc_link_t;
+#endif
+
+/**
+ * Internal queue node structure. Do NOT manipulate these fields.
+ * Declared in header file so that compiler knows type size
+ */
+typedef struct mpsc_node {
+    mpsc_link_t _next; /*!< Next node toward the tail */
+} mpsc_node_t;
+
+/**
+ * Queue structure. Initialize with mpsc_init before use.
+ */
+typedef struct mpsc_queue {
+    mpsc_link_t _tail;  /*!< Last node pushed. Written by producers */
+    mpsc_node_t *_head; /*!< Next node to pop. Used only by the consumer */
+    mpsc_node_t _stub;  /*!< Placeholder node, keeps the queue nonempty */
+} mpsc_queue_t;
+
+/**
+ * Gets the element containing a queue node structure
+ * @param node: mpsc_node_t pointer
+ * @param type: type of the element
+ * @param member: name of the mpsc_node_t member within type
+ */
+#define MPSC_ENTRY(node, type, member)                                         \
+    ((type *)((char *)(node)-offsetof(type, member)))
+
+/**
+ * Initializes an empty queue
+ * @param queue: queue to initialize
+ */
+void mpsc_init(mpsc_queue_t *queue);
+
+/**
+ * Pushes an element to the tail of a queue. Safe to call from any task or
+ * interrupt handler, concurrently with other pushes and with mpsc_pop.
+ * @param queue: queue to push to
+ * @param node: queue node of the element to push. Must not be queued.
+ */
+void mpsc_push(mpsc_queue_t *queue, mpsc_node_t *node);
+
+/**
+ * Pops an element from the head of a queue. Must only be called by one
+ * consumer at a time.
+ * If a push was interrupted between its exchange and store, elements from
+ * that push onward cannot be reached until it completes, and NULL is
+ * returned. Interrupt handlers always complete their pushes before a task
+ * can pop, so this is only seen when tasks push and are preempted.
+ * @param queue: queue to pop from
+ * @return queue node of the head element, or NULL if none can be popped
+ */
+mpsc_node_t *mpsc_pop(mpsc_queue_t *queue);
+
+#endif
@@ -0,0 +1,216 @@
+/**
+ * @file perf.c
+ * Implements access to the Cortex-M4 DWT performance counters and ITM
+ * timestamps.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <drivers/device/device.h>
+#include <util/bitmask.h>
+
+#include "perf.h"
+
+/** Value that unlocks ITM register writes */
+#define ITM_LAR_UNLOCK 0xC5ACCE55UL
+/** 8 bit DWT event counters */
+#define EVENT_COUNTER_MASK 0xFFUL
+
+// Cycles taken by perf_snapshot, removed from region cycle counts
+static uint32_t snapshot_cycles = 0;
+
+static uint32_t ctrl_mask(uint32_t counters);
+static void calibrate(void);
+
+/**
+ * Enables performance counters. Counters keep their current values.
+ * @param counters: mask of counters to enable
+ * @return SYS_OK on success, or ERR_NOSUPPORT if the core has no cycle
+ * counter and PERF_CYCLES was requested
+ */
+syserr_t perf_enable(uint32_t counters) {
+    // DWT registers only count once the trace block is enabled
+    SETBITS(CoreDebug->DEMCR, CoreDebug_DEMCR_TRCENA_Msk);
+    if ((counters & PERF_CYCLES) &&
+        READBITS(DWT->CTRL, DWT_CTRL_NOCYCCNT_Msk) != 0UL) {
+        return ERR_NOSUPPORT;
+    }
+    SETBITS(DWT->CTRL, ctrl_mask(counters));
+    if (counters & PERF_CYCLES) {
+        calibrate();
+    }
+    return SYS_OK;
+}
+
+/**
+ * Disables performance counters. Counters keep their current values.
+ * @param counters: mask of counters to disable
+ */
+void perf_disable(uint32_t counters) {
+    CLEARBITS(DWT->CTRL, ctrl_mask(counters));
+}
+
+/**
+ * Resets performance counters to zero. Other users of the cycle counter
+ * (such as the trace recorder) will see it jump, so prefer PERF_START.
+ * @param counters: mask of counters to reset
+ */
+void perf_reset(uint32_t counters) {
+    if (counters & PERF_CYCLES) {
+        DWT->CYCCNT = 0;
+    }
+    if (counters & PERF_CPI) {
+        DWT->CPICNT = 0;
+    }
+    if (counters & PERF_EXC) {
+        DWT->EXCCNT = 0;
+    }
+    if (counters & PERF_SLEEP) {
+        DWT->SLEEPCNT = 0;
+    }
+    if (counters & PERF_LSU) {
+        DWT->LSUCNT = 0;
+    }
+    if (counters & PERF_FOLD) {
+        DWT->FOLDCNT = 0;
+    }
+}
+
+/**
+ * Reads one performance counter
+ * @param counter: counter to read
+ * @return counter value
+ */
+uint32_t perf_read(perf_counter_t counter) {
+    switch (counter) {
+    case PERF_CYCLES:
+        return DWT->CYCCNT;
+    case PERF_CPI:
+        return DWT->CPICNT & EVENT_COUNTER_MASK;
+    case PERF_EXC:
+        return DWT->EXCCNT & EVENT_COUNTER_MASK;
+    case PERF_SLEEP:
+        return DWT->SLEEPCNT & EVENT_COUNTER_MASK;
+    case PERF_LSU:
+        return DWT->LSUCNT & EVENT_COUNTER_MASK;
+    case PERF_FOLD:
+        return DWT->FOLDCNT & EVENT_COUNTER_MASK;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Reads all performance counters
+ * @param counts: set to counter values
+ */
+void perf_snapshot(perf_counts_t *counts) {
+    /**
+     * Counters are always read in the same order, so the cost of a snapshot
+     * is constant and calibrate can remove it from region cycle counts
+     */
+    counts->cpi = DWT->CPICNT;
+    counts->exc = DWT->EXCCNT;
+    counts->sleep = DWT->SLEEPCNT;
+    counts->lsu = DWT->LSUCNT;
+    counts->fold = DWT->FOLDCNT;
+    counts->cycles = DWT->CYCCNT;
+}
+
+/**
+ * Gets the counts between two snapshots. The cost of taking a snapshot is
+ * removed from the cycle count, and 8 bit counters are taken modulo 256.
+ * @param start: snapshot at start of region
+ * @param end: snapshot at end of region
+ * @param delta: set to counts within the region
+ */
+void perf_elapsed(const perf_counts_t *start, const perf_counts_t *end,
+                  perf_counts_t *delta) {
+    uint32_t cycles = end->cycles - start->cycles;
+    delta->cycles = cycles > snapshot_cycles ? cycles - snapshot_cycles : 0;
+    delta->cpi = (end->cpi - start->cpi) & EVENT_COUNTER_MASK;
+    delta->exc = (end->exc - start->exc) & EVENT_COUNTER_MASK;
+    delta->sleep = (end->sleep - start->sleep) & EVENT_COUNTER_MASK;
+    delta->lsu = (end->lsu - start->lsu) & EVENT_COUNTER_MASK;
+    delta->fold = (end->fold - start->fold) & EVENT_COUNTER_MASK;
+}
+
+/**
+ * Estimates the number of instructions executed from region counts, as
+ * cycles - cpi - exc - sleep - lsu + fold. Only valid if no 8 bit counter
+ * wrapped within the region.
+ * @param delta: region counts from perf_elapsed
+ * @return instructions executed
+ */
+uint32_t perf_instructions(const perf_counts_t *delta) {
+    return delta->cycles - delta->cpi - delta->exc - delta->sleep -
+           delta->lsu + delta->fold;
+}
+
+/**
+ * Enables or disables ITM local timestamps, so packets on the SWO output
+ * carry the cycle count they were emitted at. The debugger must enable ITM.
+ * @param enable: true to enable timestamps
+ * @return SYS_OK on success, or ERR_NOTINIT if ITM is not enabled
+ */
+syserr_t perf_itm_timestamps(bool enable) {
+    if (READBITS(ITM->TCR, ITM_TCR_ITMENA_Msk) == 0UL) {
+        return ERR_NOTINIT;
+    }
+    ITM->LAR = ITM_LAR_UNLOCK;
+    if (enable) {
+        // Timestamp with the undivided core clock
+        CLEARBITS(ITM->TCR, ITM_TCR_TSPrescale_Msk);
+        SETBITS(ITM->TCR, ITM_TCR_TSENA_Msk);
+    } else {
+        CLEARBITS(ITM->TCR, ITM_TCR_TSENA_Msk);
+    }
+    return SYS_OK;
+}
+
+/**
+ * Converts a counter mask to DWT CTRL enable bits
+ * @param counters: mask of counters
+ * @return DWT CTRL bits enabling the counters
+ */
+static uint32_t ctrl_mask(uint32_t counters) {
+    uint32_t mask = 0;
+    if (counters & PERF_CYCLES) {
+        mask |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    if (counters & PERF_CPI) {
+        mask |= DWT_CTRL_CPIEVTENA_Msk;
+    }
+    if (counters & PERF_EXC) {
+        mask |= DWT_CTRL_EXCEVTENA_Msk;
+    }
+    if (counters & PERF_SLEEP) {
+        mask |= DWT_CTRL_SLEEPEVTENA_Msk;
+    }
+    if (counters & PERF_LSU) {
+        mask |= DWT_CTRL_LSUEVTENA_Msk;
+    }
+    if (counters & PERF_FOLD) {
+        mask |= DWT_CTRL_FOLDEVTENA_Msk;
+    }
+    return mask;
+}
+
+/**
+ * Measures the cycles an empty PERF_START/PERF_STOP region counts, so they
+ * can be removed from region cycle counts. Takes the minimum of several
+ * runs, since an interrupt may land in any one of them.
+ */
+static void calibrate(void) {
+    perf_counts_t start, end;
+    uint32_t i, cycles, best = UINT32_MAX;
+    for (i = 0; i < 8; i++) {
+        perf_snapshot(&start);
+        perf_snapshot(&end);
+        cycles = end.cycles - start.cycles;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    snapshot_cycles = best;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file perf.h
+ * Implements access to the Cortex-M4 DWT performance counters and ITM
+ * timestamps.
+ *
+ * The DWT has a 32 bit cycle counter, and five 8 bit event counters:
+ * - CPI: extra cycles taken by multi cycle instructions
+ * - EXC: cycles spent in exception entry and exit
+ * - SLEEP: cycles spent sleeping
+ * - LSU: extra cycles taken by loads and stores
+ * - FOLD: instructions folded into another (taking zero cycles)
+ * Event counters wrap at 256, so their counts are exact only for regions
+ * with fewer than 256 events of each kind.
+ *
+ * Code regions are measured with PERF_START and PERF_STOP:
+ * perf_counts_t delta;
+ * perf_enable(PERF_ALL);
+ * PERF_START(region);
+ * ... code to measure ...
+ * PERF_STOP(region, &delta);
+ */
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/err.h>
+
+/**
+ * Performance counters. Values may be combined as a mask.
+ */
+typedef enum {
+    PERF_CYCLES = 0x01, /*!< 32 bit cycle counter (CYCCNT) */
+    PERF_CPI = 0x02,    /*!< Multi cycle instruction counter (CPICNT) */
+    PERF_EXC = 0x04,    /*!< Exception overhead counter (EXCCNT) */
+    PERF_SLEEP = 0x08,  /*!< Sleep cycle counter (SLEEPCNT) */
+    PERF_LSU = 0x10,    /*!< Load store extra cycle counter (LSUCNT) */
+    PERF_FOLD = 0x20,   /*!< Folded instruction counter (FOLDCNT) */
+} perf_counter_t;
+
+/** Mask of all performance counters */
+#define PERF_ALL 0x3F
+
+/**
+ * Performance counter values
+ */
+typedef struct {
+    uint32_t cycles; /*!< Cycles */
+    uint32_t cpi;    /*!< Extra cycles of multi cycle instructions */
+    uint32_t exc;    /*!< Exception overhead cycles */
+    uint32_t sleep;  /*!< Sleep cycles */
+    uint32_t lsu;    /*!< Extra load store cycles */
+    uint32_t fold;   /*!< Folded instructions */
+} perf_counts_t;
+
+/**
+ * Starts measuring a code region
+ * @param region: region name. Declares a variable in the current scope
+ */
+#define PERF_START(region)                                                     \
+    perf_counts_t region##_perf_start;                                         \
+    perf_snapshot(&region##_perf_start)
+
+/**
+ * Stops measuring a code region started with PERF_START
+ * @param region: region name passed to PERF_START
+ * @param delta: perf_counts_t pointer, set to counts within the region
+ */
+#define PERF_STOP(region, delta)                                               \
+    do {                                                                       \
+        perf_counts_t _perf_end;                                               \
+        perf_snapshot(&_perf_end);                                             \
+        perf_elapsed(&region##_perf_start, &_perf_end, (delta));               \
+    } while (0)
+
+/**
+ * Enables performance counters. Counters keep their current values.
+ * @param counters: mask of counters to enable
+ * @return SYS_OK on success, or ERR_NOSUPPORT if the core has no cycle
+ * counter and PERF_CYCLES was requested
+ */
+syserr_t perf_enable(uint32_t counters);
+
+/**
+ * Disables performance counters. Counters keep their current values.
+ * @param counters: mask of counters to disable
+ */
+void perf_disable(uint32_t counters);
+
+/**
+ * Resets performance counters to zero. Other users of the cycle counter
+ * (such as the trace recorder) will see it jump, so prefer PERF_START.
+ * @param counters: mask of counters to reset
+ */
+void perf_reset(uint32_t counters);
+
+/**
+ * Reads one performance counter
+ * @param counter: counter to read
+ * @return counter value
+ */
+uint32_t perf_read(perf_counter_t counter);
+
+/**
+ * Reads all performance counters
+ * @param counts: set to counter values
+ */
+void perf_snapshot(perf_counts_t *counts);
+
+/**
+ * Gets the counts between two snapshots. The cost of taking a snapshot is
+ * removed from the cycle count, and 8 bit counters are taken modulo 256.
+ * @param start: snapshot at start of region
+ * @param end: snapshot at end of region
+ * @param delta: set to counts within the region
+ */
+void perf_elapsed(const perf_counts_t *start, const perf_counts_t *end,
+                  perf_counts_t *delta);
+
+/**
+ * Estimates the number of instructions executed from region counts, as
+ * cycles - cpi - exc - sleep - lsu + fold. Only valid if no 8 bit counter
+ * wrapped within the region.
+ * @param delta: region counts from perf_elapsed
+ * @return instructions executed
+ */
+uint32_t perf_instructions(const perf_counts_t *delta);
+
+/**
+ * Enables or disables ITM local timestamps, so packets on the SWO output
+ * carry the cycle count they were emitted at. The debugger must enable ITM.
+ * @param enable: true to enable timestamps
+ * @return SYS_OK on success, or ERR_NOTINIT if ITM is not enabled
+ */
+syserr_t perf_itm_timestamps(bool enable);
+
+#endif
@@ -0,0 +1,239 @@
+/**
+ * @file heap_host_test.c
+ * Tests the priority heap against a simple array model. Built and run on the
+ * host, see Makefile.
+ *
+ * Expected output:
+ * Test 1 passed: empty heap peeks and pops nothing
+ * Test 2 passed: inserted elements pop in order
+ * Test 3 passed: removing arbitrary elements kept the order
+ * Test 4 passed: random inserts, pops and removes matched the model
+ * Test 5 passed: popped elements could be inserted again
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <util/heap/heap.h>
+
+#define NUM_ELEMS 1000
+#define RANDOM_OPS 100000
+
+/**
+ * Heap element. The node is deliberately not the first member, so elements
+ * are only found correctly if the member offset is honoured.
+ */
+struct heap_entry {
+    uint32_t deadline;
+    bool queued;
+    heap_node_t node;
+};
+
+static struct heap_entry elements[NUM_ELEMS];
+
+/**
+ * Orders elements by deadline
+ */
+static bool earlier(heap_node_t *a, heap_node_t *b) {
+    return HEAP_ENTRY(a, struct heap_entry, node)->deadline <
+           HEAP_ENTRY(b, struct heap_entry, node)->deadline;
+}
+
+/**
+ * Pops every element of a heap, checking that deadlines never decrease
+ * @param heap: heap to empty
+ * @param expected: number of elements the heap should hold
+ * @return true if the elements popped in order, and there were as many as
+ * expected
+ */
+static bool pop_all(heap_t *heap, uint32_t expected) {
+    struct heap_entry *elem;
+    heap_node_t *node;
+    uint32_t count = 0, last = 0;
+    while ((node = heap_pop(heap)) != NULL) {
+        elem = HEAP_ENTRY(node, struct heap_entry, node);
+        if (elem->deadline < last || !elem->queued) {
+            return false;
+        }
+        elem->queued = false;
+        last = elem->deadline;
+        count++;
+    }
+    return count == expected;
+}
+
+/**
+ * Fills a heap with every element, with random deadlines
+ * @param heap: heap to fill
+ */
+static void fill(heap_t *heap) {
+    uint32_t i;
+    for (i = 0; i < NUM_ELEMS; i++) {
+        elements[i].deadline = rand() % (NUM_ELEMS / 4);
+        elements[i].queued = true;
+        heap_insert(heap, &elements[i].node);
+    }
+}
+
+/**
+ * Gets the least deadline among queued elements
+ * @return least deadline, or UINT32_MAX if no element is queued
+ */
+static uint32_t model_min(void) {
+    uint32_t i, min = UINT32_MAX;
+    for (i = 0; i < NUM_ELEMS; i++) {
+        if (elements[i].queued && elements[i].deadline < min) {
+            min = elements[i].deadline;
+        }
+    }
+    return min;
+}
+
+static bool test_empty(void) {
+    heap_t heap;
+    heap_init(&heap, earlier);
+    return heap_empty(&heap) && heap_peek(&heap) == NULL &&
+           heap_pop(&heap) == NULL;
+}
+
+static bool test_order(void) {
+    heap_t heap;
+    heap_init(&heap, earlier);
+    fill(&heap);
+    if (HEAP_ENTRY(heap_peek(&heap), struct heap_entry, node)->deadline !=
+        model_min()) {
+        return false;
+    }
+    return pop_all(&heap, NUM_ELEMS) && heap_empty(&heap);
+}
+
+static bool test_remove(void) {
+    heap_t heap;
+    uint32_t i, removed = 0;
+    heap_init(&heap, earlier);
+    fill(&heap);
+    // Pop once so the heap has structure, then remove every third element
+    HEAP_ENTRY(heap_pop(&heap), struct heap_entry, node)->queued = false;
+    for (i = 0; i < NUM_ELEMS; i += 3) {
+        if (elements[i].queued) {
+            heap_remove(&heap, &elements[i].node);
+            elements[i].queued = false;
+            removed++;
+        }
+    }
+    if (HEAP_ENTRY(heap_peek(&heap), struct heap_entry, node)->deadline !=
+        model_min()) {
+        return false;
+    }
+    return pop_all(&heap, NUM_ELEMS - 1 - removed);
+}
+
+static bool test_random(void) {
+    heap_t heap;
+    heap_node_t *node;
+    struct heap_entry *elem;
+    uint32_t i, count = 0;
+    heap_init(&heap, earlier);
+    for (i = 0; i < RANDOM_OPS; i++) {
+        elem = &elements[rand() % NUM_ELEMS];
+        switch (rand() % 3) {
+        case 0:
+            // Insert, or remove if already queued
+            if (elem->queued) {
+                heap_remove(&heap, &elem->node);
+                elem->queued = false;
+                count--;
+            } else {
+                elem->deadline = rand() % 1000;
+                elem->queued = true;
+                heap_insert(&heap, &elem->node);
+                count++;
+            }
+            break;
+        case 1:
+            // Pop, which must return an element with the least deadline
+            node = heap_pop(&heap);
+            if (node == NULL) {
+                if (count != 0) {
+                    return false;
+                }
+                break;
+            }
+            elem = HEAP_ENTRY(node, struct heap_entry, node);
+            if (!elem->queued || elem->deadline != model_min()) {
+                return false;
+            }
+            elem->queued = false;
+            count--;
+            break;
+        default:
+            // Peek
+            node = heap_peek(&heap);
+            if ((node == NULL) != (count == 0) ||
+                (node != NULL &&
+                 HEAP_ENTRY(node, struct heap_entry, node)->deadline !=
+                     model_min())) {
+                return false;
+            }
+            break;
+        }
+    }
+    return pop_all(&heap, count);
+}
+
+static bool test_reinsert(void) {
+    heap_t heap;
+    struct heap_entry *elem;
+    uint32_t i;
+    heap_init(&heap, earlier);
+    fill(&heap);
+    // Repeatedly move the earliest element to a later deadline
+    for (i = 0; i < NUM_ELEMS * 10; i++) {
+        elem = HEAP_ENTRY(heap_pop(&heap), struct heap_entry, node);
+        if (elem->deadline != model_min()) {
+            return false;
+        }
+        elem->deadline += 1 + rand() % 100;
+        heap_insert(&heap, &elem->node);
+    }
+    return pop_all(&heap, NUM_ELEMS);
+}
+
+int main() {
+    int failures = 0;
+    srand(1);
+    if (test_empty()) {
+        printf("Test 1 passed: empty heap peeks and pops nothing\n");
+    } else {
+        printf("Test 1 failed\n");
+        failures++;
+    }
+    if (test_order()) {
+        printf("Test 2 passed: inserted elements pop in order\n");
+    } else {
+        printf("Test 2 failed\n");
+        failures++;
+    }
+    if (test_remove()) {
+        printf("Test 3 passed: removing arbitrary elements kept the order\n");
+    } else {
+        printf("Test 3 failed\n");
+        failures++;
+    }
+    if (test_random()) {
+        printf("Test 4 passed: random inserts, pops and removes matched the "
+               "model\n");
+    } else {
+        printf("Test 4 failed\n");
+        failures++;
+    }
+    if (test_reinsert()) {
+        printf("Test 5 passed: popped elements could be inserted again\n");
+    } else {
+        printf("Test 5 failed\n");
+        failures++;
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
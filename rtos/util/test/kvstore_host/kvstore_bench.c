@@ -0,0 +1,87 @@
+/**
+ * @file kvstore_bench.c
+ * Benchmarks the key-value store on simulated flash. Reports operation
+ * rates, flash bytes programmed per write (write amplification), erases,
+ * and the spread of erase counts across pages. Built and run on the host,
+ * see Makefile.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <util/kvstore/kvstore.h>
+
+#include "sim_flash.h"
+
+#define PAGE_SIZE 2048
+#define NUM_PAGES 16
+#define NUM_KEYS 64
+#define INDEX_LEN 128
+#define VAL_LEN 24
+#define WRITES 200000
+#define READS 1000000
+
+static kv_index_entry_t index_store[INDEX_LEN];
+
+/**
+ * Gets monotonic time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main() {
+    sim_flash_t sim;
+    kv_flash_t flash;
+    kv_store_t kv;
+    char keys[NUM_KEYS][KV_MAX_KEY_LEN + 1];
+    uint8_t val[VAL_LEN];
+    double start, write_time, read_time, mount_time;
+    uint32_t i, min = UINT32_MAX, max = 0;
+    volatile int sink = 0;
+    syserr_t err;
+    sim_flash_init(&sim, &flash, PAGE_SIZE, NUM_PAGES);
+    if (kv_mount(&kv, &flash, index_store, INDEX_LEN) != SYS_OK) {
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "config/param%02u", i);
+    }
+    srand(1);
+    /* Random updates. Garbage is collected as writes need it */
+    start = now();
+    for (i = 0; i < WRITES; i++) {
+        val[i % VAL_LEN] = i;
+        if (kv_set(&kv, keys[rand() % NUM_KEYS], val, VAL_LEN) != SYS_OK) {
+            printf("Write %u failed\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    write_time = now() - start;
+    start = now();
+    for (i = 0; i < READS; i++) {
+        sink += kv_get(&kv, keys[i % NUM_KEYS], val, VAL_LEN, &err);
+    }
+    read_time = now() - start;
+    start = now();
+    kv_mount(&kv, &flash, index_store, INDEX_LEN);
+    mount_time = now() - start;
+    for (i = 0; i < NUM_PAGES; i++) {
+        min = sim.erase_counts[i] < min ? sim.erase_counts[i] : min;
+        max = sim.erase_counts[i] > max ? sim.erase_counts[i] : max;
+    }
+    printf("writes:            %10.0f /s\n", WRITES / write_time);
+    printf("reads:             %10.0f /s\n", READS / read_time);
+    printf("mount:             %10.3f ms\n", mount_time * 1e3);
+    printf("bytes per write:   %10.1f (value %u, key %u)\n",
+           (double)sim.programs * 8 / WRITES, VAL_LEN,
+           (uint32_t)sizeof("config/paramXX") - 1);
+    printf("erases per 1000:   %10.2f\n", (double)sim.erases * 1000 / WRITES);
+    printf("erase count range: %6u - %u\n", min, max);
+    sim_flash_free(&sim);
+    return sink == 0;
+}
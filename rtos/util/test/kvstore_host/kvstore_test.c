@@ -0,0 +1,364 @@
+/**
+ * @file kvstore_test.c
+ * Tests the key-value store on simulated flash. Built and run on the host,
+ * see Makefile.
+ *
+ * Expected output:
+ * Test 1 passed: set, get and delete behaved correctly
+ * Test 2 passed: remount restored all keys
+ * Test 3 passed: wear levelled across pages
+ * Test 4 passed: every power failure point recovered
+ * Test 5 passed: full index and full store were rejected
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/kvstore/kvstore.h>
+
+#include "sim_flash.h"
+
+#define NUM_KEYS 16
+#define MAX_VAL_LEN 48
+#define INDEX_LEN 32
+
+/**
+ * Expected contents of one key
+ */
+typedef struct {
+    uint8_t val[MAX_VAL_LEN]; /*!< Expected value */
+    int len;                  /*!< Expected length, or -1 if deleted */
+} model_t;
+
+static kv_index_entry_t index_store[INDEX_LEN];
+static model_t model[NUM_KEYS];
+
+/**
+ * Gets the name of a test key
+ * @param key: key number
+ * @return key name. Overwritten by the next call
+ */
+static const char *key_name(int key) {
+    static char name[16];
+    snprintf(name, sizeof(name), "key%02d", key);
+    return name;
+}
+
+/**
+ * Fills a value with a pattern derived from a seed
+ * @param val: value to fill
+ * @param seed: pattern seed
+ * @return length of value
+ */
+static int make_value(uint8_t *val, uint32_t seed) {
+    int len = 1 + seed % (MAX_VAL_LEN - 1);
+    int i;
+    for (i = 0; i < len; i++) {
+        val[i] = seed * 7 + i;
+    }
+    return len;
+}
+
+/**
+ * Checks that every key in a store matches the model
+ * @param kv: store to check
+ * @return true if the store matches
+ */
+static bool check_model(kv_store_t *kv) {
+    uint8_t val[MAX_VAL_LEN];
+    syserr_t err;
+    int i, len;
+    for (i = 0; i < NUM_KEYS; i++) {
+        len = kv_get(kv, key_name(i), val, sizeof(val), &err);
+        if (model[i].len < 0) {
+            if (err != ERR_NOTFOUND) {
+                printf("%s should be deleted\n", key_name(i));
+                return false;
+            }
+        } else if (err != SYS_OK || len != model[i].len ||
+                   memcmp(val, model[i].val, len) != 0) {
+            printf("%s does not match\n", key_name(i));
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Compares two expected key contents
+ * @param a: first contents
+ * @param b: second contents
+ * @return true if both are deleted, or hold the same value
+ */
+static bool model_equal(const model_t *a, const model_t *b) {
+    return a->len == b->len &&
+           (a->len < 0 || memcmp(a->val, b->val, a->len) == 0);
+}
+
+/**
+ * Sets a key in both the store and the model
+ * @param kv: store to write to
+ * @param key: key number
+ * @param seed: value seed
+ * @return result of kv_set
+ */
+static syserr_t set_key(kv_store_t *kv, int key, uint32_t seed) {
+    uint8_t val[MAX_VAL_LEN];
+    int len = make_value(val, seed);
+    syserr_t err = kv_set(kv, key_name(key), val, len);
+    if (err == SYS_OK) {
+        memcpy(model[key].val, val, len);
+        model[key].len = len;
+    }
+    return err;
+}
+
+/**
+ * Sets, gets, overwrites and deletes keys
+ */
+static bool test_basic(void) {
+    sim_flash_t sim;
+    kv_flash_t flash;
+    kv_store_t kv;
+    char val[16];
+    syserr_t err;
+    int len;
+    bool passed = true;
+    sim_flash_init(&sim, &flash, 1024, 4);
+    passed &= kv_mount(&kv, &flash, index_store, INDEX_LEN) == SYS_OK;
+    passed &= kv_set(&kv, "baud", "115200", 6) == SYS_OK;
+    passed &= kv_set(&kv, "gain", "3", 1) == SYS_OK;
+    len = kv_get(&kv, "baud", val, sizeof(val), &err);
+    passed &= err == SYS_OK && len == 6 && memcmp(val, "115200", 6) == 0;
+    passed &= kv_set(&kv, "baud", "9600", 4) == SYS_OK;
+    len = kv_get(&kv, "baud", val, sizeof(val), &err);
+    passed &= err == SYS_OK && len == 4 && memcmp(val, "9600", 4) == 0;
+    // Truncated read still reports the full length
+    len = kv_get(&kv, "baud", val, 2, &err);
+    passed &= err == SYS_OK && len == 4;
+    // Rewriting the same value programs nothing
+    sim.programs = 0;
+    passed &= kv_set(&kv, "baud", "9600", 4) == SYS_OK && sim.programs == 0;
+    passed &= kv_delete(&kv, "gain") == SYS_OK;
+    kv_get(&kv, "gain", val, sizeof(val), &err);
+    passed &= err == ERR_NOTFOUND;
+    passed &= kv_delete(&kv, "gain") == ERR_NOTFOUND;
+    kv_get(&kv, "none", val, sizeof(val), &err);
+    passed &= err == ERR_NOTFOUND;
+    passed &= kv_set(&kv, "", "x", 1) == ERR_BADPARAM;
+    passed &= sim.violations == 0;
+    sim_flash_free(&sim);
+    return passed;
+}
+
+/**
+ * Remounts a store, and checks the index is rebuilt
+ */
+static bool test_remount(void) {
+    sim_flash_t sim;
+    kv_flash_t flash;
+    kv_store_t kv;
+    bool passed = true;
+    int i;
+    sim_flash_init(&sim, &flash, 1024, 4);
+    passed &= kv_mount(&kv, &flash, index_store, INDEX_LEN) == SYS_OK;
+    for (i = 0; i < NUM_KEYS; i++) {
+        passed &= set_key(&kv, i, i) == SYS_OK;
+    }
+    for (i = 0; i < NUM_KEYS; i += 3) {
+        passed &= set_key(&kv, i, i + 100) == SYS_OK;
+    }
+    for (i = 1; i < NUM_KEYS; i += 4) {
+        passed &= kv_delete(&kv, key_name(i)) == SYS_OK;
+        model[i].len = -1;
+    }
+    passed &= kv_mount(&kv, &flash, index_store, INDEX_LEN) == SYS_OK;
+    passed &= check_model(&kv);
+    sim_flash_free(&sim);
+    return passed;
+}
+
+/**
+ * Writes many updates, collecting garbage in the idle hook, and checks
+ * pages are erased evenly
+ */
+static bool test_wear(void) {
+    sim_flash_t sim;
+    kv_flash_t flash;
+    kv_store_t kv;
+    uint32_t i, min = UINT32_MAX, max = 0;
+    bool passed = true;
+    sim_flash_init(&sim, &flash, 1024, 8);
+    passed &= kv_mount(&kv, &flash, index_store, INDEX_LEN) == SYS_OK;
+    srand(2);
+    for (i = 0; i < 20000 && passed; i++) {
+        passed &= set_key(&kv, rand() % NUM_KEYS, rand()) == SYS_OK;
+        if (i % 8 == 0) {
+            kv_idle_gc(&kv);
+        }
+    }
+    passed &= check_model(&kv);
+    for (i = 0; i < flash.num_pages; i++) {
+        min = sim.erase_counts[i] < min ? sim.erase_counts[i] : min;
+        max = sim.erase_counts[i] > max ? sim.erase_counts[i] : max;
+    }
+    if (max - min > 1) {
+        printf("Erase counts range from %u to %u\n", min, max);
+        passed = false;
+    }
+    passed &= kv_mount(&kv, &flash, index_store, INDEX_LEN) == SYS_OK;
+    passed &= check_model(&kv);
+    passed &= sim.violations == 0;
+    sim_flash_free(&sim);
+    return passed;
+}
+
+/**
+ * Fails power at every program and erase of a write sequence, and checks
+ * each key holds its old or new value after remount
+ */
+static bool test_power_fail(void) {
+    sim_flash_t sim;
+    kv_flash_t flash;
+    kv_store_t kv;
+    model_t pending, found;
+    int32_t fail;
+    int i, key = 0;
+    syserr_t err;
+    for (fail = 0; fail < 1500; fail++) {
+        sim_flash_init(&sim, &flash, 512, 4);
+        if (kv_mount(&kv, &flash, index_store, INDEX_LEN) != SYS_OK) {
+            return false;
+        }
+        for (i = 0; i < NUM_KEYS; i++) {
+            set_key(&kv, i, i);
+        }
+        /* Updates and deletes until power fails */
+        sim_flash_fail_after(&sim, fail);
+        err = SYS_OK;
+        for (i = 0; err == SYS_OK && i < 200; i++) {
+            key = (i * 5) % NUM_KEYS;
+            if (i % 11 == 10) {
+                pending.len = -1;
+                err = kv_delete(&kv, key_name(key));
+                if (err == ERR_NOTFOUND) {
+                    err = SYS_OK;
+                }
+            } else {
+                pending.len = make_value(pending.val, fail + i * 31);
+                err = kv_set(&kv, key_name(key), pending.val, pending.len);
+            }
+            if (err == SYS_OK) {
+                model[key] = pending;
+            }
+        }
+        sim_flash_power_on(&sim);
+        if (kv_mount(&kv, &flash, index_store, INDEX_LEN) != SYS_OK) {
+            printf("Mount failed after failure %d\n", fail);
+            return false;
+        }
+        if (err != SYS_OK) {
+            /* The interrupted write may or may not have landed */
+            memset(&found, 0, sizeof(found));
+            found.len = kv_get(&kv, key_name(key), found.val,
+                               sizeof(found.val), &err);
+            if (err == ERR_NOTFOUND) {
+                found.len = -1;
+            }
+            if (model_equal(&found, &pending)) {
+                model[key] = pending;
+            }
+        }
+        if (!check_model(&kv) || sim.violations != 0) {
+            printf("Failure at operation %d was not recovered\n", fail);
+            return false;
+        }
+        /* The recovered store must still accept writes */
+        for (i = 0; i < NUM_KEYS; i++) {
+            if (set_key(&kv, i, i + 7) != SYS_OK) {
+                printf("Write failed after failure %d\n", fail);
+                return false;
+            }
+        }
+        if (kv_mount(&kv, &flash, index_store, INDEX_LEN) != SYS_OK ||
+            !check_model(&kv) || sim.violations != 0) {
+            printf("Store corrupt after failure %d\n", fail);
+            return false;
+        }
+        sim_flash_free(&sim);
+    }
+    return true;
+}
+
+/**
+ * Fills the index and the store
+ */
+static bool test_full(void) {
+    sim_flash_t sim;
+    kv_flash_t flash;
+    kv_store_t kv;
+    kv_index_entry_t small_index[4];
+    uint8_t big[400];
+    char key[16];
+    syserr_t err = SYS_OK;
+    bool passed = true;
+    int i;
+    sim_flash_init(&sim, &flash, 512, 4);
+    passed &= kv_mount(&kv, &flash, small_index, 4) == SYS_OK;
+    passed &= kv_set(&kv, "a", "1", 1) == SYS_OK;
+    passed &= kv_set(&kv, "b", "2", 1) == SYS_OK;
+    passed &= kv_set(&kv, "c", "3", 1) == SYS_OK;
+    passed &= kv_set(&kv, "d", "4", 1) == ERR_NOMEM;
+    // Updates to existing keys still work
+    passed &= kv_set(&kv, "a", "5", 1) == SYS_OK;
+    passed &= kv_mount(&kv, &flash, index_store, INDEX_LEN) == SYS_OK;
+    memset(big, 0x5A, sizeof(big));
+    for (i = 0; i < INDEX_LEN && err == SYS_OK; i++) {
+        snprintf(key, sizeof(key), "big%d", i);
+        err = kv_set(&kv, key, big, sizeof(big));
+    }
+    passed &= err == ERR_NOMEM;
+    // Values larger than a page are rejected
+    passed &= kv_set(&kv, "huge", big, 500) == ERR_BADPARAM;
+    passed &= sim.violations == 0;
+    sim_flash_free(&sim);
+    return passed;
+}
+
+int main() {
+    int failures = 0;
+    if (test_basic()) {
+        printf("Test 1 passed: set, get and delete behaved correctly\n");
+    } else {
+        printf("Test 1 failed\n");
+        failures++;
+    }
+    if (test_remount()) {
+        printf("Test 2 passed: remount restored all keys\n");
+    } else {
+        printf("Test 2 failed\n");
+        failures++;
+    }
+    if (test_wear()) {
+        printf("Test 3 passed: wear levelled across pages\n");
+    } else {
+        printf("Test 3 failed\n");
+        failures++;
+    }
+    if (test_power_fail()) {
+        printf("Test 4 passed: every power failure point recovered\n");
+    } else {
+        printf("Test 4 failed\n");
+        failures++;
+    }
+    if (test_full()) {
+        printf("Test 5 passed: full index and full store were rejected\n");
+    } else {
+        printf("Test 5 failed\n");
+        failures++;
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file rtos_stub.c
+ * Stubs the RTOS services used by the key-value store, for host builds.
+ * The RTOS never runs on the host, so the store never waits on its lock.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <sys/isr/isr.h>
+#include <sys/semaphore/semaphore.h>
+#include <sys/task/task.h>
+
+bool rtos_started() { return false; }
+
+void mask_irq() {}
+
+void unmask_irq() {}
+
+semaphore_t semaphore_create_binary() { return NULL; }
+
+syserr_t semaphore_pend(semaphore_t sem, int delay) { abort(); }
+
+void semaphore_post(semaphore_t sem) { abort(); }
+
+syserr_t semaphore_destroy(semaphore_t sem) { abort(); }
@@ -0,0 +1,172 @@
+/**
+ * @file sim_flash.c
+ * Simulated NOR flash backend for the key-value store, for host builds.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_flash.h"
+
+#define SIM_DWORD 8
+
+/**
+ * Counts an operation against the pending power failure
+ * @param sim: simulated flash
+ * @return true if power fails during this operation
+ */
+static bool sim_power_fails(sim_flash_t *sim) {
+    if (sim->fail_after < 0) {
+        return false;
+    }
+    if (sim->fail_after-- == 0) {
+        sim->powered = false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Reads from simulated flash
+ * @param ctx: simulated flash
+ * @param offset: offset to read at
+ * @param buf: buffer to read into
+ * @param len: length to read
+ * @return SYS_OK, or ERR_DEVICE without power
+ */
+static syserr_t sim_read(void *ctx, uint32_t offset, void *buf,
+                         uint32_t len) {
+    sim_flash_t *sim = ctx;
+    if (!sim->powered) {
+        return ERR_DEVICE;
+    }
+    if (offset + len > sim->page_size * sim->num_pages) {
+        abort();
+    }
+    memcpy(buf, sim->mem + offset, len);
+    return SYS_OK;
+}
+
+/**
+ * Programs simulated flash, one double word at a time
+ * @param ctx: simulated flash
+ * @param offset: offset to program at
+ * @param buf: data to program
+ * @param len: length of data
+ * @return SYS_OK, or ERR_DEVICE without power or if flash is not erased
+ */
+static syserr_t sim_program(void *ctx, uint32_t offset, const void *buf,
+                            uint32_t len) {
+    sim_flash_t *sim = ctx;
+    const uint8_t *src = buf;
+    uint32_t i, j;
+    if (!sim->powered) {
+        return ERR_DEVICE;
+    }
+    if (offset % SIM_DWORD || len % SIM_DWORD ||
+        offset + len > sim->page_size * sim->num_pages) {
+        abort();
+    }
+    for (i = 0; i < len; i += SIM_DWORD) {
+        for (j = 0; j < SIM_DWORD; j++) {
+            if (sim->mem[offset + i + j] != 0xFF) {
+                sim->violations++;
+                return ERR_DEVICE;
+            }
+        }
+        if (sim_power_fails(sim)) {
+            // Half of the double word is programmed
+            for (j = 0; j < SIM_DWORD / 2; j++) {
+                sim->mem[offset + i + j] &= src[i + j];
+            }
+            return ERR_DEVICE;
+        }
+        for (j = 0; j < SIM_DWORD; j++) {
+            sim->mem[offset + i + j] &= src[i + j];
+        }
+        sim->programs++;
+    }
+    return SYS_OK;
+}
+
+/**
+ * Erases a simulated flash page
+ * @param ctx: simulated flash
+ * @param page: page to erase
+ * @return SYS_OK, or ERR_DEVICE without power
+ */
+static syserr_t sim_erase(void *ctx, uint32_t page) {
+    sim_flash_t *sim = ctx;
+    if (!sim->powered) {
+        return ERR_DEVICE;
+    }
+    if (page >= sim->num_pages) {
+        abort();
+    }
+    if (sim_power_fails(sim)) {
+        // The end of the page is erased, the start is not
+        memset(sim->mem + page * sim->page_size + sim->page_size / 2, 0xFF,
+               sim->page_size / 2);
+        return ERR_DEVICE;
+    }
+    memset(sim->mem + page * sim->page_size, 0xFF, sim->page_size);
+    sim->erase_counts[page]++;
+    sim->erases++;
+    return SYS_OK;
+}
+
+/**
+ * Creates a simulated flash, and a backend using it. Flash starts erased.
+ * @param sim: simulated flash to create
+ * @param flash: backend to initialize
+ * @param page_size: page size
+ * @param num_pages: number of pages
+ */
+void sim_flash_init(sim_flash_t *sim, kv_flash_t *flash, uint32_t page_size,
+                    uint32_t num_pages) {
+    memset(sim, 0, sizeof(*sim));
+    sim->page_size = page_size;
+    sim->num_pages = num_pages;
+    sim->mem = malloc(page_size * num_pages);
+    sim->erase_counts = calloc(num_pages, sizeof(uint32_t));
+    if (sim->mem == NULL || sim->erase_counts == NULL) {
+        abort();
+    }
+    memset(sim->mem, 0xFF, page_size * num_pages);
+    sim->fail_after = -1;
+    sim->powered = true;
+    flash->read = sim_read;
+    flash->program = sim_program;
+    flash->erase = sim_erase;
+    flash->ctx = sim;
+    flash->page_size = page_size;
+    flash->num_pages = num_pages;
+}
+
+/**
+ * Frees a simulated flash
+ * @param sim: simulated flash to free
+ */
+void sim_flash_free(sim_flash_t *sim) {
+    free(sim->mem);
+    free(sim->erase_counts);
+}
+
+/**
+ * Fails power after a number of program or erase operations. The failing
+ * operation is left half complete, and all later operations fail until
+ * sim_flash_power_on is called.
+ * @param sim: simulated flash
+ * @param ops: operations to allow before failing
+ */
+void sim_flash_fail_after(sim_flash_t *sim, int32_t ops) {
+    sim->fail_after = ops;
+}
+
+/**
+ * Restores power to a simulated flash, cancelling any pending failure
+ * @param sim: simulated flash
+ */
+void sim_flash_power_on(sim_flash_t *sim) {
+    sim->fail_after = -1;
+    sim->powered = true;
+}
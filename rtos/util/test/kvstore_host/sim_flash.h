@@ -0,0 +1,65 @@
+/**
+ * @file sim_flash.h
+ * Simulated NOR flash backend for the key-value store, for host builds.
+ *
+ * Programming follows the internal flash rules: only erased, aligned
+ * double words may be programmed. A power failure can be injected after a
+ * set number of double word programs or page erases, leaving the failing
+ * operation half complete.
+ */
+
+#ifndef SIM_FLASH_H
+#define SIM_FLASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <util/kvstore/kvstore.h>
+
+/**
+ * Simulated flash state
+ */
+typedef struct {
+    uint8_t *mem;            /*!< Flash contents */
+    uint32_t page_size;      /*!< Page size */
+    uint32_t num_pages;      /*!< Number of pages */
+    uint32_t *erase_counts;  /*!< Erase count of each page */
+    uint32_t programs;       /*!< Double words programmed */
+    uint32_t erases;         /*!< Pages erased */
+    uint32_t violations;     /*!< Programs to non erased flash */
+    int32_t fail_after;      /*!< Operations until power fails, or -1 */
+    bool powered;            /*!< Cleared when power fails */
+} sim_flash_t;
+
+/**
+ * Creates a simulated flash, and a backend using it. Flash starts erased.
+ * @param sim: simulated flash to create
+ * @param flash: backend to initialize
+ * @param page_size: page size
+ * @param num_pages: number of pages
+ */
+void sim_flash_init(sim_flash_t *sim, kv_flash_t *flash, uint32_t page_size,
+                    uint32_t num_pages);
+
+/**
+ * Frees a simulated flash
+ * @param sim: simulated flash to free
+ */
+void sim_flash_free(sim_flash_t *sim);
+
+/**
+ * Fails power after a number of program or erase operations. The failing
+ * operation is left half complete, and all later operations fail until
+ * sim_flash_power_on is called.
+ * @param sim: simulated flash
+ * @param ops: operations to allow before failing
+ */
+void sim_flash_fail_after(sim_flash_t *sim, int32_t ops);
+
+/**
+ * Restores power to a simulated flash, cancelling any pending failure
+ * @param sim: simulated flash
+ */
+void sim_flash_power_on(sim_flash_t *sim);
+
+#endif
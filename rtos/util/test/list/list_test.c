@@ -101,6 +101,7 @@ void destructor(void *elem) {
 int main() {
     system_init();
     struct list_entry *ret;
+    list_state_t *pos, *next;
     int i;
     // Make list
     list_t list = NULL;
@@ -108,7 +109,7 @@ int main() {
         // Populate list entry
         elements[i].data = data + i;
         // Append to list
-        list = list_append(list, (elements + i), &elements[i].state);
+        list = list_append(list, &elements[i].state);
         if (list == NULL) {
             LOG_E(TAG, "List return value was null");
             exit(ERR_FAIL);
@@ -119,7 +120,7 @@ int main() {
            "Expected printout: %s\n"
            "Actual printout: ",
            data);
-    ret = list_iterate(list, print_iterator);
+    ret = list_iterate(list, print_iterator, struct list_entry, state);
     printf("\n");
     if ((struct list_entry *)ret != &elements[i - 1]) {
         // returned value should have been last list entry
@@ -129,8 +130,7 @@ int main() {
     }
     // Test list prepending
     elements[sizeof(data)].data = &data[0];
-    list = list_prepend(list, &elements[sizeof(data)],
-                        &elements[sizeof(data)].state);
+    list = list_prepend(list, &elements[sizeof(data)].state);
     if (list == NULL) {
         LOG_E(TAG, "List return value was null");
         exit(ERR_FAIL);
@@ -140,7 +140,7 @@ int main() {
            "Expected printout: %c%s\n"
            "Actual printout: ",
            data[0], data);
-    ret = list_iterate(list, print_iterator);
+    ret = list_iterate(list, print_iterator, struct list_entry, state);
     printf("\n");
     if (ret != &elements[i - 1]) {
         // returned value should have been last list entry
@@ -150,7 +150,7 @@ int main() {
     }
     // Verify that list iteration can find a value
     printf("Test 3: valid list iteration\n");
-    ret = list_iterate(list, find_first_D);
+    ret = list_iterate(list, find_first_D, struct list_entry, state);
     if (ret != &elements[5]) {
         LOG_E(TAG, "Test 3 failed");
         exit(ERR_FAIL);
@@ -168,7 +168,7 @@ int main() {
     }
     printf("List contents: ");
     // Verify that list does not have first D
-    ret = list_iterate(list, print_iterator);
+    ret = list_iterate(list, print_iterator, struct list_entry, state);
     if ((struct list_entry *)ret != &elements[i - 1]) {
         // returned value should have been last list entry
         LOG_E(TAG, "Iterator has bad return value. Expected %p, got %p",
@@ -178,13 +178,13 @@ int main() {
     printf("\n");
     // Verify that list can handle another append
     printf("Test 5: List append after remove\n");
-    list = list_append(list, &elements[5], &elements[5].state);
+    list = list_append(list, &elements[5].state);
     if (list == NULL) {
         LOG_E(TAG, "List return value was null");
         exit(ERR_FAIL);
     } else {
         printf("Test 5 passed\nList contents: ");
-        ret = list_iterate(list, print_iterator);
+        ret = list_iterate(list, print_iterator, struct list_entry, state);
         if ((struct list_entry *)ret != &elements[5]) {
             // returned value should have been last list entry
             LOG_E(TAG, "Iterator has bad return value. Expected %p, got %p",
@@ -195,12 +195,12 @@ int main() {
     }
     printf("Test 6: Removing Ts. If the list printed has any 'T' or 't's in\n"
            "it, this test failed\nList Contents:\n");
-    list = list_filter(list, remove_t, destructor);
+    list = list_filter(list, remove_t, destructor, struct list_entry, state);
     if (list == NULL) {
         LOG_E(TAG, "Test 6 failed\n");
         exit(ERR_FAIL);
     }
-    ret = list_iterate(list, print_iterator);
+    ret = list_iterate(list, print_iterator, struct list_entry, state);
     if (ret != &elements[5]) {
         LOG_E(TAG, "Test 6 failed");
         exit(ERR_FAIL);
@@ -211,7 +211,7 @@ int main() {
         "This test should print out the list contents as they are removed\n");
     i = 0;
     while (list != NULL) {
-        ret = list_get_head(list);
+        ret = list_get_head(list, struct list_entry, state);
         printf("%c", *((char *)ret->data));
         list = list_remove(list, &(ret->state));
         i++;
@@ -222,6 +222,31 @@ int main() {
     } else {
         printf("Test 7 failed\n");
     }
+    printf("Test 8: Inline removal\n"
+           "This test removes every element but the 'D' within the loop\n");
+    for (i = 0; i < sizeof(data) - 1; i++) {
+        list = list_append(list, &elements[i].state);
+    }
+    // The first five elements are removed in a row, each as the list head
+    LIST_FOR_EACH_SAFE(list, pos, next) {
+        ret = LIST_ENTRY(pos, struct list_entry, state);
+        if (*ret->data != 'D') {
+            list = list_remove(list, pos);
+        }
+    }
+    i = 0;
+    LIST_FOR_EACH(list, pos) {
+        ret = LIST_ENTRY(pos, struct list_entry, state);
+        printf("%c", *ret->data);
+        i++;
+    }
+    printf("\n");
+    ret = list_get_head(list, struct list_entry, state);
+    if (i == 1 && ret == &elements[5]) {
+        printf("Test 8 passed\n");
+    } else {
+        printf("Test 8 failed\n");
+    }
     printf("If expected outputs matched actual, all tests passed\n");
     return SYS_OK;
 }
\ No newline at end of file
@@ -0,0 +1,194 @@
+/**
+ * @file list_host_test.c
+ * Tests the linked list against the same sequence as the target list test,
+ * checking the element order after each step. Built and run on the host,
+ * see Makefile.
+ *
+ * Expected output:
+ * Test 1 passed: appended elements iterate in order
+ * Test 2 passed: prepended element iterates first
+ * Test 3 passed: iteration stopped at the first 'D'
+ * Test 4 passed: removed element no longer iterates
+ * Test 5 passed: filter removed every 'T' and 't'
+ * Test 6 passed: head and tail found, and all elements removed
+ * Test 7 passed: inline removal left only the 'D'
+ * Test 8 passed: list state holds only the links
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/list/list.h>
+
+/**
+ * List element. The list state is deliberately not the first member, so
+ * elements are only found correctly if the member offset is honoured.
+ */
+struct list_entry {
+    char data;
+    uint32_t pad;
+    list_state_t state;
+};
+
+static const char data[] = "Test Data elements";
+static struct list_entry elements[sizeof(data) + 1];
+static char printout[sizeof(data) * 2];
+static uint32_t printout_len;
+static uint32_t destroyed;
+
+/**
+ * Records each element of the list
+ */
+static list_return_t print_iterator(void *elem) {
+    printout[printout_len++] = ((struct list_entry *)elem)->data;
+    printout[printout_len] = '\0';
+    return LST_CONT;
+}
+
+/**
+ * Stops iteration at the first 'D'
+ */
+static list_return_t find_first_D(void *elem) {
+    return ((struct list_entry *)elem)->data == 'D' ? LST_BRK : LST_CONT;
+}
+
+/**
+ * Removes all list elements that are a T or t
+ */
+static list_return_t remove_t(void *elem) {
+    char ch = ((struct list_entry *)elem)->data;
+    return (ch == 'T' || ch == 't') ? LST_REM : LST_CONT;
+}
+
+/**
+ * Counts removed elements, failing the test if any is not a T or t
+ */
+static void destructor(void *elem) {
+    char ch = ((struct list_entry *)elem)->data;
+    destroyed += (ch == 'T' || ch == 't') ? 1 : 1000;
+}
+
+/**
+ * Records the contents of a list
+ * @param list: list to record
+ * @return last element iterated over
+ */
+static struct list_entry *print_list(list_t list) {
+    printout_len = 0;
+    printout[0] = '\0';
+    return list_iterate(list, print_iterator, struct list_entry, state);
+}
+
+/**
+ * Builds a list of every character in data
+ * @return new list
+ */
+static list_t make_list(void) {
+    list_t list = NULL;
+    uint32_t i;
+    for (i = 0; i < sizeof(data) - 1; i++) {
+        elements[i].data = data[i];
+        list = list_append(list, &elements[i].state);
+    }
+    return list;
+}
+
+int main() {
+    struct list_entry *ret, *tail;
+    list_state_t *pos, *next;
+    int failures = 0;
+    uint32_t i;
+    list_t list = make_list();
+    // Append
+    ret = print_list(list);
+    if (strcmp(printout, data) == 0 && ret == &elements[sizeof(data) - 2]) {
+        printf("Test 1 passed: appended elements iterate in order\n");
+    } else {
+        printf("Test 1 failed: got \"%s\"\n", printout);
+        failures++;
+    }
+    // Prepend
+    elements[sizeof(data)].data = data[0];
+    list = list_prepend(list, &elements[sizeof(data)].state);
+    ret = print_list(list);
+    if (strcmp(printout, "TTest Data elements") == 0 &&
+        ret == &elements[sizeof(data) - 2]) {
+        printf("Test 2 passed: prepended element iterates first\n");
+    } else {
+        printf("Test 2 failed: got \"%s\"\n", printout);
+        failures++;
+    }
+    // Early exit from iteration
+    ret = list_iterate(list, find_first_D, struct list_entry, state);
+    if (ret == &elements[5]) {
+        printf("Test 3 passed: iteration stopped at the first 'D'\n");
+    } else {
+        printf("Test 3 failed\n");
+        failures++;
+    }
+    // Removal, then append of the removed element
+    list = list_remove(list, &ret->state);
+    print_list(list);
+    if (strcmp(printout, "TTest ata elements") == 0) {
+        printf("Test 4 passed: removed element no longer iterates\n");
+    } else {
+        printf("Test 4 failed: got \"%s\"\n", printout);
+        failures++;
+    }
+    list = list_append(list, &elements[5].state);
+    // Filter, including elements at the list head
+    list = list_filter(list, remove_t, destructor, struct list_entry, state);
+    ret = print_list(list);
+    if (strcmp(printout, "es aa elemensD") == 0 && destroyed == 5 &&
+        ret == &elements[5]) {
+        printf("Test 5 passed: filter removed every 'T' and 't'\n");
+    } else {
+        printf("Test 5 failed: got \"%s\"\n", printout);
+        failures++;
+    }
+    // Head and tail, then removal of all elements from the head
+    ret = list_get_head(list, struct list_entry, state);
+    tail = list_get_tail(list, struct list_entry, state);
+    i = 0;
+    if (ret == &elements[1] && tail == &elements[5]) {
+        while ((ret = list_get_head(list, struct list_entry, state)) != NULL) {
+            list = list_remove(list, &ret->state);
+            i++;
+        }
+    }
+    if (i == 14 && list_get_tail(list, struct list_entry, state) == NULL) {
+        printf("Test 6 passed: head and tail found, and all elements "
+               "removed\n");
+    } else {
+        printf("Test 6 failed\n");
+        failures++;
+    }
+    // Inline removal, starting with several heads in a row
+    list = make_list();
+    LIST_FOR_EACH_SAFE(list, pos, next) {
+        if (LIST_ENTRY(pos, struct list_entry, state)->data != 'D') {
+            list = list_remove(list, pos);
+        }
+    }
+    i = 0;
+    LIST_FOR_EACH(list, pos) { i++; }
+    ret = list_get_head(list, struct list_entry, state);
+    if (i == 1 && ret == &elements[5]) {
+        printf("Test 7 passed: inline removal left only the 'D'\n");
+    } else {
+        printf("Test 7 failed\n");
+        failures++;
+    }
+    // Node size
+    if (sizeof(list_state_t) == 2 * sizeof(void *)) {
+        printf("Test 8 passed: list state holds only the links\n");
+    } else {
+        printf("Test 8 failed: list state is %zu bytes\n",
+               sizeof(list_state_t));
+        failures++;
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file mpsc_host_test.c
+ * Tests the multi-producer single-consumer queue with the C11 atomics
+ * variant, using threads as producers. Built and run on the host, see
+ * Makefile.
+ *
+ * Expected output:
+ * Test 1 passed: empty queue pops nothing
+ * Test 2 passed: elements pop in push order
+ * Test 3 passed: queue refilled after being emptied
+ * Test 4 passed: concurrent producers lost and reordered nothing
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <util/mpsc/mpsc.h>
+
+#define NUM_PRODUCERS 4
+#define PER_PRODUCER 200000
+#define NUM_ELEMS 64
+
+/**
+ * Queue element. The node is deliberately not the first member, so elements
+ * are only found correctly if the member offset is honoured.
+ */
+struct event {
+    uint32_t producer;
+    uint32_t seq;
+    mpsc_node_t node;
+};
+
+static struct event events[NUM_PRODUCERS][PER_PRODUCER];
+static mpsc_queue_t queue;
+
+/**
+ * Pops one element
+ * @return element popped, or NULL if none could be
+ */
+static struct event *pop(void) {
+    mpsc_node_t *node = mpsc_pop(&queue);
+    return node == NULL ? NULL : MPSC_ENTRY(node, struct event, node);
+}
+
+/**
+ * Producer thread. Pushes its events in sequence order.
+ * @param arg: producer index
+ */
+static void *producer(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    uint32_t i;
+    for (i = 0; i < PER_PRODUCER; i++) {
+        events[index][i].producer = index;
+        events[index][i].seq = i;
+        mpsc_push(&queue, &events[index][i].node);
+    }
+    return NULL;
+}
+
+static bool test_empty(void) {
+    mpsc_init(&queue);
+    return pop() == NULL && pop() == NULL;
+}
+
+/**
+ * Pushes elements from one producer and pops them all
+ * @param count: number of elements to push
+ * @return true if they popped in order, and nothing more popped after
+ */
+static bool push_pop(uint32_t count) {
+    struct event *ev;
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        events[0][i].seq = i;
+        mpsc_push(&queue, &events[0][i].node);
+    }
+    for (i = 0; i < count; i++) {
+        ev = pop();
+        if (ev != &events[0][i]) {
+            return false;
+        }
+    }
+    return pop() == NULL;
+}
+
+static bool test_order(void) {
+    mpsc_init(&queue);
+    return push_pop(NUM_ELEMS);
+}
+
+static bool test_refill(void) {
+    uint32_t i;
+    // Each element passes through the queue alone, and then in small groups
+    mpsc_init(&queue);
+    for (i = 1; i < NUM_ELEMS; i++) {
+        if (!push_pop(1) || !push_pop(i % 4 + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool test_concurrent(void) {
+    pthread_t threads[NUM_PRODUCERS];
+    uint32_t next[NUM_PRODUCERS] = {0};
+    uint32_t i, total = 0;
+    struct event *ev;
+    mpsc_init(&queue);
+    for (i = 0; i < NUM_PRODUCERS; i++) {
+        if (pthread_create(&threads[i], NULL, producer, (void *)(uintptr_t)i)) {
+            return false;
+        }
+    }
+    // Pop concurrently with the producers, until every event has arrived
+    while (total < NUM_PRODUCERS * PER_PRODUCER) {
+        ev = pop();
+        if (ev == NULL) {
+            continue;
+        }
+        // Each producer's events must arrive in the order it pushed them
+        if (ev->seq != next[ev->producer]) {
+            return false;
+        }
+        next[ev->producer]++;
+        total++;
+    }
+    for (i = 0; i < NUM_PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    return pop() == NULL;
+}
+
+int main() {
+    int failures = 0;
+    if (test_empty()) {
+        printf("Test 1 passed: empty queue pops nothing\n");
+    } else {
+        printf("Test 1 failed\n");
+        failures++;
+    }
+    if (test_order()) {
+        printf("Test 2 passed: elements pop in push order\n");
+    } else {
+        printf("Test 2 failed\n");
+        failures++;
+    }
+    if (test_refill()) {
+        printf("Test 3 passed: queue refilled after being emptied\n");
+    } else {
+        printf("Test 3 failed\n");
+        failures++;
+    }
+    if (test_concurrent()) {
+        printf("Test 4 passed: concurrent producers lost and reordered "
+               "nothing\n");
+    } else {
+        printf("Test 4 failed\n");
+        failures++;
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}